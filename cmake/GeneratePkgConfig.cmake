@@ -46,6 +46,10 @@ function(generate_pkg_config_pc_file TARGET TEMPLATE template OUTPUT output)
                 "-lmsvcrt" "-lpthread" "-ladvapi32" "-lshell32" "-luser32" "-lkernel32")
         endif()
 
+        if(CMAKE_THREAD_LIBS_INIT)
+            list(APPEND LIBS_LIST "${CMAKE_THREAD_LIBS_INIT}")
+        endif()
+
         if(ARIBCC_USE_FREETYPE AND NOT ARIBCC_USE_EMBEDDED_FREETYPE)
             # Only required for system-wide installed FreeType
             list(APPEND REQUIRES_LIST "freetype2")
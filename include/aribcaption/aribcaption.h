@@ -24,11 +24,14 @@
 #include "context.h"
 #include "color.h"
 #include "caption.h"
+#include "caption_serializer.h"
 #include "decoder.h"
+#include "subtitle_writer.h"
 
 #ifndef ARIBCC_NO_RENDERER
 #include "image.h"
 #include "renderer.h"
+#include "pgs_writer.h"
 #endif  // ARIBCC_NO_RENDERER
 
 #endif  // ARIBCAPTION_ARIBCAPTION_H
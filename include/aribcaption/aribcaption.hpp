@@ -24,11 +24,14 @@
 #include "context.hpp"
 #include "color.hpp"
 #include "caption.hpp"
+#include "caption_serializer.hpp"
 #include "decoder.hpp"
+#include "subtitle_writer.hpp"
 
 #ifndef ARIBCC_NO_RENDERER
 #include "image.hpp"
 #include "renderer.hpp"
+#include "pgs_writer.hpp"
 #endif  // ARIBCC_NO_RENDERER
 
 #endif  // ARIBCAPTION_ARIBCAPTION_HPP
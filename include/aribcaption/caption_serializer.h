@@ -0,0 +1,58 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_CAPTION_SERIALIZER_H
+#define ARIBCAPTION_CAPTION_SERIALIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "aribcc_export.h"
+#include "caption.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Serialize a caption into the compact relocatable binary layout, e.g. for passing it through shared memory
+ *
+ * The layout is described in caption_serializer.hpp. Call with NULL buffer to query the required size.
+ *
+ * @param caption   @aribcc_caption_t
+ * @param buffer    Destination buffer, should be 8-byte aligned if it will be read in place. Could be NULL.
+ * @param capacity  Size of the destination buffer in bytes
+ * @return bytes written (or required if buffer is NULL), 0 if the buffer is too small or the caption is too large
+ */
+ARIBCC_API size_t aribcc_caption_serialize(const aribcc_caption_t* caption, void* buffer, size_t capacity);
+
+/**
+ * Validate a serialized caption, including all the offsets, ranges, alignments and enum values
+ *
+ * @param data  Serialized caption, must be 8-byte aligned
+ * @param size  Size of the data in bytes
+ * @return false if the data is malformed, truncated, misaligned or of an unsupported version
+ */
+ARIBCC_API bool aribcc_caption_validate_serialized(const void* data, size_t size);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ARIBCAPTION_CAPTION_SERIALIZER_H
@@ -0,0 +1,198 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_CAPTION_SERIALIZER_HPP
+#define ARIBCAPTION_CAPTION_SERIALIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "aribcc_export.h"
+#include "caption.hpp"
+
+namespace aribcaption {
+
+/**
+ * Compact binary layout of a Caption, for passing captions across processes (e.g. through shared memory)
+ *
+ * The layout is relocatable: it contains no pointers, every array is referenced by an offset from the beginning
+ * of the buffer. A serialized caption begins with a @SerializedCaptionHeader, followed by arrays of
+ * @SerializedCaptionRegion, @SerializedCaptionStyleRun, @SerializedCaptionChar and @SerializedCaptionDRCS,
+ * followed by a byte pool containing the text, DRCS pixels and other strings.
+ *
+ * Characters of a region sharing the same sizes, scales, colors and styles are grouped into a style run,
+ * so per-char entries only carry codepoints and positions. Style runs of regions and chars of style runs are
+ * stored contiguously in order, each entry belongs to exactly one region or style run.
+ *
+ * All the integers are in the byte order of the writer, a reader with another byte order rejects the buffer
+ * by the magic. Arrays are 4-byte aligned, the buffer itself must be 8-byte aligned for reading in place.
+ * Validate the buffer by @ValidateSerializedCaption() before reading it in place.
+ */
+constexpr uint32_t kSerializedCaptionMagic = 0x43434241;  // "ABCC" in little endian
+
+/**
+ * Version of the layout, bumped on incompatible changes
+ *
+ * Compatible extensions only append fields to the end of the header (see header_size).
+ */
+constexpr uint16_t kSerializedCaptionVersion = 1;
+
+/**
+ * Range inside a serialized caption, offset is counted from the beginning of the buffer
+ */
+struct SerializedCaptionSpan {
+    uint32_t offset;
+    uint32_t count;     ///< count of elements for arrays, or size in bytes for the byte pool
+};
+
+struct SerializedCaptionHeader {
+    uint32_t magic;                     ///< kSerializedCaptionMagic
+    uint16_t version;                   ///< kSerializedCaptionVersion
+    uint16_t header_size;               ///< sizeof(SerializedCaptionHeader) of the writer
+    uint32_t total_size;                ///< size of the whole serialized caption in bytes
+    uint8_t type;                       ///< CaptionType
+    uint8_t flags;                      ///< CaptionFlags
+    uint8_t has_builtin_sound;
+    uint8_t builtin_sound_id;
+    int64_t pts;
+    int64_t wait_duration;
+    uint32_t iso6392_language_code;
+    int32_t plane_width;
+    int32_t plane_height;
+    SerializedCaptionSpan text;         ///< UTF-8 bytes in the byte pool, followed by a '\0'
+    SerializedCaptionSpan regions;      ///< array of SerializedCaptionRegion
+    SerializedCaptionSpan style_runs;   ///< array of SerializedCaptionStyleRun
+    SerializedCaptionSpan chars;        ///< array of SerializedCaptionChar
+    SerializedCaptionSpan drcs;         ///< array of SerializedCaptionDRCS, sorted by code
+    uint32_t reserved;
+};
+
+struct SerializedCaptionRegion {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    uint32_t first_style_run;           ///< index into the style_runs array
+    uint32_t style_run_count;
+    uint8_t is_ruby;
+    uint8_t reserved[7];
+};
+
+struct SerializedCaptionStyleRun {
+    uint32_t first_char;                ///< index into the chars array
+    uint32_t char_count;
+    int32_t char_width;
+    int32_t char_height;
+    int32_t char_horizontal_spacing;
+    int32_t char_vertical_spacing;
+    float char_horizontal_scale;
+    float char_vertical_scale;
+    uint32_t text_color;                ///< ColorRGBA::u32
+    uint32_t back_color;                ///< ColorRGBA::u32
+    uint32_t stroke_color;              ///< ColorRGBA::u32
+    uint8_t style;                      ///< CharStyle
+    uint8_t enclosure_style;            ///< EnclosureStyle
+    uint8_t reserved[2];
+};
+
+struct SerializedCaptionChar {
+    uint32_t codepoint;
+    uint32_t pua_codepoint;
+    uint32_t drcs_code;
+    int32_t x;
+    int32_t y;
+    uint8_t type;                       ///< CaptionCharType
+    uint8_t reserved[3];
+    char u8str[8];
+};
+
+struct SerializedCaptionDRCS {
+    uint32_t code;                      ///< key in Caption::drcs_map
+    int32_t width;
+    int32_t height;
+    int32_t depth;
+    int32_t depth_bits;
+    uint32_t alternative_ucs4;
+    SerializedCaptionSpan pixels;       ///< bytes in the byte pool
+    SerializedCaptionSpan md5;          ///< bytes in the byte pool, followed by a '\0'
+    SerializedCaptionSpan alternative_text;  ///< bytes in the byte pool, followed by a '\0'
+};
+
+/**
+ * Calculate size of the serialized caption in bytes
+ *
+ * @return size in bytes, or 0 if the caption is too large (exceeds 4 GiB) for the layout
+ */
+ARIBCC_API size_t GetSerializedCaptionSize(const Caption& caption);
+
+/**
+ * Serialize a caption into a caller provided buffer, e.g. a shared memory segment
+ *
+ * @param caption   Caption to serialize
+ * @param buffer    Destination buffer, should be 8-byte aligned if it will be read in place
+ * @param capacity  Size of the destination buffer in bytes
+ * @return bytes written, or 0 if the buffer is too small (see @GetSerializedCaptionSize())
+ */
+ARIBCC_API size_t SerializeCaption(const Caption& caption, void* buffer, size_t capacity);
+
+/**
+ * Serialize a caption into a byte vector
+ *
+ * @param caption       Caption to serialize
+ * @param out_buffer    Write back parameter, resized to the serialized size
+ * @return false if the caption is too large for the layout
+ */
+ARIBCC_API bool SerializeCaption(const Caption& caption, std::vector<uint8_t>& out_buffer);
+
+/**
+ * Validate a serialized caption, including all the offsets, ranges, alignments and enum values
+ *
+ * Style runs and chars must be referenced contiguously in order, so the deserialized caption never has more
+ * chars than the buffer contains.
+ *
+ * @param data  Serialized caption, must be 8-byte aligned
+ * @param size  Size of the data in bytes
+ * @return Header of the serialized caption for reading in place, or nullptr if the data is malformed,
+ *         truncated, misaligned or of an unsupported version
+ */
+ARIBCC_API const SerializedCaptionHeader* ValidateSerializedCaption(const void* data, size_t size);
+
+/**
+ * Retrieve an array or the byte pool of a validated serialized caption
+ *
+ * e.g. GetSerializedCaptionArray<SerializedCaptionChar>(header, header->chars)
+ */
+template <class T>
+inline const T* GetSerializedCaptionArray(const SerializedCaptionHeader* header, SerializedCaptionSpan span) {
+    return reinterpret_cast<const T*>(reinterpret_cast<const uint8_t*>(header) + span.offset);
+}
+
+/**
+ * Deserialize a serialized caption into a Caption
+ *
+ * @param data          Serialized caption, must be 8-byte aligned
+ * @param size          Size of the data in bytes
+ * @param out_caption   Write back parameter
+ * @return false if the data is invalid, see @ValidateSerializedCaption()
+ */
+ARIBCC_API bool DeserializeCaption(const void* data, size_t size, Caption& out_caption);
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_CAPTION_SERIALIZER_HPP
@@ -20,9 +20,11 @@
 #ifndef ARIBCAPTION_IMAGE_H
 #define ARIBCAPTION_IMAGE_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include "aribcc_export.h"
+#include "color.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -31,10 +33,14 @@ extern "C" {
 /**
  * enums for pixel format used by aribcc api.
  *
- * Only @ARIBCC_PIXELFORMAT_RGBA8888 is used for now.
+ * 32-bit formats are named by the byte order in memory.
  */
 typedef enum aribcc_pixelformat_t {
     ARIBCC_PIXELFORMAT_RGBA8888 = 0,
+    ARIBCC_PIXELFORMAT_BGRA8888 = 1,
+    ARIBCC_PIXELFORMAT_RGBA8888_PREMULTIPLIED = 2,   ///< RGBA with color channels premultiplied by alpha
+    ARIBCC_PIXELFORMAT_BGRA8888_PREMULTIPLIED = 3,   ///< BGRA with color channels premultiplied by alpha
+    ARIBCC_PIXELFORMAT_INDEXED8 = 4,                 ///< 8-bit index into palette, entry 0 is always fully transparent
     ARIBCC_PIXELFORMAT_DEFAULT = ARIBCC_PIXELFORMAT_RGBA8888
 } aribcc_pixelformat_t;
 
@@ -50,7 +56,7 @@ typedef struct aribcc_image_t {
     int dst_x;     ///< x coordinate of bitmap's top-left corner inside the player's renderer frame
     int dst_y;     ///< y coordinate of bitmap's top-left corner inside the player's renderer frame
 
-    aribcc_pixelformat_t pixel_format;    ///< pixel format, always be @ARIBCC_PIXELFORMAT_RGBA8888
+    aribcc_pixelformat_t pixel_format;    ///< pixel format, see @aribcc_renderer_set_pixel_format()
 
     /**
      * Pointer pointed to the bitmap area. The buffer size is indicated in bitmap_size field.
@@ -60,6 +66,29 @@ typedef struct aribcc_image_t {
      */
     uint8_t* bitmap;
     uint32_t bitmap_size;
+
+    /**
+     * Color lookup table for ARIBCC_PIXELFORMAT_INDEXED8 images, in non-premultiplied RGBA (see @aribcc_color_t).
+     * NULL for other pixel formats.
+     *
+     * Do not manually free this pointer if you received this image from the renderer.
+     * Call @aribcc_image_cleanup() instead.
+     */
+    aribcc_color_t* palette;
+    uint32_t palette_size;    ///< entry count of palette, at most 256
+
+    /**
+     * Stable ID of the image content produced by the renderer, derived from the rendered region's content,
+     * position, renderer settings and pixel format. Images with identical content and position share the same ID,
+     * so that textures uploaded for a previous image could be reused.
+     */
+    uint64_t content_id;
+
+    /**
+     * Whether the image doesn't appear (by content_id) in the previous render result.
+     * Players could upload only changed images and reuse textures for the others.
+     */
+    bool changed;
 } aribcc_image_t;
 
 
@@ -74,6 +103,60 @@ typedef struct aribcc_image_t {
 ARIBCC_API void aribcc_image_cleanup(aribcc_image_t* image);
 
 
+/**
+ * enums for YUV 4:2:0 video frame layouts accepted by @aribcc_image_blend_to_yuv_frame()
+ */
+typedef enum aribcc_yuv_format_t {
+    ARIBCC_YUV_FORMAT_I420 = 0,      ///< 8-bit, planar Y, U, V
+    ARIBCC_YUV_FORMAT_NV12 = 1,      ///< 8-bit, planar Y followed by interleaved UV
+    ARIBCC_YUV_FORMAT_I420P10 = 2,   ///< 10-bit, planar Y, U, V. uint16_t samples stored in the low 10 bits
+    ARIBCC_YUV_FORMAT_P010 = 3,      ///< 10-bit, planar Y followed by interleaved UV. Stored in the high 10 bits
+} aribcc_yuv_format_t;
+
+/**
+ * enums for RGB => YUV conversion matrix indication
+ */
+typedef enum aribcc_yuv_color_matrix_t {
+    ARIBCC_YUV_COLOR_MATRIX_BT601 = 0,
+    ARIBCC_YUV_COLOR_MATRIX_BT709 = 1,
+} aribcc_yuv_color_matrix_t;
+
+/**
+ * enums for YUV sample range indication
+ */
+typedef enum aribcc_yuv_color_range_t {
+    ARIBCC_YUV_COLOR_RANGE_LIMITED = 0,   ///< a.k.a. TV range
+    ARIBCC_YUV_COLOR_RANGE_FULL = 1,      ///< a.k.a. PC range
+} aribcc_yuv_color_range_t;
+
+/**
+ * Structure describes a caller-owned YUV 4:2:0 video frame
+ */
+typedef struct aribcc_yuv_frame_t {
+    aribcc_yuv_format_t format;
+    aribcc_yuv_color_matrix_t color_matrix;
+    aribcc_yuv_color_range_t color_range;
+
+    int width;            ///< frame width in luma samples
+    int height;           ///< frame height in luma samples
+
+    uint8_t* planes[3];   ///< Y, U, V planes. Y, UV for NV12 / P010
+    int strides[3];       ///< bytes in a line of each plane
+} aribcc_yuv_frame_t;
+
+/**
+ * Alpha-blend a rendered caption image onto a YUV 4:2:0 video frame, i.e. burn-in
+ *
+ * The image is placed at (dst_x, dst_y) of the frame and clipped to the frame, so the renderer's frame size
+ * should be set to the video frame size. Chroma is blended per 2x2 block with the averaged alpha of the block.
+ *
+ * @param image  Image received from the renderer, must be in ARIBCC_PIXELFORMAT_RGBA8888
+ * @param frame  Target frame, see @aribcc_yuv_frame_t
+ * @return       false if the image or the frame is invalid
+ */
+ARIBCC_API bool aribcc_image_blend_to_yuv_frame(const aribcc_image_t* image, const aribcc_yuv_frame_t* frame);
+
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
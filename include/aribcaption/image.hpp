@@ -23,16 +23,22 @@
 #include <cstdint>
 #include <vector>
 #include "aligned_alloc.hpp"
+#include "aribcc_export.h"
+#include "color.hpp"
 
 namespace aribcaption {
 
 /**
  * enums for pixel format used by aribcc api.
  *
- * Only @kRGBA8888 is used for now.
+ * 32-bit formats are named by the byte order in memory.
  */
 enum class PixelFormat {
     kRGBA8888 = 0,
+    kBGRA8888 = 1,
+    kRGBA8888Premultiplied = 2,   ///< RGBA with color channels premultiplied by alpha
+    kBGRA8888Premultiplied = 3,   ///< BGRA with color channels premultiplied by alpha
+    kIndexed8 = 4,                ///< 8-bit index into Image::palette, palette entry 0 is always fully transparent
     kDefault = kRGBA8888,
 };
 
@@ -50,9 +56,27 @@ public:
     int dst_x = 0;     ///< x coordinate of bitmap's top-left corner inside the player's renderer frame
     int dst_y = 0;     ///< y coordinate of bitmap's top-left corner inside the player's renderer frame
 
-    PixelFormat pixel_format = PixelFormat::kDefault;    ///< pixel format, always be kRGBA8888
+    PixelFormat pixel_format = PixelFormat::kDefault;    ///< pixel format, see @Renderer::SetPixelFormat()
+
+    /**
+     * Stable ID of the image content produced by the renderer, derived from the rendered region's content,
+     * position, renderer settings and pixel format. Images with identical content and position share the same ID,
+     * so that textures uploaded for a previous image could be reused.
+     */
+    uint64_t content_id = 0;
+
+    /**
+     * Whether the image doesn't appear (by content_id) in the previous render result.
+     * Players could upload only changed images and reuse textures for the others.
+     */
+    bool changed = true;
 
     std::vector<uint8_t, AlignedAllocator<uint8_t, kAlignedTo>> bitmap;
+
+    /**
+     * Color lookup table for kIndexed8 images, at most 256 entries in non-premultiplied RGBA. Empty for other formats.
+     */
+    std::vector<ColorRGBA> palette;
 public:
     Image() = default;
     Image(const Image&) = default;
@@ -61,6 +85,64 @@ public:
     Image& operator=(Image&&) noexcept = default;
 };
 
+/**
+ * enums for YUV 4:2:0 video frame layouts accepted by @BlendImageToYUVFrame()
+ */
+enum class YUVFormat {
+    kI420 = 0,      ///< 8-bit, planar Y, U, V
+    kNV12 = 1,      ///< 8-bit, planar Y followed by interleaved UV
+    kI420P10 = 2,   ///< 10-bit, planar Y, U, V. Samples are uint16_t in native endianness, stored in the low 10 bits
+    kP010 = 3,      ///< 10-bit, planar Y followed by interleaved UV. Samples are uint16_t stored in the high 10 bits
+};
+
+/**
+ * enums for RGB => YUV conversion matrix indication
+ */
+enum class YUVColorMatrix {
+    kBT601 = 0,
+    kBT709 = 1,
+};
+
+/**
+ * enums for YUV sample range indication
+ */
+enum class YUVColorRange {
+    kLimited = 0,   ///< a.k.a. TV range, e.g. Y in 16 ~ 235, U/V in 16 ~ 240 for 8-bit
+    kFull = 1,      ///< a.k.a. PC range
+};
+
+/**
+ * Structure describes a caller-owned YUV 4:2:0 video frame
+ */
+struct YUVFrame {
+    YUVFormat format = YUVFormat::kI420;
+    YUVColorMatrix color_matrix = YUVColorMatrix::kBT709;
+    YUVColorRange color_range = YUVColorRange::kLimited;
+
+    int width = 0;     ///< frame width in luma samples
+    int height = 0;    ///< frame height in luma samples
+
+    uint8_t* planes[3] = {nullptr, nullptr, nullptr};   ///< Y, U, V planes. Y, UV for kNV12 / kP010
+    int strides[3] = {0, 0, 0};                         ///< bytes in a line of each plane
+};
+
+/**
+ * Alpha-blend a rendered caption image onto a YUV 4:2:0 video frame, i.e. burn-in
+ *
+ * The image is placed at (dst_x, dst_y) of the frame and clipped to the frame, so the renderer's frame size
+ * should be set to the video frame size. Chroma is blended per 2x2 block with the averaged alpha of the block.
+ *
+ * @param image  Image produced by the renderer, must be in kRGBA8888
+ * @param frame  Target frame, see @YUVFrame
+ * @return       false if the image or the frame is invalid
+ */
+ARIBCC_API bool BlendImageToYUVFrame(const Image& image, const YUVFrame& frame);
+
+/**
+ * Alpha-blend rendered caption images onto a YUV 4:2:0 video frame in order, see @BlendImageToYUVFrame()
+ */
+ARIBCC_API bool BlendImagesToYUVFrame(const std::vector<Image>& images, const YUVFrame& frame);
+
 }  // namespace aribcaption
 
 #endif  // ARIBCAPTION_IMAGE_HPP
\ No newline at end of file
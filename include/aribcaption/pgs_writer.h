@@ -0,0 +1,101 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_PGS_WRITER_H
+#define ARIBCAPTION_PGS_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "aribcc_config.h"
+#include "aribcc_export.h"
+#include "context.h"
+#include "renderer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Blu-ray PGS (Presentation Graphic Stream, .sup) bitmap subtitle writer
+ *
+ * Opaque type
+ */
+typedef struct aribcc_pgs_writer_t aribcc_pgs_writer_t;
+
+/**
+ * Callback receiving the written PGS stream, in chunks of complete display sets
+ */
+typedef void(*aribcc_pgs_write_callback_t)(const uint8_t* data, size_t size, void* userdata);
+
+/**
+ * A context is needed for allocating the PGS writer.
+ *
+ * The context shouldn't be freed before any other object constructed from the context has been freed.
+ */
+ARIBCC_API aribcc_pgs_writer_t* aribcc_pgs_writer_alloc(aribcc_context_t* context);
+
+/**
+ * Free the PGS writer and all related resources
+ */
+ARIBCC_API void aribcc_pgs_writer_free(aribcc_pgs_writer_t* writer);
+
+/**
+ * Initialize function must be called before calling any other member functions.
+ *
+ * Palette colors are converted with BT.709 for frames taller than 576 lines, otherwise with BT.601.
+ *
+ * @param writer          @aribcc_pgs_writer_t
+ * @param frame_width     Width of the video frame, should be the frame size passed to the renderer
+ * @param frame_height    Height of the video frame
+ * @param write_callback  Callback receiving the PGS stream
+ * @param userdata        Passed to write_callback
+ * @return true on success
+ */
+ARIBCC_API bool aribcc_pgs_writer_initialize(aribcc_pgs_writer_t* writer,
+                                             int frame_width,
+                                             int frame_height,
+                                             aribcc_pgs_write_callback_t write_callback,
+                                             void* userdata);
+
+/**
+ * Write a display set showing the images of the render result from result->pts,
+ * which are cleared at result->pts + result->duration unless the next result replaces them.
+ *
+ * A result without images clears the screen. Images must be in ARIBCC_PIXELFORMAT_RGBA8888 pixel format.
+ *
+ * @param writer  @aribcc_pgs_writer_t
+ * @param result  Render result, e.g. received from @aribcc_renderer_render_all_changes()
+ * @return false if the result is invalid, its PTS is earlier than a previously written one,
+ *         or out of the 32-bit 90kHz PGS timestamp range (0 ~ about 13.25 hours)
+ */
+ARIBCC_API bool aribcc_pgs_writer_write(aribcc_pgs_writer_t* writer, const aribcc_render_result_t* result);
+
+/**
+ * Write the pending clearing of the last result, call this at the end of the stream
+ *
+ * @param writer  @aribcc_pgs_writer_t
+ */
+ARIBCC_API void aribcc_pgs_writer_flush(aribcc_pgs_writer_t* writer);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ARIBCAPTION_PGS_WRITER_H
@@ -0,0 +1,96 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_PGS_WRITER_HPP
+#define ARIBCAPTION_PGS_WRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include "aribcc_config.h"
+#include "aribcc_export.h"
+#include "context.hpp"
+#include "renderer.hpp"
+
+namespace aribcaption {
+
+namespace internal { class PGSWriterImpl; }
+
+/**
+ * Blu-ray PGS (Presentation Graphic Stream, .sup) bitmap subtitle writer
+ *
+ * Converts render results of the @Renderer into PGS display sets in a single streaming pass.
+ * Images are merged into at most 2 objects per display set, quantized into one palette which keeps
+ * the ARIB CLUT colors exact, and run-length encoded. Objects unchanged since the previous display set
+ * of the same epoch are referenced again instead of being re-sent.
+ *
+ * Feed results in PTS order, e.g. from @Renderer::RenderAllChanges().
+ */
+class PGSWriter {
+public:
+    /**
+     * Callback receiving the written stream, in chunks of complete display sets
+     */
+    using WriteCallback = std::function<void(const uint8_t* data, size_t size)>;
+public:
+    /**
+     * A context is needed for constructing the PGSWriter.
+     *
+     * The context shouldn't be destructed before any other object constructed from the context has been destructed.
+     */
+    ARIBCC_API explicit PGSWriter(Context& context);
+    ARIBCC_API ~PGSWriter();
+    ARIBCC_API PGSWriter(PGSWriter&&) noexcept;
+    ARIBCC_API PGSWriter& operator=(PGSWriter&&) noexcept;
+public:
+    /**
+     * Initialize function must be called before calling any other member functions.
+     *
+     * Palette colors are converted with BT.709 for frames taller than 576 lines, otherwise with BT.601.
+     *
+     * @param frame_width     Width of the video frame, should be the frame size passed to the @Renderer
+     * @param frame_height    Height of the video frame
+     * @param write_callback  Callback receiving the PGS stream
+     * @return true on success
+     */
+    ARIBCC_API bool Initialize(int frame_width, int frame_height, WriteCallback write_callback);
+
+    /**
+     * Write a display set showing the images of the render result from result.pts,
+     * which are cleared at result.pts + result.duration unless the next result replaces them.
+     *
+     * A result without images clears the screen. Images must be in kRGBA8888 pixel format.
+     *
+     * @return false if the result is invalid, its PTS is earlier than a previously written one,
+ *         or out of the 32-bit 90kHz PGS timestamp range (0 ~ about 13.25 hours)
+     */
+    ARIBCC_API bool Write(const RenderResult& result);
+
+    /**
+     * Write the pending clearing of the last result, call this at the end of the stream
+     */
+    ARIBCC_API void Flush();
+private:
+    std::unique_ptr<internal::PGSWriterImpl> pimpl_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_PGS_WRITER_HPP
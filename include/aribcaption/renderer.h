@@ -134,8 +134,111 @@ typedef enum aribcc_caption_storage_policy_t {
      * The renderer will keep appended captions at an upper limit of duration, in milliseconds.
      */
     ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_DURATION = 3,
+
+    /**
+     * The renderer will keep approximate memory usage of appended captions (including DRCS patterns) and its image
+     * caches at an upper limit of bytes, see @aribcc_renderer_get_storage_memory_usage().
+     *
+     * Once exceeded, captions before the one displayed at the playback position (PTS of the last
+     * render / try_render / render_into call) are evicted first (oldest first), then cached region images
+     * and caption layouts (least recently used first). The displayed caption and upcoming ones are never evicted,
+     * so the limit could still be exceeded by them. Nothing is evicted before the first rendering.
+     */
+    ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_BYTES = 4,
 } aribcc_caption_storage_policy_t;
 
+/**
+ * Enums for stroke text (border) generation method indication
+ */
+typedef enum aribcc_stroke_mode_t {
+    /**
+     * Stroke glyph outlines with the TextRenderer's vector stroker, e.g. FT_Stroker. This is the default behavior.
+     */
+    ARIBCC_STROKE_MODE_OUTLINE = 0,
+
+    /**
+     * Grow rasterized glyph / DRCS coverage masks by a disk-shaped kernel (morphological dilation).
+     * Much faster than stroking outlines. Affects the Freetype TextRenderer and DRCS rendering.
+     */
+    ARIBCC_STROKE_MODE_DILATION = 1,
+} aribcc_stroke_mode_t;
+
+/**
+ * Enums for DRCS scaling method indication
+ */
+typedef enum aribcc_drcs_scale_mode_t {
+    /**
+     * Nearest-neighbor scaling, keeps the hard edges of the original pattern. This is the default behavior.
+     */
+    ARIBCC_DRCS_SCALE_MODE_NEAREST = 0,
+
+    /**
+     * Area-average (box filter) scaling, produces smoother edges when downscaling.
+     */
+    ARIBCC_DRCS_SCALE_MODE_AREA_AVERAGE = 1,
+} aribcc_drcs_scale_mode_t;
+
+/**
+ * Enums for indicating how region images are merged, see @aribcc_renderer_set_merge_region_images()
+ */
+typedef enum aribcc_region_merge_mode_t {
+    /**
+     * Merge all region images into one image covering their bounding box. This is the default behavior.
+     */
+    ARIBCC_REGION_MERGE_MODE_BOUNDING_BOX = 0,
+
+    /**
+     * Merge region images into a minimal set of non-overlapping images, regions far apart from each other
+     * stay in separate images instead of being joined by a mostly transparent bitmap.
+     */
+    ARIBCC_REGION_MERGE_MODE_SPARSE = 1,
+} aribcc_region_merge_mode_t;
+
+/**
+ * Enums for indicating what aribcc_renderer_render() outputs, see @aribcc_renderer_set_render_output_mode()
+ */
+typedef enum aribcc_render_output_mode_t {
+    /**
+     * One image per region (or merged images). This is the default behavior.
+     */
+    ARIBCC_RENDER_OUTPUT_MODE_IMAGES = 0,
+
+    /**
+     * A list of quads sampling a shared glyph atlas, plus solid quads for backgrounds and enclosures.
+     * Suitable for GPU compositors: the atlas is uploaded into one texture and updated incrementally.
+     */
+    ARIBCC_RENDER_OUTPUT_MODE_GLYPH_QUADS = 1,
+} aribcc_render_output_mode_t;
+
+/**
+ * Character sets that could be pre-rendered by @aribcc_renderer_prewarm_glyphs(), could be combined
+ */
+typedef enum aribcc_prewarm_charset_t {
+    ARIBCC_PREWARM_CHARSET_NONE = 0,
+
+    /**
+     * Hiragana, Katakana and JIS X 0208 row 1 symbols (punctuations)
+     */
+    ARIBCC_PREWARM_CHARSET_KANA = 1u << 0,
+
+    /**
+     * JIS X 0208 level-1 Kanji (row 16 ~ 47)
+     */
+    ARIBCC_PREWARM_CHARSET_JIS_LEVEL1_KANJI = 1u << 1,
+
+    /**
+     * Fullwidth alphanumerics, in both full size and middle size
+     */
+    ARIBCC_PREWARM_CHARSET_FULLWIDTH_ALPHANUMERIC = 1u << 2,
+
+    /**
+     * Alternative Unicode characters for well-known DRCS patterns
+     */
+    ARIBCC_PREWARM_CHARSET_DRCS_REPLACEMENT = 1u << 3,
+
+    ARIBCC_PREWARM_CHARSET_ALL = 0x0F,
+} aribcc_prewarm_charset_t;
+
 /**
  * Enums for reporting rendering status
  *
@@ -148,6 +251,30 @@ typedef enum aribcc_render_status_t {
     ARIBCC_RENDER_STATUS_GOT_IMAGE_UNCHANGED = 3,
 } aribcc_render_status_t;
 
+/**
+ * Rectangle inside the renderer frame, in pixels
+ */
+typedef struct aribcc_render_rect_t {
+    int x;
+    int y;
+    int width;
+    int height;
+} aribcc_render_rect_t;
+
+/**
+ * Quad to be drawn onto the frame, see @ARIBCC_RENDER_OUTPUT_MODE_GLYPH_QUADS
+ *
+ * Quads must be drawn in order with alpha blending. Glyph quads copy (blend) the src rect of the glyph atlas
+ * into the dst rect without scaling, color is opaque white and could be used as a modulation color.
+ * Solid quads fill the dst rect with color, src is empty.
+ */
+typedef struct aribcc_render_quad_t {
+    aribcc_render_rect_t dst;   ///< destination rect inside the frame, like aribcc_image_t::dst_x / dst_y
+    aribcc_render_rect_t src;   ///< rect inside the glyph atlas, empty for solid quads
+    aribcc_color_t color;
+    bool solid;
+} aribcc_render_quad_t;
+
 /**
  * Structure for holding rendered caption images
  *
@@ -165,8 +292,108 @@ typedef struct aribcc_render_result_t {
      */
     aribcc_image_t* images;
     uint32_t image_count;    ///< element count of images array
+
+    /**
+     * Quads array, only provided in ARIBCC_RENDER_OUTPUT_MODE_GLYPH_QUADS output mode.
+     * Freed by @aribcc_render_result_cleanup().
+     */
+    aribcc_render_quad_t* quads;
+    uint32_t quad_count;     ///< element count of quads array
+
+    /**
+     * Changes of the glyph atlas since the previous aribcc_renderer_render() call,
+     * only provided in ARIBCC_RENDER_OUTPUT_MODE_GLYPH_QUADS output mode.
+     *
+     * If atlas_generation differs from the one of the atlas copy held by the caller, the atlas has been reset:
+     * the copy must be cleared (fully transparent) before applying atlas_cells. Cells are new parts of the atlas,
+     * with dst_x / dst_y in atlas coordinates. Freed by @aribcc_render_result_cleanup().
+     */
+    int atlas_width;
+    int atlas_height;
+    uint64_t atlas_generation;
+    aribcc_image_t* atlas_cells;
+    uint32_t atlas_cell_count;  ///< element count of atlas_cells array
 } aribcc_render_result_t;
 
+/**
+ * Output frame of @aribcc_renderer_render_multi(),
+ * see @aribcc_renderer_set_frame_size() and @aribcc_renderer_set_margins()
+ */
+typedef struct aribcc_render_target_t {
+    int frame_width;
+    int frame_height;
+    int margin_top;
+    int margin_bottom;
+    int margin_left;
+    int margin_right;
+} aribcc_render_target_t;
+
+/**
+ * Statistics of the renderer's region image cache
+ *
+ * See @aribcc_renderer_get_region_cache_stats()
+ * Hit rate could be calculated as hits / (hits + misses).
+ */
+typedef struct aribcc_region_cache_stats_t {
+    size_t hits;           ///< count of regions served from the cache
+    size_t misses;         ///< count of regions that have been rendered
+    size_t entry_count;    ///< count of cached region images
+    size_t memory_used;    ///< approximate memory used by cached region images, in bytes
+    size_t memory_limit;   ///< memory cap of the cache, in bytes
+} aribcc_region_cache_stats_t;
+
+/**
+ * Memory usage of the renderer's caption storage and image caches
+ *
+ * See @aribcc_renderer_get_storage_memory_usage()
+ * All the values are approximate, in bytes except caption_count.
+ */
+typedef struct aribcc_storage_memory_usage_t {
+    size_t caption_count;       ///< count of stored captions
+    size_t captions;            ///< memory used by stored captions, including texts and DRCS patterns
+    size_t region_image_cache;  ///< memory used by the region image cache
+    size_t layout_cache;        ///< memory used by cached caption layouts
+    size_t total;               ///< sum of the above memory usages, which UPPER_LIMIT_BYTES policy applies to
+    size_t limit;               ///< upper limit of UPPER_LIMIT_BYTES policy, 0 if another policy is in use
+
+    size_t rendered_images;     ///< memory held by the latest rendered images, never evicted
+    size_t glyph_atlas;         ///< memory of the glyph atlas used in GLYPH_QUADS output mode, never evicted
+    size_t unevictable;         ///< sum of rendered_images and glyph_atlas, not accounted into total
+} aribcc_storage_memory_usage_t;
+
+/**
+ * Callback of @aribcc_renderer_render_all_changes(), called once per display interval in PTS order
+ *
+ * result->pts / result->duration indicate the interval. status is ARIBCC_RENDER_STATUS_GOT_IMAGE if images are
+ * displayed during the interval, or ARIBCC_RENDER_STATUS_NO_IMAGE for a cleared screen between captions.
+ * The result is owned by the renderer and only valid during the callback, do not call aribcc_render_result_cleanup().
+ *
+ * Rendering workers keep reading stored captions and render settings while the callback runs, so the callback
+ * must not call back into the renderer. Appending / flushing captions, rendering, or changing any render setting
+ * (frame size, margins, fonts, stroke, pixel format...) from the callback are rejected (and assert in debug builds).
+ * @aribcc_renderer_queue_caption() is still allowed.
+ */
+typedef void(*aribcc_render_change_callback_t)(aribcc_render_status_t status,
+                                               const aribcc_render_result_t* result,
+                                               void* userdata);
+
+/**
+ * Callback of @aribcc_renderer_set_caption_change_callback(), called on the rendering thread once stored captions
+ * are changed
+ *
+ * pts is the earliest PTS from which rendered results may differ, e.g. PTS of a newly appended caption,
+ * or ARIBCC_PTS_NOPTS if the storage has been flushed.
+ */
+typedef void(*aribcc_caption_change_callback_t)(int64_t pts, void* userdata);
+
+/**
+ * Callback of @aribcc_renderer_set_caption_queue_callback(), called on the producer thread once a caption is queued
+ *
+ * pts is PTS of the queued caption. The caption isn't stored yet, players could wake up the rendering thread
+ * on this event, which will take queued captions and then call @aribcc_caption_change_callback_t.
+ */
+typedef void(*aribcc_caption_queue_callback_t)(int64_t pts, void* userdata);
+
 /**
  * Cleanup the aribcc_render_result_t structure.
  *
@@ -205,6 +432,10 @@ ARIBCC_API void aribcc_renderer_free(aribcc_renderer_t* renderer);
  * @param font_provider_type  Indicate @FontProviderType. Use kAuto in most cases.
  * @param text_renderer_type  Indicate @TextRendererType. Use kAuto in most cases.
  * @return true on success
+ *
+ * With the Fontconfig font provider, system font configuration is loaded lazily on the first rendering
+ * (or in background by @aribcc_renderer_warm_up_fonts()), so a broken configuration is not reported here,
+ * but logged as an error and results in ARIBCC_RENDER_STATUS_ERROR from the rendering functions.
  */
 ARIBCC_API bool aribcc_renderer_initialize(aribcc_renderer_t* renderer,
                                            aribcc_captiontype_t caption_type,
@@ -219,6 +450,22 @@ ARIBCC_API bool aribcc_renderer_initialize(aribcc_renderer_t* renderer,
  */
 ARIBCC_API void aribcc_renderer_set_stroke_width(aribcc_renderer_t* renderer, float dots);
 
+/**
+ * Indicate how stroke text (border) will be generated
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param mode      See @aribcc_stroke_mode_t, default as ARIBCC_STROKE_MODE_OUTLINE
+ */
+ARIBCC_API void aribcc_renderer_set_stroke_mode(aribcc_renderer_t* renderer, aribcc_stroke_mode_t mode);
+
+/**
+ * Indicate how DRCS patterns will be scaled into target character size
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param mode      See @aribcc_drcs_scale_mode_t, default as ARIBCC_DRCS_SCALE_MODE_NEAREST
+ */
+ARIBCC_API void aribcc_renderer_set_drcs_scale_mode(aribcc_renderer_t* renderer, aribcc_drcs_scale_mode_t mode);
+
 /**
  * Indicate whether render replaced DRCS characters as Unicode characters
  *
@@ -258,6 +505,63 @@ ARIBCC_API void aribcc_renderer_set_force_no_background(aribcc_renderer_t* rende
  */
 ARIBCC_API void aribcc_renderer_set_merge_region_images(aribcc_renderer_t* renderer, bool merge);
 
+/**
+ * Indicate how region images are merged if @aribcc_renderer_set_merge_region_images() is enabled
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param mode      See @aribcc_region_merge_mode_t, default as ARIBCC_REGION_MERGE_MODE_BOUNDING_BOX
+ */
+ARIBCC_API void aribcc_renderer_set_region_merge_mode(aribcc_renderer_t* renderer, aribcc_region_merge_mode_t mode);
+
+/**
+ * Crop each rendered region image to the bounding box of its non-transparent pixels, dst_x / dst_y are adjusted
+ *
+ * Mostly useful along with @aribcc_renderer_set_force_no_background(), which leaves transparent padding
+ * around the glyphs. Regions without any visible pixel produce no image.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param crop      default as false
+ */
+ARIBCC_API void aribcc_renderer_set_crop_region_images(aribcc_renderer_t* renderer, bool crop);
+
+/**
+ * Indicate pixel format of images returned by aribcc_renderer_render()
+ *
+ * Images are always rendered in ARIBCC_PIXELFORMAT_RGBA8888 and converted once per new rendering result.
+ * For ARIBCC_PIXELFORMAT_INDEXED8, each image carries its own palette (see @aribcc_image_t).
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param format    default as ARIBCC_PIXELFORMAT_RGBA8888
+ */
+ARIBCC_API void aribcc_renderer_set_pixel_format(aribcc_renderer_t* renderer, aribcc_pixelformat_t format);
+
+/**
+ * Indicate what aribcc_renderer_render() outputs, region images or quads sampling a glyph atlas
+ *
+ * In ARIBCC_RENDER_OUTPUT_MODE_GLYPH_QUADS mode, aribcc_renderer_render() fills quads and atlas_* fields
+ * of @aribcc_render_result_t instead of images, merging / cropping of region images doesn't apply,
+ * aribcc_renderer_render_multi() and aribcc_renderer_render_into() keep producing images.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param mode      default as ARIBCC_RENDER_OUTPUT_MODE_IMAGES
+ */
+ARIBCC_API void aribcc_renderer_set_render_output_mode(aribcc_renderer_t* renderer,
+                                                       aribcc_render_output_mode_t mode);
+
+/**
+ * Retrieve a copy of the whole glyph atlas, e.g. for re-creating a lost texture
+ *
+ * Glyph cells inserted so far are treated as delivered, they won't appear in the next atlas update.
+ *
+ * @param renderer        @aribcc_renderer_t
+ * @param out_image       Write back parameter for the atlas image, call @aribcc_image_cleanup() after use
+ * @param out_generation  Optional write back parameter for the atlas generation, could be NULL
+ * @return false if the atlas hasn't been created yet, i.e. nothing rendered in glyph quads mode
+ */
+ARIBCC_API bool aribcc_renderer_get_glyph_atlas(aribcc_renderer_t* renderer,
+                                                aribcc_image_t* out_image,
+                                                uint64_t* out_generation);
+
 /**
  * Indicate font families (an array of font family names) for default usage
  *
@@ -342,8 +646,9 @@ ARIBCC_API bool aribcc_renderer_set_margins(aribcc_renderer_t* renderer, int top
  *
  * @param renderer       @aribcc_renderer_t
  * @param storage_policy See @aribcc_caption_storage_policy_t
- * @param upper_limit    Must be non-zero value for ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_COUNT or
- *                       ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_DURATION
+ * @param upper_limit    Must be non-zero value for ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_COUNT,
+ *                       ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_DURATION or
+ *                       ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_BYTES
  */
 ARIBCC_API void aribcc_renderer_set_storage_policy(aribcc_renderer_t* renderer,
                                                    aribcc_caption_storage_policy_t storage_policy,
@@ -360,6 +665,33 @@ ARIBCC_API void aribcc_renderer_set_storage_policy(aribcc_renderer_t* renderer,
  */
 ARIBCC_API bool aribcc_renderer_append_caption(aribcc_renderer_t* renderer, const aribcc_caption_t* caption);
 
+/**
+ * Append a serialized caption into renderer's internal storage for subsequent rendering
+ *
+ * The data, e.g. from shared memory, is validated and deserialized into a stored caption,
+ * see @aribcc_caption_serialize(). The data could be released right after the call.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param data      Serialized caption, must be 8-byte aligned
+ * @param size      Size of the data in bytes
+ * @return false if the data is invalid, or if the caption has no PTS or invalid plane size
+ */
+ARIBCC_API bool aribcc_renderer_append_serialized_caption(aribcc_renderer_t* renderer, const void* data, size_t size);
+
+/**
+ * Queue a caption from another thread for subsequent rendering
+ *
+ * This function is lock-free and is meant to be called from a single producer thread, while the renderer is driven
+ * from another thread. Queued captions are moved into renderer's internal storage in the queued order by the next
+ * append / try_render / render call on the rendering thread. The caption is copied, it could be freed right after.
+ * Use aribcc_renderer_set_caption_queue_callback() to be notified on the producer thread when a caption is queued.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param caption   @aribcc_caption_t
+ * @return false if caption has no PTS or invalid plane size, true otherwise
+ */
+ARIBCC_API bool aribcc_renderer_queue_caption(aribcc_renderer_t* renderer, const aribcc_caption_t* caption);
+
 /**
  * Retrieve expected render status at specific PTS, rather than actually do rendering.
  *
@@ -373,6 +705,52 @@ ARIBCC_API bool aribcc_renderer_append_caption(aribcc_renderer_t* renderer, cons
 ARIBCC_API aribcc_render_status_t aribcc_renderer_try_render(aribcc_renderer_t* renderer,
                                                              int64_t pts);
 
+/**
+ * Retrieve PTS of the next change of rendered results after specific PTS
+ *
+ * The change is where the caption displayed at pts expires through its wait_duration or is replaced by the next
+ * caption, or where the next caption appears if nothing is displayed at pts. Rendering is only necessary at
+ * the returned PTS, as long as no caption is appended meanwhile (see @aribcc_renderer_set_caption_change_callback()).
+ *
+ * @param renderer    @aribcc_renderer_t
+ * @param pts         Presentation timestamp, in milliseconds
+ * @return            PTS of the next change, or ARIBCC_PTS_NOPTS if nothing will change with currently stored captions
+ */
+ARIBCC_API int64_t aribcc_renderer_get_next_change_pts(aribcc_renderer_t* renderer, int64_t pts);
+
+/**
+ * Indicate a callback for receiving changes of stored captions
+ * To clear the callback, pass NULL for the callback parameter.
+ *
+ * The callback is called on the rendering thread, by appending functions or when queued captions are taken,
+ * once per batch of queued captions with the earliest PTS among them.
+ * Calling aribcc_renderer_get_next_change_pts() inside the callback is allowed, changes made from inside
+ * the callback are delivered after it returns rather than by calling it recursively.
+ *
+ * @param renderer    @aribcc_renderer_t
+ * @param callback    See @aribcc_caption_change_callback_t
+ * @param userdata    User data that will be passed in callback
+ */
+ARIBCC_API void aribcc_renderer_set_caption_change_callback(aribcc_renderer_t* renderer,
+                                                            aribcc_caption_change_callback_t callback,
+                                                            void* userdata);
+
+/**
+ * Indicate a callback for receiving queued captions on the producer thread
+ * To clear the callback, pass NULL for the callback parameter.
+ *
+ * The callback is called by aribcc_renderer_queue_caption() on the producer thread, after the caption is queued.
+ * Players could use it to wake the rendering thread up. The callback must not call into the renderer.
+ * Indicate the callback before calling aribcc_renderer_queue_caption().
+ *
+ * @param renderer    @aribcc_renderer_t
+ * @param callback    See @aribcc_caption_queue_callback_t
+ * @param userdata    User data that will be passed in callback
+ */
+ARIBCC_API void aribcc_renderer_set_caption_queue_callback(aribcc_renderer_t* renderer,
+                                                           aribcc_caption_queue_callback_t callback,
+                                                           void* userdata);
+
 /**
  * Render caption at specific PTS
  *
@@ -386,6 +764,151 @@ ARIBCC_API aribcc_render_status_t aribcc_renderer_render(aribcc_renderer_t* rend
                                                          int64_t pts,
                                                          aribcc_render_result_t* out_result);
 
+/**
+ * Render caption at specific PTS for multiple output frames at once, e.g. renditions of different resolutions
+ *
+ * Captions, fonts, glyph caches and region layouts are shared between targets, and rendered region images
+ * are cached per target size as well, so the region cache limit should be raised accordingly
+ * (see @aribcc_renderer_set_region_cache_memory_limit()). Frame size / margins set on the renderer are not used,
+ * and the state of aribcc_renderer_render() / aribcc_renderer_render_into() is not affected.
+ * Images are always marked as changed.
+ *
+ * @param renderer      @aribcc_renderer_t
+ * @param pts           Presentation timestamp, in milliseconds
+ * @param targets       Array of output frames to render for
+ * @param target_count  Element count of targets
+ * @param out_results   Array of target_count results, one per target in the same order.
+ *                      Every element should be released by @aribcc_render_result_cleanup() after use.
+ * @return              ARIBCC_RENDER_STATUS_GOT_IMAGE if any target got images,
+ *                      otherwise ARIBCC_RENDER_STATUS_NO_IMAGE / ARIBCC_RENDER_STATUS_ERROR
+ */
+ARIBCC_API aribcc_render_status_t aribcc_renderer_render_multi(aribcc_renderer_t* renderer,
+                                                               int64_t pts,
+                                                               const aribcc_render_target_t* targets,
+                                                               uint32_t target_count,
+                                                               aribcc_render_result_t* out_results);
+
+/**
+ * Render every change of the displayed caption within [pts_begin, pts_end), e.g. for subtitle exporting
+ *
+ * Stored captions are walked directly instead of being looked up per video frame. Each distinct display
+ * interval is reported exactly once: consecutive captions producing identical images are joined, and so are
+ * consecutive intervals without images. Intervals are clipped into [pts_begin, pts_end), and nothing is reported
+ * before the first or after the last interval with images. A caption of indefinite duration lasts until
+ * pts_end. Captions are rendered on multiple threads if there are many of them.
+ *
+ * Uses frame size / margins / pixel format set on the renderer, always produces images regardless of the
+ * output mode, and doesn't affect the state of aribcc_renderer_render() / aribcc_renderer_render_into().
+ * Captions must still be stored in the renderer, so a storage policy other than
+ * ARIBCC_CAPTION_STORAGE_POLICY_MINIMUM should be used (see @aribcc_renderer_set_storage_policy()).
+ *
+ * @param renderer   @aribcc_renderer_t
+ * @param pts_begin  Begin of the PTS range, in milliseconds
+ * @param pts_end    End of the PTS range (exclusive), in milliseconds
+ * @param callback   Called on the calling thread for each interval, see @aribcc_render_change_callback_t
+ * @param userdata   User data that will be passed in callback
+ * @return           ARIBCC_RENDER_STATUS_GOT_IMAGE if any interval with images has been reported,
+ *                   ARIBCC_RENDER_STATUS_NO_IMAGE if none, ARIBCC_RENDER_STATUS_ERROR if rendering failed
+ */
+ARIBCC_API aribcc_render_status_t aribcc_renderer_render_all_changes(aribcc_renderer_t* renderer,
+                                                                     int64_t pts_begin,
+                                                                     int64_t pts_end,
+                                                                     aribcc_render_change_callback_t callback,
+                                                                     void* userdata);
+
+/**
+ * Render caption at specific PTS, and composite it directly onto a caller-provided overlay surface
+ *
+ * The buffer represents the whole renderer frame indicated by @aribcc_renderer_set_frame_size(), and must be fully
+ * transparent before the first call. The renderer only touches pixels it has drawn, so the buffer must keep the
+ * content written by the previous call: previously drawn images are erased (set to transparent)
+ * and new images are blended onto the buffer.
+ *
+ * @param renderer        @aribcc_renderer_t
+ * @param pts             Presentation timestamp, in milliseconds
+ * @param buffer          Pointer to the top-left pixel of the surface, must be aligned to 4 bytes
+ * @param stride          Bytes in a line of the surface, must be >= frame_width * 4
+ * @param pixel_format    Pixel format of the surface, any 32-bit format, ARIBCC_PIXELFORMAT_INDEXED8 is not supported
+ * @param dirty_rect_out  Optional pointer for receiving the area that has been modified inside the buffer,
+ *                        will be empty if nothing has been modified. Could be NULL
+ *
+ * @return                ARIBCC_RENDER_STATUS_GOT_IMAGE / ARIBCC_RENDER_STATUS_GOT_IMAGE_UNCHANGED
+ *                        if the buffer contains caption images, ARIBCC_RENDER_STATUS_NO_IMAGE if the buffer
+ *                        has been cleared or left empty
+ */
+ARIBCC_API aribcc_render_status_t aribcc_renderer_render_into(aribcc_renderer_t* renderer,
+                                                              int64_t pts,
+                                                              uint8_t* buffer,
+                                                              int stride,
+                                                              aribcc_pixelformat_t pixel_format,
+                                                              aribcc_render_rect_t* dirty_rect_out);
+
+/**
+ * Start loading system font configuration on a background thread, optional
+ *
+ * Font providers loading their configuration lazily (i.e. Fontconfig) would otherwise load it on the first
+ * rendering, which may take a noticeable time on systems with large font sets. No-op for other font providers.
+ * Must be called after @aribcc_renderer_initialize().
+ *
+ * @param renderer       @aribcc_renderer_t
+ */
+ARIBCC_API void aribcc_renderer_warm_up_fonts(aribcc_renderer_t* renderer);
+
+/**
+ * Load fonts and pre-render glyphs of specified character sets on a background thread
+ *
+ * Glyphs will be rendered at the size in which they would appear inside a frame of indicated size,
+ * so that subsequent render calls could hit the glyph cache from the first caption.
+ * Calling this function again cancels the pending pre-warm task. Font families, margins and other renderer settings
+ * should be indicated before calling this function.
+ *
+ * @param renderer       @aribcc_renderer_t
+ * @param language_code  ISO639-2 Language Code for font family selection, e.g. ARIBCC_MAKE_LANG('j', 'p', 'n')
+ * @param charsets       Combination of @aribcc_prewarm_charset_t flags
+ * @param frame_width    Expected frame width, must be > 0
+ * @param frame_height   Expected frame height, must be > 0
+ * @return true if the pre-warm task has been started
+ */
+ARIBCC_API bool aribcc_renderer_prewarm_glyphs(aribcc_renderer_t* renderer,
+                                               uint32_t language_code,
+                                               int charsets,
+                                               int frame_width,
+                                               int frame_height);
+
+/**
+ * Set memory cap of the region image cache
+ *
+ * Rendered region images are cached by their content (characters, styles, DRCS patterns, positions and sizes),
+ * so that identical regions among consecutive captions, e.g. a persistent speaker label or lines kept during
+ * roll-up, won't be rendered again. Least recently used images are evicted once the cap is exceeded.
+ *
+ * @param renderer  @aribcc_renderer_t
+ * @param bytes     Memory cap in bytes, 0 for disabling the cache. Default as 16 MiB
+ */
+ARIBCC_API void aribcc_renderer_set_region_cache_memory_limit(aribcc_renderer_t* renderer, size_t bytes);
+
+/**
+ * Retrieve statistics of the region image cache
+ *
+ * @param renderer   @aribcc_renderer_t
+ * @param out_stats  Pointer to a @aribcc_region_cache_stats_t for receiving the statistics
+ */
+ARIBCC_API void aribcc_renderer_get_region_cache_stats(aribcc_renderer_t* renderer,
+                                                       aribcc_region_cache_stats_t* out_stats);
+
+/**
+ * Retrieve approximate memory usage of the caption storage and image caches, for monitoring
+ *
+ * With ARIBCC_CAPTION_STORAGE_POLICY_UPPER_LIMIT_BYTES, the limit is enforced on each caption appending and after
+ * each rendering call. Images returned to the caller are not accounted. The latest rendered images and the glyph
+ * atlas can't be evicted, they are reported separately and not accounted into the limit.
+ *
+ * @param renderer   @aribcc_renderer_t
+ * @param out_usage  Pointer to a @aribcc_storage_memory_usage_t for receiving the memory usage
+ */
+ARIBCC_API void aribcc_renderer_get_storage_memory_usage(aribcc_renderer_t* renderer,
+                                                         aribcc_storage_memory_usage_t* out_usage);
+
 /**
  * Clear caption storage inside the renderer. Will evict all the appended captions.
  *
@@ -19,6 +19,7 @@
 #ifndef ARIBCAPTION_RENDERER_HPP
 #define ARIBCAPTION_RENDERER_HPP
 
+#include <functional>
 #include <memory>
 #include <optional>
 #include "aribcc_config.h"
@@ -105,6 +106,69 @@ enum class TextRendererType {
 #endif
 };
 
+/**
+ * Enums for stroke text (border) generation method indication
+ */
+enum class StrokeMode {
+    /**
+     * Stroke glyph outlines with the TextRenderer's vector stroker, e.g. FT_Stroker. This is the default behavior.
+     */
+    kOutline = 0,
+
+    /**
+     * Grow rasterized glyph / DRCS coverage masks by a disk-shaped kernel (morphological dilation).
+     * Much faster than stroking outlines. Affects the Freetype TextRenderer and DRCS rendering.
+     */
+    kDilation = 1,
+};
+
+/**
+ * Enums for DRCS scaling method indication
+ */
+enum class DRCSScaleMode {
+    /**
+     * Nearest-neighbor scaling, keeps the hard edges of the original pattern. This is the default behavior.
+     */
+    kNearest = 0,
+
+    /**
+     * Area-average (box filter) scaling, produces smoother edges when downscaling.
+     */
+    kAreaAverage = 1,
+};
+
+/**
+ * Enums for indicating how region images are merged, see @Renderer::SetMergeRegionImages()
+ */
+enum class RegionMergeMode {
+    /**
+     * Merge all region images into one image covering their bounding box. This is the default behavior.
+     */
+    kBoundingBox = 0,
+
+    /**
+     * Merge region images into a minimal set of non-overlapping images, regions far apart from each other
+     * stay in separate images instead of being joined by a mostly transparent bitmap.
+     */
+    kSparse = 1,
+};
+
+/**
+ * Enums for indicating what Render() outputs, see @Renderer::SetRenderOutputMode()
+ */
+enum class RenderOutputMode {
+    /**
+     * One image per region (or merged images). This is the default behavior.
+     */
+    kImages = 0,
+
+    /**
+     * A list of quads sampling a shared glyph atlas, plus solid quads for backgrounds and enclosures.
+     * Suitable for GPU compositors: the atlas is uploaded into one texture and updated incrementally.
+     */
+    kGlyphQuads = 1,
+};
+
 namespace internal { class RendererImpl; }
 
 /**
@@ -132,6 +196,49 @@ enum class CaptionStoragePolicy {
      * The renderer will keep appended captions at an upper limit of duration, in milliseconds.
      */
     kUpperLimitDuration = 3,
+
+    /**
+     * The renderer will keep approximate memory usage of appended captions (including DRCS patterns) and its
+     * caches at an upper limit of bytes, see @Renderer::GetStorageMemoryUsage().
+     *
+     * Once exceeded, captions before the one displayed at the playback position (PTS of the last
+     * Render() / TryRender() / RenderInto() call) are evicted first (oldest first), then cached region images
+     * and caption layouts (least recently used first). The displayed caption and upcoming ones are never evicted,
+     * so the limit could still be exceeded by them. Nothing is evicted before the first rendering.
+     */
+    kUpperLimitBytes = 4,
+};
+
+/**
+ * Character sets that could be pre-rendered by @Renderer::PrewarmGlyphs(), could be combined
+ */
+enum PrewarmCharset {
+    kPrewarmCharsetNone = 0,
+
+    /**
+     * Hiragana, Katakana and JIS X 0208 row 1 symbols (punctuations)
+     */
+    kPrewarmCharsetKana = 1u << 0,
+
+    /**
+     * JIS X 0208 level-1 Kanji (row 16 ~ 47)
+     */
+    kPrewarmCharsetJISLevel1Kanji = 1u << 1,
+
+    /**
+     * Fullwidth alphanumerics, in both full size and middle size
+     */
+    kPrewarmCharsetFullwidthAlphanumeric = 1u << 2,
+
+    /**
+     * Alternative Unicode characters for well-known DRCS patterns
+     */
+    kPrewarmCharsetDRCSReplacement = 1u << 3,
+
+    kPrewarmCharsetAll = kPrewarmCharsetKana |
+                         kPrewarmCharsetJISLevel1Kanji |
+                         kPrewarmCharsetFullwidthAlphanumeric |
+                         kPrewarmCharsetDRCSReplacement,
 };
 
 /**
@@ -146,15 +253,127 @@ enum class RenderStatus {
     kGotImageUnchanged = 3,
 };
 
+/**
+ * Statistics of the renderer's region image cache, see @Renderer::GetRegionCacheStatistics()
+ *
+ * Hit rate could be calculated as hits / (hits + misses).
+ */
+struct RegionCacheStatistics {
+    size_t hits = 0;           ///< count of regions served from the cache
+    size_t misses = 0;         ///< count of regions that have been rendered
+    size_t entry_count = 0;    ///< count of cached region images
+    size_t memory_used = 0;    ///< approximate memory used by cached region images, in bytes
+    size_t memory_limit = 0;   ///< memory cap of the cache, in bytes
+};
+
+/**
+ * Memory usage of the renderer's caption storage and image caches, see @Renderer::GetStorageMemoryUsage()
+ *
+ * All the values are approximate, in bytes except caption_count.
+ */
+struct StorageMemoryUsage {
+    size_t caption_count = 0;       ///< count of stored captions
+    size_t captions = 0;            ///< memory used by stored captions, including texts and DRCS patterns
+    size_t region_image_cache = 0;  ///< memory used by the region image cache
+    size_t layout_cache = 0;        ///< memory used by cached caption layouts
+    size_t total = 0;               ///< sum of the above memory usages, which kUpperLimitBytes policy applies to
+    size_t limit = 0;               ///< upper limit of kUpperLimitBytes policy, 0 if another policy is in use
+
+    size_t rendered_images = 0;     ///< memory held by the latest rendered images, never evicted
+    size_t glyph_atlas = 0;         ///< memory of the glyph atlas used in kGlyphQuads output mode, never evicted
+    size_t unevictable = 0;         ///< sum of rendered_images and glyph_atlas, not accounted into total
+};
+
+/**
+ * Rectangle inside the renderer frame, in pixels
+ */
+struct RenderRect {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+/**
+ * Output frame of @Renderer::RenderMulti(), see @Renderer::SetFrameSize() and @Renderer::SetMargins()
+ */
+struct RenderTarget {
+    int frame_width = 0;
+    int frame_height = 0;
+    int margin_top = 0;
+    int margin_bottom = 0;
+    int margin_left = 0;
+    int margin_right = 0;
+};
+
+/**
+ * Quad to be drawn onto the frame, see @RenderOutputMode::kGlyphQuads
+ *
+ * Quads must be drawn in order with alpha blending. Glyph quads copy (blend) the src rect of the glyph atlas
+ * into the dst rect without scaling, color is opaque white and could be used as a modulation color.
+ * Solid quads fill the dst rect with color, src is empty.
+ */
+struct RenderQuad {
+    RenderRect dst;              ///< destination rect inside the frame, like Image::dst_x / dst_y
+    RenderRect src;              ///< rect inside the glyph atlas, empty for solid quads
+    ColorRGBA color;
+    bool solid = false;
+};
+
+/**
+ * Changes of the glyph atlas since the previous Render() call, see @RenderOutputMode::kGlyphQuads
+ *
+ * If generation differs from the one of the atlas copy held by the caller, the atlas has been reset:
+ * the copy must be cleared (fully transparent) before applying cells. Cells are new parts of the atlas,
+ * with dst_x / dst_y in atlas coordinates, in the output pixel format (kRGBA8888 if kIndexed8 is indicated).
+ */
+struct GlyphAtlasUpdate {
+    int width = 0;
+    int height = 0;
+    uint64_t generation = 0;
+    std::vector<Image> cells;
+};
+
 /**
  * Structure for holding rendered caption images
  */
 struct RenderResult {
     int64_t pts = 0;             ///< PTS of rendered caption
     int64_t duration = 0;        ///< duration of rendered caption, may be DURATION_INDEFINITE
-    std::vector<Image> images;
+    std::vector<Image> images;   ///< empty in kGlyphQuads output mode
+    std::vector<RenderQuad> quads;  ///< only provided in kGlyphQuads output mode
+    GlyphAtlasUpdate atlas;         ///< only provided in kGlyphQuads output mode
 };
 
+/**
+ * Callback of @Renderer::RenderAllChanges(), called once per display interval in PTS order
+ *
+ * result.pts / result.duration indicate the interval. status is kGotImage if images are displayed during
+ * the interval, or kNoImage for a cleared screen between captions, in which case result.images is empty.
+ *
+ * Rendering workers keep reading stored captions and render settings while the callback runs, so the callback
+ * must not call back into the renderer. Appending / flushing captions, rendering, or changing any render setting
+ * (frame size, margins, fonts, stroke, pixel format...) from the callback are rejected (and assert in debug builds).
+ * @Renderer::QueueCaption() is still allowed.
+ */
+using RenderChangeCallback = std::function<void(RenderStatus status, const RenderResult& result)>;
+
+/**
+ * Callback of @Renderer::SetCaptionChangeCallback(), called on the rendering thread once stored captions are changed
+ *
+ * pts is the earliest PTS from which rendered results may differ, e.g. PTS of a newly appended caption,
+ * or PTS_NOPTS if the storage has been flushed. Players could re-query @Renderer::GetNextChangePts() on this event.
+ */
+using CaptionChangeCallback = std::function<void(int64_t pts)>;
+
+/**
+ * Callback of @Renderer::SetCaptionQueueCallback(), called on the producer thread once a caption is queued
+ *
+ * pts is PTS of the queued caption. The caption isn't stored yet, players could wake up the rendering thread
+ * on this event, which will take queued captions and then call @CaptionChangeCallback.
+ */
+using CaptionQueueCallback = std::function<void(int64_t pts)>;
+
 /**
  * ARIB STD-B24 caption renderer
  */
@@ -177,6 +396,10 @@ public:
      * @param font_provider_type  Indicate @FontProviderType. Use kAuto in most cases.
      * @param text_renderer_type  Indicate @TextRendererType. Use kAuto in most cases.
      * @return true on success
+     *
+     * With the Fontconfig font provider, system font configuration is loaded lazily on the first rendering
+     * (or in background by @WarmUpFonts()), so a broken configuration is not reported here, but logged as an error
+     * and results in kError from the rendering functions.
      */
     ARIBCC_API bool Initialize(CaptionType caption_type = CaptionType::kCaption,
                                FontProviderType font_provider_type = FontProviderType::kAuto,
@@ -188,6 +411,18 @@ public:
      */
     ARIBCC_API void SetStrokeWidth(float dots);
 
+    /**
+     * Indicate how stroke text (border) will be generated
+     * @param mode See @StrokeMode, default as kOutline
+     */
+    ARIBCC_API void SetStrokeMode(StrokeMode mode);
+
+    /**
+     * Indicate how DRCS patterns will be scaled into target character size
+     * @param mode See @DRCSScaleMode, default as kNearest
+     */
+    ARIBCC_API void SetDRCSScaleMode(DRCSScaleMode mode);
+
     /**
      * Indicate whether render replaced DRCS characters as Unicode characters
      * @param replace default as true
@@ -218,6 +453,52 @@ public:
      */
     ARIBCC_API void SetMergeRegionImages(bool merge);
 
+    /**
+     * Indicate how region images are merged if @SetMergeRegionImages() is enabled
+     * @param mode See @RegionMergeMode, default as kBoundingBox
+     */
+    ARIBCC_API void SetRegionMergeMode(RegionMergeMode mode);
+
+    /**
+     * Crop each rendered region image to the bounding box of its non-transparent pixels, dst_x / dst_y are adjusted
+     *
+     * Mostly useful along with @SetForceNoBackground(), which leaves transparent padding around the glyphs.
+     * Regions without any visible pixel produce no image.
+     *
+     * @param crop default as false
+     */
+    ARIBCC_API void SetCropRegionImages(bool crop);
+
+    /**
+     * Indicate pixel format of images returned by Render()
+     *
+     * Images are always rendered in kRGBA8888 and converted once per new rendering result.
+     * For kIndexed8, each image carries its own palette (see @Image::palette).
+     *
+     * @param format default as kRGBA8888
+     */
+    ARIBCC_API void SetPixelFormat(PixelFormat format);
+
+    /**
+     * Indicate what Render() outputs, region images or quads sampling a glyph atlas
+     *
+     * In kGlyphQuads mode, Render() fills @RenderResult::quads and @RenderResult::atlas instead of images,
+     * merging / cropping of region images doesn't apply, RenderMulti() and RenderInto() keep producing images.
+     *
+     * @param mode See @RenderOutputMode, default as kImages
+     */
+    ARIBCC_API void SetRenderOutputMode(RenderOutputMode mode);
+
+    /**
+     * Retrieve a copy of the whole glyph atlas, e.g. for re-creating a lost texture
+     *
+     * Glyph cells inserted so far are treated as delivered, they won't appear in the next atlas update.
+     *
+     * @param out_atlas  Write back parameter, cells contains one image of the whole atlas
+     * @return false if the atlas hasn't been created yet, i.e. nothing rendered in kGlyphQuads mode
+     */
+    ARIBCC_API bool GetGlyphAtlas(GlyphAtlasUpdate& out_atlas);
+
     /**
      * Indicate font families (an array of font family names) for default usage
      *
@@ -274,7 +555,8 @@ public:
      * Set storage policy for renderer's internal caption storage
      *
      * @param policy       See @CaptionStoragePolicy
-     * @param upper_limit  Optional parameter, but must has a value for kUpperLimitCount & kUpperLimitDuration
+     * @param upper_limit  Optional parameter, but must has a value for kUpperLimitCount, kUpperLimitDuration
+     *                     & kUpperLimitBytes
      */
     ARIBCC_API void SetStoragePolicy(CaptionStoragePolicy policy, std::optional<size_t> upper_limit = std::nullopt);
 
@@ -298,6 +580,35 @@ public:
      */
     ARIBCC_API bool AppendCaption(Caption&& caption);
 
+    /**
+     * Append a serialized caption into renderer's internal storage for subsequent rendering
+     *
+     * The data, e.g. from shared memory, is validated and deserialized into a stored Caption, so the caller doesn't
+     * need to construct one. See caption_serializer.hpp for the layout. The data could be released right after
+     * the call.
+     *
+     * @param data  Serialized caption, must be 8-byte aligned
+     * @param size  Size of the data in bytes
+     * @return false if the data is invalid, or if the caption has no PTS or invalid plane size
+     */
+    ARIBCC_API bool AppendCaption(const void* data, size_t size);
+
+    /**
+     * Queue a caption from another thread for subsequent rendering
+     *
+     * This function is lock-free and is meant to be called from a single producer thread (e.g. the decoding thread),
+     * while the renderer is driven from another thread. Queued captions are moved into renderer's internal storage
+     * in the queued order by the next call of AppendCaption(), TryRender(), Render(), RenderMulti(),
+     * RenderAllChanges() or RenderInto() on the rendering thread. Flush() drops queued captions as well.
+     * Use SetCaptionQueueCallback() to be notified on the producer thread when a caption is queued.
+     *
+     * Only one thread may call QueueCaption() at a time, all the other functions must stay on the rendering thread.
+     *
+     * @param caption Caption to queue, use std::move() to avoid copying
+     * @return false if caption has no PTS or invalid plane size, true otherwise
+     */
+    ARIBCC_API bool QueueCaption(Caption caption);
+
     /**
      * Retrieve expected RenderStatus at specific PTS, rather than actually do rendering.
      *
@@ -309,6 +620,42 @@ public:
      */
     ARIBCC_API RenderStatus TryRender(int64_t pts);
 
+    /**
+     * Retrieve PTS of the next change of rendered results after specific PTS
+     *
+     * The change is where the caption displayed at pts expires through its wait_duration or is replaced by the next
+     * caption, or where the next caption appears if nothing is displayed at pts. Rendering is only necessary at
+     * the returned PTS, rather than on every video frame, as long as no caption is appended meanwhile
+     * (see @SetCaptionChangeCallback()).
+     *
+     * @param pts  Presentation timestamp, in milliseconds
+     * @return     PTS of the next change, or PTS_NOPTS if nothing will change with currently stored captions
+     */
+    ARIBCC_API int64_t GetNextChangePts(int64_t pts);
+
+    /**
+     * Indicate a callback for receiving changes of stored captions, pass nullptr to clear the callback
+     *
+     * The callback is called on the rendering thread, by appending functions or when queued captions are taken
+     * (see @QueueCaption()), once per batch of queued captions with the earliest PTS among them.
+     * Calling GetNextChangePts() inside the callback is allowed, changes made from inside the callback are
+     * delivered after it returns rather than by calling it recursively.
+     *
+     * @param callback  See @CaptionChangeCallback
+     */
+    ARIBCC_API void SetCaptionChangeCallback(CaptionChangeCallback callback);
+
+    /**
+     * Indicate a callback for receiving queued captions on the producer thread, pass nullptr to clear the callback
+     *
+     * The callback is called by QueueCaption() on the producer thread, after the caption is queued. Queued captions
+     * are only taken on the rendering thread, so players could use this callback to wake the rendering thread up.
+     * The callback must not call into the renderer. Indicate the callback before calling QueueCaption().
+     *
+     * @param callback  See @CaptionQueueCallback
+     */
+    ARIBCC_API void SetCaptionQueueCallback(CaptionQueueCallback callback);
+
     /**
      * Render caption at specific PTS
      *
@@ -322,6 +669,128 @@ public:
      */
     ARIBCC_API RenderStatus Render(int64_t pts, RenderResult& out_result);
 
+    /**
+     * Render caption at specific PTS for multiple output frames at once, e.g. renditions of different resolutions
+     *
+     * Captions, fonts, glyph caches and region layouts are shared between targets, and rendered region images
+     * are cached per target size as well, so the region cache limit should be raised accordingly
+     * (see @SetRegionCacheMemoryLimit()). Frame size / margins set on the renderer are not used, and the state
+     * of Render() / RenderInto() is not affected. Images are always marked as changed.
+     *
+     * @param pts          Presentation timestamp, in milliseconds
+     * @param targets      Output frames to render for
+     * @param out_results  Write back parameter for rendered images, one RenderResult per target in the same order,
+     *                     will be empty if status is kError / kNoImage
+     *
+     * @return             kGotImage if any target got images, otherwise kNoImage / kError
+     */
+    ARIBCC_API RenderStatus RenderMulti(int64_t pts,
+                                        const std::vector<RenderTarget>& targets,
+                                        std::vector<RenderResult>& out_results);
+
+    /**
+     * Render every change of the displayed caption within [pts_begin, pts_end), e.g. for subtitle exporting
+     *
+     * Stored captions are walked directly instead of being looked up per video frame. Each distinct display
+     * interval is reported exactly once: consecutive captions producing identical images are joined, and so are
+     * consecutive intervals without images. Intervals are clipped into [pts_begin, pts_end), and nothing is reported
+     * before the first or after the last interval with images. A caption of indefinite duration lasts until
+     * pts_end. Captions are rendered on multiple threads if there are many of them.
+     *
+     * Uses frame size / margins / pixel format set on the renderer, always produces images regardless of
+     * @SetRenderOutputMode(), and doesn't affect the state of Render() / RenderInto(). Captions must still be
+     * stored in the renderer, so a storage policy other than kMinimum should be used (see @SetStoragePolicy()).
+     *
+     * @param pts_begin  Begin of the PTS range, in milliseconds
+     * @param pts_end    End of the PTS range (exclusive), in milliseconds
+     * @param callback   Called on the calling thread for each interval, see @RenderChangeCallback
+     *
+     * @return           kGotImage if any interval with images has been reported, kNoImage if none,
+     *                   kError if rendering failed, no more intervals will be reported in that case
+     */
+    ARIBCC_API RenderStatus RenderAllChanges(int64_t pts_begin, int64_t pts_end, const RenderChangeCallback& callback);
+
+    /**
+     * Render caption at specific PTS, and composite it directly onto a caller-provided overlay surface
+     *
+     * The buffer represents the whole renderer frame indicated by @SetFrameSize(), and must be fully transparent
+     * before the first call. The renderer only touches pixels it has drawn, so the buffer must keep the content
+     * written by the previous RenderInto() call: previously drawn images are erased (set to transparent)
+     * and new images are blended onto the buffer.
+     *
+     * @param pts             Presentation timestamp, in milliseconds
+     * @param buffer          Pointer to the top-left pixel of the surface, must be aligned to 4 bytes
+     * @param stride          Bytes in a line of the surface, must be >= frame_width * 4
+     * @param pixel_format    Pixel format of the surface, any 32-bit format, kIndexed8 is not supported
+     * @param dirty_rect_out  Optional write back parameter for the area that has been modified inside the buffer,
+     *                        will be empty if nothing has been modified
+     *
+     * @return                kGotImage / kGotImageUnchanged if the buffer contains caption images
+     *                        kNoImage if the buffer has been cleared or left empty
+     */
+    ARIBCC_API RenderStatus RenderInto(int64_t pts,
+                                       uint8_t* buffer,
+                                       int stride,
+                                       PixelFormat pixel_format,
+                                       RenderRect* dirty_rect_out = nullptr);
+
+    /**
+     * Start loading system font configuration on a background thread, optional
+     *
+     * Font providers loading their configuration lazily (i.e. Fontconfig) would otherwise load it on the first
+     * rendering, which may take a noticeable time on systems with large font sets. No-op for other font providers.
+     * Must be called after @Initialize().
+     */
+    ARIBCC_API void WarmUpFonts();
+
+    /**
+     * Load fonts and pre-render glyphs of specified character sets on a background thread
+     *
+     * Glyphs will be rendered at the size in which they would appear inside a frame of indicated size,
+     * so that subsequent @Render() calls could hit the glyph cache from the first caption.
+     * Calling this function again cancels the pending pre-warm task. Font families, margins (see @SetMargins()),
+     * stroke width and other renderer settings should be indicated before calling this function.
+     *
+     * Only the Freetype based TextRenderer keeps a glyph cache, other TextRenderers only benefit from font loading.
+     *
+     * @param language_code ISO639-2 Language Code for font family selection, e.g. ThreeCC("jpn")
+     * @param charsets      Combination of @PrewarmCharset flags
+     * @param frame_width   Expected frame width, must be > 0
+     * @param frame_height  Expected frame height, must be > 0
+     * @return true if the pre-warm task has been started
+     */
+    ARIBCC_API bool PrewarmGlyphs(uint32_t language_code, PrewarmCharset charsets, int frame_width, int frame_height);
+
+    /**
+     * Set memory cap of the region image cache
+     *
+     * Rendered region images are cached by their content (characters, styles, DRCS patterns, positions and sizes),
+     * so that identical regions among consecutive captions, e.g. a persistent speaker label or lines kept during
+     * roll-up, won't be rendered again. Least recently used images are evicted once the cap is exceeded.
+     *
+     * @param bytes  Memory cap in bytes, 0 for disabling the cache. Default as 16 MiB
+     */
+    ARIBCC_API void SetRegionCacheMemoryLimit(size_t bytes);
+
+    /**
+     * Retrieve statistics of the region image cache
+     *
+     * @return See @RegionCacheStatistics
+     */
+    ARIBCC_API RegionCacheStatistics GetRegionCacheStatistics();
+
+    /**
+     * Retrieve approximate memory usage of the caption storage and image caches, for monitoring
+     *
+     * With kUpperLimitBytes storage policy, the limit is enforced on each caption appending and after each
+     * Render() / RenderMulti() / RenderAllChanges() / RenderInto() call. Copies of images returned to the caller
+     * are not accounted. The latest rendered images and the glyph atlas can't be evicted, they are reported
+     * separately and not accounted into the limit.
+     *
+     * @return See @StorageMemoryUsage
+     */
+    ARIBCC_API StorageMemoryUsage GetStorageMemoryUsage();
+
     /**
      * Clear caption storage inside the renderer. Will evict all the appended captions.
      *
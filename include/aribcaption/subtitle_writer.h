@@ -0,0 +1,134 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_SUBTITLE_WRITER_H
+#define ARIBCAPTION_SUBTITLE_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "aribcc_export.h"
+#include "context.h"
+#include "caption.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Enums for text subtitle formats written by @aribcc_subtitle_writer_t
+ */
+typedef enum aribcc_subtitle_format_t {
+    /**
+     * Advanced SubStation Alpha (.ass), regions are absolutely positioned on the caption plane,
+     * ruby regions use a separate "Ruby" style
+     */
+    ARIBCC_SUBTITLE_FORMAT_ASS = 0,
+
+    /**
+     * WebVTT (.vtt), regions are positioned by cue settings, ruby is attached to its base text
+     * by <ruby> tags, colors are mapped to the nearest ARIB color with a cue class
+     */
+    ARIBCC_SUBTITLE_FORMAT_WEBVTT = 1,
+} aribcc_subtitle_format_t;
+
+/**
+ * Default output buffer size of @aribcc_subtitle_writer_initialize()
+ */
+#define ARIBCC_SUBTITLE_WRITER_DEFAULT_BUFFER_SIZE (64 * 1024)
+
+/**
+ * Streaming text subtitle writer converting decoded captions into ASS / WebVTT with ARIB styling
+ *
+ * Captions are written in PTS order, each one is displayed until the next caption clearing the screen
+ * (ARIBCC_CAPTIONFLAGS_CLEARSCREEN) or until its duration ends. Captions without the flag are displayed on top of
+ * the captions still displayed, and a caption clearing the screen without new regions only ends the displayed ones.
+ *
+ * Opaque type
+ */
+typedef struct aribcc_subtitle_writer_t aribcc_subtitle_writer_t;
+
+/**
+ * Callback receiving the written subtitle in UTF-8, in chunks of up to the buffer size
+ */
+typedef void(*aribcc_subtitle_write_callback_t)(const char* data, size_t size, void* userdata);
+
+/**
+ * A context is needed for allocating the subtitle writer.
+ *
+ * The context shouldn't be freed before any other object constructed from the context has been freed.
+ */
+ARIBCC_API aribcc_subtitle_writer_t* aribcc_subtitle_writer_alloc(aribcc_context_t* context);
+
+/**
+ * Free the subtitle writer and all related resources
+ */
+ARIBCC_API void aribcc_subtitle_writer_free(aribcc_subtitle_writer_t* writer);
+
+/**
+ * Initialize function must be called before calling any other member functions.
+ *
+ * @param writer          @aribcc_subtitle_writer_t
+ * @param format          Indicate @aribcc_subtitle_format_t
+ * @param write_callback  Callback receiving the subtitle
+ * @param userdata        Passed to write_callback
+ * @param buffer_size     Output is buffered up to buffer_size bytes before write_callback is called,
+ *                        e.g. ARIBCC_SUBTITLE_WRITER_DEFAULT_BUFFER_SIZE
+ * @return true on success
+ */
+ARIBCC_API bool aribcc_subtitle_writer_initialize(aribcc_subtitle_writer_t* writer,
+                                                  aribcc_subtitle_format_t format,
+                                                  aribcc_subtitle_write_callback_t write_callback,
+                                                  void* userdata,
+                                                  size_t buffer_size);
+
+/**
+ * Set font family written into ASS styles, must be called before writing the first caption.
+ * Ignored for WebVTT. Default as "sans-serif".
+ *
+ * @param writer       @aribcc_subtitle_writer_t
+ * @param font_family  Font family name in UTF-8
+ */
+ARIBCC_API void aribcc_subtitle_writer_set_font_family(aribcc_subtitle_writer_t* writer, const char* font_family);
+
+/**
+ * Write a caption, e.g. received from @aribcc_decoder_decode()
+ *
+ * The caption is buffered until its end time is known, e.g. until the next caption clearing the screen or flushing.
+ *
+ * @param writer   @aribcc_subtitle_writer_t
+ * @param caption  Caption to write
+ * @return false if the caption has no PTS, or its PTS is earlier than the previous one
+ */
+ARIBCC_API bool aribcc_subtitle_writer_write(aribcc_subtitle_writer_t* writer, const aribcc_caption_t* caption);
+
+/**
+ * Write the last caption and all buffered output, call this at the end of the stream
+ *
+ * @param writer   @aribcc_subtitle_writer_t
+ * @param end_pts  End of the stream, the last caption is cut at end_pts if indicated. A last caption with
+ *                 ARIBCC_DURATION_INDEFINITE lasts 1 second if end_pts is ARIBCC_PTS_NOPTS.
+ */
+ARIBCC_API void aribcc_subtitle_writer_flush(aribcc_subtitle_writer_t* writer, int64_t end_pts);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ARIBCAPTION_SUBTITLE_WRITER_H
@@ -0,0 +1,120 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_SUBTITLE_WRITER_HPP
+#define ARIBCAPTION_SUBTITLE_WRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include "aribcc_export.h"
+#include "context.hpp"
+#include "caption.hpp"
+
+namespace aribcaption {
+
+namespace internal { class SubtitleWriterImpl; }
+
+/**
+ * Enums for text subtitle formats written by @SubtitleWriter
+ */
+enum class SubtitleFormat {
+    /**
+     * Advanced SubStation Alpha (.ass), regions are absolutely positioned on the caption plane,
+     * ruby regions use a separate "Ruby" style
+     */
+    kASS = 0,
+
+    /**
+     * WebVTT (.vtt), regions are positioned by cue settings, ruby is attached to its base text
+     * by <ruby> tags, colors are mapped to the nearest ARIB color with a cue class
+     */
+    kWebVTT = 1,
+};
+
+/**
+ * Streaming text subtitle writer converting decoded captions into ASS / WebVTT with ARIB styling,
+ * i.e. region positions, character sizes, colors, backgrounds, stroke and ruby, without rendering bitmaps.
+ *
+ * Captions are written in PTS order, each one is displayed until the next caption clearing the screen
+ * (@kCaptionFlagsClearScreen) or until its duration ends. Captions without the flag are displayed on top of
+ * the captions still displayed, and a caption clearing the screen without new regions only ends the displayed ones.
+ */
+class SubtitleWriter {
+public:
+    /**
+     * Callback receiving the written subtitle in UTF-8, in chunks of up to the buffer size
+     */
+    using WriteCallback = std::function<void(const char* data, size_t size)>;
+
+    static constexpr size_t kDefaultBufferSize = 64 * 1024;
+public:
+    /**
+     * A context is needed for constructing the SubtitleWriter.
+     *
+     * The context shouldn't be destructed before any other object constructed from the context has been destructed.
+     */
+    ARIBCC_API explicit SubtitleWriter(Context& context);
+    ARIBCC_API ~SubtitleWriter();
+    ARIBCC_API SubtitleWriter(SubtitleWriter&&) noexcept;
+    ARIBCC_API SubtitleWriter& operator=(SubtitleWriter&&) noexcept;
+public:
+    /**
+     * Initialize function must be called before calling any other member functions.
+     *
+     * @param format          Indicate @SubtitleFormat
+     * @param write_callback  Callback receiving the subtitle
+     * @param buffer_size     Output is buffered up to buffer_size bytes before write_callback is called
+     * @return true on success
+     */
+    ARIBCC_API bool Initialize(SubtitleFormat format,
+                               WriteCallback write_callback,
+                               size_t buffer_size = kDefaultBufferSize);
+
+    /**
+     * Set font family written into ASS styles, must be called before writing the first caption.
+     * Ignored for WebVTT. Default as "sans-serif".
+     */
+    ARIBCC_API void SetFontFamily(const std::string& font_family);
+
+    /**
+     * Write a caption, e.g. received from @Decoder::Decode()
+     *
+     * The caption is buffered until its end time is known, e.g. until the next caption clearing the screen or Flush().
+     *
+     * @return false if the caption has no PTS, or its PTS is earlier than the previous one
+     */
+    ARIBCC_API bool Write(const Caption& caption);
+
+    /**
+     * Write the last caption and all buffered output, call this at the end of the stream
+     *
+     * @param end_pts  End of the stream, the last caption is cut at end_pts if indicated.
+     *                 A last caption with DURATION_INDEFINITE lasts 1 second if end_pts is PTS_NOPTS.
+     */
+    ARIBCC_API void Flush(int64_t end_pts = PTS_NOPTS);
+private:
+    std::unique_ptr<internal::SubtitleWriterImpl> pimpl_;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_SUBTITLE_WRITER_HPP
@@ -0,0 +1,164 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_LRU_CACHE_HPP
+#define ARIBCAPTION_LRU_CACHE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace aribcaption {
+
+// Least-recently-used cache with cost accounting
+// Each entry has a cost (e.g. size in bytes), least recently used entries are evicted
+// once the total cost exceeds the capacity
+template <class Key, class Value, class Hash = std::hash<Key>>
+class LRUCache {
+public:
+    explicit LRUCache(size_t capacity) : capacity_(capacity) {}
+    ~LRUCache() = default;
+public:
+    // Returns nullptr if not found, otherwise the entry will be marked as most recently used
+    // Returned pointer stays valid until the entry is evicted
+    Value* Get(const Key& key) {
+        auto iter = index_.find(key);
+        if (iter == index_.end()) {
+            misses_++;
+            return nullptr;
+        }
+        hits_++;
+        entries_.splice(entries_.begin(), entries_, iter->second);
+        return &iter->second->value;
+    }
+
+    // Insert or replace an entry, then evict least recently used entries if necessary
+    // The newly inserted entry is never evicted by this call, even if its cost exceeds the capacity
+    Value& Put(const Key& key, Value value, size_t cost = 1) {
+        Erase(key);
+
+        entries_.push_front(Entry{key, std::move(value), cost});
+        index_.emplace(key, entries_.begin());
+        total_cost_ += cost;
+
+        EvictIfNecessary();
+        return entries_.front().value;
+    }
+
+    // Update the cost of an existing entry (e.g. after it has been modified through Get())
+    // The entry will be marked as most recently used and won't be evicted by this call
+    void UpdateCost(const Key& key, size_t cost) {
+        auto iter = index_.find(key);
+        if (iter == index_.end()) {
+            return;
+        }
+        entries_.splice(entries_.begin(), entries_, iter->second);
+        total_cost_ = total_cost_ - iter->second->cost + cost;
+        iter->second->cost = cost;
+
+        EvictIfNecessary();
+    }
+
+    void Erase(const Key& key) {
+        auto iter = index_.find(key);
+        if (iter == index_.end()) {
+            return;
+        }
+        total_cost_ -= iter->second->cost;
+        entries_.erase(iter->second);
+        index_.erase(iter);
+    }
+
+    void Clear() {
+        entries_.clear();
+        index_.clear();
+        total_cost_ = 0;
+    }
+
+    void SetCapacity(size_t capacity) {
+        capacity_ = capacity;
+        EvictIfNecessary();
+    }
+
+    // Evict least recently used entries until the total cost doesn't exceed max_cost, regardless of the capacity
+    // Unlike capacity based eviction, all the entries could be evicted
+    void Trim(size_t max_cost) {
+        while (total_cost_ > max_cost && !entries_.empty()) {
+            Entry& last = entries_.back();
+            total_cost_ -= last.cost;
+            index_.erase(last.key);
+            entries_.pop_back();
+        }
+    }
+
+    void ResetStatistics() {
+        hits_ = 0;
+        misses_ = 0;
+    }
+
+    [[nodiscard]]
+    size_t size() const { return index_.size(); }
+
+    [[nodiscard]]
+    bool empty() const { return index_.empty(); }
+
+    [[nodiscard]]
+    size_t cost() const { return total_cost_; }
+
+    [[nodiscard]]
+    size_t capacity() const { return capacity_; }
+
+    [[nodiscard]]
+    size_t hits() const { return hits_; }
+
+    [[nodiscard]]
+    size_t misses() const { return misses_; }
+private:
+    void EvictIfNecessary() {
+        while (total_cost_ > capacity_ && entries_.size() > 1) {
+            Entry& last = entries_.back();
+            total_cost_ -= last.cost;
+            index_.erase(last.key);
+            entries_.pop_back();
+        }
+    }
+private:
+    struct Entry {
+        Key key;
+        Value value;
+        size_t cost = 0;
+    };
+
+    size_t capacity_ = 0;
+    size_t total_cost_ = 0;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+
+    std::list<Entry> entries_;
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index_;
+public:
+    LRUCache(const LRUCache&) = delete;
+    LRUCache& operator=(const LRUCache&) = delete;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_LRU_CACHE_HPP
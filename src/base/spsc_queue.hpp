@@ -0,0 +1,94 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_SPSC_QUEUE_HPP
+#define ARIBCAPTION_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace aribcaption {
+
+// Unbounded lock-free queue for exactly one producer thread and one consumer thread
+// Push() is only called by the producer and Pop() only by the consumer, neither of them ever waits for the other.
+// Nodes form a singly linked list from head_ (a consumed dummy, owned by the consumer) to tail_ (owned by the producer).
+template <class T>
+class SPSCQueue {
+public:
+    SPSCQueue() : head_(new Node), tail_(head_) {}
+
+    ~SPSCQueue() {
+        while (head_) {
+            Node* next = head_->next.load(std::memory_order_relaxed);
+            delete head_;
+            head_ = next;
+        }
+    }
+public:
+    void Push(T value) {
+        Node* node = new Node;
+        node->value.emplace(std::move(value));
+        tail_->next.store(node, std::memory_order_release);
+        tail_ = node;
+    }
+
+    // Returns false if the queue is empty
+    bool Pop(T& out_value) {
+        Node* next = head_->next.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+        out_value = std::move(*next->value);
+        next->value.reset();
+        delete head_;
+        head_ = next;
+        return true;
+    }
+
+    // Drops all values pushed so far, only called by the consumer
+    void Clear() {
+        while (Node* next = head_->next.load(std::memory_order_acquire)) {
+            delete head_;
+            head_ = next;
+            head_->value.reset();
+        }
+    }
+
+    [[nodiscard]]
+    bool empty() const {
+        return head_->next.load(std::memory_order_acquire) == nullptr;
+    }
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        std::optional<T> value;
+    };
+public:
+    // Disallow copy and assign
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+private:
+    Node* head_;  // Consumer side
+    Node* tail_;  // Producer side
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_SPSC_QUEUE_HPP
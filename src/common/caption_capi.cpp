@@ -23,9 +23,61 @@
 #include "aribcaption/caption.h"
 #include "aribcaption/caption.hpp"
 #include "base/utf_helper.hpp"
+#include "common/caption_capi.hpp"
 
 using namespace aribcaption;
 
+namespace aribcaption::internal {
+
+static CaptionRegion ConstructCaptionRegionFromCAPI(const aribcc_caption_region_t* src) {
+    CaptionRegion region;
+    region.x = src->x;
+    region.y = src->y;
+    region.width = src->width;
+    region.height = src->height;
+    region.is_ruby = src->is_ruby;
+
+    if (src->chars) {
+        region.chars.resize(src->char_count);
+        memcpy(region.chars.data(), src->chars, src->char_count * sizeof(aribcc_caption_char_t));
+    }
+
+    return region;
+}
+
+Caption ConstructCaptionFromCAPI(const aribcc_caption_t* src) {
+    Caption caption;
+    caption.type = static_cast<CaptionType>(src->type);
+    caption.flags = static_cast<CaptionFlags>(src->flags);
+    caption.iso6392_language_code = src->iso6392_language_code;
+    caption.pts = src->pts;
+    caption.wait_duration = src->wait_duration;
+    caption.plane_width = src->plane_width;
+    caption.plane_height = src->plane_height;
+    caption.has_builtin_sound = src->has_builtin_sound;
+    caption.builtin_sound_id = src->builtin_sound_id;
+
+    if (src->text) {
+        caption.text = src->text;
+    }
+
+    if (src->regions) {
+        for (uint32_t i = 0; i < src->region_count; i++) {
+            caption.regions.emplace_back(ConstructCaptionRegionFromCAPI(&src->regions[i]));
+        }
+    }
+
+    if (src->drcs_map) {
+        auto drcs_map = reinterpret_cast<std::unordered_map<uint32_t, DRCS>*>(src->drcs_map);
+        caption.drcs_map = *drcs_map;
+    }
+
+    return caption;
+}
+
+}  // namespace aribcaption::internal
+
+
 extern "C" {
 
 // aribcc_caption_char_t related function implementations
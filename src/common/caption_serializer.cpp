@@ -0,0 +1,422 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include "aribcaption/caption_serializer.hpp"
+
+namespace aribcaption {
+
+static_assert(sizeof(SerializedCaptionHeader) == 88, "Layout of SerializedCaptionHeader must not change");
+static_assert(sizeof(SerializedCaptionRegion) == 32, "Layout of SerializedCaptionRegion must not change");
+static_assert(sizeof(SerializedCaptionStyleRun) == 48, "Layout of SerializedCaptionStyleRun must not change");
+static_assert(sizeof(SerializedCaptionChar) == 32, "Layout of SerializedCaptionChar must not change");
+static_assert(sizeof(SerializedCaptionDRCS) == 48, "Layout of SerializedCaptionDRCS must not change");
+
+namespace {
+
+// Whether two adjoining chars could share a style run
+bool IsSameStyle(const CaptionChar& a, const CaptionChar& b) {
+    return a.char_width == b.char_width &&
+           a.char_height == b.char_height &&
+           a.char_horizontal_spacing == b.char_horizontal_spacing &&
+           a.char_vertical_spacing == b.char_vertical_spacing &&
+           a.char_horizontal_scale == b.char_horizontal_scale &&
+           a.char_vertical_scale == b.char_vertical_scale &&
+           a.text_color.u32 == b.text_color.u32 &&
+           a.back_color.u32 == b.back_color.u32 &&
+           a.stroke_color.u32 == b.stroke_color.u32 &&
+           a.style == b.style &&
+           a.enclosure_style == b.enclosure_style;
+}
+
+size_t CountStyleRuns(const CaptionRegion& region) {
+    size_t count = 0;
+    for (size_t i = 0; i < region.chars.size(); i++) {
+        if (i == 0 || !IsSameStyle(region.chars[i - 1], region.chars[i])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Offsets of each part inside a serialized caption
+struct Layout {
+    uint64_t regions = 0;
+    uint64_t style_runs = 0;
+    uint64_t chars = 0;
+    uint64_t drcs = 0;
+    uint64_t pool = 0;
+    uint64_t total_size = 0;
+
+    size_t region_count = 0;
+    size_t style_run_count = 0;
+    size_t char_count = 0;
+};
+
+Layout CalcLayout(const Caption& caption) {
+    Layout layout;
+    layout.region_count = caption.regions.size();
+    for (const CaptionRegion& region : caption.regions) {
+        layout.style_run_count += CountStyleRuns(region);
+        layout.char_count += region.chars.size();
+    }
+
+    uint64_t pool_size = caption.text.size() + 1;
+    for (const auto& [code, drcs] : caption.drcs_map) {
+        pool_size += drcs.pixels.size() + drcs.md5.size() + 1 + drcs.alternative_text.size() + 1;
+    }
+
+    layout.regions = sizeof(SerializedCaptionHeader);
+    layout.style_runs = layout.regions + layout.region_count * sizeof(SerializedCaptionRegion);
+    layout.chars = layout.style_runs + layout.style_run_count * sizeof(SerializedCaptionStyleRun);
+    layout.drcs = layout.chars + layout.char_count * sizeof(SerializedCaptionChar);
+    layout.pool = layout.drcs + caption.drcs_map.size() * sizeof(SerializedCaptionDRCS);
+    // Keep serialized captions 8-byte aligned if they are stored one after another
+    layout.total_size = (layout.pool + pool_size + 7) / 8 * 8;
+    return layout;
+}
+
+// Checks an array (or a byte range if elem_size is 1) lies inside the serialized caption, after the header
+bool IsValidSpan(const SerializedCaptionHeader* header, SerializedCaptionSpan span, size_t elem_size, size_t align) {
+    uint64_t end = static_cast<uint64_t>(span.offset) + static_cast<uint64_t>(span.count) * elem_size;
+    return span.offset >= header->header_size && end <= header->total_size && span.offset % align == 0;
+}
+
+// Checks a string in the byte pool, which must be followed by a '\0'
+bool IsValidString(const SerializedCaptionHeader* header, SerializedCaptionSpan span) {
+    if (span.count == std::numeric_limits<uint32_t>::max() ||
+            !IsValidSpan(header, SerializedCaptionSpan{span.offset, span.count + 1}, 1, 1)) {
+        return false;
+    }
+    return GetSerializedCaptionArray<char>(header, span)[span.count] == '\0';
+}
+
+}  // namespace
+
+size_t GetSerializedCaptionSize(const Caption& caption) {
+    Layout layout = CalcLayout(caption);
+    if (layout.total_size > std::numeric_limits<uint32_t>::max()) {
+        return 0;
+    }
+    return static_cast<size_t>(layout.total_size);
+}
+
+size_t SerializeCaption(const Caption& caption, void* buffer, size_t capacity) {
+    Layout layout = CalcLayout(caption);
+    if (layout.total_size > std::numeric_limits<uint32_t>::max() || layout.total_size > capacity) {
+        return 0;
+    }
+
+    auto base = static_cast<uint8_t*>(buffer);
+    memset(base, 0, static_cast<size_t>(layout.total_size));
+    auto pool_offset = static_cast<uint32_t>(layout.pool);
+
+    // Copy bytes into the byte pool, optionally followed by a '\0'
+    auto append_pool = [&](const void* data, size_t size, bool terminate) -> SerializedCaptionSpan {
+        SerializedCaptionSpan span{pool_offset, static_cast<uint32_t>(size)};
+        if (size) {
+            memcpy(base + pool_offset, data, size);
+        }
+        pool_offset += static_cast<uint32_t>(size + (terminate ? 1 : 0));
+        return span;
+    };
+
+    SerializedCaptionHeader header{};
+    header.magic = kSerializedCaptionMagic;
+    header.version = kSerializedCaptionVersion;
+    header.header_size = sizeof(SerializedCaptionHeader);
+    header.total_size = static_cast<uint32_t>(layout.total_size);
+    header.type = static_cast<uint8_t>(caption.type);
+    header.flags = static_cast<uint8_t>(caption.flags);
+    header.has_builtin_sound = caption.has_builtin_sound ? 1 : 0;
+    header.builtin_sound_id = caption.builtin_sound_id;
+    header.pts = caption.pts;
+    header.wait_duration = caption.wait_duration;
+    header.iso6392_language_code = caption.iso6392_language_code;
+    header.plane_width = caption.plane_width;
+    header.plane_height = caption.plane_height;
+    header.text = append_pool(caption.text.data(), caption.text.size(), true);
+    header.regions = {static_cast<uint32_t>(layout.regions), static_cast<uint32_t>(layout.region_count)};
+    header.style_runs = {static_cast<uint32_t>(layout.style_runs), static_cast<uint32_t>(layout.style_run_count)};
+    header.chars = {static_cast<uint32_t>(layout.chars), static_cast<uint32_t>(layout.char_count)};
+    header.drcs = {static_cast<uint32_t>(layout.drcs), static_cast<uint32_t>(caption.drcs_map.size())};
+    memcpy(base, &header, sizeof(header));
+
+    uint8_t* region_ptr = base + layout.regions;
+    uint8_t* run_ptr = base + layout.style_runs;
+    uint8_t* char_ptr = base + layout.chars;
+    uint32_t run_index = 0;
+    uint32_t char_index = 0;
+
+    for (const CaptionRegion& region : caption.regions) {
+        SerializedCaptionRegion out_region{};
+        out_region.x = region.x;
+        out_region.y = region.y;
+        out_region.width = region.width;
+        out_region.height = region.height;
+        out_region.first_style_run = run_index;
+        out_region.is_ruby = region.is_ruby ? 1 : 0;
+
+        SerializedCaptionStyleRun run{};
+        for (size_t i = 0; i < region.chars.size(); i++) {
+            const CaptionChar& ch = region.chars[i];
+            if (i == 0 || !IsSameStyle(region.chars[i - 1], ch)) {
+                if (i > 0) {
+                    memcpy(run_ptr, &run, sizeof(run));
+                    run_ptr += sizeof(run);
+                }
+                run = SerializedCaptionStyleRun{};
+                run.first_char = char_index;
+                run.char_width = ch.char_width;
+                run.char_height = ch.char_height;
+                run.char_horizontal_spacing = ch.char_horizontal_spacing;
+                run.char_vertical_spacing = ch.char_vertical_spacing;
+                run.char_horizontal_scale = ch.char_horizontal_scale;
+                run.char_vertical_scale = ch.char_vertical_scale;
+                run.text_color = ch.text_color.u32;
+                run.back_color = ch.back_color.u32;
+                run.stroke_color = ch.stroke_color.u32;
+                run.style = static_cast<uint8_t>(ch.style);
+                run.enclosure_style = static_cast<uint8_t>(ch.enclosure_style);
+                out_region.style_run_count++;
+                run_index++;
+            }
+            run.char_count++;
+
+            SerializedCaptionChar out_char{};
+            out_char.codepoint = ch.codepoint;
+            out_char.pua_codepoint = ch.pua_codepoint;
+            out_char.drcs_code = ch.drcs_code;
+            out_char.x = ch.x;
+            out_char.y = ch.y;
+            out_char.type = static_cast<uint8_t>(ch.type);
+            memcpy(out_char.u8str, ch.u8str, sizeof(out_char.u8str) - 1);
+            memcpy(char_ptr, &out_char, sizeof(out_char));
+            char_ptr += sizeof(out_char);
+            char_index++;
+        }
+        if (!region.chars.empty()) {
+            memcpy(run_ptr, &run, sizeof(run));
+            run_ptr += sizeof(run);
+        }
+
+        memcpy(region_ptr, &out_region, sizeof(out_region));
+        region_ptr += sizeof(out_region);
+    }
+
+    // Sort by code, so that identical captions are serialized identically
+    std::vector<const std::pair<const uint32_t, DRCS>*> drcs_entries;
+    drcs_entries.reserve(caption.drcs_map.size());
+    for (const auto& entry : caption.drcs_map) {
+        drcs_entries.push_back(&entry);
+    }
+    std::sort(drcs_entries.begin(), drcs_entries.end(), [](auto a, auto b) { return a->first < b->first; });
+
+    uint8_t* drcs_ptr = base + layout.drcs;
+    for (const auto* entry : drcs_entries) {
+        const DRCS& drcs = entry->second;
+        SerializedCaptionDRCS out_drcs{};
+        out_drcs.code = entry->first;
+        out_drcs.width = drcs.width;
+        out_drcs.height = drcs.height;
+        out_drcs.depth = drcs.depth;
+        out_drcs.depth_bits = drcs.depth_bits;
+        out_drcs.alternative_ucs4 = drcs.alternative_ucs4;
+        out_drcs.pixels = append_pool(drcs.pixels.data(), drcs.pixels.size(), false);
+        out_drcs.md5 = append_pool(drcs.md5.data(), drcs.md5.size(), true);
+        out_drcs.alternative_text = append_pool(drcs.alternative_text.data(), drcs.alternative_text.size(), true);
+        memcpy(drcs_ptr, &out_drcs, sizeof(out_drcs));
+        drcs_ptr += sizeof(out_drcs);
+    }
+
+    return static_cast<size_t>(layout.total_size);
+}
+
+bool SerializeCaption(const Caption& caption, std::vector<uint8_t>& out_buffer) {
+    size_t size = GetSerializedCaptionSize(caption);
+    if (size == 0) {
+        return false;
+    }
+    out_buffer.resize(size);
+    return SerializeCaption(caption, out_buffer.data(), out_buffer.size()) == size;
+}
+
+const SerializedCaptionHeader* ValidateSerializedCaption(const void* data, size_t size) {
+    if (!data || size < sizeof(SerializedCaptionHeader) ||
+            reinterpret_cast<uintptr_t>(data) % alignof(SerializedCaptionHeader) != 0) {
+        return nullptr;
+    }
+
+    auto header = static_cast<const SerializedCaptionHeader*>(data);
+    if (header->magic != kSerializedCaptionMagic || header->version != kSerializedCaptionVersion ||
+            header->header_size < sizeof(SerializedCaptionHeader) || header->total_size > size ||
+            header->header_size > header->total_size) {
+        return nullptr;
+    }
+    if (header->type != static_cast<uint8_t>(CaptionType::kCaption) &&
+            header->type != static_cast<uint8_t>(CaptionType::kSuperimpose)) {
+        return nullptr;
+    }
+
+    if (!IsValidString(header, header->text) ||
+            !IsValidSpan(header, header->regions, sizeof(SerializedCaptionRegion), 4) ||
+            !IsValidSpan(header, header->style_runs, sizeof(SerializedCaptionStyleRun), 4) ||
+            !IsValidSpan(header, header->chars, sizeof(SerializedCaptionChar), 4) ||
+            !IsValidSpan(header, header->drcs, sizeof(SerializedCaptionDRCS), 4)) {
+        return nullptr;
+    }
+
+    // Style runs of regions, and chars of style runs, must be contiguous and in order without overlapping
+    // Otherwise shared entries could expand a small buffer into a huge Caption
+    auto regions = GetSerializedCaptionArray<SerializedCaptionRegion>(header, header->regions);
+    uint64_t next_style_run = 0;
+    for (uint32_t i = 0; i < header->regions.count; i++) {
+        if (regions[i].first_style_run != next_style_run) {
+            return nullptr;
+        }
+        next_style_run += regions[i].style_run_count;
+    }
+    if (next_style_run != header->style_runs.count) {
+        return nullptr;
+    }
+
+    auto runs = GetSerializedCaptionArray<SerializedCaptionStyleRun>(header, header->style_runs);
+    uint64_t next_char = 0;
+    for (uint32_t i = 0; i < header->style_runs.count; i++) {
+        if (runs[i].first_char != next_char) {
+            return nullptr;
+        }
+        next_char += runs[i].char_count;
+    }
+    if (next_char != header->chars.count) {
+        return nullptr;
+    }
+
+    auto chars = GetSerializedCaptionArray<SerializedCaptionChar>(header, header->chars);
+    for (uint32_t i = 0; i < header->chars.count; i++) {
+        if (chars[i].type > static_cast<uint8_t>(CaptionCharType::kDRCSReplaced) ||
+                chars[i].u8str[sizeof(chars[i].u8str) - 1] != '\0') {
+            return nullptr;
+        }
+    }
+
+    auto drcs = GetSerializedCaptionArray<SerializedCaptionDRCS>(header, header->drcs);
+    for (uint32_t i = 0; i < header->drcs.count; i++) {
+        if ((i > 0 && drcs[i].code <= drcs[i - 1].code) ||
+                !IsValidSpan(header, drcs[i].pixels, 1, 1) ||
+                !IsValidString(header, drcs[i].md5) ||
+                !IsValidString(header, drcs[i].alternative_text)) {
+            return nullptr;
+        }
+    }
+
+    return header;
+}
+
+bool DeserializeCaption(const void* data, size_t size, Caption& out_caption) {
+    const SerializedCaptionHeader* header = ValidateSerializedCaption(data, size);
+    if (!header) {
+        return false;
+    }
+
+    Caption caption;
+    caption.type = static_cast<CaptionType>(header->type);
+    caption.flags = static_cast<CaptionFlags>(header->flags);
+    caption.iso6392_language_code = header->iso6392_language_code;
+    caption.text.assign(GetSerializedCaptionArray<char>(header, header->text), header->text.count);
+    caption.pts = header->pts;
+    caption.wait_duration = header->wait_duration;
+    caption.plane_width = header->plane_width;
+    caption.plane_height = header->plane_height;
+    caption.has_builtin_sound = header->has_builtin_sound != 0;
+    caption.builtin_sound_id = header->builtin_sound_id;
+
+    auto regions = GetSerializedCaptionArray<SerializedCaptionRegion>(header, header->regions);
+    auto runs = GetSerializedCaptionArray<SerializedCaptionStyleRun>(header, header->style_runs);
+    auto chars = GetSerializedCaptionArray<SerializedCaptionChar>(header, header->chars);
+
+    caption.regions.resize(header->regions.count);
+    for (uint32_t i = 0; i < header->regions.count; i++) {
+        const SerializedCaptionRegion& src = regions[i];
+        CaptionRegion& region = caption.regions[i];
+        region.x = src.x;
+        region.y = src.y;
+        region.width = src.width;
+        region.height = src.height;
+        region.is_ruby = src.is_ruby != 0;
+
+        size_t char_count = 0;
+        for (uint32_t r = 0; r < src.style_run_count; r++) {
+            char_count += runs[src.first_style_run + r].char_count;
+        }
+        region.chars.reserve(char_count);
+
+        for (uint32_t r = 0; r < src.style_run_count; r++) {
+            const SerializedCaptionStyleRun& run = runs[src.first_style_run + r];
+            CaptionChar ch;
+            ch.char_width = run.char_width;
+            ch.char_height = run.char_height;
+            ch.char_horizontal_spacing = run.char_horizontal_spacing;
+            ch.char_vertical_spacing = run.char_vertical_spacing;
+            ch.char_horizontal_scale = run.char_horizontal_scale;
+            ch.char_vertical_scale = run.char_vertical_scale;
+            ch.text_color.u32 = run.text_color;
+            ch.back_color.u32 = run.back_color;
+            ch.stroke_color.u32 = run.stroke_color;
+            ch.style = static_cast<CharStyle>(run.style);
+            ch.enclosure_style = static_cast<EnclosureStyle>(run.enclosure_style);
+
+            for (uint32_t c = 0; c < run.char_count; c++) {
+                const SerializedCaptionChar& src_char = chars[run.first_char + c];
+                ch.type = static_cast<CaptionCharType>(src_char.type);
+                ch.codepoint = src_char.codepoint;
+                ch.pua_codepoint = src_char.pua_codepoint;
+                ch.drcs_code = src_char.drcs_code;
+                ch.x = src_char.x;
+                ch.y = src_char.y;
+                memcpy(ch.u8str, src_char.u8str, sizeof(ch.u8str));
+                region.chars.push_back(ch);
+            }
+        }
+    }
+
+    auto drcs = GetSerializedCaptionArray<SerializedCaptionDRCS>(header, header->drcs);
+    caption.drcs_map.reserve(header->drcs.count);
+    for (uint32_t i = 0; i < header->drcs.count; i++) {
+        const SerializedCaptionDRCS& src = drcs[i];
+        DRCS& out_drcs = caption.drcs_map[src.code];
+        out_drcs.width = src.width;
+        out_drcs.height = src.height;
+        out_drcs.depth = src.depth;
+        out_drcs.depth_bits = src.depth_bits;
+        out_drcs.alternative_ucs4 = src.alternative_ucs4;
+        auto pixels = GetSerializedCaptionArray<uint8_t>(header, src.pixels);
+        out_drcs.pixels.assign(pixels, pixels + src.pixels.count);
+        out_drcs.md5.assign(GetSerializedCaptionArray<char>(header, src.md5), src.md5.count);
+        out_drcs.alternative_text.assign(GetSerializedCaptionArray<char>(header, src.alternative_text),
+                                         src.alternative_text.count);
+    }
+
+    out_caption = std::move(caption);
+    return true;
+}
+
+}  // namespace aribcaption
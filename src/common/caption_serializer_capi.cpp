@@ -0,0 +1,41 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "aribcaption/caption_serializer.h"
+#include "aribcaption/caption_serializer.hpp"
+#include "common/caption_capi.hpp"
+
+using namespace aribcaption;
+using namespace aribcaption::internal;
+
+extern "C" {
+
+size_t aribcc_caption_serialize(const aribcc_caption_t* caption, void* buffer, size_t capacity) {
+    Caption cap = ConstructCaptionFromCAPI(caption);
+    if (!buffer) {
+        return GetSerializedCaptionSize(cap);
+    }
+    return SerializeCaption(cap, buffer, capacity);
+}
+
+bool aribcc_caption_validate_serialized(const void* data, size_t size) {
+    return ValidateSerializedCaption(data, size) != nullptr;
+}
+
+}  // extern "C"
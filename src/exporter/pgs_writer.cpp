@@ -0,0 +1,45 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "aribcaption/pgs_writer.hpp"
+#include "exporter/pgs_writer_impl.hpp"
+
+namespace aribcaption {
+
+PGSWriter::PGSWriter(Context& context) : pimpl_(std::make_unique<internal::PGSWriterImpl>(context)) {}
+
+PGSWriter::~PGSWriter() = default;
+
+PGSWriter::PGSWriter(PGSWriter&&) noexcept = default;
+
+PGSWriter& PGSWriter::operator=(PGSWriter&&) noexcept = default;
+
+bool PGSWriter::Initialize(int frame_width, int frame_height, WriteCallback write_callback) {
+    return pimpl_->Initialize(frame_width, frame_height, std::move(write_callback));
+}
+
+bool PGSWriter::Write(const RenderResult& result) {
+    return pimpl_->Write(result);
+}
+
+void PGSWriter::Flush() {
+    pimpl_->Flush();
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,96 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cstring>
+#include <new>
+#include "aribcaption/pgs_writer.h"
+#include "aribcaption/pgs_writer.hpp"
+#include "exporter/pgs_writer_impl.hpp"
+
+using namespace aribcaption;
+using namespace aribcaption::internal;
+
+static Image ConstructImageFromCAPI(const aribcc_image_t* src) {
+    Image image;
+    image.width = src->width;
+    image.height = src->height;
+    image.stride = src->stride;
+    image.dst_x = src->dst_x;
+    image.dst_y = src->dst_y;
+    image.pixel_format = static_cast<PixelFormat>(src->pixel_format);
+    image.content_id = src->content_id;
+    image.changed = src->changed;
+
+    if (src->bitmap) {
+        image.bitmap.resize(src->bitmap_size);
+        memcpy(image.bitmap.data(), src->bitmap, src->bitmap_size);
+    }
+
+    return image;
+}
+
+extern "C" {
+
+aribcc_pgs_writer_t* aribcc_pgs_writer_alloc(aribcc_context_t* context) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    auto impl = new(std::nothrow) PGSWriterImpl(*ctx);
+    return reinterpret_cast<aribcc_pgs_writer_t*>(impl);
+}
+
+void aribcc_pgs_writer_free(aribcc_pgs_writer_t* writer) {
+    auto impl = reinterpret_cast<PGSWriterImpl*>(writer);
+    delete impl;
+}
+
+bool aribcc_pgs_writer_initialize(aribcc_pgs_writer_t* writer,
+                                  int frame_width,
+                                  int frame_height,
+                                  aribcc_pgs_write_callback_t write_callback,
+                                  void* userdata) {
+    auto impl = reinterpret_cast<PGSWriterImpl*>(writer);
+    if (!write_callback) {
+        return impl->Initialize(frame_width, frame_height, nullptr);
+    }
+    return impl->Initialize(frame_width, frame_height, [=](const uint8_t* data, size_t size) {
+        write_callback(data, size, userdata);
+    });
+}
+
+bool aribcc_pgs_writer_write(aribcc_pgs_writer_t* writer, const aribcc_render_result_t* result) {
+    auto impl = reinterpret_cast<PGSWriterImpl*>(writer);
+
+    RenderResult render_result;
+    render_result.pts = result->pts;
+    render_result.duration = result->duration;
+    if (result->images) {
+        render_result.images.reserve(result->image_count);
+        for (uint32_t i = 0; i < result->image_count; i++) {
+            render_result.images.push_back(ConstructImageFromCAPI(&result->images[i]));
+        }
+    }
+
+    return impl->Write(render_result);
+}
+
+void aribcc_pgs_writer_flush(aribcc_pgs_writer_t* writer) {
+    auto impl = reinterpret_cast<PGSWriterImpl*>(writer);
+    impl->Flush();
+}
+
+}  // extern "C"
@@ -0,0 +1,524 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <numeric>
+#include "decoder/b24_colors.hpp"
+#include "exporter/pgs_writer_impl.hpp"
+#include "renderer/bitmap.hpp"
+#include "renderer/canvas.hpp"
+#include "renderer/pixel_convert.hpp"
+#include "renderer/yuv_blend.hpp"
+
+namespace aribcaption::internal {
+
+namespace {
+
+// Segment types of the Presentation Graphic Stream
+constexpr uint8_t kSegmentPDS = 0x14;  // Palette Definition Segment
+constexpr uint8_t kSegmentODS = 0x15;  // Object Definition Segment
+constexpr uint8_t kSegmentPCS = 0x16;  // Presentation Composition Segment
+constexpr uint8_t kSegmentWDS = 0x17;  // Window Definition Segment
+constexpr uint8_t kSegmentEND = 0x80;  // End of Display Set Segment
+
+constexpr uint8_t kCompositionNormal = 0x00;
+constexpr uint8_t kCompositionEpochStart = 0x80;
+
+constexpr uint8_t kFrameRateCode = 0x10;
+constexpr size_t kSegmentHeaderSize = 13;
+constexpr size_t kMaxSegmentSize = 0xFFFF;
+constexpr int kMaxRunLength = 0x3FFF;
+constexpr int kMaxFrameSize = 0xFFFF;
+
+constexpr size_t kCLUTPaletteCount = 8;
+constexpr size_t kCLUTPaletteSize = 16;
+
+Rect ImageRect(const Image& image) {
+    return {image.dst_x, image.dst_y, image.dst_x + image.width, image.dst_y + image.height};
+}
+
+Rect UnionRect(const Rect& a, const Rect& b) {
+    return {std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right), std::max(a.bottom, b.bottom)};
+}
+
+bool IsOverlapped(const Rect& a, const Rect& b) {
+    Rect intersection = Rect::ClipRect(a, b);
+    return intersection.width() > 0 && intersection.height() > 0;
+}
+
+int64_t Area(const Rect& rect) {
+    return static_cast<int64_t>(rect.width()) * rect.height();
+}
+
+// ARIB colors are kept exact in the palette, text and backgrounds mostly use them
+const std::vector<ColorRGBA>& GetCLUTColors() {
+    static const std::vector<ColorRGBA> colors = [] {
+        std::vector<ColorRGBA> clut;
+        for (size_t palette = 0; palette < kCLUTPaletteCount; palette++) {
+            for (size_t index = 0; index < kCLUTPaletteSize; index++) {
+                clut.push_back(kB24ColorCLUT[palette][index]);
+            }
+        }
+        return clut;
+    }();
+    return colors;
+}
+
+}  // namespace
+
+PGSWriterImpl::PGSWriterImpl(Context& context) : log_(GetContextLogger(context)) {}
+
+PGSWriterImpl::~PGSWriterImpl() = default;
+
+bool PGSWriterImpl::Initialize(int frame_width, int frame_height, PGSWriter::WriteCallback write_callback) {
+    if (frame_width <= 0 || frame_height <= 0 || frame_width > kMaxFrameSize || frame_height > kMaxFrameSize) {
+        log_->e("PGSWriter: Invalid frame size %dx%d", frame_width, frame_height);
+        return false;
+    }
+    if (!write_callback) {
+        log_->e("PGSWriter: write_callback is empty");
+        return false;
+    }
+
+    write_callback_ = std::move(write_callback);
+    frame_width_ = frame_width;
+    frame_height_ = frame_height;
+    color_matrix_ = frame_height > 576 ? YUVColorMatrix::kBT709 : YUVColorMatrix::kBT601;
+
+    has_written_ = false;
+    has_pending_clear_ = false;
+    showing_ = false;
+    composition_number_ = 0;
+    epoch_started_ = false;
+    windows_.clear();
+    object_content_ids_.clear();
+    object_versions_.clear();
+    buffer_.clear();
+
+    return true;
+}
+
+bool PGSWriterImpl::Write(const RenderResult& result) {
+    if (!write_callback_) {
+        log_->e("PGSWriter: Writer is not initialized");
+        return false;
+    }
+    if (result.pts < 0 || result.pts > kMaxPTS) {
+        log_->e("PGSWriter: PTS %" PRId64 " is out of the range of PGS timestamps", result.pts);
+        return false;
+    }
+    if (has_written_ && result.pts < last_pts_) {
+        log_->e("PGSWriter: PTS %" PRId64 " is earlier than previous PTS %" PRId64, result.pts, last_pts_);
+        return false;
+    }
+
+    std::vector<Image> objects;
+    if (!PrepareObjects(result.images, objects)) {
+        return false;
+    }
+
+    // A clearing scheduled before this result is due, otherwise this result replaces the displayed one
+    if (has_pending_clear_ && pending_clear_pts_ < result.pts) {
+        WriteClearDisplaySet(pending_clear_pts_);
+    }
+    has_pending_clear_ = false;
+
+    if (objects.empty()) {
+        if (showing_) {
+            WriteClearDisplaySet(result.pts);
+        }
+    } else {
+        WriteDisplaySet(result.pts, objects);
+        if (result.duration != DURATION_INDEFINITE) {
+            has_pending_clear_ = true;
+            pending_clear_pts_ = result.pts + std::clamp<int64_t>(result.duration, 0, kMaxPTS - result.pts);
+        }
+    }
+
+    last_pts_ = result.pts;
+    has_written_ = true;
+    FlushBuffer();
+    return true;
+}
+
+void PGSWriterImpl::Flush() {
+    if (!write_callback_) {
+        return;
+    }
+    if (has_pending_clear_) {
+        WriteClearDisplaySet(pending_clear_pts_);
+        has_pending_clear_ = false;
+    }
+    FlushBuffer();
+}
+
+bool PGSWriterImpl::PrepareObjects(const std::vector<Image>& images, std::vector<Image>& out_objects) {
+    Rect frame_rect(0, 0, frame_width_, frame_height_);
+
+    // Drop invisible parts, objects must be inside the frame
+    std::vector<Image> visible_images;
+    for (const Image& image : images) {
+        if (image.pixel_format != PixelFormat::kRGBA8888) {
+            log_->e("PGSWriter: Unsupported pixel format %d, only kRGBA8888 is accepted",
+                    static_cast<int>(image.pixel_format));
+            return false;
+        }
+
+        Rect rect = ImageRect(image);
+        Rect visible = Rect::ClipRect(rect, frame_rect);
+        if (image.bitmap.empty() || visible.width() <= 0 || visible.height() <= 0) {
+            continue;
+        }
+
+        if (visible == rect) {
+            visible_images.push_back(image);
+            continue;
+        }
+
+        Image copy = image;
+        Bitmap bitmap = Bitmap::FromImage(std::move(copy));
+        Rect crop_rect(visible.left - rect.left, visible.top - rect.top,
+                       visible.right - rect.left, visible.bottom - rect.top);
+        Image cropped = Bitmap::ToImage(bitmap.Crop(crop_rect));
+        cropped.dst_x = visible.left;
+        cropped.dst_y = visible.top;
+        cropped.content_id = image.content_id;
+        visible_images.push_back(std::move(cropped));
+    }
+
+    size_t count = visible_images.size();
+    bool overlapped = false;
+    for (size_t i = 0; i < count && !overlapped; i++) {
+        for (size_t j = i + 1; j < count; j++) {
+            if (IsOverlapped(ImageRect(visible_images[i]), ImageRect(visible_images[j]))) {
+                overlapped = true;
+                break;
+            }
+        }
+    }
+
+    if (count <= kMaxObjects && !overlapped) {
+        out_objects = std::move(visible_images);
+        return true;
+    }
+
+    // Split images in vertical order into 2 groups whose bounding boxes don't overlap, which become the windows,
+    // taking the split with the smallest total area. Fall back to a single object if no split is possible.
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&visible_images](size_t lhs, size_t rhs) {
+        return visible_images[lhs].dst_y < visible_images[rhs].dst_y;
+    });
+
+    std::vector<Rect> prefix(count);
+    std::vector<Rect> suffix(count);
+    for (size_t i = 0; i < count; i++) {
+        Rect rect = ImageRect(visible_images[order[i]]);
+        prefix[i] = i ? UnionRect(prefix[i - 1], rect) : rect;
+    }
+    for (size_t i = count; i-- > 0;) {
+        Rect rect = ImageRect(visible_images[order[i]]);
+        suffix[i] = i + 1 < count ? UnionRect(suffix[i + 1], rect) : rect;
+    }
+
+    size_t best_split = 0;
+    int64_t best_area = Area(prefix[count - 1]);
+    for (size_t split = 1; split < count; split++) {
+        if (IsOverlapped(prefix[split - 1], suffix[split])) {
+            continue;
+        }
+        int64_t area = Area(prefix[split - 1]) + Area(suffix[split]);
+        if (area < best_area) {
+            best_area = area;
+            best_split = split;
+        }
+    }
+
+    std::vector<std::vector<size_t>> groups;
+    if (best_split) {
+        groups.emplace_back(order.begin(), order.begin() + static_cast<ptrdiff_t>(best_split));
+        groups.emplace_back(order.begin() + static_cast<ptrdiff_t>(best_split), order.end());
+    } else {
+        groups.emplace_back(order);
+    }
+
+    out_objects.clear();
+    for (std::vector<size_t>& group : groups) {
+        // Keep the original order of images, which is also the drawing order
+        std::sort(group.begin(), group.end());
+        std::vector<Image> members;
+        members.reserve(group.size());
+        for (size_t index : group) {
+            members.push_back(std::move(visible_images[index]));
+        }
+        out_objects.push_back(members.size() == 1 ? std::move(members[0]) : MergeObject(members));
+    }
+
+    return true;
+}
+
+Image PGSWriterImpl::MergeObject(std::vector<Image>& images) {
+    Rect rect = ImageRect(images[0]);
+    for (const Image& image : images) {
+        rect = UnionRect(rect, ImageRect(image));
+    }
+
+    Bitmap bitmap(rect.width(), rect.height(), PixelFormat::kRGBA8888);
+    Canvas canvas(bitmap);
+
+    // Content of the merged object is known only if all of its parts are
+    uint64_t content_id = 0xCBF29CE484222325;
+    for (Image& image : images) {
+        content_id = image.content_id && content_id ? (content_id ^ image.content_id) * 0x100000001B3 : 0;
+        int x = image.dst_x - rect.left;
+        int y = image.dst_y - rect.top;
+        canvas.DrawBitmap(Bitmap::FromImage(std::move(image)), x, y);
+    }
+
+    Image merged = Bitmap::ToImage(std::move(bitmap));
+    merged.dst_x = rect.left;
+    merged.dst_y = rect.top;
+    merged.content_id = content_id;
+    return merged;
+}
+
+void PGSWriterImpl::WriteDisplaySet(int64_t pts, const std::vector<Image>& objects) {
+    std::vector<Rect> windows;
+    std::vector<uint64_t> content_ids;
+    for (const Image& object : objects) {
+        windows.push_back(ImageRect(object));
+        content_ids.push_back(object.content_id);
+    }
+
+    // Windows are fixed during an epoch, a new epoch also drops all objects stored in the decoder
+    bool epoch_start = !epoch_started_ || windows != windows_;
+    if (epoch_start) {
+        epoch_started_ = true;
+        windows_ = std::move(windows);
+        object_content_ids_.clear();
+        object_versions_.assign(windows_.size(), 0);
+        palette_version_ = 0;
+    }
+
+    // Objects and palette are still in the decoder if the previous objects of the epoch are shown again
+    bool reuse_objects = !epoch_start && content_ids == object_content_ids_ &&
+                         std::find(content_ids.begin(), content_ids.end(), 0) == content_ids.end();
+
+    WriteCompositionSegment(pts, epoch_start ? kCompositionEpochStart : kCompositionNormal, false, objects.size());
+    WriteWindowSegment(pts);
+
+    if (!reuse_objects) {
+        std::vector<const Image*> sources;
+        for (const Image& object : objects) {
+            sources.push_back(&object);
+        }
+        std::vector<Image> indexed = pixelconv::IndexImages(sources, GetCLUTColors());
+
+        WritePaletteSegment(pts, indexed[0].palette);
+        for (size_t i = 0; i < indexed.size(); i++) {
+            WriteObjectSegments(pts, static_cast<uint16_t>(i), indexed[i]);
+        }
+        object_content_ids_ = std::move(content_ids);
+    }
+
+    WriteEndSegment(pts);
+    showing_ = true;
+}
+
+void PGSWriterImpl::WriteClearDisplaySet(int64_t pts) {
+    if (!epoch_started_) {
+        return;
+    }
+    WriteCompositionSegment(pts, kCompositionNormal, false, 0);
+    WriteWindowSegment(pts);
+    WriteEndSegment(pts);
+    showing_ = false;
+}
+
+void PGSWriterImpl::WriteCompositionSegment(int64_t pts, uint8_t composition_state,
+                                            bool palette_update, size_t object_count) {
+    BeginSegment(kSegmentPCS, pts);
+    WriteU16(static_cast<uint16_t>(frame_width_));
+    WriteU16(static_cast<uint16_t>(frame_height_));
+    WriteU8(kFrameRateCode);
+    WriteU16(composition_number_++);
+    WriteU8(composition_state);
+    WriteU8(palette_update ? 0x80 : 0x00);
+    WriteU8(0);  // palette_id
+    WriteU8(static_cast<uint8_t>(object_count));
+    for (size_t i = 0; i < object_count; i++) {
+        WriteU16(static_cast<uint16_t>(i));  // object_id
+        WriteU8(static_cast<uint8_t>(i));    // window_id
+        WriteU8(0);                          // not cropped, not forced
+        WriteU16(static_cast<uint16_t>(windows_[i].left));
+        WriteU16(static_cast<uint16_t>(windows_[i].top));
+    }
+    EndSegment();
+}
+
+void PGSWriterImpl::WriteWindowSegment(int64_t pts) {
+    BeginSegment(kSegmentWDS, pts);
+    WriteU8(static_cast<uint8_t>(windows_.size()));
+    for (size_t i = 0; i < windows_.size(); i++) {
+        WriteU8(static_cast<uint8_t>(i));
+        WriteU16(static_cast<uint16_t>(windows_[i].left));
+        WriteU16(static_cast<uint16_t>(windows_[i].top));
+        WriteU16(static_cast<uint16_t>(windows_[i].width()));
+        WriteU16(static_cast<uint16_t>(windows_[i].height()));
+    }
+    EndSegment();
+}
+
+void PGSWriterImpl::WritePaletteSegment(int64_t pts, const std::vector<ColorRGBA>& palette) {
+    BeginSegment(kSegmentPDS, pts);
+    WriteU8(0);  // palette_id
+    WriteU8(palette_version_++);
+    for (size_t i = 0; i < palette.size(); i++) {
+        uint8_t yuv[3] = {16, 128, 128};
+        if (palette[i].a) {
+            yuvblend::ConvertColorToYUV(palette[i], color_matrix_, YUVColorRange::kLimited, yuv);
+        }
+        WriteU8(static_cast<uint8_t>(i));
+        WriteU8(yuv[0]);  // Y
+        WriteU8(yuv[2]);  // Cr
+        WriteU8(yuv[1]);  // Cb
+        WriteU8(palette[i].a);
+    }
+    EndSegment();
+}
+
+void PGSWriterImpl::WriteObjectSegments(int64_t pts, uint16_t object_id, const Image& indexed) {
+    EncodeRLE(indexed, rle_buffer_);
+
+    // Object data is split into segments if it doesn't fit into one,
+    // the first one carries the data length, which includes width and height
+    constexpr size_t kFirstHeaderSize = 11;
+    constexpr size_t kNextHeaderSize = 4;
+
+    size_t offset = 0;
+    bool first = true;
+    while (first || offset < rle_buffer_.size()) {
+        size_t header_size = first ? kFirstHeaderSize : kNextHeaderSize;
+        size_t chunk = std::min(rle_buffer_.size() - offset, kMaxSegmentSize - header_size);
+        bool last = offset + chunk == rle_buffer_.size();
+
+        BeginSegment(kSegmentODS, pts);
+        WriteU16(object_id);
+        WriteU8(object_versions_[object_id]);
+        WriteU8(static_cast<uint8_t>((first ? 0x80 : 0x00) | (last ? 0x40 : 0x00)));
+        if (first) {
+            WriteU24(static_cast<uint32_t>(rle_buffer_.size() + 4));
+            WriteU16(static_cast<uint16_t>(indexed.width));
+            WriteU16(static_cast<uint16_t>(indexed.height));
+        }
+        buffer_.insert(buffer_.end(), rle_buffer_.begin() + static_cast<ptrdiff_t>(offset),
+                       rle_buffer_.begin() + static_cast<ptrdiff_t>(offset + chunk));
+        EndSegment();
+
+        offset += chunk;
+        first = false;
+    }
+
+    object_versions_[object_id]++;
+}
+
+void PGSWriterImpl::WriteEndSegment(int64_t pts) {
+    BeginSegment(kSegmentEND, pts);
+    EndSegment();
+}
+
+void PGSWriterImpl::EncodeRLE(const Image& indexed, std::vector<uint8_t>& out) {
+    // Runs are coded as 00 LL (transparent), 00 4L LL (long transparent), 00 8L CC (color), 00 CL LL CC (long color)
+    // and single pixels of a non-transparent color as CC, lines are terminated by 00 00
+    out.clear();
+    for (int y = 0; y < indexed.height; y++) {
+        const uint8_t* line = indexed.bitmap.data() + static_cast<size_t>(y) * indexed.stride;
+        int x = 0;
+        while (x < indexed.width) {
+            uint8_t color = line[x];
+            int run = 1;
+            while (x + run < indexed.width && line[x + run] == color && run < kMaxRunLength) {
+                run++;
+            }
+            x += run;
+
+            if (color && run <= 2) {
+                out.insert(out.end(), static_cast<size_t>(run), color);
+                continue;
+            }
+
+            uint8_t flags = color ? 0x80 : 0x00;
+            out.push_back(0);
+            if (run < 64) {
+                out.push_back(static_cast<uint8_t>(flags | run));
+            } else {
+                out.push_back(static_cast<uint8_t>(flags | 0x40 | (run >> 8)));
+                out.push_back(static_cast<uint8_t>(run & 0xFF));
+            }
+            if (color) {
+                out.push_back(color);
+            }
+        }
+        out.push_back(0);
+        out.push_back(0);
+    }
+}
+
+void PGSWriterImpl::BeginSegment(uint8_t type, int64_t pts) {
+    // PTS in 90kHz clock, DTS is left zero
+    segment_start_ = buffer_.size();
+    WriteU8('P');
+    WriteU8('G');
+    WriteU32(static_cast<uint32_t>(std::clamp<int64_t>(pts, 0, kMaxPTS) * 90));
+    WriteU32(0);
+    WriteU8(type);
+    WriteU16(0);  // segment_size, filled by EndSegment()
+}
+
+void PGSWriterImpl::EndSegment() {
+    size_t size = buffer_.size() - segment_start_ - kSegmentHeaderSize;
+    buffer_[segment_start_ + kSegmentHeaderSize - 2] = static_cast<uint8_t>(size >> 8);
+    buffer_[segment_start_ + kSegmentHeaderSize - 1] = static_cast<uint8_t>(size & 0xFF);
+}
+
+void PGSWriterImpl::FlushBuffer() {
+    if (!buffer_.empty()) {
+        write_callback_(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+}
+
+void PGSWriterImpl::WriteU16(uint16_t value) {
+    buffer_.push_back(static_cast<uint8_t>(value >> 8));
+    buffer_.push_back(static_cast<uint8_t>(value & 0xFF));
+}
+
+void PGSWriterImpl::WriteU24(uint32_t value) {
+    buffer_.push_back(static_cast<uint8_t>((value >> 16) & 0xFF));
+    buffer_.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
+    buffer_.push_back(static_cast<uint8_t>(value & 0xFF));
+}
+
+void PGSWriterImpl::WriteU32(uint32_t value) {
+    WriteU16(static_cast<uint16_t>(value >> 16));
+    WriteU16(static_cast<uint16_t>(value & 0xFFFF));
+}
+
+}  // namespace aribcaption::internal
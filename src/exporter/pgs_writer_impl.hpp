@@ -0,0 +1,96 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_PGS_WRITER_IMPL_HPP
+#define ARIBCAPTION_PGS_WRITER_IMPL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/image.hpp"
+#include "aribcaption/pgs_writer.hpp"
+#include "base/logger.hpp"
+#include "renderer/rect.hpp"
+
+namespace aribcaption::internal {
+
+class PGSWriterImpl {
+public:
+    explicit PGSWriterImpl(Context& context);
+    ~PGSWriterImpl();
+public:
+    bool Initialize(int frame_width, int frame_height, PGSWriter::WriteCallback write_callback);
+    bool Write(const RenderResult& result);
+    void Flush();
+private:
+    // PGS allows 2 objects / windows per display set
+    static constexpr size_t kMaxObjects = 2;
+
+    // Segment PTS is a 32-bit value in 90kHz clock, i.e. about 13.25 hours in milliseconds
+    static constexpr int64_t kMaxPTS = UINT32_MAX / 90;
+private:
+    bool PrepareObjects(const std::vector<Image>& images, std::vector<Image>& out_objects);
+    void WriteDisplaySet(int64_t pts, const std::vector<Image>& objects);
+    void WriteClearDisplaySet(int64_t pts);
+    void WriteCompositionSegment(int64_t pts, uint8_t composition_state, bool palette_update, size_t object_count);
+    void WriteWindowSegment(int64_t pts);
+    void WritePaletteSegment(int64_t pts, const std::vector<ColorRGBA>& palette);
+    void WriteObjectSegments(int64_t pts, uint16_t object_id, const Image& indexed);
+    void WriteEndSegment(int64_t pts);
+    void BeginSegment(uint8_t type, int64_t pts);
+    void EndSegment();
+    void FlushBuffer();
+    void WriteU8(uint8_t value) { buffer_.push_back(value); }
+    void WriteU16(uint16_t value);
+    void WriteU24(uint32_t value);
+    void WriteU32(uint32_t value);
+private:
+    static Image MergeObject(std::vector<Image>& images);
+    static void EncodeRLE(const Image& indexed, std::vector<uint8_t>& out);
+private:
+    std::shared_ptr<Logger> log_;
+
+    PGSWriter::WriteCallback write_callback_;
+    int frame_width_ = 0;
+    int frame_height_ = 0;
+    YUVColorMatrix color_matrix_ = YUVColorMatrix::kBT709;
+
+    int64_t last_pts_ = 0;
+    bool has_written_ = false;
+    bool has_pending_clear_ = false;
+    int64_t pending_clear_pts_ = 0;
+    bool showing_ = false;
+
+    uint16_t composition_number_ = 0;
+    bool epoch_started_ = false;
+    std::vector<Rect> windows_;                // windows of the current epoch, one per object
+    std::vector<uint64_t> object_content_ids_;   // content of the objects stored in the decoder
+    std::vector<uint8_t> object_versions_;
+    uint8_t palette_version_ = 0;
+
+    std::vector<uint8_t> buffer_;
+    size_t segment_start_ = 0;
+    std::vector<uint8_t> rle_buffer_;
+};
+
+}  // namespace aribcaption::internal
+
+#endif  // ARIBCAPTION_PGS_WRITER_IMPL_HPP
@@ -0,0 +1,83 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include "exporter/subtitle_formatter.hpp"
+#include "exporter/subtitle_formatter_ass.hpp"
+#include "exporter/subtitle_formatter_webvtt.hpp"
+
+namespace aribcaption {
+
+// U+3013 GETA MARK, conventionally shown for characters which couldn't be displayed
+constexpr std::string_view kGetaMark = "\xE3\x80\x93";
+
+std::unique_ptr<SubtitleFormatter> SubtitleFormatter::Create(SubtitleFormat format) {
+    switch (format) {
+        case SubtitleFormat::kASS:
+            return std::make_unique<SubtitleFormatterASS>();
+        case SubtitleFormat::kWebVTT:
+            return std::make_unique<SubtitleFormatterWebVTT>();
+        default:
+            return nullptr;
+    }
+}
+
+auto SubtitleFormatter::SplitSegments(const Caption& caption) -> std::vector<Segment> {
+    std::vector<Segment> segments;
+
+    for (const CaptionRegion& region : caption.regions) {
+        for (size_t i = 0; i < region.chars.size(); i++) {
+            const CaptionChar& ch = region.chars[i];
+            if (!segments.empty() && segments.back().region == &region) {
+                Segment& last = segments.back();
+                if (ch.y == last.y && ch.x == last.x + last.width) {
+                    last.end = i + 1;
+                    last.width += ch.section_width();
+                    last.height = std::max(last.height, ch.section_height());
+                    continue;
+                }
+            }
+
+            Segment segment;
+            segment.region = &region;
+            segment.begin = i;
+            segment.end = i + 1;
+            segment.x = ch.x;
+            segment.y = ch.y;
+            segment.width = ch.section_width();
+            segment.height = ch.section_height();
+            segments.push_back(segment);
+        }
+    }
+
+    return segments;
+}
+
+std::string_view SubtitleFormatter::GetCharText(const Caption& caption, const CaptionChar& ch) {
+    if (ch.type == CaptionCharType::kDRCS) {
+        auto iter = caption.drcs_map.find(ch.drcs_code);
+        if (iter != caption.drcs_map.end() && !iter->second.alternative_text.empty()) {
+            return iter->second.alternative_text;
+        }
+        return kGetaMark;
+    }
+    return ch.u8str;
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,66 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_SUBTITLE_FORMATTER_HPP
+#define ARIBCAPTION_SUBTITLE_FORMATTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "aribcaption/caption.hpp"
+#include "aribcaption/subtitle_writer.hpp"
+
+namespace aribcaption {
+
+class SubtitleFormatter {
+public:
+    static std::unique_ptr<SubtitleFormatter> Create(SubtitleFormat format);
+public:
+    SubtitleFormatter() = default;
+    virtual ~SubtitleFormatter() = default;
+public:
+    virtual void SetFontFamily([[maybe_unused]] const std::string& font_family) {}
+    virtual void FormatHeader(int plane_width, int plane_height, std::string& out) = 0;
+    virtual void FormatEvent(const Caption& caption, int64_t begin_pts, int64_t end_pts, std::string& out) = 0;
+protected:
+    // Run of adjoining characters inside a region, which could be positioned as a whole
+    struct Segment {
+        const CaptionRegion* region = nullptr;
+        size_t begin = 0;   // index of the first char in region->chars
+        size_t end = 0;     // index of the last char plus one
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+    };
+protected:
+    static std::vector<Segment> SplitSegments(const Caption& caption);
+    static std::string_view GetCharText(const Caption& caption, const CaptionChar& ch);
+public:
+    // Disallow copy and assign
+    SubtitleFormatter(const SubtitleFormatter&) = delete;
+    SubtitleFormatter& operator=(const SubtitleFormatter&) = delete;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_SUBTITLE_FORMATTER_HPP
@@ -0,0 +1,260 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+#include <vector>
+#include "exporter/subtitle_formatter_ass.hpp"
+
+namespace aribcaption {
+
+namespace {
+
+// Stroke width drawn by the renderer by default, in caption plane dots
+constexpr double kStrokeWidth = 1.5;
+
+constexpr int kDefaultFontSize = 36;
+
+void AppendTime(std::string& out, int64_t pts) {
+    // H:MM:SS.cc
+    int64_t centiseconds = std::max<int64_t>(pts, 0) / 10;
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%d:%02d:%02d.%02d",
+             static_cast<int>(centiseconds / 360000),
+             static_cast<int>(centiseconds / 6000 % 60),
+             static_cast<int>(centiseconds / 100 % 60),
+             static_cast<int>(centiseconds % 100));
+    out.append(buffer);
+}
+
+void AppendColorTag(std::string& out, const char* color_tag, const char* alpha_tag, ColorRGBA color) {
+    // &HBBGGRR& with inverted alpha
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "\\%s&H%02X%02X%02X&\\%s&H%02X&",
+             color_tag, color.b, color.g, color.r, alpha_tag, 255 - color.a);
+    out.append(buffer);
+}
+
+void AppendInt(std::string& out, const char* tag, long value) {
+    out.push_back('\\');
+    out.append(tag);
+    out.append(std::to_string(value));
+}
+
+void AppendEscaped(std::string& out, std::string_view text) {
+    for (char c : text) {
+        if (c == '{' || c == '}') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (c == '\\') {
+            // Keep a following character from forming \n, \N or \h, by U+2060 WORD JOINER
+            out.append("\\\xE2\x81\xA0");
+        } else {
+            out.push_back(c);
+        }
+    }
+}
+
+}  // namespace
+
+void SubtitleFormatterASS::SetFontFamily(const std::string& font_family) {
+    font_family_ = font_family;
+}
+
+void SubtitleFormatterASS::FormatHeader(int plane_width, int plane_height, std::string& out) {
+    play_res_x_ = plane_width;
+    play_res_y_ = plane_height;
+
+    out.append("[Script Info]\n"
+               "ScriptType: v4.00+\n"
+               "PlayResX: ");
+    out.append(std::to_string(play_res_x_));
+    out.append("\nPlayResY: ");
+    out.append(std::to_string(play_res_y_));
+    out.append("\nWrapStyle: 2\n"
+               "ScaledBorderAndShadow: yes\n"
+               "\n"
+               "[V4+ Styles]\n"
+               "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, "
+               "Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, "
+               "Alignment, MarginL, MarginR, MarginV, Encoding\n");
+
+    // Top-left aligned, as text is positioned by \pos; backgrounds are drawn in the Background style
+    const char* style_names[] = {"Default", "Ruby", "Background"};
+    for (const char* name : style_names) {
+        out.append("Style: ");
+        out.append(name);
+        out.push_back(',');
+        out.append(font_family_);
+        out.push_back(',');
+        out.append(std::to_string(kDefaultFontSize));
+        out.append(",&H00FFFFFF,&H00FFFFFF,&H00000000,&H00000000,0,0,0,0,100,100,0,0,1,0,0,7,0,0,0,1\n");
+    }
+
+    out.append("\n"
+               "[Events]\n"
+               "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n");
+}
+
+void SubtitleFormatterASS::FormatEvent(const Caption& caption, int64_t begin_pts, int64_t end_pts,
+                                       std::string& out) {
+    // Captions of another plane size are scaled into PlayResX / PlayResY
+    double scale_x = caption.plane_width > 0 ? static_cast<double>(play_res_x_) / caption.plane_width : 1.0;
+    double scale_y = caption.plane_height > 0 ? static_cast<double>(play_res_y_) / caption.plane_height : 1.0;
+
+    std::string times;
+    AppendTime(times, begin_pts);
+    times.push_back(',');
+    AppendTime(times, end_pts);
+
+    std::vector<Segment> segments = SplitSegments(caption);
+
+    // Backgrounds go below the text, one drawing per color
+    std::vector<std::pair<ColorRGBA, std::string>> backgrounds;
+    for (const Segment& segment : segments) {
+        const std::vector<CaptionChar>& chars = segment.region->chars;
+        size_t i = segment.begin;
+        while (i < segment.end) {
+            ColorRGBA back_color = chars[i].back_color;
+            int left = chars[i].x;
+            int right = left;
+            int bottom = segment.y;
+            for (; i < segment.end && chars[i].back_color.u32 == back_color.u32; i++) {
+                right = chars[i].x + chars[i].section_width();
+                bottom = std::max(bottom, chars[i].y + chars[i].section_height());
+            }
+            if (back_color.a == 0) {
+                continue;
+            }
+
+            auto iter = std::find_if(backgrounds.begin(), backgrounds.end(),
+                                     [&](const auto& pair) { return pair.first.u32 == back_color.u32; });
+            if (iter == backgrounds.end()) {
+                iter = backgrounds.emplace(backgrounds.end(), back_color, std::string());
+            }
+
+            char buffer[96];
+            long x0 = std::lround(left * scale_x);
+            long y0 = std::lround(segment.y * scale_y);
+            long x1 = std::lround(right * scale_x);
+            long y1 = std::lround(bottom * scale_y);
+            snprintf(buffer, sizeof(buffer), "%sm %ld %ld l %ld %ld %ld %ld %ld %ld",
+                     iter->second.empty() ? "" : " ", x0, y0, x1, y0, x1, y1, x0, y1);
+            iter->second.append(buffer);
+        }
+    }
+
+    for (const auto& [color, path] : backgrounds) {
+        out.append("Dialogue: 0,");
+        out.append(times);
+        out.append(",Background,,0,0,0,,{\\pos(0,0)");
+        AppendColorTag(out, "1c", "1a", color);
+        out.append("\\p1}");
+        out.append(path);
+        out.push_back('\n');
+    }
+
+    for (const Segment& segment : segments) {
+        out.append("Dialogue: 1,");
+        out.append(times);
+        out.append(segment.region->is_ruby ? ",Ruby,,0,0,0,," : ",Default,,0,0,0,,");
+        FormatSegmentText(caption, segment, scale_x, scale_y, out);
+        out.push_back('\n');
+    }
+}
+
+void SubtitleFormatterASS::FormatSegmentText(const Caption& caption, const Segment& segment,
+                                             double scale_x, double scale_y, std::string& out) {
+    const std::vector<CaptionChar>& chars = segment.region->chars;
+    const CaptionChar& first = chars[segment.begin];
+
+    // Glyphs are centered inside their sections, which include the spacing
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "{\\pos(%ld,%ld)",
+             std::lround((first.x + first.char_horizontal_spacing * first.char_horizontal_scale / 2) * scale_x),
+             std::lround((first.y + first.char_vertical_spacing * first.char_vertical_scale / 2) * scale_y));
+    out.append(buffer);
+
+    const CaptionChar* prev = nullptr;
+    for (size_t i = segment.begin; i < segment.end; i++) {
+        const CaptionChar& ch = chars[i];
+
+        // Only write the attributes differing from the previous character
+        std::string tags;
+        if (!prev || ch.char_height != prev->char_height) {
+            AppendInt(tags, "fs", std::lround(ch.char_height * scale_y));
+        }
+        if (!prev || ch.char_width != prev->char_width || ch.char_height != prev->char_height ||
+                ch.char_horizontal_scale != prev->char_horizontal_scale) {
+            double ratio = ch.char_height ? static_cast<double>(ch.char_width) / ch.char_height : 1.0;
+            AppendInt(tags, "fscx", std::lround(ch.char_horizontal_scale * ratio * 100 * scale_x / scale_y));
+        }
+        if (!prev || ch.char_vertical_scale != prev->char_vertical_scale) {
+            AppendInt(tags, "fscy", std::lround(ch.char_vertical_scale * 100));
+        }
+        if (!prev || ch.char_horizontal_spacing != prev->char_horizontal_spacing ||
+                ch.char_horizontal_scale != prev->char_horizontal_scale) {
+            snprintf(buffer, sizeof(buffer), "\\fsp%.2f",
+                     ch.char_horizontal_spacing * ch.char_horizontal_scale * scale_x);
+            tags.append(buffer);
+        }
+        if (!prev || ch.text_color.u32 != prev->text_color.u32) {
+            AppendColorTag(tags, "1c", "1a", ch.text_color);
+        }
+
+        bool stroke = ch.style & CharStyle::kCharStyleStroke;
+        bool prev_stroke = prev && (prev->style & CharStyle::kCharStyleStroke);
+        if (!prev || stroke != prev_stroke) {
+            snprintf(buffer, sizeof(buffer), "\\bord%.2f", stroke ? kStrokeWidth * scale_y : 0.0);
+            tags.append(buffer);
+        }
+        if (stroke && (!prev_stroke || ch.stroke_color.u32 != prev->stroke_color.u32)) {
+            AppendColorTag(tags, "3c", "3a", ch.stroke_color);
+        }
+
+        const std::pair<CharStyle, const char*> flags[] = {
+            {CharStyle::kCharStyleBold, "b"},
+            {CharStyle::kCharStyleItalic, "i"},
+            {CharStyle::kCharStyleUnderline, "u"},
+        };
+        for (const auto& [flag, tag] : flags) {
+            bool enabled = ch.style & flag;
+            if (prev ? enabled != static_cast<bool>(prev->style & flag) : enabled) {
+                AppendInt(tags, tag, enabled);
+            }
+        }
+
+        if (!tags.empty()) {
+            if (prev) {
+                out.push_back('{');
+            }
+            out.append(tags);
+            out.push_back('}');
+        } else if (!prev) {
+            out.push_back('}');
+        }
+
+        AppendEscaped(out, GetCharText(caption, ch));
+        prev = &ch;
+    }
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,47 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_SUBTITLE_FORMATTER_ASS_HPP
+#define ARIBCAPTION_SUBTITLE_FORMATTER_ASS_HPP
+
+#include <string>
+#include "exporter/subtitle_formatter.hpp"
+
+namespace aribcaption {
+
+class SubtitleFormatterASS : public SubtitleFormatter {
+public:
+    SubtitleFormatterASS() = default;
+    ~SubtitleFormatterASS() override = default;
+public:
+    void SetFontFamily(const std::string& font_family) override;
+    void FormatHeader(int plane_width, int plane_height, std::string& out) override;
+    void FormatEvent(const Caption& caption, int64_t begin_pts, int64_t end_pts, std::string& out) override;
+private:
+    void FormatSegmentText(const Caption& caption, const Segment& segment, double scale_x, double scale_y,
+                           std::string& out);
+private:
+    std::string font_family_ = "sans-serif";
+    int play_res_x_ = 0;
+    int play_res_y_ = 0;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_SUBTITLE_FORMATTER_ASS_HPP
@@ -0,0 +1,285 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include "decoder/b24_colors.hpp"
+#include "exporter/subtitle_formatter_webvtt.hpp"
+
+namespace aribcaption {
+
+namespace {
+
+// Cue classes of the first ARIB CLUT palette, full intensity colors use the default classes of WebVTT,
+// entry 8 is transparent
+constexpr size_t kColorCount = 16;
+constexpr size_t kTransparentIndex = 8;
+constexpr const char* kColorNames[kColorCount] = {
+    "black", "red", "lime", "yellow", "blue", "magenta", "cyan", "white",
+    "", "maroon", "green", "olive", "navy", "purple", "teal", "gray",
+};
+
+const char* NearestColorName(ColorRGBA color) {
+    size_t best = 0;
+    int best_distance = INT32_MAX;
+    for (size_t i = 0; i < kColorCount; i++) {
+        if (i == kTransparentIndex) {
+            continue;
+        }
+        ColorRGBA entry = kB24ColorCLUT[0][i];
+        int dr = entry.r - color.r;
+        int dg = entry.g - color.g;
+        int db = entry.b - color.b;
+        int distance = dr * dr + dg * dg + db * db;
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = i;
+        }
+    }
+    return kColorNames[best];
+}
+
+void AppendTime(std::string& out, int64_t pts) {
+    // HH:MM:SS.mmm
+    int64_t milliseconds = std::max<int64_t>(pts, 0);
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d.%03d",
+             static_cast<int>(milliseconds / 3600000),
+             static_cast<int>(milliseconds / 60000 % 60),
+             static_cast<int>(milliseconds / 1000 % 60),
+             static_cast<int>(milliseconds % 1000));
+    out.append(buffer);
+}
+
+void AppendEscaped(std::string& out, std::string_view text) {
+    for (char c : text) {
+        switch (c) {
+            case '&':
+                out.append("&amp;");
+                break;
+            case '<':
+                out.append("&lt;");
+                break;
+            case '>':
+                out.append("&gt;");
+                break;
+            default:
+                out.push_back(c);
+                break;
+        }
+    }
+}
+
+std::string MakeSpanClasses(const CaptionChar& ch) {
+    std::string classes = ".";
+    classes.append(NearestColorName(ch.text_color));
+    if (ch.back_color.a) {
+        classes.append(".bg_");
+        classes.append(NearestColorName(ch.back_color));
+    }
+    if (ch.style & CharStyle::kCharStyleStroke) {
+        classes.append(".stroke_");
+        classes.append(NearestColorName(ch.stroke_color));
+    }
+    return classes;
+}
+
+}  // namespace
+
+void SubtitleFormatterWebVTT::FormatHeader(int plane_width, int plane_height, std::string& out) {
+    // Cues are positioned in percentages, the plane size is not needed
+    (void)plane_width;
+    (void)plane_height;
+
+    out.append("WEBVTT\n\nSTYLE\n");
+
+    char buffer[160];
+    for (size_t i = 0; i < kColorCount; i++) {
+        if (i == kTransparentIndex) {
+            continue;
+        }
+        ColorRGBA color = kB24ColorCLUT[0][i];
+        const char* name = kColorNames[i];
+        snprintf(buffer, sizeof(buffer),
+                 "::cue(.%s) { color: #%02X%02X%02X; }\n"
+                 "::cue(.bg_%s) { background-color: #%02X%02X%02X; }\n",
+                 name, color.r, color.g, color.b, name, color.r, color.g, color.b);
+        out.append(buffer);
+        snprintf(buffer, sizeof(buffer),
+                 "::cue(.stroke_%s) { text-shadow: -1px -1px 0 #%02X%02X%02X, 1px -1px 0 #%02X%02X%02X, "
+                 "-1px 1px 0 #%02X%02X%02X, 1px 1px 0 #%02X%02X%02X; }\n",
+                 name, color.r, color.g, color.b, color.r, color.g, color.b,
+                 color.r, color.g, color.b, color.r, color.g, color.b);
+        out.append(buffer);
+    }
+    out.push_back('\n');
+}
+
+void SubtitleFormatterWebVTT::FormatEvent(const Caption& caption, int64_t begin_pts, int64_t end_pts,
+                                          std::string& out) {
+    std::vector<Segment> segments = SplitSegments(caption);
+    std::vector<std::vector<Ruby>> rubies(segments.size());
+    std::vector<bool> attached(segments.size(), false);
+
+    // Attach ruby to the base text right below it, covering the base chars which are at least half under the ruby
+    for (size_t r = 0; r < segments.size(); r++) {
+        const Segment& ruby = segments[r];
+        if (!ruby.region->is_ruby) {
+            continue;
+        }
+
+        size_t base_index = segments.size();
+        int best_distance = ruby.height + 1;
+        for (size_t b = 0; b < segments.size(); b++) {
+            const Segment& base = segments[b];
+            if (base.region->is_ruby || base.x >= ruby.x + ruby.width || ruby.x >= base.x + base.width) {
+                continue;
+            }
+            int distance = std::abs(base.y - (ruby.y + ruby.height));
+            if (distance < best_distance) {
+                best_distance = distance;
+                base_index = b;
+            }
+        }
+        if (base_index == segments.size()) {
+            continue;
+        }
+
+        const Segment& base = segments[base_index];
+        const std::vector<CaptionChar>& chars = base.region->chars;
+        size_t begin = base.end;
+        size_t end = base.begin;
+        for (size_t i = base.begin; i < base.end; i++) {
+            int width = chars[i].section_width();
+            int overlap = std::min(chars[i].x + width, ruby.x + ruby.width) - std::max(chars[i].x, ruby.x);
+            if (overlap > 0 && overlap * 2 >= width) {
+                begin = std::min(begin, i);
+                end = std::max(end, i + 1);
+            }
+        }
+        if (begin >= end) {
+            continue;
+        }
+
+        std::string text;
+        for (size_t i = ruby.begin; i < ruby.end; i++) {
+            AppendEscaped(text, GetCharText(caption, ruby.region->chars[i]));
+        }
+
+        // Join rubies sharing base chars
+        std::vector<Ruby>& base_rubies = rubies[base_index];
+        auto iter = std::find_if(base_rubies.begin(), base_rubies.end(), [&](const Ruby& other) {
+            return begin < other.end && other.begin < end;
+        });
+        if (iter != base_rubies.end()) {
+            iter->begin = std::min(iter->begin, begin);
+            iter->end = std::max(iter->end, end);
+            iter->text.append(text);
+        } else {
+            base_rubies.push_back(Ruby{begin, end, std::move(text)});
+        }
+        attached[r] = true;
+    }
+
+    char buffer[128];
+    for (size_t s = 0; s < segments.size(); s++) {
+        if (attached[s]) {
+            continue;
+        }
+        const Segment& segment = segments[s];
+        std::vector<Ruby>& segment_rubies = rubies[s];
+        std::sort(segment_rubies.begin(), segment_rubies.end(),
+                  [](const Ruby& lhs, const Ruby& rhs) { return lhs.begin < rhs.begin; });
+
+        double plane_width = caption.plane_width > 0 ? caption.plane_width : 960;
+        double plane_height = caption.plane_height > 0 ? caption.plane_height : 540;
+        double position = std::clamp(segment.x * 100.0 / plane_width, 0.0, 100.0);
+        double line = std::clamp(segment.y * 100.0 / plane_height, 0.0, 100.0);
+        double size = std::clamp(segment.width * 100.0 / plane_width, 0.0, 100.0 - position);
+
+        AppendTime(out, begin_pts);
+        out.append(" --> ");
+        AppendTime(out, end_pts);
+        snprintf(buffer, sizeof(buffer), " line:%.2f%% position:%.2f%%,line-left align:left size:%.2f%%\n",
+                 line, position, size);
+        out.append(buffer);
+        FormatCueText(caption, segment, segment_rubies, out);
+        out.append("\n\n");
+    }
+}
+
+void SubtitleFormatterWebVTT::FormatCueText(const Caption& caption, const Segment& segment,
+                                            const std::vector<Ruby>& rubies, std::string& out) {
+    const std::vector<CaptionChar>& chars = segment.region->chars;
+    auto ruby_iter = rubies.begin();
+
+    // Classes and style flags of the open <c> span
+    bool span_opened = false;
+    std::string span_classes;
+    int span_style = 0;
+    auto close_span = [&]() {
+        if (!span_opened) {
+            return;
+        }
+        if (span_style & CharStyle::kCharStyleUnderline) out.append("</u>");
+        if (span_style & CharStyle::kCharStyleItalic) out.append("</i>");
+        if (span_style & CharStyle::kCharStyleBold) out.append("</b>");
+        out.append("</c>");
+        span_opened = false;
+    };
+
+    for (size_t i = segment.begin; i < segment.end; i++) {
+        const CaptionChar& ch = chars[i];
+
+        if (ruby_iter != rubies.end() && ruby_iter->begin == i) {
+            close_span();
+            out.append("<ruby>");
+        }
+
+        std::string classes = MakeSpanClasses(ch);
+        int style = ch.style & (CharStyle::kCharStyleBold | CharStyle::kCharStyleItalic |
+                                CharStyle::kCharStyleUnderline);
+        if (!span_opened || classes != span_classes || style != span_style) {
+            close_span();
+            out.append("<c");
+            out.append(classes);
+            out.push_back('>');
+            if (style & CharStyle::kCharStyleBold) out.append("<b>");
+            if (style & CharStyle::kCharStyleItalic) out.append("<i>");
+            if (style & CharStyle::kCharStyleUnderline) out.append("<u>");
+            span_opened = true;
+            span_classes = std::move(classes);
+            span_style = style;
+        }
+
+        AppendEscaped(out, GetCharText(caption, ch));
+
+        if (ruby_iter != rubies.end() && ruby_iter->end == i + 1) {
+            close_span();
+            out.append("<rt>");
+            out.append(ruby_iter->text);
+            out.append("</rt></ruby>");
+            ++ruby_iter;
+        }
+    }
+    close_span();
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,50 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_SUBTITLE_FORMATTER_WEBVTT_HPP
+#define ARIBCAPTION_SUBTITLE_FORMATTER_WEBVTT_HPP
+
+#include <string>
+#include <vector>
+#include "exporter/subtitle_formatter.hpp"
+
+namespace aribcaption {
+
+class SubtitleFormatterWebVTT : public SubtitleFormatter {
+public:
+    SubtitleFormatterWebVTT() = default;
+    ~SubtitleFormatterWebVTT() override = default;
+public:
+    void FormatHeader(int plane_width, int plane_height, std::string& out) override;
+    void FormatEvent(const Caption& caption, int64_t begin_pts, int64_t end_pts, std::string& out) override;
+private:
+    // Ruby text attached to chars [begin, end) of a base segment
+    struct Ruby {
+        size_t begin = 0;
+        size_t end = 0;
+        std::string text;
+    };
+private:
+    static void FormatCueText(const Caption& caption, const Segment& segment, const std::vector<Ruby>& rubies,
+                              std::string& out);
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_SUBTITLE_FORMATTER_WEBVTT_HPP
@@ -0,0 +1,50 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "aribcaption/subtitle_writer.hpp"
+#include "exporter/subtitle_writer_impl.hpp"
+
+namespace aribcaption {
+
+SubtitleWriter::SubtitleWriter(Context& context)
+    : pimpl_(std::make_unique<internal::SubtitleWriterImpl>(context)) {}
+
+SubtitleWriter::~SubtitleWriter() = default;
+
+SubtitleWriter::SubtitleWriter(SubtitleWriter&&) noexcept = default;
+
+SubtitleWriter& SubtitleWriter::operator=(SubtitleWriter&&) noexcept = default;
+
+bool SubtitleWriter::Initialize(SubtitleFormat format, WriteCallback write_callback, size_t buffer_size) {
+    return pimpl_->Initialize(format, std::move(write_callback), buffer_size);
+}
+
+void SubtitleWriter::SetFontFamily(const std::string& font_family) {
+    pimpl_->SetFontFamily(font_family);
+}
+
+bool SubtitleWriter::Write(const Caption& caption) {
+    return pimpl_->Write(caption);
+}
+
+void SubtitleWriter::Flush(int64_t end_pts) {
+    pimpl_->Flush(end_pts);
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,71 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <new>
+#include "aribcaption/subtitle_writer.h"
+#include "aribcaption/subtitle_writer.hpp"
+#include "common/caption_capi.hpp"
+#include "exporter/subtitle_writer_impl.hpp"
+
+using namespace aribcaption;
+using namespace aribcaption::internal;
+
+extern "C" {
+
+aribcc_subtitle_writer_t* aribcc_subtitle_writer_alloc(aribcc_context_t* context) {
+    auto ctx = reinterpret_cast<Context*>(context);
+    auto impl = new(std::nothrow) SubtitleWriterImpl(*ctx);
+    return reinterpret_cast<aribcc_subtitle_writer_t*>(impl);
+}
+
+void aribcc_subtitle_writer_free(aribcc_subtitle_writer_t* writer) {
+    auto impl = reinterpret_cast<SubtitleWriterImpl*>(writer);
+    delete impl;
+}
+
+bool aribcc_subtitle_writer_initialize(aribcc_subtitle_writer_t* writer,
+                                       aribcc_subtitle_format_t format,
+                                       aribcc_subtitle_write_callback_t write_callback,
+                                       void* userdata,
+                                       size_t buffer_size) {
+    auto impl = reinterpret_cast<SubtitleWriterImpl*>(writer);
+    if (!write_callback) {
+        return impl->Initialize(static_cast<SubtitleFormat>(format), nullptr, buffer_size);
+    }
+    return impl->Initialize(static_cast<SubtitleFormat>(format), [=](const char* data, size_t size) {
+        write_callback(data, size, userdata);
+    }, buffer_size);
+}
+
+void aribcc_subtitle_writer_set_font_family(aribcc_subtitle_writer_t* writer, const char* font_family) {
+    auto impl = reinterpret_cast<SubtitleWriterImpl*>(writer);
+    impl->SetFontFamily(font_family ? font_family : "");
+}
+
+bool aribcc_subtitle_writer_write(aribcc_subtitle_writer_t* writer, const aribcc_caption_t* caption) {
+    auto impl = reinterpret_cast<SubtitleWriterImpl*>(writer);
+    return impl->Write(ConstructCaptionFromCAPI(caption));
+}
+
+void aribcc_subtitle_writer_flush(aribcc_subtitle_writer_t* writer, int64_t end_pts) {
+    auto impl = reinterpret_cast<SubtitleWriterImpl*>(writer);
+    impl->Flush(end_pts);
+}
+
+}  // extern "C"
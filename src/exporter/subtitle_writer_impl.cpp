@@ -0,0 +1,185 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include "exporter/subtitle_writer_impl.hpp"
+
+namespace aribcaption::internal {
+
+// Display time of a last caption with undetermined duration, if the end of stream is unknown
+constexpr int64_t kIndefiniteLastDuration = 1000;
+
+// Upper limit of captions displayed at once, for streams adding captions without ever clearing the screen
+constexpr size_t kMaxDisplayedCaptions = 16;
+
+constexpr int kDefaultPlaneWidth = 960;
+constexpr int kDefaultPlaneHeight = 540;
+
+SubtitleWriterImpl::SubtitleWriterImpl(Context& context) : log_(GetContextLogger(context)) {}
+
+SubtitleWriterImpl::~SubtitleWriterImpl() = default;
+
+bool SubtitleWriterImpl::Initialize(SubtitleFormat format, SubtitleWriter::WriteCallback write_callback,
+                                    size_t buffer_size) {
+    if (!write_callback) {
+        log_->e("SubtitleWriter: write_callback is empty");
+        return false;
+    }
+
+    formatter_ = SubtitleFormatter::Create(format);
+    if (!formatter_) {
+        log_->e("SubtitleWriter: Unsupported subtitle format %d", static_cast<int>(format));
+        return false;
+    }
+
+    write_callback_ = std::move(write_callback);
+    buffer_size_ = std::max<size_t>(buffer_size, 1);
+    buffer_.clear();
+    buffer_.reserve(buffer_size_);
+
+    header_written_ = false;
+    has_written_ = false;
+    pending_captions_.clear();
+    return true;
+}
+
+void SubtitleWriterImpl::SetFontFamily(const std::string& font_family) {
+    if (!formatter_) {
+        log_->e("SubtitleWriter: Writer is not initialized");
+        return;
+    }
+    if (header_written_) {
+        log_->w("SubtitleWriter: Font family should be set before writing captions");
+    }
+    formatter_->SetFontFamily(font_family);
+}
+
+bool SubtitleWriterImpl::Write(const Caption& caption) {
+    if (!formatter_) {
+        log_->e("SubtitleWriter: Writer is not initialized");
+        return false;
+    }
+    if (caption.pts == PTS_NOPTS) {
+        log_->e("SubtitleWriter: Caption without PTS is not supported");
+        return false;
+    }
+    if (has_written_ && caption.pts < last_pts_) {
+        log_->e("SubtitleWriter: PTS %" PRId64 " is earlier than previous PTS %" PRId64, caption.pts, last_pts_);
+        return false;
+    }
+
+    if (caption.flags & CaptionFlags::kCaptionFlagsClearScreen) {
+        // Clearing the screen ends all displayed captions, a caption without regions does nothing else
+        WritePendingCaptions(caption.pts);
+    } else {
+        // Otherwise new regions are displayed on top of the captions still displayed
+        WriteExpiredCaptions(caption.pts);
+    }
+
+    if (!caption.regions.empty()) {
+        if (pending_captions_.size() >= kMaxDisplayedCaptions) {
+            WritePendingCaption(pending_captions_.front(), caption.pts);
+            pending_captions_.pop_front();
+        }
+        pending_captions_.push_back(caption);
+    }
+    last_pts_ = caption.pts;
+    has_written_ = true;
+    return true;
+}
+
+void SubtitleWriterImpl::Flush(int64_t end_pts) {
+    if (!formatter_) {
+        return;
+    }
+    WritePendingCaptions(end_pts);
+    WriteHeaderIfNecessary(kDefaultPlaneWidth, kDefaultPlaneHeight);
+    FlushBuffer();
+}
+
+void SubtitleWriterImpl::WriteHeaderIfNecessary(int plane_width, int plane_height) {
+    if (header_written_) {
+        return;
+    }
+    event_.clear();
+    formatter_->FormatHeader(plane_width > 0 ? plane_width : kDefaultPlaneWidth,
+                             plane_height > 0 ? plane_height : kDefaultPlaneHeight, event_);
+    Append(event_);
+    header_written_ = true;
+}
+
+void SubtitleWriterImpl::WritePendingCaptions(int64_t next_pts) {
+    for (const Caption& caption : pending_captions_) {
+        WritePendingCaption(caption, next_pts);
+    }
+    pending_captions_.clear();
+}
+
+void SubtitleWriterImpl::WriteExpiredCaptions(int64_t pts) {
+    // Captions are written in PTS order, so a caption ended by its duration waits for the ones displayed before it
+    while (!pending_captions_.empty()) {
+        const Caption& caption = pending_captions_.front();
+        if (caption.wait_duration == DURATION_INDEFINITE || caption.pts + caption.wait_duration > pts) {
+            break;
+        }
+        WritePendingCaption(caption, pts);
+        pending_captions_.pop_front();
+    }
+}
+
+void SubtitleWriterImpl::WritePendingCaption(const Caption& caption, int64_t next_pts) {
+    int64_t end_pts = next_pts;
+    if (caption.wait_duration != DURATION_INDEFINITE) {
+        int64_t caption_end = caption.pts + caption.wait_duration;
+        end_pts = next_pts == PTS_NOPTS ? caption_end : std::min(caption_end, next_pts);
+    } else if (next_pts == PTS_NOPTS) {
+        end_pts = caption.pts + kIndefiniteLastDuration;
+    }
+    if (end_pts <= caption.pts) {
+        return;
+    }
+
+    WriteHeaderIfNecessary(caption.plane_width, caption.plane_height);
+
+    event_.clear();
+    formatter_->FormatEvent(caption, caption.pts, end_pts, event_);
+    Append(event_);
+}
+
+void SubtitleWriterImpl::Append(const std::string& data) {
+    // Keep the buffer within buffer_size_, data exceeding it on its own is written through
+    if (buffer_.size() + data.size() > buffer_size_) {
+        FlushBuffer();
+    }
+    if (data.size() >= buffer_size_) {
+        write_callback_(data.data(), data.size());
+        return;
+    }
+    buffer_.append(data);
+}
+
+void SubtitleWriterImpl::FlushBuffer() {
+    if (!buffer_.empty()) {
+        write_callback_(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+}
+
+}  // namespace aribcaption::internal
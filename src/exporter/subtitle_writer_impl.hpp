@@ -0,0 +1,72 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_SUBTITLE_WRITER_IMPL_HPP
+#define ARIBCAPTION_SUBTITLE_WRITER_IMPL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include "aribcaption/caption.hpp"
+#include "aribcaption/context.hpp"
+#include "aribcaption/subtitle_writer.hpp"
+#include "base/logger.hpp"
+#include "exporter/subtitle_formatter.hpp"
+
+namespace aribcaption::internal {
+
+class SubtitleWriterImpl {
+public:
+    explicit SubtitleWriterImpl(Context& context);
+    ~SubtitleWriterImpl();
+public:
+    bool Initialize(SubtitleFormat format, SubtitleWriter::WriteCallback write_callback, size_t buffer_size);
+    void SetFontFamily(const std::string& font_family);
+    bool Write(const Caption& caption);
+    void Flush(int64_t end_pts);
+private:
+    void WriteHeaderIfNecessary(int plane_width, int plane_height);
+    void WritePendingCaption(const Caption& caption, int64_t next_pts);
+    void WritePendingCaptions(int64_t next_pts);
+    void WriteExpiredCaptions(int64_t pts);
+    void Append(const std::string& data);
+    void FlushBuffer();
+private:
+    std::shared_ptr<Logger> log_;
+
+    std::unique_ptr<SubtitleFormatter> formatter_;
+    SubtitleWriter::WriteCallback write_callback_;
+    size_t buffer_size_ = 0;
+    std::string buffer_;
+    std::string event_;
+
+    bool header_written_ = false;
+    bool has_written_ = false;
+    int64_t last_pts_ = 0;
+
+    // Captions displayed on the screen at last_pts_ in PTS order, waiting for their end time to be known
+    // More than one is displayed if captions are added without clearing the screen
+    std::deque<Caption> pending_captions_;
+};
+
+}  // namespace aribcaption::internal
+
+#endif  // ARIBCAPTION_SUBTITLE_WRITER_IMPL_HPP
@@ -17,7 +17,9 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include "renderer/bitmap.hpp"
 
 namespace aribcaption {
@@ -67,4 +69,50 @@ Bitmap::Bitmap(int width, int height, PixelFormat pixel_format) :
     pixels.resize(stride_ * height);
 }
 
-}  // namespace aribcaption
\ No newline at end of file
+Rect Bitmap::GetContentRect() const {
+    Rect rect(width_, height_, 0, 0);
+
+    for (int y = 0; y < height_; y++) {
+        const ColorRGBA* line = GetPixelAt(0, y);
+
+        int left = 0;
+        while (left < width_ && !line[left].a) {
+            left++;
+        }
+        if (left == width_) {
+            continue;  // Fully transparent line
+        }
+
+        // Pixels on the right side of the known right edge are the only ones that could extend it
+        int right = width_;
+        int right_limit = std::max(left + 1, rect.right);
+        while (right > right_limit && !line[right - 1].a) {
+            right--;
+        }
+
+        rect.left = std::min(rect.left, left);
+        rect.right = std::max(rect.right, right);
+        rect.top = std::min(rect.top, y);
+        rect.bottom = y + 1;
+    }
+
+    if (rect.left >= rect.right || rect.top >= rect.bottom) {
+        return {};
+    }
+    return rect;
+}
+
+Bitmap Bitmap::Crop(const Rect& rect) const {
+    assert(rect.left >= 0 && rect.top >= 0 && rect.right <= width_ && rect.bottom <= height_);
+
+    Bitmap cropped(rect.width(), rect.height(), pixel_format_);
+    for (int y = 0; y < rect.height(); y++) {
+        memcpy(cropped.GetPixelAt(0, y),
+               GetPixelAt(rect.left, rect.top + y),
+               static_cast<size_t>(rect.width()) * sizeof(ColorRGBA));
+    }
+
+    return cropped;
+}
+
+}  // namespace aribcaption
@@ -79,6 +79,18 @@ public:
         return {0, 0, width_, height_};
     }
 
+    /**
+     * Get the bounding box of pixels which are not fully transparent, empty rect if there is none
+     */
+    [[nodiscard]]
+    Rect GetContentRect() const;
+
+    /**
+     * Copy the pixels inside rect into a new bitmap, rect must be inside the bitmap
+     */
+    [[nodiscard]]
+    Bitmap Crop(const Rect& rect) const;
+
     [[nodiscard]]
     ALWAYS_INLINE size_t size() const { return pixels.size(); }
 
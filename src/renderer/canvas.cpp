@@ -17,6 +17,8 @@
  */
 
 #include <cassert>
+#include <cstddef>
+#include <vector>
 #include "renderer/alphablend.hpp"
 #include "renderer/bitmap.hpp"
 #include "renderer/canvas.hpp"
@@ -90,4 +92,28 @@ void Canvas::DrawBitmap(const Bitmap& bmp, int target_x, int target_y) {
     DrawBitmap(bmp, rect);
 }
 
+void Canvas::DrawAlphaMask(const uint8_t* alphas, int width, int height, int pitch, ColorRGBA color,
+                           int target_x, int target_y) {
+    Rect rect{target_x, target_y, target_x + width, target_y + height};
+    Rect clipped = Rect::ClipRect(bitmap_.GetRect(), rect);
+
+    if (clipped.width() <= 0 || clipped.height() <= 0) {
+        return;
+    }
+
+    int clip_x_offset = clipped.left - rect.left;
+    int clip_y_offset = clipped.top - rect.top;
+    auto line_width = static_cast<size_t>(clipped.width());
+
+    std::vector<ColorRGBA> line(line_width);
+
+    for (int y = clipped.top; y < clipped.bottom; y++) {
+        ColorRGBA* dest_begin = bitmap_.GetPixelAt(clipped.left, y);
+        const uint8_t* src_begin = alphas + static_cast<ptrdiff_t>(clip_y_offset + y - clipped.top) * pitch +
+                                   clip_x_offset;
+        alphablend::FillLineWithAlphas(line.data(), src_begin, color, line_width);
+        alphablend::BlendLine(dest_begin, line.data(), line_width);
+    }
+}
+
 }  // namespace aribcaption
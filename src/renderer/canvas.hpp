@@ -20,6 +20,7 @@
 #ifndef ARIBCAPTION_CANVAS_HPP
 #define ARIBCAPTION_CANVAS_HPP
 
+#include <cstdint>
 #include <optional>
 #include "aribcaption/caption.hpp"
 #include "aribcaption/color.hpp"
@@ -39,6 +40,10 @@ public:
     void DrawRect(ColorRGBA color, const Rect& rect);
     void DrawBitmap(const Bitmap& bmp, const Rect& rect);
     void DrawBitmap(const Bitmap& bmp, int target_x, int target_y);
+
+    // Blend an 8-bit coverage mask filled with color, as if it has been converted into a colored bitmap
+    void DrawAlphaMask(const uint8_t* alphas, int width, int height, int pitch, ColorRGBA color,
+                       int target_x, int target_y);
 public:
     // Disallow copy and assign
     Canvas(const Canvas&) = delete;
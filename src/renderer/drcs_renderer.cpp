@@ -17,7 +17,10 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
 #include <cstdint>
+#include <iterator>
+#include "base/md5_helper.hpp"
 #include "renderer/alphablend.hpp"
 #include "renderer/bitmap.hpp"
 #include "renderer/canvas.hpp"
@@ -25,61 +28,227 @@
 
 namespace aribcaption {
 
+DRCSRenderer::DRCSRenderer()
+    : pattern_cache_(kPatternCacheCapacity), scaled_mask_cache_(kScaledMaskCacheCapacity) {}
+
+void DRCSRenderer::SetStrokeMode(StrokeMode mode) {
+    stroke_mode_ = mode;
+}
+
+void DRCSRenderer::SetScaleMode(DRCSScaleMode mode) {
+    scale_mode_ = mode;
+}
+
 bool DRCSRenderer::DrawDRCS(const DRCS& drcs, CharStyle style, ColorRGBA color, ColorRGBA stroke_color,
-                            int stroke_width, int target_width, int target_height,
+                            float stroke_width, int target_width, int target_height,
                             Bitmap& target_bmp, int target_x, int target_y) {
-    if (drcs.width == 0 || drcs.height == 0 || drcs.pixels.empty()) {
+    if (drcs.width <= 0 || drcs.height <= 0 || drcs.depth < 2 || drcs.pixels.empty() ||
+        target_width <= 0 || target_height <= 0) {
+        return false;
+    }
+
+    size_t pattern_bytes = (static_cast<size_t>(drcs.width) * drcs.height * drcs.depth_bits + 7) / 8;
+    if (drcs.pixels.size() < pattern_bytes) {
+        return false;
+    }
+
+    ScaledMaskKey key{PatternKey{drcs.md5, drcs.width, drcs.height, drcs.depth},
+                      target_width, target_height, scale_mode_};
+    if (key.pattern.md5.empty()) {
+        key.pattern.md5 = md5::GetDigest(drcs.pixels.data(), drcs.pixels.size());
+    }
+
+    ScaledMask* mask = GetScaledMask(key, drcs);
+    if (!mask) {
         return false;
     }
 
     Canvas canvas(target_bmp);
 
     // Draw stroke (border) if needed
-    if (style & CharStyle::kCharStyleStroke) {
-        Bitmap stroke_bitmap = DRCSToColoredBitmap(drcs, target_width, target_height, stroke_color);
+    if ((style & CharStyle::kCharStyleStroke) && stroke_mode_ == StrokeMode::kDilation) {
+        auto radius = static_cast<int>(stroke_width * 64);
+        auto iter = std::find_if(mask->borders.begin(), mask->borders.end(),
+                                 [radius](const auto& pair) { return pair.first == radius; });
+        if (iter == mask->borders.end()) {
+            mask->borders.emplace_back(radius, morphology::DilateMask(mask->alphas.data(),
+                                                                      target_width, target_height,
+                                                                      target_width, stroke_width));
+            iter = std::prev(mask->borders.end());
+            scaled_mask_cache_.UpdateCost(key, mask->GetMemoryCost());
+        }
 
-        canvas.DrawBitmap(stroke_bitmap, target_x - stroke_width, target_y);
-        canvas.DrawBitmap(stroke_bitmap, target_x + stroke_width, target_y);
-        canvas.DrawBitmap(stroke_bitmap, target_x, target_y - stroke_width);
-        canvas.DrawBitmap(stroke_bitmap, target_x, target_y + stroke_width);
+        const morphology::AlphaMask& border = iter->second;
+        int padding = morphology::GetDilationPadding(stroke_width);
+        canvas.DrawAlphaMask(border.alphas.data(), border.width, border.height, border.width, stroke_color,
+                             target_x - padding, target_y - padding);
+    } else if (style & CharStyle::kCharStyleStroke) {
+        auto offset = static_cast<int>(stroke_width);
+        const uint8_t* alphas = mask->alphas.data();
+
+        canvas.DrawAlphaMask(alphas, target_width, target_height, target_width, stroke_color,
+                             target_x - offset, target_y);
+        canvas.DrawAlphaMask(alphas, target_width, target_height, target_width, stroke_color,
+                             target_x + offset, target_y);
+        canvas.DrawAlphaMask(alphas, target_width, target_height, target_width, stroke_color,
+                             target_x, target_y - offset);
+        canvas.DrawAlphaMask(alphas, target_width, target_height, target_width, stroke_color,
+                             target_x, target_y + offset);
     }
 
     // Draw DRCS with text color
-    Bitmap text_bitmap = DRCSToColoredBitmap(drcs, target_width, target_height, color);
-    canvas.DrawBitmap(text_bitmap, target_x, target_y);
+    canvas.DrawAlphaMask(mask->alphas.data(), target_width, target_height, target_width, color,
+                         target_x, target_y);
 
     return true;
 }
 
-Bitmap DRCSRenderer::DRCSToColoredBitmap(const DRCS& drcs, int target_width, int target_height, ColorRGBA color) {
-    Bitmap bitmap(target_width, target_height, PixelFormat::kRGBA8888);
+auto DRCSRenderer::GetScaledMask(const ScaledMaskKey& key, const DRCS& drcs) -> ScaledMask* {
+    if (ScaledMask* mask = scaled_mask_cache_.Get(key)) {
+        return mask;
+    }
+
+    std::vector<uint8_t>* pattern = pattern_cache_.Get(key.pattern);
+    if (!pattern) {
+        std::vector<uint8_t> unpacked = UnpackDRCS(drcs);
+        size_t cost = sizeof(unpacked) + unpacked.size();
+        pattern = &pattern_cache_.Put(key.pattern, std::move(unpacked), cost);
+    }
+
+    ScaledMask mask;
+    if (key.scale_mode == DRCSScaleMode::kAreaAverage) {
+        mask.alphas = ScaleAreaAverage(pattern->data(), drcs.width, drcs.height,
+                                       key.target_width, key.target_height);
+    } else {
+        mask.alphas = ScaleNearest(pattern->data(), drcs.width, drcs.height,
+                                   key.target_width, key.target_height);
+    }
+
+    size_t cost = mask.GetMemoryCost();
+    return &scaled_mask_cache_.Put(key, std::move(mask), cost);
+}
+
+std::vector<uint8_t> DRCSRenderer::UnpackDRCS(const DRCS& drcs) {
+    std::vector<uint8_t> alphas(static_cast<size_t>(drcs.width) * drcs.height);
+
+    const auto max_value = static_cast<uint32_t>(drcs.depth - 1);
+    const auto value_mask = static_cast<uint8_t>(drcs.depth - 1);
+
+    for (size_t i = 0; i < alphas.size(); i++) {
+        size_t bit_position = i * drcs.depth_bits;
+        uint8_t byte = drcs.pixels[bit_position / 8];
+        size_t bit_offset = bit_position % 8;
+
+        uint8_t value = (byte >> (8 - (bit_offset + drcs.depth_bits))) & value_mask;
+        alphas[i] = alphablend::Clamp255(255 * static_cast<uint32_t>(value) / max_value);
+    }
+
+    return alphas;
+}
+
+std::vector<uint8_t> DRCSRenderer::ScaleNearest(const uint8_t* src, int src_width, int src_height,
+                                                int target_width, int target_height) {
+    std::vector<uint8_t> alphas(static_cast<size_t>(target_width) * target_height);
 
-    float x_fraction = static_cast<float>(drcs.width) / static_cast<float>(target_width);
-    float y_fraction = static_cast<float>(drcs.height) / static_cast<float>(target_height);
+    // Source column for each target column, computed in exact integer arithmetic
+    std::vector<int> x_map(target_width);
+    for (int x = 0; x < target_width; x++) {
+        x_map[x] = static_cast<int>(static_cast<int64_t>(x) * src_width / target_width);
+    }
 
     for (int y = 0; y < target_height; y++) {
-        ColorRGBA* dest = bitmap.GetPixelAt(0, y);
-        int drcs_y = static_cast<int>(y_fraction * static_cast<float>(y));
+        auto src_y = static_cast<int>(static_cast<int64_t>(y) * src_height / target_height);
+        const uint8_t* src_line = src + static_cast<size_t>(src_y) * src_width;
+        uint8_t* dest = &alphas[static_cast<size_t>(y) * target_width];
+
         for (int x = 0; x < target_width; x++) {
-            int drcs_x = static_cast<int>(x_fraction * static_cast<float>(x));
+            dest[x] = src_line[x_map[x]];
+        }
+    }
+
+    return alphas;
+}
 
-            intptr_t index = (drcs_y * drcs.width + drcs_x) * drcs.depth_bits / 8;
-            intptr_t bit_offset = (drcs_y * drcs.width + drcs_x) * drcs.depth_bits % 8;
-            uint8_t byte = drcs.pixels[index];
+namespace {
+
+// Source pixels covered by a target pixel, weights are in 16.16 fixed-point and sum up to 1.0
+struct AreaContribution {
+    int begin = 0;
+    std::vector<uint32_t> weights;
+};
+
+std::vector<AreaContribution> CalcAreaContributions(int src_length, int target_length) {
+    constexpr uint32_t kOne = 1u << 16;
+    std::vector<AreaContribution> contributions(target_length);
+
+    // Target pixel i covers [i * src_length, (i + 1) * src_length),
+    // Source pixel j covers [j * target_length, (j + 1) * target_length)
+    for (int i = 0; i < target_length; i++) {
+        int64_t start = static_cast<int64_t>(i) * src_length;
+        int64_t end = start + src_length;
+        auto first = static_cast<int>(start / target_length);
+        auto last = static_cast<int>((end - 1) / target_length);
+
+        AreaContribution& contribution = contributions[i];
+        contribution.begin = first;
+
+        uint32_t sum = 0;
+        for (int j = first; j <= last; j++) {
+            int64_t overlap = std::min(end, static_cast<int64_t>(j + 1) * target_length) -
+                              std::max(start, static_cast<int64_t>(j) * target_length);
+            auto weight = static_cast<uint32_t>(overlap * kOne / src_length);
+            contribution.weights.push_back(weight);
+            sum += weight;
+        }
 
-            uint8_t value = (byte >> (8 - (bit_offset + drcs.depth_bits))) & (drcs.depth - 1);
-            uint8_t grey = alphablend::Clamp255((uint32_t)255 * value / (drcs.depth - 1));
+        // Compensate rounding errors
+        auto largest = std::max_element(contribution.weights.begin(), contribution.weights.end());
+        *largest += kOne - sum;
+    }
 
-            if (grey) {
-                uint8_t alpha = (static_cast<uint32_t>(grey) * color.a) >> 8;
-                dest[x] = ColorRGBA(color, alpha);
-            } else {
-                dest[x] = ColorRGBA(0);
+    return contributions;
+}
+
+}  // namespace
+
+std::vector<uint8_t> DRCSRenderer::ScaleAreaAverage(const uint8_t* src, int src_width, int src_height,
+                                                    int target_width, int target_height) {
+    std::vector<AreaContribution> x_contributions = CalcAreaContributions(src_width, target_width);
+    std::vector<AreaContribution> y_contributions = CalcAreaContributions(src_height, target_height);
+
+    // Horizontal pass, intermediate values are kept in 8.8 fixed-point
+    std::vector<uint32_t> intermediate(static_cast<size_t>(target_width) * src_height);
+    for (int y = 0; y < src_height; y++) {
+        const uint8_t* src_line = src + static_cast<size_t>(y) * src_width;
+        uint32_t* dest = &intermediate[static_cast<size_t>(y) * target_width];
+
+        for (int x = 0; x < target_width; x++) {
+            const AreaContribution& contribution = x_contributions[x];
+            uint32_t sum = 0;
+            for (size_t k = 0; k < contribution.weights.size(); k++) {
+                sum += contribution.weights[k] * src_line[contribution.begin + k];
+            }
+            dest[x] = (sum + (1u << 7)) >> 8;
+        }
+    }
+
+    // Vertical pass
+    std::vector<uint8_t> alphas(static_cast<size_t>(target_width) * target_height);
+    for (int y = 0; y < target_height; y++) {
+        const AreaContribution& contribution = y_contributions[y];
+        uint8_t* dest = &alphas[static_cast<size_t>(y) * target_width];
+
+        for (int x = 0; x < target_width; x++) {
+            uint64_t sum = 0;
+            for (size_t k = 0; k < contribution.weights.size(); k++) {
+                size_t index = (contribution.begin + k) * target_width + x;
+                sum += static_cast<uint64_t>(contribution.weights[k]) * intermediate[index];
             }
+            dest[x] = alphablend::Clamp255(static_cast<uint32_t>((sum + (1u << 23)) >> 24));
         }
     }
 
-    return bitmap;
+    return alphas;
 }
 
-}  // namespace aribcaption
\ No newline at end of file
+}  // namespace aribcaption
@@ -1,3 +1,4 @@
+
 /*
  * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
  *
@@ -19,8 +20,16 @@
 #ifndef ARIBCAPTION_DRCS_RENDERER_HPP
 #define ARIBCAPTION_DRCS_RENDERER_HPP
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
 #include "aribcaption/caption.hpp"
 #include "aribcaption/color.hpp"
+#include "aribcaption/renderer.hpp"
+#include "base/lru_cache.hpp"
+#include "renderer/morphology.hpp"
 
 namespace aribcaption {
 
@@ -28,17 +37,93 @@ class Bitmap;
 
 class DRCSRenderer {
 public:
-    DRCSRenderer() = default;
+    DRCSRenderer();
     ~DRCSRenderer() = default;
 public:
+    void SetStrokeMode(StrokeMode mode);
+    void SetScaleMode(DRCSScaleMode mode);
     bool DrawDRCS(const DRCS& drcs, CharStyle style, ColorRGBA color, ColorRGBA stroke_color,
-                  int stroke_width, int char_width, int char_height,
+                  float stroke_width, int char_width, int char_height,
                   Bitmap& target_bmp, int x, int y);
 private:
-    static Bitmap DRCSToColoredBitmap(const DRCS& drcs, int target_width, int target_height, ColorRGBA color);
+    // Identifies a DRCS pattern, DRCS::md5 only covers the pixels buffer
+    struct PatternKey {
+        std::string md5;
+        int width = 0;
+        int height = 0;
+        int depth = 0;
+
+        bool operator==(const PatternKey& rhs) const {
+            return width == rhs.width && height == rhs.height && depth == rhs.depth && md5 == rhs.md5;
+        }
+    };
+
+    struct PatternKeyHash {
+        size_t operator()(const PatternKey& key) const {
+            size_t h = std::hash<std::string>{}(key.md5);
+            h ^= static_cast<size_t>(key.width) * 0x9E3779B1u + (h << 6) + (h >> 2);
+            h ^= static_cast<size_t>(key.height) * 0x85EBCA77u + (h << 6) + (h >> 2);
+            h ^= static_cast<size_t>(key.depth) + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+
+    struct ScaledMaskKey {
+        PatternKey pattern;
+        int target_width = 0;
+        int target_height = 0;
+        DRCSScaleMode scale_mode = DRCSScaleMode::kNearest;
+
+        bool operator==(const ScaledMaskKey& rhs) const {
+            return target_width == rhs.target_width && target_height == rhs.target_height &&
+                   scale_mode == rhs.scale_mode && pattern == rhs.pattern;
+        }
+    };
+
+    struct ScaledMaskKeyHash {
+        size_t operator()(const ScaledMaskKey& key) const {
+            size_t h = PatternKeyHash{}(key.pattern);
+            h ^= static_cast<size_t>(key.target_width) * 0x9E3779B1u + (h << 6) + (h >> 2);
+            h ^= static_cast<size_t>(key.target_height) * 0x85EBCA77u + (h << 6) + (h >> 2);
+            h ^= static_cast<size_t>(key.scale_mode) + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+
+    // Coverage mask scaled to target size, together with dilated stroke borders
+    struct ScaledMask {
+        std::vector<uint8_t> alphas;
+        std::vector<std::pair<int, morphology::AlphaMask>> borders;  // stroke radius (26.6) => border mask
+
+        [[nodiscard]]
+        size_t GetMemoryCost() const {
+            size_t cost = sizeof(ScaledMask) + alphas.size();
+            for (const auto& [radius, border] : borders) {
+                cost += sizeof(border) + border.alphas.size();
+            }
+            return cost;
+        }
+    };
+
+    static constexpr size_t kPatternCacheCapacity = 1024 * 1024;     // in bytes
+    static constexpr size_t kScaledMaskCacheCapacity = 4 * 1024 * 1024;  // in bytes
+private:
+    auto GetScaledMask(const ScaledMaskKey& key, const DRCS& drcs) -> ScaledMask*;
+    static std::vector<uint8_t> UnpackDRCS(const DRCS& drcs);
+    static std::vector<uint8_t> ScaleNearest(const uint8_t* src, int src_width, int src_height,
+                                             int target_width, int target_height);
+    static std::vector<uint8_t> ScaleAreaAverage(const uint8_t* src, int src_width, int src_height,
+                                                 int target_width, int target_height);
 public:
     DRCSRenderer(const DRCSRenderer&) = delete;
     DRCSRenderer& operator=(const DRCSRenderer&) = delete;
+private:
+    StrokeMode stroke_mode_ = StrokeMode::kOutline;
+    DRCSScaleMode scale_mode_ = DRCSScaleMode::kNearest;
+
+    // DRCS patterns unpacked into 8-bit coverage, in original size
+    LRUCache<PatternKey, std::vector<uint8_t>, PatternKeyHash> pattern_cache_;
+    LRUCache<ScaledMaskKey, ScaledMask, ScaledMaskKeyHash> scaled_mask_cache_;
 };
 
 }  // namespace aribcaption
@@ -61,6 +61,9 @@ public:
 public:
     virtual FontProviderType GetType() = 0;
     virtual bool Initialize() = 0;
+
+    // Start loading font configuration on a background thread, only for providers loading it lazily
+    virtual void WarmUpAsync() {}
     virtual void SetLanguage(uint32_t iso6392_language_code) = 0;
     virtual Result<FontfaceInfo, FontProviderError> GetFontFace(const std::string& font_name,
                                                                 std::optional<uint32_t> ucs4) = 0;
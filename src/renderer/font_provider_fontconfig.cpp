@@ -17,12 +17,40 @@
  */
 
 #include <cassert>
+#include <mutex>
 #include "base/language_code.hpp"
 #include "base/scoped_holder.hpp"
 #include "renderer/font_provider_fontconfig.hpp"
 
 namespace aribcaption {
 
+namespace {
+
+std::mutex shared_config_mutex;
+std::weak_ptr<FcConfig> shared_config;
+
+// Building a FcConfig scans all the font directories, which is expensive on systems with large font sets.
+// Share one configuration among all providers in the process, it will be released with the last provider.
+std::shared_ptr<FcConfig> AcquireSharedConfig() {
+    std::lock_guard<std::mutex> lock(shared_config_mutex);
+
+    std::shared_ptr<FcConfig> config = shared_config.lock();
+    if (config) {
+        return config;
+    }
+
+    FcConfig* fc_config = FcInitLoadConfigAndFonts();
+    if (!fc_config) {
+        return nullptr;
+    }
+
+    config = std::shared_ptr<FcConfig>(fc_config, FcConfigDestroy);
+    shared_config = config;
+    return config;
+}
+
+}  // namespace
+
 FontProviderFontconfig::FontProviderFontconfig(Context& context) :
       log_(GetContextLogger(context)) {}
 
@@ -33,12 +61,32 @@ FontProviderType FontProviderFontconfig::GetType() {
 }
 
 bool FontProviderFontconfig::Initialize() {
-    FcConfig* config = nullptr;
-    if (!(config = FcInitLoadConfigAndFonts())) {
+    // Fontconfig configuration will be loaded on demand, see EnsureConfig()
+    return true;
+}
+
+void FontProviderFontconfig::WarmUpAsync() {
+    if (config_ || pending_config_.valid()) {
+        return;
+    }
+    pending_config_ = std::async(std::launch::async, AcquireSharedConfig);
+}
+
+bool FontProviderFontconfig::EnsureConfig() {
+    if (config_) {
+        return true;
+    }
+
+    if (pending_config_.valid()) {
+        config_ = pending_config_.get();
+    } else {
+        config_ = AcquireSharedConfig();
+    }
+
+    if (!config_) {
         log_->e("Fontconfig: FcInitLoadConfigAndFonts() failed");
         return false;
     }
-    config_ = ScopedHolder<FcConfig*>(config, FcConfigDestroy);
     return true;
 }
 
@@ -48,7 +96,50 @@ void FontProviderFontconfig::SetLanguage(uint32_t iso6392_language_code) {
 
 auto FontProviderFontconfig::GetFontFace(const std::string& font_name,
                                          std::optional<uint32_t> ucs4) -> Result<FontfaceInfo, FontProviderError> {
-    assert(config_);
+    if (!EnsureConfig()) {
+        return Err(FontProviderError::kOtherError);
+    }
+
+    if (match_cache_config_ != config_.get()) {
+        // Font configuration has been changed, previous matches are no longer reliable
+        InvalidateMatchCache();
+    }
+
+    MatchCacheKey key(font_name, iso6392_language_code_);
+    auto iter = match_cache_.find(key);
+    if (iter == match_cache_.end()) {
+        iter = match_cache_.emplace(std::move(key), MatchFontFace(font_name)).first;
+    }
+
+    const MatchCacheEntry& entry = iter->second;
+    if (entry.error) {
+        return Err(entry.error.value());
+    }
+
+    if (ucs4.has_value() && ucs4 != 0) {
+        if (!entry.charset) {
+            log_->e("Fontconfig: Retrieve font charset failed for %s", font_name.c_str());
+            return Err(FontProviderError::kOtherError);
+        }
+
+        if (FcTrue != FcCharSetHasChar(entry.charset, ucs4.value())) {
+            log_->w("Fontconfig: Font %s doesn't contain U+%04X", font_name.c_str(), ucs4.value());
+            return Err(FontProviderError::kCodePointNotFound);
+        }
+    }
+
+    FontfaceInfo info;
+    info.family_name = entry.family_name;
+    info.postscript_name = entry.postscript_name;
+    info.filename = entry.filename;
+    info.face_index = entry.face_index;
+    info.provider_type = FontProviderType::kFontconfig;
+
+    return Ok(std::move(info));
+}
+
+auto FontProviderFontconfig::MatchFontFace(const std::string& font_name) -> MatchCacheEntry {
+    MatchCacheEntry entry;
 
     ScopedHolder<FcPattern*> pattern(
         FcNameParse(reinterpret_cast<const FcChar8*>(font_name.c_str())),
@@ -56,15 +147,17 @@ auto FontProviderFontconfig::GetFontFace(const std::string& font_name,
     );
     if (!pattern) {
         log_->e("Fontconfig: Cannot parse font pattern string");
-        return Err(FontProviderError::kFontNotFound);
+        entry.error = FontProviderError::kFontNotFound;
+        return entry;
     }
 
     FcPatternAddString(pattern, FC_FAMILY, reinterpret_cast<const FcChar8*>(font_name.c_str()));
     FcPatternAddBool(pattern, FC_OUTLINE, FcTrue);
 
-    if (FcTrue != FcConfigSubstitute(config_, pattern, FcMatchPattern)) {
+    if (FcTrue != FcConfigSubstitute(config_.get(), pattern, FcMatchPattern)) {
         log_->e("Fontconfig: Substitution cannot be performed");
-        return Err(FontProviderError::kOtherError);
+        entry.error = FontProviderError::kOtherError;
+        return entry;
     }
     FcDefaultSubstitute(pattern);
 
@@ -77,10 +170,11 @@ auto FontProviderFontconfig::GetFontFace(const std::string& font_name,
     }
 
     FcResult result = FcResultMatch;
-    FcPattern* matched = FcFontMatch(config_, pattern, &result);
+    FcPattern* matched = FcFontMatch(config_.get(), pattern, &result);
     if (!matched || result != FcResultMatch) {
         log_->w("Fontconfig: Cannot find a suitable font for %s", font_name.c_str());
-        return Err(FontProviderError::kFontNotFound);
+        entry.error = FontProviderError::kFontNotFound;
+        return entry;
     }
 
     ScopedHolder<FcPattern*> best(matched, FcPatternDestroy);
@@ -88,49 +182,48 @@ auto FontProviderFontconfig::GetFontFace(const std::string& font_name,
     FcChar8* filename = nullptr;
     if (FcResultMatch != FcPatternGetString(best, FC_FILE, 0, &filename)) {
         log_->e("Fontconfig: Retrieve font filename failed for %s", font_name.c_str());
-        return Err(FontProviderError::kOtherError);
+        entry.error = FontProviderError::kOtherError;
+        return entry;
     }
 
     int fc_index = 0;
     if (FcResultMatch != FcPatternGetInteger(best, FC_INDEX, 0, &fc_index)) {
         log_->e("Fontconfig: Retrieve font FC_INDEX failed for %s", font_name.c_str());
-        return Err(FontProviderError::kOtherError);
-    }
-
-    if (ucs4.has_value() && ucs4 != 0) {
-        FcCharSet* charset = nullptr;
-
-        if (FcResultMatch != FcPatternGetCharSet(best, FC_CHARSET, 0, &charset)) {
-            log_->e("Fontconfig: Retrieve font charset failed for %s", font_name.c_str());
-            return Err(FontProviderError::kOtherError);
-        }
-
-        if (FcTrue != FcCharSetHasChar(charset, ucs4.value())) {
-            log_->w("Fontconfig: Font %s doesn't contain U+%04X", font_name.c_str(), ucs4.value());
-            return Err(FontProviderError::kCodePointNotFound);
-        }
+        entry.error = FontProviderError::kOtherError;
+        return entry;
     }
 
     FcChar8* fc_family_name = nullptr;
     if (FcResultMatch != FcPatternGetString(best, FC_FAMILY, 0, &fc_family_name)) {
         log_->e("Fontconfig: Retrieve font FC_FAMILY failed for %s", font_name.c_str());
-        return Err(FontProviderError::kOtherError);
+        entry.error = FontProviderError::kOtherError;
+        return entry;
     }
 
     FcChar8* fc_postscript_name = nullptr;
     if (FcResultMatch != FcPatternGetString(best, FC_POSTSCRIPT_NAME, 0, &fc_postscript_name)) {
         log_->e("Fontconfig: Retrieve font FC_POSTSCRIPT_NAME failed for %s", font_name.c_str());
-        return Err(FontProviderError::kOtherError);
+        entry.error = FontProviderError::kOtherError;
+        return entry;
     }
 
-    FontfaceInfo info;
-    info.family_name = reinterpret_cast<char*>(fc_family_name);
-    info.postscript_name = reinterpret_cast<char*>(fc_postscript_name);
-    info.filename = reinterpret_cast<char*>(filename);
-    info.face_index = fc_index;
-    info.provider_type = FontProviderType::kFontconfig;
+    // Charset is owned by the matched pattern, hold our own reference for later coverage checks
+    FcCharSet* charset = nullptr;
+    if (FcResultMatch == FcPatternGetCharSet(best, FC_CHARSET, 0, &charset)) {
+        entry.charset = ScopedHolder<FcCharSet*>(FcCharSetCopy(charset), FcCharSetDestroy);
+    }
 
-    return Ok(std::move(info));
+    entry.family_name = reinterpret_cast<char*>(fc_family_name);
+    entry.postscript_name = reinterpret_cast<char*>(fc_postscript_name);
+    entry.filename = reinterpret_cast<char*>(filename);
+    entry.face_index = fc_index;
+
+    return entry;
+}
+
+void FontProviderFontconfig::InvalidateMatchCache() {
+    match_cache_.clear();
+    match_cache_config_ = config_.get();
 }
 
 }  // namespace aribcaption
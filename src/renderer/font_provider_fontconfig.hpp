@@ -21,8 +21,12 @@
 
 #include <fontconfig/fontconfig.h>
 #include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 #include "aribcaption/context.hpp"
 #include "base/logger.hpp"
@@ -37,15 +41,48 @@ public:
     ~FontProviderFontconfig() override;
 public:
     FontProviderType GetType() override;
+    /**
+     * Fontconfig configuration is not loaded here but on the first GetFontFace() call (or by WarmUpAsync()),
+     * so this function always succeeds. A failure of loading the configuration is logged and reported
+     * by GetFontFace() as kOtherError instead.
+     */
     bool Initialize() override;
     void SetLanguage(uint32_t iso6392_language_code) override;
     Result<FontfaceInfo, FontProviderError> GetFontFace(const std::string& font_name,
                                                         std::optional<uint32_t> ucs4) override;
+
+    /**
+     * Start loading the shared Fontconfig configuration on a background thread.
+     * Otherwise the configuration is loaded on the first GetFontFace() call.
+     */
+    void WarmUpAsync() override;
+private:
+    // Result of a single FcFontMatch() call, kept together with the charset of the matched font
+    // so that subsequent codepoint coverage checks could be answered without asking Fontconfig again
+    struct MatchCacheEntry {
+        std::optional<FontProviderError> error;
+        std::string family_name;
+        std::string postscript_name;
+        std::string filename;
+        int face_index = 0;
+        ScopedHolder<FcCharSet*> charset;
+    };
+    using MatchCacheKey = std::pair<std::string, uint32_t>;  // Pair<font_name, iso6392_language_code>
+private:
+    bool EnsureConfig();
+    auto MatchFontFace(const std::string& font_name) -> MatchCacheEntry;
+    void InvalidateMatchCache();
 private:
     std::shared_ptr<Logger> log_;
 
-    ScopedHolder<FcConfig*> config_;
+    // Process-wide FcConfig shared among all instances, loaded lazily
+    std::shared_ptr<FcConfig> config_;
+    std::future<std::shared_ptr<FcConfig>> pending_config_;
     uint32_t iso6392_language_code_ = 0;
+
+    // Font match cache, only valid for the FcConfig which it was built from
+    FcConfig* match_cache_config_ = nullptr;
+    std::map<MatchCacheKey, MatchCacheEntry> match_cache_;
 };
 
 }  // namespace aribcaption
@@ -0,0 +1,116 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cstring>
+#include "renderer/glyph_atlas.hpp"
+
+namespace aribcaption {
+
+GlyphAtlas::GlyphAtlas(int width, int height) : bitmap_(width, height, PixelFormat::kRGBA8888) {}
+
+auto GlyphAtlas::Find(const std::string& key) const -> const Cell* {
+    auto iter = cells_.find(key);
+    if (iter == cells_.end()) {
+        return nullptr;
+    }
+    return &iter->second;
+}
+
+auto GlyphAtlas::Insert(std::string key, const Bitmap& bitmap, const Rect& rect,
+                        int offset_x, int offset_y) -> const Cell* {
+    Cell cell;
+    cell.offset_x = offset_x;
+    cell.offset_y = offset_y;
+
+    if (rect.width() > 0 && rect.height() > 0) {
+        if (!Allocate(rect.width(), rect.height(), cell.rect)) {
+            return nullptr;
+        }
+        for (int y = 0; y < rect.height(); y++) {
+            memcpy(bitmap_.GetPixelAt(cell.rect.left, cell.rect.top + y),
+                   bitmap.GetPixelAt(rect.left, rect.top + y),
+                   static_cast<size_t>(rect.width()) * sizeof(ColorRGBA));
+        }
+        pending_updates_.push_back(cell.rect);
+    }
+
+    auto [iter, inserted] = cells_.insert_or_assign(std::move(key), cell);
+    return &iter->second;
+}
+
+bool GlyphAtlas::Allocate(int width, int height, Rect& out_rect) {
+    int padded_width = width + kGutter;
+    int padded_height = height + kGutter;
+    if (padded_width > bitmap_.width() || padded_height > bitmap_.height()) {
+        return false;
+    }
+
+    // Use the first shelf that fits without wasting more than a quarter of its height
+    for (Shelf& shelf : shelves_) {
+        if (padded_height <= shelf.height && padded_height * 4 >= shelf.height * 3 &&
+            shelf.used_width + padded_width <= bitmap_.width()) {
+            out_rect = Rect(shelf.used_width, shelf.top, shelf.used_width + width, shelf.top + height);
+            shelf.used_width += padded_width;
+            return true;
+        }
+    }
+
+    if (used_height_ + padded_height > bitmap_.height()) {
+        return false;
+    }
+
+    Shelf& shelf = shelves_.emplace_back();
+    shelf.top = used_height_;
+    shelf.height = padded_height;
+    shelf.used_width = padded_width;
+    used_height_ += padded_height;
+
+    out_rect = Rect(0, shelf.top, width, shelf.top + height);
+    return true;
+}
+
+void GlyphAtlas::Clear() {
+    memset(bitmap_.data(), 0, bitmap_.size());
+    shelves_.clear();
+    used_height_ = 0;
+    cells_.clear();
+    pending_updates_.clear();
+    generation_++;
+}
+
+std::vector<Image> GlyphAtlas::TakeUpdates() {
+    std::vector<Image> updates;
+    updates.reserve(pending_updates_.size());
+
+    for (const Rect& rect : pending_updates_) {
+        Image image = Bitmap::ToImage(bitmap_.Crop(rect));
+        image.dst_x = rect.left;
+        image.dst_y = rect.top;
+        updates.push_back(std::move(image));
+    }
+
+    pending_updates_.clear();
+    return updates;
+}
+
+Image GlyphAtlas::Snapshot() const {
+    return Bitmap::ToImage(Bitmap(bitmap_));
+}
+
+}  // namespace aribcaption
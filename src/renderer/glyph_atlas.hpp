@@ -0,0 +1,113 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_GLYPH_ATLAS_HPP
+#define ARIBCAPTION_GLYPH_ATLAS_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "aribcaption/image.hpp"
+#include "renderer/bitmap.hpp"
+#include "renderer/rect.hpp"
+
+namespace aribcaption {
+
+/**
+ * RGBA atlas of rasterized glyph cells, packed into shelves and looked up by key
+ *
+ * Cells are never moved or removed individually, the atlas is cleared as a whole once it runs out of room.
+ * Cells inserted since the last TakeUpdates() call are reported, so that a copy of the atlas (e.g. a GPU texture)
+ * could be updated incrementally.
+ */
+class GlyphAtlas {
+public:
+    struct Cell {
+        Rect rect;         // Position inside the atlas, empty for cells without any visible pixel
+        int offset_x = 0;  // Offset of the cell from the origin it was rasterized against
+        int offset_y = 0;
+    };
+public:
+    GlyphAtlas(int width, int height);
+    ~GlyphAtlas() = default;
+public:
+    [[nodiscard]]
+    const Cell* Find(const std::string& key) const;
+
+    /**
+     * Copy rect of bitmap into the atlas, an empty rect records a cell without visible pixels
+     * @return nullptr if there is no room left
+     */
+    const Cell* Insert(std::string key, const Bitmap& bitmap, const Rect& rect, int offset_x, int offset_y);
+
+    /**
+     * Drop all cells, generation is bumped
+     */
+    void Clear();
+
+    /**
+     * Take cells inserted since the previous call, as images with dst_x / dst_y in atlas coordinates
+     */
+    std::vector<Image> TakeUpdates();
+
+    /**
+     * Copy the whole atlas into an image
+     */
+    [[nodiscard]]
+    Image Snapshot() const;
+
+    [[nodiscard]]
+    int width() const { return bitmap_.width(); }
+
+    [[nodiscard]]
+    int height() const { return bitmap_.height(); }
+
+    [[nodiscard]]
+    size_t memory_size() const { return bitmap_.size(); }
+
+    [[nodiscard]]
+    uint64_t generation() const { return generation_; }
+private:
+    bool Allocate(int width, int height, Rect& out_rect);
+private:
+    // Cells are separated by a transparent gutter, so that bilinear sampling won't bleed into neighbors
+    static constexpr int kGutter = 1;
+
+    struct Shelf {
+        int top = 0;
+        int height = 0;
+        int used_width = 0;
+    };
+
+    Bitmap bitmap_;
+    std::vector<Shelf> shelves_;
+    int used_height_ = 0;
+    uint64_t generation_ = 1;
+
+    std::unordered_map<std::string, Cell> cells_;
+    std::vector<Rect> pending_updates_;
+public:
+    GlyphAtlas(const GlyphAtlas&) = delete;
+    GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+};
+
+}  // namespace aribcaption
+
+#endif  // ARIBCAPTION_GLYPH_ATLAS_HPP
@@ -16,8 +16,11 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <cstdlib>
 #include "aribcaption/aligned_alloc.hpp"
 #include "aribcaption/image.h"
+#include "aribcaption/image.hpp"
+#include "renderer/yuv_blend.hpp"
 
 using namespace aribcaption;
 
@@ -29,6 +32,31 @@ void aribcc_image_cleanup(aribcc_image_t* image) {
         image->bitmap = nullptr;
         image->bitmap_size = 0;
     }
+    if (image->palette) {
+        free(image->palette);
+        image->palette = nullptr;
+        image->palette_size = 0;
+    }
+}
+
+bool aribcc_image_blend_to_yuv_frame(const aribcc_image_t* image, const aribcc_yuv_frame_t* frame) {
+    if (image->pixel_format != ARIBCC_PIXELFORMAT_RGBA8888 || !image->bitmap) {
+        return false;
+    }
+
+    YUVFrame yuv_frame;
+    yuv_frame.format = static_cast<YUVFormat>(frame->format);
+    yuv_frame.color_matrix = static_cast<YUVColorMatrix>(frame->color_matrix);
+    yuv_frame.color_range = static_cast<YUVColorRange>(frame->color_range);
+    yuv_frame.width = frame->width;
+    yuv_frame.height = frame->height;
+    for (int i = 0; i < 3; i++) {
+        yuv_frame.planes[i] = frame->planes[i];
+        yuv_frame.strides[i] = frame->strides[i];
+    }
+
+    return yuvblend::BlendRGBAToYUVFrame(image->bitmap, image->width, image->height, image->stride,
+                                         image->dst_x, image->dst_y, yuv_frame);
 }
 
 }  // extern "C"
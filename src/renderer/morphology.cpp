@@ -0,0 +1,182 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include "base/always_inline.hpp"
+#include "renderer/morphology.hpp"
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    #include <emmintrin.h>  // SSE2
+    #if defined(__SSE2__) || defined(_MSC_VER)
+        #define ARIBCC_MORPHOLOGY_SSE2
+    #endif
+#endif
+
+namespace aribcaption::morphology {
+
+namespace {
+
+// dest[i] = max(dest[i], src[i])
+ALWAYS_INLINE void MaxLine(uint8_t* __restrict dest, const uint8_t* __restrict src, size_t width) {
+    size_t i = 0;
+#if defined(ARIBCC_MORPHOLOGY_SSE2)
+    for (; i + 16 <= width; i += 16) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_max_epu8(d, s));
+    }
+#endif
+    for (; i < width; i++) {
+        dest[i] = std::max(dest[i], src[i]);
+    }
+}
+
+// dest[i] = max(src[i - 1], src[i], src[i + 1]), out-of-range neighbors are ignored
+ALWAYS_INLINE void MaxLine3(uint8_t* __restrict dest, const uint8_t* __restrict src, size_t width) {
+    if (width < 2) {
+        if (width == 1) {
+            dest[0] = src[0];
+        }
+        return;
+    }
+
+    dest[0] = std::max(src[0], src[1]);
+
+    size_t i = 1;
+#if defined(ARIBCC_MORPHOLOGY_SSE2)
+    for (; i + 17 <= width; i += 16) {
+        __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i - 1));
+        __m128i center = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_max_epu8(_mm_max_epu8(left, center), right));
+    }
+#endif
+    for (; i + 1 < width; i++) {
+        dest[i] = std::max({src[i - 1], src[i], src[i + 1]});
+    }
+
+    dest[width - 1] = std::max(src[width - 2], src[width - 1]);
+}
+
+// dest[i] = lo[i] + (hi[i] - lo[i]) * fraction / 256, hi[i] >= lo[i]
+// dest may alias with lo / hi
+ALWAYS_INLINE void LerpLine(uint8_t* dest, const uint8_t* lo, const uint8_t* hi, uint32_t fraction, size_t width) {
+    for (size_t i = 0; i < width; i++) {
+        dest[i] = static_cast<uint8_t>(lo[i] + (((hi[i] - lo[i]) * fraction) >> 8));
+    }
+}
+
+// Half-widths of a disk of integer radius for each row offset in [-radius, radius]
+// A point (dx, dy) is inside the disk if dx^2 + dy^2 <= (radius + 0.5)^2
+std::vector<int> GetDiskHalfWidths(int radius) {
+    std::vector<int> half_widths(static_cast<size_t>(radius) * 2 + 1);
+    float r = static_cast<float>(radius) + 0.5f;
+    for (int dy = -radius; dy <= radius; dy++) {
+        auto w = static_cast<int>(std::floor(std::sqrt(r * r - static_cast<float>(dy * dy))));
+        half_widths[dy + radius] = std::min(w, radius);
+    }
+    return half_widths;
+}
+
+// Vertical pass: for each output row, take max of the horizontal runs matching the disk's width
+void DilateVertical(const std::vector<uint8_t>& runs, int src_height, int padded_width, int padding,
+                    int radius, uint8_t* out) {
+    const size_t run_size = static_cast<size_t>(src_height) * padded_width;
+    const std::vector<int> half_widths = GetDiskHalfWidths(radius);
+    const int padded_height = src_height + padding * 2;
+
+    for (int oy = 0; oy < padded_height; oy++) {
+        uint8_t* dest = out + static_cast<size_t>(oy) * padded_width;
+        std::memset(dest, 0, padded_width);
+
+        int center_y = oy - padding;
+        for (int dy = -radius; dy <= radius; dy++) {
+            int y = center_y + dy;
+            if (y < 0 || y >= src_height) {
+                continue;
+            }
+            const uint8_t* run = runs.data() + run_size * half_widths[dy + radius] +
+                                 static_cast<size_t>(y) * padded_width;
+            MaxLine(dest, run, padded_width);
+        }
+    }
+}
+
+}  // namespace
+
+int GetDilationPadding(float radius) {
+    if (radius <= 0.0f) {
+        return 0;
+    }
+    return static_cast<int>(std::ceil(radius));
+}
+
+AlphaMask DilateMask(const uint8_t* src, int width, int height, int pitch, float radius) {
+    assert(width >= 0 && height >= 0);
+
+    const int padding = GetDilationPadding(radius);
+    const int padded_width = width + padding * 2;
+    const int padded_height = height + padding * 2;
+
+    AlphaMask mask;
+    mask.width = padded_width;
+    mask.height = padded_height;
+    mask.alphas.resize(static_cast<size_t>(padded_width) * padded_height);
+
+    if (width == 0 || height == 0) {
+        return mask;
+    }
+
+    // Horizontal pass: runs[w] holds the max over [x - w, x + w] for w in [0, padding]
+    const size_t run_size = static_cast<size_t>(height) * padded_width;
+    std::vector<uint8_t> runs(run_size * (padding + 1));
+
+    for (int y = 0; y < height; y++) {
+        std::memcpy(&runs[static_cast<size_t>(y) * padded_width + padding],
+                    src + static_cast<ptrdiff_t>(y) * pitch,
+                    width);
+    }
+    for (int w = 1; w <= padding; w++) {
+        const uint8_t* prev = runs.data() + run_size * (w - 1);
+        uint8_t* curr = runs.data() + run_size * w;
+        for (int y = 0; y < height; y++) {
+            size_t offset = static_cast<size_t>(y) * padded_width;
+            MaxLine3(curr + offset, prev + offset, padded_width);
+        }
+    }
+
+    const int lower_radius = static_cast<int>(std::floor(std::max(radius, 0.0f)));
+    const auto fraction = static_cast<uint32_t>(std::lround((radius - static_cast<float>(lower_radius)) * 256.0f));
+
+    DilateVertical(runs, height, padded_width, padding, padding, mask.alphas.data());
+
+    if (lower_radius != padding && fraction < 256) {
+        // Anti-alias the outermost ring for fractional radius
+        std::vector<uint8_t> lower(mask.alphas.size());
+        DilateVertical(runs, height, padded_width, padding, lower_radius, lower.data());
+        LerpLine(mask.alphas.data(), lower.data(), mask.alphas.data(), fraction, mask.alphas.size());
+    }
+
+    return mask;
+}
+
+}  // namespace aribcaption::morphology
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_MORPHOLOGY_HPP
+#define ARIBCAPTION_MORPHOLOGY_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace aribcaption::morphology {
+
+/**
+ * 8-bit coverage (alpha) mask, rows are tightly packed
+ */
+struct AlphaMask {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> alphas;
+};
+
+/**
+ * Padding added to each side of the mask by DilateMask(), i.e. ceil(radius)
+ */
+int GetDilationPadding(float radius);
+
+/**
+ * Grow a coverage mask by a disk-shaped kernel, used for generating stroke borders
+ *
+ * The disk is applied as separable max-filters: horizontal runs for every half-width needed,
+ * then a vertical pass picking the run matching the disk's width at each row offset.
+ * Fractional radius is anti-aliased by interpolating between the two nearest integer radii.
+ *
+ * The returned mask is GetDilationPadding(radius) pixels larger than the source on each side.
+ */
+AlphaMask DilateMask(const uint8_t* src, int width, int height, int pitch, float radius);
+
+}  // namespace aribcaption::morphology
+
+#endif  // ARIBCAPTION_MORPHOLOGY_HPP
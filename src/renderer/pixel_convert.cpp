@@ -0,0 +1,267 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "renderer/alphablend.hpp"
+#include "renderer/pixel_convert.hpp"
+
+namespace aribcaption::pixelconv {
+
+namespace {
+
+constexpr size_t kMaxPaletteSize = 256;
+constexpr uint32_t kMaxIndexShift = 4;
+
+ALWAYS_INLINE ColorRGBA SwapRB(ColorRGBA color) {
+    return {color.b, color.g, color.r, color.a};
+}
+
+ALWAYS_INLINE ColorRGBA Premultiply(ColorRGBA color) {
+    uint32_t a = color.a;
+    return {static_cast<uint8_t>(alphablend::Div255(color.r * a)),
+            static_cast<uint8_t>(alphablend::Div255(color.g * a)),
+            static_cast<uint8_t>(alphablend::Div255(color.b * a)),
+            color.a};
+}
+
+Image MakeImage(const Image& src, PixelFormat format, int bytes_per_pixel) {
+    Image image;
+    image.width = src.width;
+    image.height = src.height;
+    image.dst_x = src.dst_x;
+    image.dst_y = src.dst_y;
+    image.content_id = src.content_id;
+    image.changed = src.changed;
+    image.pixel_format = format;
+
+    image.stride = src.width * bytes_per_pixel;
+    if (int remainder = image.stride % static_cast<int>(Image::kAlignedTo)) {
+        image.stride += static_cast<int>(Image::kAlignedTo) - remainder;
+    }
+    image.bitmap.resize(static_cast<size_t>(image.stride) * image.height);
+
+    return image;
+}
+
+ALWAYS_INLINE const ColorRGBA* GetLine(const Image& image, int y) {
+    return reinterpret_cast<const ColorRGBA*>(image.bitmap.data() + static_cast<size_t>(y) * image.stride);
+}
+
+// Index colors of the images against one shared palette by bins of the color channels truncated by shift bits,
+// each bin becomes one palette entry holding its mean color. With shift = 0 the palette consists of the exact colors.
+// Returns false if there are too many bins, unless allow_nearest is true: in that case only the most frequent
+// bins get their own entries, and the rest are mapped to the nearest entry, compared in premultiplied space.
+// Bins containing one of preferred colors are kept first, with that exact color as their entry.
+bool IndexColors(const std::vector<const Image*>& srcs, std::vector<Image>& dests,
+                 const std::unordered_set<uint32_t>& preferred, uint32_t shift, bool allow_nearest) {
+    struct Bin {
+        uint32_t count = 0;
+        uint32_t sum[4] = {0, 0, 0, 0};
+        uint8_t index = 0;
+        bool preferred = false;
+        ColorRGBA preferred_color;
+    };
+
+    auto bin_of = [shift](ColorRGBA color) -> uint32_t {
+        uint32_t mask = (0xFFu >> shift) * 0x01010101u;
+        return (color.u32 >> shift) & mask;
+    };
+
+    std::unordered_map<uint32_t, Bin> bins;
+    std::vector<uint32_t> used_bins;
+
+    for (const Image* src : srcs) {
+        for (int y = 0; y < src->height; y++) {
+            const ColorRGBA* line = GetLine(*src, y);
+            for (int x = 0; x < src->width; x++) {
+                ColorRGBA color = line[x];
+                if (color.a == 0) {
+                    continue;
+                }
+                uint32_t key = bin_of(color);
+                Bin& bin = bins[key];
+                if (bin.count++ == 0) {
+                    if (used_bins.size() >= kMaxPaletteSize - 1 && !allow_nearest) {
+                        return false;
+                    }
+                    used_bins.push_back(key);
+                }
+                if (!bin.preferred && !preferred.empty() && preferred.count(color.u32)) {
+                    bin.preferred = true;
+                    bin.preferred_color = color;
+                }
+                bin.sum[0] += color.r;
+                bin.sum[1] += color.g;
+                bin.sum[2] += color.b;
+                bin.sum[3] += color.a;
+            }
+        }
+    }
+
+    auto entry_of = [](const Bin& bin) -> ColorRGBA {
+        if (bin.preferred) {
+            return bin.preferred_color;
+        }
+        return {static_cast<uint8_t>((bin.sum[0] + bin.count / 2) / bin.count),
+                static_cast<uint8_t>((bin.sum[1] + bin.count / 2) / bin.count),
+                static_cast<uint8_t>((bin.sum[2] + bin.count / 2) / bin.count),
+                static_cast<uint8_t>((bin.sum[3] + bin.count / 2) / bin.count)};
+    };
+
+    size_t entry_count = std::min(used_bins.size(), kMaxPaletteSize - 1);
+    if (entry_count < used_bins.size()) {
+        std::partial_sort(used_bins.begin(), used_bins.begin() + static_cast<ptrdiff_t>(entry_count), used_bins.end(),
+                          [&bins](uint32_t lhs, uint32_t rhs) {
+                              const Bin& l = bins[lhs];
+                              const Bin& r = bins[rhs];
+                              if (l.preferred != r.preferred) {
+                                  return l.preferred;
+                              }
+                              return l.count > r.count;
+                          });
+    }
+
+    std::vector<ColorRGBA> palette(1, ColorRGBA(0));
+    for (size_t i = 0; i < entry_count; i++) {
+        Bin& bin = bins[used_bins[i]];
+        bin.index = static_cast<uint8_t>(palette.size());
+        palette.push_back(entry_of(bin));
+    }
+
+    auto distance = [](ColorRGBA lhs, ColorRGBA rhs) -> uint32_t {
+        ColorRGBA l = Premultiply(lhs);
+        ColorRGBA r = Premultiply(rhs);
+        int dr = l.r - r.r;
+        int dg = l.g - r.g;
+        int db = l.b - r.b;
+        int da = l.a - r.a;
+        return static_cast<uint32_t>(dr * dr + dg * dg + db * db + da * da);
+    };
+
+    for (size_t i = entry_count; i < used_bins.size(); i++) {
+        Bin& bin = bins[used_bins[i]];
+        ColorRGBA mean = entry_of(bin);
+        uint32_t best_distance = UINT32_MAX;
+        for (size_t index = 1; index < palette.size(); index++) {
+            uint32_t d = distance(mean, palette[index]);
+            if (d < best_distance) {
+                best_distance = d;
+                bin.index = static_cast<uint8_t>(index);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < srcs.size(); i++) {
+        const Image& src = *srcs[i];
+        Image& dest = dests[i];
+        dest.palette = palette;
+        for (int y = 0; y < src.height; y++) {
+            const ColorRGBA* line = GetLine(src, y);
+            uint8_t* out = dest.bitmap.data() + static_cast<size_t>(y) * dest.stride;
+            for (int x = 0; x < src.width; x++) {
+                out[x] = line[x].a ? bins[bin_of(line[x])].index : 0;
+            }
+        }
+    }
+
+    return true;
+}
+
+}  // namespace
+
+bool IsPackedFormat(PixelFormat format) {
+    return format == PixelFormat::kRGBA8888 ||
+           format == PixelFormat::kBGRA8888 ||
+           format == PixelFormat::kRGBA8888Premultiplied ||
+           format == PixelFormat::kBGRA8888Premultiplied;
+}
+
+void ConvertLine(ColorRGBA* dest, const ColorRGBA* src, size_t width, PixelFormat format) {
+    switch (format) {
+        case PixelFormat::kBGRA8888:
+            for (size_t i = 0; i < width; i++) {
+                dest[i] = SwapRB(src[i]);
+            }
+            break;
+        case PixelFormat::kRGBA8888Premultiplied:
+            for (size_t i = 0; i < width; i++) {
+                dest[i] = Premultiply(src[i]);
+            }
+            break;
+        case PixelFormat::kBGRA8888Premultiplied:
+            for (size_t i = 0; i < width; i++) {
+                dest[i] = SwapRB(Premultiply(src[i]));
+            }
+            break;
+        default:
+            if (dest != src) {
+                std::copy(src, src + width, dest);
+            }
+            break;
+    }
+}
+
+Image ConvertImage(const Image& image, PixelFormat format) {
+    if (format == PixelFormat::kRGBA8888 || image.bitmap.empty()) {
+        Image copy = image;
+        copy.pixel_format = format;
+        return copy;
+    }
+
+    if (format == PixelFormat::kIndexed8) {
+        std::vector<Image> indexed = IndexImages({&image}, {});
+        return std::move(indexed[0]);
+    }
+
+    Image converted = MakeImage(image, format, 4);
+    for (int y = 0; y < image.height; y++) {
+        auto dest = reinterpret_cast<ColorRGBA*>(converted.bitmap.data() + static_cast<size_t>(y) * converted.stride);
+        ConvertLine(dest, GetLine(image, y), static_cast<size_t>(image.width), format);
+    }
+    return converted;
+}
+
+std::vector<Image> IndexImages(const std::vector<const Image*>& images, const std::vector<ColorRGBA>& preferred_colors) {
+    std::vector<Image> indexed;
+    indexed.reserve(images.size());
+    for (const Image* image : images) {
+        indexed.push_back(MakeImage(*image, PixelFormat::kIndexed8, 1));
+    }
+
+    std::unordered_set<uint32_t> preferred;
+    for (ColorRGBA color : preferred_colors) {
+        if (color.a) {
+            preferred.insert(color.u32);
+        }
+    }
+
+    // Try exact colors first, then coarser bins until they fit into the palette
+    for (uint32_t shift = 0; shift <= kMaxIndexShift; shift++) {
+        if (IndexColors(images, indexed, preferred, shift, shift == kMaxIndexShift)) {
+            break;
+        }
+    }
+    return indexed;
+}
+
+}  // namespace aribcaption::pixelconv
@@ -0,0 +1,59 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_PIXEL_CONVERT_HPP
+#define ARIBCAPTION_PIXEL_CONVERT_HPP
+
+#include <cstddef>
+#include <vector>
+#include "aribcaption/color.hpp"
+#include "aribcaption/image.hpp"
+
+namespace aribcaption::pixelconv {
+
+/**
+ * Whether the pixel format has 32 bits per pixel, i.e. not indexed
+ */
+bool IsPackedFormat(PixelFormat format);
+
+/**
+ * Convert a line of RGBA8888 pixels into a 32-bit pixel format, dest and src may be the same
+ */
+void ConvertLine(ColorRGBA* dest, const ColorRGBA* src, size_t width, PixelFormat format);
+
+/**
+ * Convert a RGBA8888 image into indicated pixel format, position and content ID are kept
+ *
+ * kIndexed8 uses the exact colors of the image if there are no more than 255 of them (plus the transparent
+ * entry 0), otherwise mean colors of the finest per-channel histogram that fits. At 4 bits per channel only
+ * the 255 most frequent bins are kept, and the remaining pixels are mapped to the nearest entry.
+ */
+Image ConvertImage(const Image& image, PixelFormat format);
+
+/**
+ * Convert RGBA8888 images into kIndexed8 images sharing one palette, quantized the same way as ConvertImage()
+ *
+ * Opaque or translucent colors listed in preferred_colors keep exact palette entries and take precedence
+ * over more frequent colors if the palette runs out of entries. Every returned image holds a copy of the palette.
+ */
+std::vector<Image> IndexImages(const std::vector<const Image*>& images, const std::vector<ColorRGBA>& preferred_colors);
+
+}  // namespace aribcaption::pixelconv
+
+#endif  // ARIBCAPTION_PIXEL_CONVERT_HPP
@@ -18,12 +18,68 @@
  */
 
 #include <cassert>
+#include <type_traits>
 #include "renderer/bitmap.hpp"
 #include "renderer/canvas.hpp"
+#include "renderer/glyph_atlas.hpp"
 #include "renderer/region_renderer.hpp"
 
 namespace aribcaption {
 
+namespace {
+
+template <typename T>
+void AppendKeyField(std::string& key, const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void AppendKeyField(std::string& key, const std::string& value) {
+    AppendKeyField(key, value.size());
+    key.append(value);
+}
+
+// Passes rects to a fill function, e.g. Canvas::ClearRect(), consecutive rects of the same color
+// which extend each other horizontally or vertically are coalesced into one span
+class SpanFiller {
+public:
+    explicit SpanFiller(const RegionRenderer::FillFunction& fill) : fill_(fill) {}
+    ~SpanFiller() { Flush(); }
+
+    void Fill(ColorRGBA color, const Rect& rect) {
+        if (pending_ && color.u32 == color_.u32) {
+            if (rect.top == rect_.top && rect.bottom == rect_.bottom && rect.left == rect_.right) {
+                rect_.right = rect.right;
+                return;
+            } else if (rect.left == rect_.left && rect.right == rect_.right && rect.top == rect_.bottom) {
+                rect_.bottom = rect.bottom;
+                return;
+            }
+        }
+        Flush();
+        color_ = color;
+        rect_ = rect;
+        pending_ = true;
+    }
+
+    void Flush() {
+        if (pending_) {
+            fill_(color_, rect_);
+            pending_ = false;
+        }
+    }
+public:
+    SpanFiller(const SpanFiller&) = delete;
+    SpanFiller& operator=(const SpanFiller&) = delete;
+private:
+    const RegionRenderer::FillFunction& fill_;
+    bool pending_ = false;
+    ColorRGBA color_;
+    Rect rect_;
+};
+
+}  // namespace
+
 RegionRenderer::RegionRenderer(Context& context) : context_(context), log_(GetContextLogger(context)) {}
 
 bool RegionRenderer::Initialize(FontProviderType font_provider_type, TextRendererType text_renderer_type) {
@@ -40,14 +96,21 @@ bool RegionRenderer::Initialize(FontProviderType font_provider_type, TextRendere
     return true;
 }
 
+void RegionRenderer::WarmUpFontProvider() {
+    assert(font_provider_);
+    font_provider_->WarmUpAsync();
+}
+
 void RegionRenderer::SetFontLanguage(uint32_t iso6392_language_code) {
     assert(font_provider_ && text_renderer_);
     font_provider_->SetLanguage(iso6392_language_code);
     text_renderer_->SetLanguage(iso6392_language_code);
+    font_language_code_ = iso6392_language_code;
 }
 
 bool RegionRenderer::SetFontFamily(const std::vector<std::string>& font_family) {
     assert(text_renderer_);
+    font_family_ = font_family;
     return text_renderer_->SetFontFamily(font_family);
 }
 
@@ -82,6 +145,18 @@ void RegionRenderer::SetStrokeWidth(float dots) {
     }
 }
 
+void RegionRenderer::SetStrokeMode(StrokeMode mode) {
+    assert(text_renderer_);
+    text_renderer_->SetStrokeMode(mode);
+    drcs_renderer_.SetStrokeMode(mode);
+    stroke_mode_ = mode;
+}
+
+void RegionRenderer::SetDRCSScaleMode(DRCSScaleMode mode) {
+    drcs_renderer_.SetScaleMode(mode);
+    drcs_scale_mode_ = mode;
+}
+
 void RegionRenderer::SetReplaceDRCS(bool replace) {
     replace_drcs_ = replace;
 }
@@ -94,26 +169,42 @@ void RegionRenderer::SetForceNoBackground(bool force_no_background) {
     force_no_background_ = force_no_background;
 }
 
+void RegionRenderer::SetCropToContent(bool crop) {
+    crop_to_content_ = crop;
+}
+
+void RegionRenderer::CopySettingsFrom(const RegionRenderer& other) {
+    SetStrokeWidth(other.stroke_width_);
+    SetStrokeMode(other.stroke_mode_);
+    SetDRCSScaleMode(other.drcs_scale_mode_);
+    SetReplaceDRCS(other.replace_drcs_);
+    SetForceStrokeText(other.force_stroke_text_);
+    SetForceNoBackground(other.force_no_background_);
+    SetCropToContent(other.crop_to_content_);
+}
+
 auto RegionRenderer::RenderCaptionRegion(const CaptionRegion& region,
                                          const std::unordered_map<uint32_t, DRCS>& drcs_map)
                                          -> Result<Image, RegionRenderError> {
-    assert(text_renderer_ && plane_inited_ && caption_area_inited_);
+    return RenderRegionLayout(LayoutCaptionRegion(region), drcs_map);
+}
 
-    size_t char_count = region.chars.size();
-    size_t succeed = 0;
-    bool has_font_not_found_error = false;
-    bool has_codepoint_not_found_error = false;
-    [[maybe_unused]] bool has_other_error = false;
+RegionLayout RegionRenderer::LayoutCaptionRegion(const CaptionRegion& region) const {
+    assert(plane_inited_ && caption_area_inited_);
+
+    RegionLayout layout;
+    layout.char_count = region.chars.size();
 
     if (ScaleWidth(region.width, region.x) < 3 || ScaleHeight(region.height, region.y) < 3) {
-        return Err(RegionRenderError::kImageTooSmall);
+        return layout;  // Too small, leave it empty
     }
 
-    Bitmap bitmap(ScaleWidth(region.width, region.x),
-                  ScaleHeight(region.height, region.y),
-                  PixelFormat::kRGBA8888);
-    Canvas canvas(bitmap);
-    TextRenderContext text_render_ctx = text_renderer_->BeginDraw(bitmap);
+    layout.width = ScaleWidth(region.width, region.x);
+    layout.height = ScaleHeight(region.height, region.y);
+    layout.dst_x = caption_area_start_x_ + ScaleX(region.x);
+    layout.dst_y = caption_area_start_y_ + ScaleY(region.y);
+    layout.stroke_width = stroke_width_ * x_magnification_;
+    layout.chars.reserve(region.chars.size());
 
     for (const CaptionChar& ch : region.chars) {
         int section_x = ScaleX(ch.x) - ScaleX(region.x);
@@ -126,174 +217,441 @@ auto RegionRenderer::RenderCaptionRegion(const CaptionRegion& region,
             continue;  // Too small, skip
         }
 
-        // Draw background if not disabled
-        if (!force_no_background_) {
-            canvas.ClearRect(ch.back_color, section_rect);
-        }
+        CharLayout& char_layout = layout.chars.emplace_back();
+        char_layout.type = ch.type;
+        char_layout.codepoint = ch.codepoint;
+        char_layout.pua_codepoint = ch.pua_codepoint;
+        char_layout.drcs_code = ch.drcs_code;
+        char_layout.section_rect = section_rect;
+        char_layout.char_x = ScaleX((float)(ch.x - region.x) + (float)ch.char_horizontal_spacing * ch.char_horizontal_scale / 2);
+        char_layout.char_y = ScaleY((float)(ch.y - region.y) + (float)ch.char_vertical_spacing * ch.char_vertical_scale / 2);
+        char_layout.char_width = ScaleWidth((float)ch.char_width * ch.char_horizontal_scale);
+        char_layout.char_height = ScaleHeight((float)ch.char_height * ch.char_vertical_scale);
+        char_layout.draw_glyph = char_layout.char_width >= 2 && char_layout.char_height >= 2;
+        char_layout.style = ch.style;
+        char_layout.enclosure_style = ch.enclosure_style;
+        char_layout.text_color = ch.text_color;
+        char_layout.back_color = ch.back_color;
+        char_layout.stroke_color = ch.stroke_color;
 
-        // Draw enclosure if needed
-        if (ch.enclosure_style) {
-            int w = std::max(ScaleX(1), 1);  // use floor
-            int h = std::max(ScaleY(1), 1);  // use floor
-            if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleTop) {
-                canvas.ClearRect(ch.text_color,
-                                 Rect(section_rect.left,
-                                      section_rect.top,
-                                      section_rect.right,
-                                      section_rect.top + h));
-            }
-            if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleBottom) {
-                canvas.ClearRect(ch.text_color,
-                                 Rect(section_rect.left,
-                                      section_rect.bottom - h,
-                                      section_rect.right,
-                                      section_rect.bottom));
-            }
-            if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleLeft) {
-                canvas.ClearRect(ch.text_color,
-                                 Rect(section_rect.left,
-                                      section_rect.top,
-                                      section_rect.left + w,
-                                      section_rect.bottom));
-            }
-            if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleRight) {
-                canvas.ClearRect(ch.text_color,
-                                 Rect(section_rect.right - w,
-                                      section_rect.top,
-                                      section_rect.right,
-                                      section_rect.bottom));
-            }
+        if (force_stroke_text_ && !(ch.style & CharStyle::kCharStyleStroke)) {
+            char_layout.style = static_cast<CharStyle>(ch.style | CharStyle::kCharStyleStroke);
+            // Use background color for stroke text when forcing stroke text
+            char_layout.stroke_color = ch.back_color;
         }
+    }
 
-        int char_x = ScaleX((float)(ch.x - region.x) + (float)ch.char_horizontal_spacing * ch.char_horizontal_scale / 2);
-        int char_y = ScaleY((float)(ch.y - region.y) + (float)ch.char_vertical_spacing * ch.char_vertical_scale / 2);
-        int char_width = ScaleWidth((float)ch.char_width * ch.char_horizontal_scale);
-        int char_height = ScaleHeight((float)ch.char_height * ch.char_vertical_scale);
+    return layout;
+}
 
-        if (char_width < 2 || char_height < 2) {
+auto RegionRenderer::RenderRegionLayout(const RegionLayout& layout,
+                                        const std::unordered_map<uint32_t, DRCS>& drcs_map)
+                                        -> Result<Image, RegionRenderError> {
+    assert(text_renderer_);
+
+    size_t succeed = 0;
+    DrawCharErrors errors;
+
+    if (layout.empty()) {
+        return Err(RegionRenderError::kImageTooSmall);
+    }
+
+    Bitmap bitmap(layout.width, layout.height, PixelFormat::kRGBA8888);
+    Canvas canvas(bitmap);
+    TextRenderContext text_render_ctx = text_renderer_->BeginDraw(bitmap);
+
+    DrawSectionBackgrounds(layout, [&canvas](ColorRGBA color, const Rect& rect) {
+        canvas.ClearRect(color, rect);
+    });
+
+    for (const CharLayout& ch : layout.chars) {
+        if (!ch.draw_glyph) {
             continue;  // Too small, skip
         }
 
-        CaptionCharType type = ch.type;
-        CharStyle style = ch.style;
-        ColorRGBA stroke_color = ch.stroke_color;
-        float stroke_width = stroke_width_ * x_magnification_;
-        UnderlineInfo underline_info{section_rect.left, section_rect.width()};
+        if (DrawCharGlyph(text_render_ctx, bitmap, ch, 0, 0, layout.stroke_width, drcs_map, errors)) {
+            succeed++;
+        }
+    }
 
-        if (force_stroke_text_ && !(ch.style & CharStyle::kCharStyleStroke)) {
-            style = static_cast<CharStyle>(ch.style | CharStyle::kCharStyleStroke);
-            // Use background color for stroke text when forcing stroke text
-            stroke_color = ch.back_color;
+    text_renderer_->EndDraw(text_render_ctx);
+
+    // If there's no successfully rendered char, return RegionRenderError
+    if (layout.char_count > 0 && succeed == 0) {
+        if (errors.font_not_found) {
+            return Err(RegionRenderError::kFontNotFound);
+        } else if (errors.codepoint_not_found) {
+            return Err(RegionRenderError::kCodePointNotFound);
+        } else {
+            return Err(RegionRenderError::kOtherError);
+        }
+    }
+
+    int dst_x = layout.dst_x;
+    int dst_y = layout.dst_y;
+
+    if (crop_to_content_) {
+        Rect content_rect = bitmap.GetContentRect();
+        if (content_rect.width() <= 0 || content_rect.height() <= 0) {
+            return Err(RegionRenderError::kImageTooSmall);  // Nothing visible
         }
+        if (content_rect != bitmap.GetRect()) {
+            bitmap = bitmap.Crop(content_rect);
+            dst_x += content_rect.left;
+            dst_y += content_rect.top;
+        }
+    }
+
+    Image image = Bitmap::ToImage(std::move(bitmap));
+    image.dst_x = dst_x;
+    image.dst_y = dst_y;
+
+    return Ok(std::move(image));
+}
+
+auto RegionRenderer::RenderRegionQuads(const RegionLayout& layout,
+                                       const std::unordered_map<uint32_t, DRCS>& drcs_map,
+                                       GlyphAtlas& atlas,
+                                       std::vector<RenderQuad>& out_quads) -> Result<size_t, RegionRenderError> {
+    assert(text_renderer_);
+
+    size_t succeed = 0;
+    DrawCharErrors errors;
+
+    if (layout.empty()) {
+        return Err(RegionRenderError::kImageTooSmall);
+    }
 
-        // Draw char
-        if (type == CaptionCharType::kText) {
-            // Do automatic fallback rendering by default.
-            TextRenderFallbackPolicy fallback_policy = TextRenderFallbackPolicy::kAutoFallback;
-            if (ch.pua_codepoint) {
-                // If ch contains an alternative PUA codepoint, it should be an additional symbol (gaiji)
-                // Manually fallback to PUA(Private Use Area) codepoint on failure
-                fallback_policy = TextRenderFallbackPolicy::kFailOnCodePointNotFound;
+    size_t quad_count = out_quads.size();
+    Rect region_rect(0, 0, layout.width, layout.height);
+
+    // Quads are clipped into the region, as if they were drawn into the region image
+    auto append_quad = [&](const Rect& rect, int src_x, int src_y, ColorRGBA color, bool solid) {
+        Rect clipped = Rect::ClipRect(region_rect, rect);
+        if (clipped.width() <= 0 || clipped.height() <= 0) {
+            return;
+        }
+        RenderQuad& quad = out_quads.emplace_back();
+        quad.dst = RenderRect{layout.dst_x + clipped.left, layout.dst_y + clipped.top,
+                              clipped.width(), clipped.height()};
+        if (!solid) {
+            quad.src = RenderRect{src_x + clipped.left - rect.left, src_y + clipped.top - rect.top,
+                                  clipped.width(), clipped.height()};
+        }
+        quad.color = color;
+        quad.solid = solid;
+    };
+
+    DrawSectionBackgrounds(layout, [&append_quad](ColorRGBA color, const Rect& rect) {
+        append_quad(rect, 0, 0, color, true);
+    });
+
+    std::string key;
+
+    for (const CharLayout& ch : layout.chars) {
+        if (!ch.draw_glyph) {
+            continue;  // Too small, skip
+        }
+
+        // Leave room for strokes and glyphs overflowing the char box, and the underline spanning the section
+        int padding = static_cast<int>(std::ceil(layout.stroke_width)) + std::max(ch.char_width, ch.char_height) / 4;
+        Rect cell_rect(ch.char_x - padding,
+                       ch.char_y - padding,
+                       ch.char_x + ch.char_width + padding,
+                       ch.char_y + ch.char_height + padding);
+        if (ch.style & CharStyle::kCharStyleUnderline) {
+            cell_rect = Rect(std::min(cell_rect.left, ch.section_rect.left),
+                             std::min(cell_rect.top, ch.section_rect.top),
+                             std::max(cell_rect.right, ch.section_rect.right),
+                             std::max(cell_rect.bottom, ch.section_rect.bottom));
+        }
+
+        MakeGlyphCellKey(key, ch, cell_rect, layout.stroke_width, drcs_map);
+
+        const GlyphAtlas::Cell* cell = atlas.Find(key);
+        if (!cell) {
+            Bitmap bitmap(cell_rect.width(), cell_rect.height(), PixelFormat::kRGBA8888);
+            TextRenderContext text_render_ctx = text_renderer_->BeginDraw(bitmap);
+            bool drawn = DrawCharGlyph(text_render_ctx, bitmap, ch, cell_rect.left, cell_rect.top,
+                                       layout.stroke_width, drcs_map, errors);
+            text_renderer_->EndDraw(text_render_ctx);
+            if (!drawn) {
+                continue;  // Failed chars are not cached, so that errors will be reported again
+            }
+
+            Rect content_rect = bitmap.GetContentRect();
+            cell = atlas.Insert(key, bitmap, content_rect,
+                                cell_rect.left - ch.char_x + content_rect.left,
+                                cell_rect.top - ch.char_y + content_rect.top);
+            if (!cell) {
+                out_quads.resize(quad_count);
+                return Err(RegionRenderError::kAtlasFull);
             }
-            TextRenderStatus status = text_renderer_->DrawChar(text_render_ctx, char_x, char_y,
-                                                               ch.codepoint, style, ch.text_color, stroke_color,
-                                                               stroke_width, char_width, char_height,
-                                                               underline_info, fallback_policy);
-            if (status == TextRenderStatus::kOK) {
-                succeed++;
-            } else if (status == TextRenderStatus::kCodePointNotFound && ch.pua_codepoint) {
-                // Additional symbol (gaiji)'s Unicode codepoint not found in font
-                // Try fallback rendering with pua_codepoint
-                status = text_renderer_->DrawChar(text_render_ctx, char_x, char_y,
-                                                  ch.pua_codepoint, style, ch.text_color, stroke_color,
+        }
+
+        succeed++;
+        if (cell->rect.width() > 0 && cell->rect.height() > 0) {
+            Rect dst(ch.char_x + cell->offset_x,
+                     ch.char_y + cell->offset_y,
+                     ch.char_x + cell->offset_x + cell->rect.width(),
+                     ch.char_y + cell->offset_y + cell->rect.height());
+            append_quad(dst, cell->rect.left, cell->rect.top, ColorRGBA(255, 255, 255, 255), false);
+        }
+    }
+
+    // If there's no successfully rendered char, return RegionRenderError
+    if (layout.char_count > 0 && succeed == 0) {
+        out_quads.resize(quad_count);
+        if (errors.font_not_found) {
+            return Err(RegionRenderError::kFontNotFound);
+        } else if (errors.codepoint_not_found) {
+            return Err(RegionRenderError::kCodePointNotFound);
+        } else {
+            return Err(RegionRenderError::kOtherError);
+        }
+    }
+
+    return Ok(out_quads.size() - quad_count);
+}
+
+void RegionRenderer::MakeGlyphCellKey(std::string& key, const CharLayout& ch, const Rect& cell_rect,
+                                      float stroke_width, const std::unordered_map<uint32_t, DRCS>& drcs_map) const {
+    key.clear();
+
+    // Everything affecting the rasterized glyph, positions are relative to the char box
+    AppendKeyField(key, font_language_code_);
+    AppendKeyField(key, font_family_.size());
+    for (const std::string& family : font_family_) {
+        AppendKeyField(key, family);
+    }
+    AppendKeyField(key, replace_drcs_);
+    AppendKeyField(key, stroke_width);
+    AppendKeyField(key, ch.type);
+    AppendKeyField(key, ch.codepoint);
+    AppendKeyField(key, ch.pua_codepoint);
+    AppendKeyField(key, ch.style);
+    AppendKeyField(key, ch.text_color);
+    AppendKeyField(key, ch.stroke_color);
+    AppendKeyField(key, ch.char_width);
+    AppendKeyField(key, ch.char_height);
+    AppendKeyField(key, Rect(cell_rect.left - ch.char_x, cell_rect.top - ch.char_y,
+                             cell_rect.right - ch.char_x, cell_rect.bottom - ch.char_y));
+    AppendKeyField(key, Rect(ch.section_rect.left - ch.char_x, ch.section_rect.top - ch.char_y,
+                             ch.section_rect.right - ch.char_x, ch.section_rect.bottom - ch.char_y));
+
+    if (ch.type != CaptionCharType::kDRCS && ch.type != CaptionCharType::kDRCSReplaced) {
+        return;
+    }
+
+    // DRCS codes are only meaningful within a caption, identify the pattern by its content
+    auto iter = drcs_map.find(ch.drcs_code);
+    if (iter == drcs_map.end()) {
+        AppendKeyField(key, int{-1});
+        return;
+    }
+
+    const DRCS& drcs = iter->second;
+    AppendKeyField(key, drcs.width);
+    AppendKeyField(key, drcs.height);
+    AppendKeyField(key, drcs.depth);
+    if (!drcs.md5.empty()) {
+        AppendKeyField(key, drcs.md5);
+    } else {
+        AppendKeyField(key, drcs.pixels.size());
+        key.append(reinterpret_cast<const char*>(drcs.pixels.data()), drcs.pixels.size());
+    }
+}
+
+bool RegionRenderer::DrawCharGlyph(TextRenderContext& ctx, Bitmap& bitmap, const CharLayout& ch,
+                                   int offset_x, int offset_y, float stroke_width,
+                                   const std::unordered_map<uint32_t, DRCS>& drcs_map, DrawCharErrors& errors) {
+    bool succeed = false;
+    CaptionCharType type = ch.type;
+    CharStyle style = ch.style;
+    ColorRGBA stroke_color = ch.stroke_color;
+    UnderlineInfo underline_info{ch.section_rect.left - offset_x, ch.section_rect.width()};
+    int char_x = ch.char_x - offset_x;
+    int char_y = ch.char_y - offset_y;
+    int char_width = ch.char_width;
+    int char_height = ch.char_height;
+
+    // Draw char
+    if (type == CaptionCharType::kText) {
+        // Do automatic fallback rendering by default.
+        TextRenderFallbackPolicy fallback_policy = TextRenderFallbackPolicy::kAutoFallback;
+        if (ch.pua_codepoint) {
+            // If ch contains an alternative PUA codepoint, it should be an additional symbol (gaiji)
+            // Manually fallback to PUA(Private Use Area) codepoint on failure
+            fallback_policy = TextRenderFallbackPolicy::kFailOnCodePointNotFound;
+        }
+        TextRenderStatus status = text_renderer_->DrawChar(ctx, char_x, char_y,
+                                                           ch.codepoint, style, ch.text_color, stroke_color,
+                                                           stroke_width, char_width, char_height,
+                                                           underline_info, fallback_policy);
+        if (status == TextRenderStatus::kOK) {
+            succeed = true;
+        } else if (status == TextRenderStatus::kCodePointNotFound && ch.pua_codepoint) {
+            // Additional symbol (gaiji)'s Unicode codepoint not found in font
+            // Try fallback rendering with pua_codepoint
+            status = text_renderer_->DrawChar(ctx, char_x, char_y,
+                                              ch.pua_codepoint, style, ch.text_color, stroke_color,
+                                              stroke_width, char_width, char_height,
+                                              underline_info, TextRenderFallbackPolicy::kAutoFallback);
+            if (status == TextRenderStatus::kCodePointNotFound) {
+                // If failed, try fallback rendering with Unicode codepoint again
+                status = text_renderer_->DrawChar(ctx, char_x, char_y,
+                                                  ch.codepoint, style, ch.text_color, stroke_color,
                                                   stroke_width, char_width, char_height,
                                                   underline_info, TextRenderFallbackPolicy::kAutoFallback);
-                if (status == TextRenderStatus::kCodePointNotFound) {
-                    // If failed, try fallback rendering with Unicode codepoint again
-                    status = text_renderer_->DrawChar(text_render_ctx, char_x, char_y,
-                                                      ch.codepoint, style, ch.text_color, stroke_color,
-                                                      stroke_width, char_width, char_height,
-                                                      underline_info, TextRenderFallbackPolicy::kAutoFallback);
-                }
             }
+        }
 
-            if (status != TextRenderStatus::kOK){
+        if (status != TextRenderStatus::kOK){
+            log_->e("RegionRenderer: TextRenderer::DrawChar() returned error: %d", static_cast<int>(status));
+            if (status == TextRenderStatus::kFontNotFound) {
+                errors.font_not_found = true;
+            } else if (status == TextRenderStatus::kCodePointNotFound) {
+                errors.codepoint_not_found = true;
+            } else if (status == TextRenderStatus::kOtherError) {
+                errors.other = true;
+            }
+        }
+    } else if (replace_drcs_ && type == CaptionCharType::kDRCSReplaced) {
+        // Draw replaced DRCS (alternative ucs4)
+        TextRenderStatus status = text_renderer_->DrawChar(ctx, char_x, char_y,
+                                                           ch.codepoint, style, ch.text_color, stroke_color,
+                                                           stroke_width, char_width, char_height,
+                                                           underline_info, TextRenderFallbackPolicy::kAutoFallback);
+        if (status == TextRenderStatus::kOK) {
+            succeed = true;
+        } else {
+            if (status == TextRenderStatus::kCodePointNotFound) {
+                log_->w("RegionRenderer: Cannot find alternative codepoint U+%04X, fallback to DRCS rendering",
+                        ch.codepoint);
+                errors.codepoint_not_found = true;
+            } else {
                 log_->e("RegionRenderer: TextRenderer::DrawChar() returned error: %d", static_cast<int>(status));
                 if (status == TextRenderStatus::kFontNotFound) {
-                    has_font_not_found_error = true;
-                } else if (status == TextRenderStatus::kCodePointNotFound) {
-                    has_codepoint_not_found_error = true;
+                    errors.font_not_found = true;
                 } else if (status == TextRenderStatus::kOtherError) {
-                    has_other_error = true;
+                    errors.other = true;
                 }
             }
-        } else if (replace_drcs_ && type == CaptionCharType::kDRCSReplaced) {
-            // Draw replaced DRCS (alternative ucs4)
-            TextRenderStatus status = text_renderer_->DrawChar(text_render_ctx, char_x, char_y,
-                                                               ch.codepoint, style, ch.text_color, stroke_color,
-                                                               stroke_width, char_width, char_height,
-                                                               underline_info, TextRenderFallbackPolicy::kAutoFallback);
-            if (status == TextRenderStatus::kOK) {
-                succeed++;
-            } else {
-                if (status == TextRenderStatus::kCodePointNotFound) {
-                    log_->w("RegionRenderer: Cannot find alternative codepoint U+%04X, fallback to DRCS rendering",
-                            ch.codepoint);
-                    has_codepoint_not_found_error = true;
-                } else {
-                    log_->e("RegionRenderer: TextRenderer::DrawChar() returned error: %d", static_cast<int>(status));
-                    if (status == TextRenderStatus::kFontNotFound) {
-                        has_font_not_found_error = true;
-                    } else if (status == TextRenderStatus::kOtherError) {
-                        has_other_error = true;
-                    }
-                }
-                // Fallback to DRCS rendering
-                type = CaptionCharType::kDRCS;
-            }
-        } else if (!replace_drcs_) {
-            // if DRCS replacement is disabled, force fallback to DRCS rendering
+            // Fallback to DRCS rendering
             type = CaptionCharType::kDRCS;
         }
+    } else if (!replace_drcs_) {
+        // if DRCS replacement is disabled, force fallback to DRCS rendering
+        type = CaptionCharType::kDRCS;
+    }
 
-        // Draw DRCS
-        if (type == CaptionCharType::kDRCS) {
-            auto iter = drcs_map.find(ch.drcs_code);
-            if (iter != drcs_map.end()) {
-                const DRCS& drcs = iter->second;
-                bool ret = drcs_renderer_.DrawDRCS(drcs, style, ch.text_color, stroke_color,
-                                                   static_cast<int>(stroke_width),
-                                                   char_width, char_height, bitmap, char_x, char_y);
-                if (ret) {
-                    succeed++;
-                } else {
-                    log_->e("RegionRenderer: drcs_renderer_.DrawDRCS() returned error");
-                }
+    // Draw DRCS
+    if (type == CaptionCharType::kDRCS) {
+        auto iter = drcs_map.find(ch.drcs_code);
+        if (iter != drcs_map.end()) {
+            const DRCS& drcs = iter->second;
+            bool ret = drcs_renderer_.DrawDRCS(drcs, style, ch.text_color, stroke_color,
+                                               stroke_width,
+                                               char_width, char_height, bitmap, char_x, char_y);
+            if (ret) {
+                succeed = true;
             } else {
-                // DRCS not found in drcs_map
-                log_->e("RegionRenderer: Missing DRCS for drcs_code %u", ch.drcs_code);
+                log_->e("RegionRenderer: drcs_renderer_.DrawDRCS() returned error");
             }
+        } else {
+            // DRCS not found in drcs_map
+            log_->e("RegionRenderer: Missing DRCS for drcs_code %u", ch.drcs_code);
         }
     }
 
-    text_renderer_->EndDraw(text_render_ctx);
+    return succeed;
+}
 
-    // If there's no successfully rendered char, return RegionRenderError
-    if (char_count > 0 && succeed == 0) {
-        if (has_font_not_found_error) {
-            return Err(RegionRenderError::kFontNotFound);
-        } else if (has_codepoint_not_found_error) {
-            return Err(RegionRenderError::kCodePointNotFound);
-        } else {
-            return Err(RegionRenderError::kOtherError);
+void RegionRenderer::DrawSectionBackgrounds(const RegionLayout& layout, const FillFunction& fill) {
+    // Sections never overlap, so drawing all backgrounds before all enclosures gives the same result
+    // as drawing them char by char, while runs of identical sections are filled at once.
+    //
+    // Note that this is called before any glyph is drawn. Strokes or glyphs overflowing their own section
+    // are therefore drawn on top of the neighbouring sections' backgrounds, instead of being covered by them
+    // as they were when backgrounds and glyphs were drawn char by char.
+    if (!force_no_background_) {
+        SpanFiller background(fill);
+        for (const CharLayout& ch : layout.chars) {
+            background.Fill(ch.back_color, ch.section_rect);
         }
     }
 
-    Image image = Bitmap::ToImage(std::move(bitmap));
-    image.dst_x = caption_area_start_x_ + ScaleX(region.x);
-    image.dst_y = caption_area_start_y_ + ScaleY(region.y);
+    SpanFiller top(fill);
+    SpanFiller bottom(fill);
+    SpanFiller left(fill);
+    SpanFiller right(fill);
+    int w = std::max(ScaleX(1), 1);  // use floor
+    int h = std::max(ScaleY(1), 1);  // use floor
 
-    return Ok(std::move(image));
+    for (const CharLayout& ch : layout.chars) {
+        if (!ch.enclosure_style) {
+            continue;
+        }
+        const Rect& section_rect = ch.section_rect;
+        if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleTop) {
+            top.Fill(ch.text_color,
+                     Rect(section_rect.left,
+                          section_rect.top,
+                          section_rect.right,
+                          section_rect.top + h));
+        }
+        if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleBottom) {
+            bottom.Fill(ch.text_color,
+                        Rect(section_rect.left,
+                             section_rect.bottom - h,
+                             section_rect.right,
+                             section_rect.bottom));
+        }
+        if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleLeft) {
+            left.Fill(ch.text_color,
+                      Rect(section_rect.left,
+                           section_rect.top,
+                           section_rect.left + w,
+                           section_rect.bottom));
+        }
+        if (ch.enclosure_style & EnclosureStyle::kEnclosureStyleRight) {
+            right.Fill(ch.text_color,
+                       Rect(section_rect.right - w,
+                            section_rect.top,
+                            section_rect.right,
+                            section_rect.bottom));
+        }
+    }
+}
+
+bool RegionRenderer::PrewarmChar(uint32_t ucs4, int char_width, int char_height) {
+    assert(text_renderer_ && plane_inited_ && caption_area_inited_);
+
+    int scaled_char_width = ScaleWidth(char_width);
+    int scaled_char_height = ScaleHeight(char_height);
+    if (scaled_char_width < 2 || scaled_char_height < 2) {
+        return false;
+    }
+
+    // Stroke borders are cached by stroke width as well, warm them up if stroke text is forced
+    CharStyle style = CharStyle::kCharStyleDefault;
+    float stroke_width = 0.0f;
+    if (force_stroke_text_) {
+        style = CharStyle::kCharStyleStroke;
+        stroke_width = stroke_width_ * x_magnification_;
+    }
+
+    Bitmap bitmap(scaled_char_width, scaled_char_height, PixelFormat::kRGBA8888);
+    TextRenderContext text_render_ctx = text_renderer_->BeginDraw(bitmap);
+
+    TextRenderStatus status = text_renderer_->DrawChar(text_render_ctx, 0, 0,
+                                                       ucs4, style,
+                                                       ColorRGBA(255, 255, 255), ColorRGBA(),
+                                                       stroke_width, scaled_char_width, scaled_char_height,
+                                                       std::nullopt, TextRenderFallbackPolicy::kAutoFallback);
+    text_renderer_->EndDraw(text_render_ctx);
+
+    return status == TextRenderStatus::kOK;
 }
 
-}  // namespace aribcaption
\ No newline at end of file
+}  // namespace aribcaption
@@ -21,6 +21,7 @@
 #define ARIBCAPTION_REGION_RENDERER_HPP
 
 #include <cmath>
+#include <functional>
 #include <vector>
 #include <string>
 #include <memory>
@@ -28,8 +29,10 @@
 #include "aribcaption/caption.hpp"
 #include "aribcaption/context.hpp"
 #include "aribcaption/image.hpp"
+#include "aribcaption/renderer.hpp"
 #include "base/logger.hpp"
 #include "base/result.hpp"
+#include "renderer/canvas.hpp"
 #include "renderer/drcs_renderer.hpp"
 #include "renderer/font_provider.hpp"
 #include "renderer/rect.hpp"
@@ -42,9 +45,47 @@ enum class RegionRenderError {
     kCodePointNotFound,
     kImageTooSmall,
     kOtherError,
+    kAtlasFull,
 };
 
+// Char inside a RegionLayout, with geometry in region bitmap coordinates and resolved style / colors
+struct CharLayout {
+    CaptionCharType type = CaptionCharType::kText;
+    uint32_t codepoint = 0;
+    uint32_t pua_codepoint = 0;
+    uint32_t drcs_code = 0;
+    Rect section_rect;
+    int char_x = 0;
+    int char_y = 0;
+    int char_width = 0;
+    int char_height = 0;
+    bool draw_glyph = false;  // false if the glyph is too small to be drawn, background is still drawn
+    CharStyle style = CharStyle::kCharStyleDefault;
+    EnclosureStyle enclosure_style = EnclosureStyle::kEnclosureStyleNone;
+    ColorRGBA text_color;
+    ColorRGBA back_color;
+    ColorRGBA stroke_color;
+};
+
+// Region scaled into the target caption area, chars with too small sections are left out
+struct RegionLayout {
+    int width = 0;            // 0 if the region is too small to be rendered
+    int height = 0;
+    int dst_x = 0;
+    int dst_y = 0;
+    float stroke_width = 0.0f;
+    size_t char_count = 0;    // Char count of the original region
+    std::vector<CharLayout> chars;
+public:
+    [[nodiscard]]
+    bool empty() const { return width <= 0 || height <= 0; }
+};
+
+class GlyphAtlas;
+
 class RegionRenderer {
+public:
+    using FillFunction = std::function<void(ColorRGBA color, const Rect& rect)>;
 public:
     explicit RegionRenderer(Context& context);
     ~RegionRenderer() = default;
@@ -52,16 +93,60 @@ public:
     bool Initialize(FontProviderType font_provider_type = FontProviderType::kAuto,
                     TextRendererType text_renderer_type = TextRendererType::kAuto);
     void SetFontLanguage(uint32_t iso6392_language_code);
+    void WarmUpFontProvider();
     bool SetFontFamily(const std::vector<std::string>& font_family);
     void SetOriginalPlaneSize(int plane_width, int plane_height);
     void SetTargetCaptionAreaRect(const Rect& rect);
     void SetStrokeWidth(float dots);
+    void SetStrokeMode(StrokeMode mode);
+    void SetDRCSScaleMode(DRCSScaleMode mode);
     void SetReplaceDRCS(bool replace);
     void SetForceStrokeText(bool force_stroke);
     void SetForceNoBackground(bool force_no_background);
+    void SetCropToContent(bool crop);
+
+    // Copy rendering settings, but not the plane size / caption area / font language, from another RegionRenderer
+    void CopySettingsFrom(const RegionRenderer& other);
     auto RenderCaptionRegion(const CaptionRegion& region,
                              const std::unordered_map<uint32_t, DRCS>& drcs_map) -> Result<Image, RegionRenderError>;
+
+    // Resolve geometry and attributes of the region for the current plane size, caption area and settings
+    // The result stays valid until any of them changes
+    [[nodiscard]]
+    RegionLayout LayoutCaptionRegion(const CaptionRegion& region) const;
+
+    auto RenderRegionLayout(const RegionLayout& layout,
+                            const std::unordered_map<uint32_t, DRCS>& drcs_map) -> Result<Image, RegionRenderError>;
+
+    // Append quads of section backgrounds, enclosures and glyphs to out_quads, in drawing order
+    // Glyphs missing in the atlas are rasterized into it, kAtlasFull is returned if there's no room left
+    // Returns count of appended quads
+    auto RenderRegionQuads(const RegionLayout& layout,
+                           const std::unordered_map<uint32_t, DRCS>& drcs_map,
+                           GlyphAtlas& atlas,
+                           std::vector<RenderQuad>& out_quads) -> Result<size_t, RegionRenderError>;
+
+    // Render a character into a scratch bitmap for warming up the fonts and glyph caches
+    // char_width / char_height are in original plane dots
+    bool PrewarmChar(uint32_t ucs4, int char_width, int char_height);
 private:
+    struct DrawCharErrors {
+        bool font_not_found = false;
+        bool codepoint_not_found = false;
+        bool other = false;
+    };
+
+    // Fill backgrounds and enclosures of all sections, must be called before drawing glyphs
+    void DrawSectionBackgrounds(const RegionLayout& layout, const FillFunction& fill);
+
+    // Draw glyph of the char into bitmap, with the char box moved by -offset_x / -offset_y
+    bool DrawCharGlyph(TextRenderContext& ctx, Bitmap& bitmap, const CharLayout& ch,
+                       int offset_x, int offset_y, float stroke_width,
+                       const std::unordered_map<uint32_t, DRCS>& drcs_map, DrawCharErrors& errors);
+
+    void MakeGlyphCellKey(std::string& key, const CharLayout& ch, const Rect& cell_rect,
+                          float stroke_width, const std::unordered_map<uint32_t, DRCS>& drcs_map) const;
+
     template <typename T>
     [[nodiscard]]
     int ScaleX(T x) const {
@@ -107,9 +192,16 @@ private:
     int caption_area_height_ = 0;
 
     float stroke_width_ = 1.5f;
+    StrokeMode stroke_mode_ = StrokeMode::kOutline;
+    DRCSScaleMode drcs_scale_mode_ = DRCSScaleMode::kNearest;
     bool replace_drcs_ = true;
     bool force_stroke_text_ = false;
     bool force_no_background_ = false;
+    bool crop_to_content_ = false;
+
+    // Identify fonts in glyph atlas keys
+    uint32_t font_language_code_ = 0;
+    std::vector<std::string> font_family_;
 
     float x_magnification_ = 0.0f;
     float y_magnification_ = 0.0f;
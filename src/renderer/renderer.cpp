@@ -40,6 +40,14 @@ void Renderer::SetStrokeWidth(float dots) {
     pimpl_->SetStrokeWidth(dots);
 }
 
+void Renderer::SetStrokeMode(StrokeMode mode) {
+    pimpl_->SetStrokeMode(mode);
+}
+
+void Renderer::SetDRCSScaleMode(DRCSScaleMode mode) {
+    pimpl_->SetDRCSScaleMode(mode);
+}
+
 void Renderer::SetReplaceDRCS(bool replace) {
     pimpl_->SetReplaceDRCS(replace);
 }
@@ -60,6 +68,26 @@ void Renderer::SetMergeRegionImages(bool merge) {
     pimpl_->SetMergeRegionImages(merge);
 }
 
+void Renderer::SetRegionMergeMode(RegionMergeMode mode) {
+    pimpl_->SetRegionMergeMode(mode);
+}
+
+void Renderer::SetCropRegionImages(bool crop) {
+    pimpl_->SetCropRegionImages(crop);
+}
+
+void Renderer::SetPixelFormat(PixelFormat format) {
+    pimpl_->SetPixelFormat(format);
+}
+
+void Renderer::SetRenderOutputMode(RenderOutputMode mode) {
+    pimpl_->SetRenderOutputMode(mode);
+}
+
+bool Renderer::GetGlyphAtlas(GlyphAtlasUpdate& out_atlas) {
+    return pimpl_->GetGlyphAtlas(out_atlas);
+}
+
 bool Renderer::SetDefaultFontFamily(const std::vector<std::string>& font_family, bool force_default) {
     return pimpl_->SetDefaultFontFamily(font_family, force_default);
 }
@@ -88,14 +116,72 @@ bool Renderer::AppendCaption(Caption&& caption) {
     return pimpl_->AppendCaption(std::move(caption));
 }
 
+bool Renderer::AppendCaption(const void* data, size_t size) {
+    return pimpl_->AppendCaption(data, size);
+}
+
+bool Renderer::QueueCaption(Caption caption) {
+    return pimpl_->QueueCaption(std::move(caption));
+}
+
 RenderStatus Renderer::TryRender(int64_t pts) {
     return pimpl_->TryRender(pts);
 }
 
+int64_t Renderer::GetNextChangePts(int64_t pts) {
+    return pimpl_->GetNextChangePts(pts);
+}
+
+void Renderer::SetCaptionChangeCallback(CaptionChangeCallback callback) {
+    pimpl_->SetCaptionChangeCallback(std::move(callback));
+}
+
+void Renderer::SetCaptionQueueCallback(CaptionQueueCallback callback) {
+    pimpl_->SetCaptionQueueCallback(std::move(callback));
+}
+
 RenderStatus Renderer::Render(int64_t pts, RenderResult& out_result) {
     return pimpl_->Render(pts, out_result);
 }
 
+RenderStatus Renderer::RenderMulti(int64_t pts,
+                                   const std::vector<RenderTarget>& targets,
+                                   std::vector<RenderResult>& out_results) {
+    return pimpl_->RenderMulti(pts, targets, out_results);
+}
+
+RenderStatus Renderer::RenderAllChanges(int64_t pts_begin, int64_t pts_end, const RenderChangeCallback& callback) {
+    return pimpl_->RenderAllChanges(pts_begin, pts_end, callback);
+}
+
+RenderStatus Renderer::RenderInto(int64_t pts,
+                                  uint8_t* buffer,
+                                  int stride,
+                                  PixelFormat pixel_format,
+                                  RenderRect* dirty_rect_out) {
+    return pimpl_->RenderInto(pts, buffer, stride, pixel_format, dirty_rect_out);
+}
+
+void Renderer::WarmUpFonts() {
+    pimpl_->WarmUpFonts();
+}
+
+bool Renderer::PrewarmGlyphs(uint32_t language_code, PrewarmCharset charsets, int frame_width, int frame_height) {
+    return pimpl_->PrewarmGlyphs(language_code, charsets, frame_width, frame_height);
+}
+
+void Renderer::SetRegionCacheMemoryLimit(size_t bytes) {
+    pimpl_->SetRegionCacheMemoryLimit(bytes);
+}
+
+RegionCacheStatistics Renderer::GetRegionCacheStatistics() {
+    return pimpl_->GetRegionCacheStatistics();
+}
+
+StorageMemoryUsage Renderer::GetStorageMemoryUsage() {
+    return pimpl_->GetStorageMemoryUsage();
+}
+
 void Renderer::Flush() {
     pimpl_->Flush();
 }
@@ -21,57 +21,12 @@
 #include "aribcaption/aligned_alloc.hpp"
 #include "aribcaption/renderer.h"
 #include "aribcaption/renderer.hpp"
+#include "common/caption_capi.hpp"
 #include "renderer/renderer_impl.hpp"
 
 using namespace aribcaption;
 using namespace aribcaption::internal;
 
-static CaptionRegion ConstructCaptionRegionFromCAPI(const aribcc_caption_region_t* src) {
-    CaptionRegion region;
-    region.x = src->x;
-    region.y = src->y;
-    region.width = src->width;
-    region.height = src->height;
-    region.is_ruby = src->is_ruby;
-
-    if (src->chars) {
-        region.chars.resize(src->char_count);
-        memcpy(region.chars.data(), src->chars, src->char_count * sizeof(aribcc_caption_char_t));
-    }
-
-    return region;
-}
-
-static Caption ConstructCaptionFromCAPI(const aribcc_caption_t* src) {
-    Caption caption;
-    caption.type = static_cast<CaptionType>(src->type);
-    caption.flags = static_cast<CaptionFlags>(src->flags);
-    caption.iso6392_language_code = src->iso6392_language_code;
-    caption.pts = src->pts;
-    caption.wait_duration = src->wait_duration;
-    caption.plane_width = src->plane_width;
-    caption.plane_height = src->plane_height;
-    caption.has_builtin_sound = src->has_builtin_sound;
-    caption.builtin_sound_id = src->builtin_sound_id;
-
-    if (src->text) {
-        caption.text = src->text;
-    }
-
-    if (src->regions) {
-        for (uint32_t i = 0; i < src->region_count; i++) {
-            caption.regions.emplace_back(ConstructCaptionRegionFromCAPI(&src->regions[i]));
-        }
-    }
-
-    if (src->drcs_map) {
-        auto drcs_map = reinterpret_cast<std::unordered_map<uint32_t, DRCS>*>(src->drcs_map);
-        caption.drcs_map = *drcs_map;
-    }
-
-    return caption;
-}
-
 extern "C" {
 
 void aribcc_render_result_cleanup(aribcc_render_result_t* render_result) {
@@ -84,6 +39,19 @@ void aribcc_render_result_cleanup(aribcc_render_result_t* render_result) {
         render_result->images = nullptr;
         render_result->image_count = 0;
     }
+    if (render_result->quads) {
+        free(render_result->quads);
+        render_result->quads = nullptr;
+        render_result->quad_count = 0;
+    }
+    if (render_result->atlas_cells) {
+        for (uint32_t i = 0; i < render_result->atlas_cell_count; i++) {
+            aribcc_image_cleanup(&render_result->atlas_cells[i]);
+        }
+        free(render_result->atlas_cells);
+        render_result->atlas_cells = nullptr;
+        render_result->atlas_cell_count = 0;
+    }
 }
 
 aribcc_renderer_t* aribcc_renderer_alloc(aribcc_context_t* context) {
@@ -112,6 +80,16 @@ void aribcc_renderer_set_stroke_width(aribcc_renderer_t* renderer, float dots) {
     impl->SetStrokeWidth(dots);
 }
 
+void aribcc_renderer_set_stroke_mode(aribcc_renderer_t* renderer, aribcc_stroke_mode_t mode) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetStrokeMode(static_cast<StrokeMode>(mode));
+}
+
+void aribcc_renderer_set_drcs_scale_mode(aribcc_renderer_t* renderer, aribcc_drcs_scale_mode_t mode) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetDRCSScaleMode(static_cast<DRCSScaleMode>(mode));
+}
+
 void aribcc_renderer_set_replace_drcs(aribcc_renderer_t* renderer, bool replace) {
     auto impl = reinterpret_cast<RendererImpl*>(renderer);
     impl->SetReplaceDRCS(replace);
@@ -137,6 +115,26 @@ void aribcc_renderer_set_merge_region_images(aribcc_renderer_t* renderer, bool m
     impl->SetMergeRegionImages(merge);
 }
 
+void aribcc_renderer_set_region_merge_mode(aribcc_renderer_t* renderer, aribcc_region_merge_mode_t mode) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetRegionMergeMode(static_cast<RegionMergeMode>(mode));
+}
+
+void aribcc_renderer_set_crop_region_images(aribcc_renderer_t* renderer, bool crop) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetCropRegionImages(crop);
+}
+
+void aribcc_renderer_set_render_output_mode(aribcc_renderer_t* renderer, aribcc_render_output_mode_t mode) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetRenderOutputMode(static_cast<RenderOutputMode>(mode));
+}
+
+void aribcc_renderer_set_pixel_format(aribcc_renderer_t* renderer, aribcc_pixelformat_t format) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetPixelFormat(static_cast<PixelFormat>(format));
+}
+
 bool aribcc_renderer_set_default_font_family(aribcc_renderer_t* renderer,
                                              const char * const * font_family,
                                              size_t family_count,
@@ -190,6 +188,17 @@ bool aribcc_renderer_append_caption(aribcc_renderer_t* renderer, const aribcc_ca
     return impl->AppendCaption(std::move(cap));
 }
 
+bool aribcc_renderer_append_serialized_caption(aribcc_renderer_t* renderer, const void* data, size_t size) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    return impl->AppendCaption(data, size);
+}
+
+bool aribcc_renderer_queue_caption(aribcc_renderer_t* renderer, const aribcc_caption_t* caption) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    Caption cap = ConstructCaptionFromCAPI(caption);
+    return impl->QueueCaption(std::move(cap));
+}
+
 static void ConvertImageToCAPI(const Image& image, aribcc_image_t* out_image) {
     out_image->width = image.width;
     out_image->height = image.height;
@@ -197,12 +206,22 @@ static void ConvertImageToCAPI(const Image& image, aribcc_image_t* out_image) {
     out_image->dst_x = image.dst_x;
     out_image->dst_y = image.dst_y;
     out_image->pixel_format = static_cast<aribcc_pixelformat_t>(image.pixel_format);
+    out_image->content_id = image.content_id;
+    out_image->changed = image.changed;
 
     if (!image.bitmap.empty()) {
         out_image->bitmap_size = static_cast<uint32_t>(image.bitmap.size());
         out_image->bitmap = reinterpret_cast<uint8_t*>(AlignedAlloc(out_image->bitmap_size, Image::kAlignedTo));
         memcpy(out_image->bitmap, image.bitmap.data(), out_image->bitmap_size);
     }
+
+    if (!image.palette.empty()) {
+        out_image->palette_size = static_cast<uint32_t>(image.palette.size());
+        out_image->palette = reinterpret_cast<aribcc_color_t*>(malloc(sizeof(aribcc_color_t) * out_image->palette_size));
+        for (uint32_t i = 0; i < out_image->palette_size; i++) {
+            out_image->palette[i] = image.palette[i].u32;
+        }
+    }
 }
 
 static void ConvertRenderResultToCAPI(const RenderResult& result, aribcc_render_result_t* out_result) {
@@ -219,6 +238,53 @@ static void ConvertRenderResultToCAPI(const RenderResult& result, aribcc_render_
             ConvertImageToCAPI(src, dst);
         }
     }
+
+    if (!result.quads.empty()) {
+        out_result->quad_count = static_cast<uint32_t>(result.quads.size());
+        out_result->quads = reinterpret_cast<aribcc_render_quad_t*>(calloc(out_result->quad_count,
+                                                                           sizeof(aribcc_render_quad_t)));
+
+        for (uint32_t i = 0; i < out_result->quad_count; i++) {
+            const RenderQuad& src = result.quads[i];
+            aribcc_render_quad_t* dst = &out_result->quads[i];
+            dst->dst = aribcc_render_rect_t{src.dst.x, src.dst.y, src.dst.width, src.dst.height};
+            dst->src = aribcc_render_rect_t{src.src.x, src.src.y, src.src.width, src.src.height};
+            dst->color = src.color.u32;
+            dst->solid = src.solid;
+        }
+    }
+
+    out_result->atlas_width = result.atlas.width;
+    out_result->atlas_height = result.atlas.height;
+    out_result->atlas_generation = result.atlas.generation;
+
+    if (!result.atlas.cells.empty()) {
+        out_result->atlas_cell_count = static_cast<uint32_t>(result.atlas.cells.size());
+        out_result->atlas_cells = reinterpret_cast<aribcc_image_t*>(calloc(out_result->atlas_cell_count,
+                                                                           sizeof(aribcc_image_t)));
+
+        for (uint32_t i = 0; i < out_result->atlas_cell_count; i++) {
+            ConvertImageToCAPI(result.atlas.cells[i], &out_result->atlas_cells[i]);
+        }
+    }
+}
+
+bool aribcc_renderer_get_glyph_atlas(aribcc_renderer_t* renderer,
+                                     aribcc_image_t* out_image,
+                                     uint64_t* out_generation) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+
+    GlyphAtlasUpdate atlas;
+    if (!impl->GetGlyphAtlas(atlas) || atlas.cells.empty()) {
+        return false;
+    }
+
+    memset(out_image, 0, sizeof(*out_image));
+    ConvertImageToCAPI(atlas.cells[0], out_image);
+    if (out_generation) {
+        *out_generation = atlas.generation;
+    }
+    return true;
 }
 
 aribcc_render_status_t aribcc_renderer_try_render(aribcc_renderer_t* renderer, int64_t pts) {
@@ -227,6 +293,37 @@ aribcc_render_status_t aribcc_renderer_try_render(aribcc_renderer_t* renderer, i
     return static_cast<aribcc_render_status_t>(status);
 }
 
+int64_t aribcc_renderer_get_next_change_pts(aribcc_renderer_t* renderer, int64_t pts) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    return impl->GetNextChangePts(pts);
+}
+
+void aribcc_renderer_set_caption_change_callback(aribcc_renderer_t* renderer,
+                                                 aribcc_caption_change_callback_t callback,
+                                                 void* userdata) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    if (callback) {
+        impl->SetCaptionChangeCallback([callback, userdata](int64_t pts) {
+            callback(pts, userdata);
+        });
+    } else {
+        impl->SetCaptionChangeCallback(nullptr);
+    }
+}
+
+void aribcc_renderer_set_caption_queue_callback(aribcc_renderer_t* renderer,
+                                                aribcc_caption_queue_callback_t callback,
+                                                void* userdata) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    if (callback) {
+        impl->SetCaptionQueueCallback([callback, userdata](int64_t pts) {
+            callback(pts, userdata);
+        });
+    } else {
+        impl->SetCaptionQueueCallback(nullptr);
+    }
+}
+
 aribcc_render_status_t aribcc_renderer_render(aribcc_renderer_t* renderer,
                                               int64_t pts,
                                               aribcc_render_result_t* out_result) {
@@ -244,6 +341,122 @@ aribcc_render_status_t aribcc_renderer_render(aribcc_renderer_t* renderer,
     return static_cast<aribcc_render_status_t>(status);
 }
 
+aribcc_render_status_t aribcc_renderer_render_multi(aribcc_renderer_t* renderer,
+                                                    int64_t pts,
+                                                    const aribcc_render_target_t* targets,
+                                                    uint32_t target_count,
+                                                    aribcc_render_result_t* out_results) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+
+    std::vector<RenderTarget> render_targets(target_count);
+    for (uint32_t i = 0; i < target_count; i++) {
+        render_targets[i].frame_width = targets[i].frame_width;
+        render_targets[i].frame_height = targets[i].frame_height;
+        render_targets[i].margin_top = targets[i].margin_top;
+        render_targets[i].margin_bottom = targets[i].margin_bottom;
+        render_targets[i].margin_left = targets[i].margin_left;
+        render_targets[i].margin_right = targets[i].margin_right;
+    }
+
+    std::vector<RenderResult> results;
+    RenderStatus status = impl->RenderMulti(pts, render_targets, results);
+
+    memset(out_results, 0, sizeof(aribcc_render_result_t) * target_count);
+
+    if (status == RenderStatus::kGotImage) {
+        for (uint32_t i = 0; i < target_count; i++) {
+            ConvertRenderResultToCAPI(results[i], &out_results[i]);
+        }
+    }
+
+    return static_cast<aribcc_render_status_t>(status);
+}
+
+aribcc_render_status_t aribcc_renderer_render_all_changes(aribcc_renderer_t* renderer,
+                                                          int64_t pts_begin,
+                                                          int64_t pts_end,
+                                                          aribcc_render_change_callback_t callback,
+                                                          void* userdata) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+
+    RenderStatus status = impl->RenderAllChanges(pts_begin, pts_end,
+                                                 [callback, userdata](RenderStatus status, const RenderResult& result) {
+        aribcc_render_result_t out_result;
+        memset(&out_result, 0, sizeof(out_result));
+        ConvertRenderResultToCAPI(result, &out_result);
+        callback(static_cast<aribcc_render_status_t>(status), &out_result, userdata);
+        aribcc_render_result_cleanup(&out_result);
+    });
+
+    return static_cast<aribcc_render_status_t>(status);
+}
+
+aribcc_render_status_t aribcc_renderer_render_into(aribcc_renderer_t* renderer,
+                                                   int64_t pts,
+                                                   uint8_t* buffer,
+                                                   int stride,
+                                                   aribcc_pixelformat_t pixel_format,
+                                                   aribcc_render_rect_t* dirty_rect_out) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+
+    RenderRect dirty_rect;
+    RenderStatus status = impl->RenderInto(pts, buffer, stride, static_cast<PixelFormat>(pixel_format), &dirty_rect);
+
+    if (dirty_rect_out) {
+        dirty_rect_out->x = dirty_rect.x;
+        dirty_rect_out->y = dirty_rect.y;
+        dirty_rect_out->width = dirty_rect.width;
+        dirty_rect_out->height = dirty_rect.height;
+    }
+
+    return static_cast<aribcc_render_status_t>(status);
+}
+
+void aribcc_renderer_warm_up_fonts(aribcc_renderer_t* renderer) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->WarmUpFonts();
+}
+
+bool aribcc_renderer_prewarm_glyphs(aribcc_renderer_t* renderer,
+                                    uint32_t language_code,
+                                    int charsets,
+                                    int frame_width,
+                                    int frame_height) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    return impl->PrewarmGlyphs(language_code, static_cast<PrewarmCharset>(charsets), frame_width, frame_height);
+}
+
+void aribcc_renderer_set_region_cache_memory_limit(aribcc_renderer_t* renderer, size_t bytes) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    impl->SetRegionCacheMemoryLimit(bytes);
+}
+
+void aribcc_renderer_get_region_cache_stats(aribcc_renderer_t* renderer, aribcc_region_cache_stats_t* out_stats) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    RegionCacheStatistics stats = impl->GetRegionCacheStatistics();
+
+    out_stats->hits = stats.hits;
+    out_stats->misses = stats.misses;
+    out_stats->entry_count = stats.entry_count;
+    out_stats->memory_used = stats.memory_used;
+    out_stats->memory_limit = stats.memory_limit;
+}
+
+void aribcc_renderer_get_storage_memory_usage(aribcc_renderer_t* renderer, aribcc_storage_memory_usage_t* out_usage) {
+    auto impl = reinterpret_cast<RendererImpl*>(renderer);
+    StorageMemoryUsage usage = impl->GetStorageMemoryUsage();
+
+    out_usage->caption_count = usage.caption_count;
+    out_usage->captions = usage.captions;
+    out_usage->region_image_cache = usage.region_image_cache;
+    out_usage->layout_cache = usage.layout_cache;
+    out_usage->total = usage.total;
+    out_usage->limit = usage.limit;
+    out_usage->rendered_images = usage.rendered_images;
+    out_usage->glyph_atlas = usage.glyph_atlas;
+    out_usage->unevictable = usage.unevictable;
+}
+
 void aribcc_renderer_flush(aribcc_renderer_t* renderer) {
     auto impl = reinterpret_cast<RendererImpl*>(renderer);
     impl->Flush();
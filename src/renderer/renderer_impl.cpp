@@ -18,24 +18,102 @@
 
 #include <cmath>
 #include <algorithm>
+#include <condition_variable>
+#include <cstring>
 #include <iterator>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include "aribcaption/caption_serializer.hpp"
 #include "aribcaption/context.hpp"
+#include "decoder/b24_conv_tables.hpp"
+#include "decoder/b24_drcs_conv.hpp"
+#include "renderer/alphablend.hpp"
 #include "renderer/bitmap.hpp"
 #include "renderer/canvas.hpp"
+#include "renderer/pixel_convert.hpp"
 #include "renderer/renderer_impl.hpp"
 
 namespace aribcaption::internal {
 
+namespace {
+
+// 64-bit FNV-1a
+uint64_t HashBytes(const void* data, size_t length, uint64_t seed = 0) {
+    uint64_t hash = 0xCBF29CE484222325ull ^ seed;
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// Calls a function when leaving the scope, including by an exception
+template <class Function>
+class ScopeExit {
+public:
+    explicit ScopeExit(Function function) : function_(std::move(function)) {}
+    ~ScopeExit() { function_(); }
+
+    ScopeExit(const ScopeExit&) = delete;
+    ScopeExit& operator=(const ScopeExit&) = delete;
+private:
+    Function function_;
+};
+
+// Convert an output image, the pixel format is mixed into the content ID since converted pixels differ
+Image ConvertOutputImage(const Image& image, PixelFormat format) {
+    Image converted = pixelconv::ConvertImage(image, format);
+    converted.content_id = HashBytes(&format, sizeof(format), image.content_id);
+    return converted;
+}
+
+// Bounding rect of two rects, empty rects are ignored
+Rect UnionRect(const Rect& a, const Rect& b) {
+    if (a.width() <= 0 || a.height() <= 0) {
+        return b;
+    } else if (b.width() <= 0 || b.height() <= 0) {
+        return a;
+    }
+    return {std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right), std::max(a.bottom, b.bottom)};
+}
+
+// Approximate memory footprint of a stored caption, in bytes
+size_t EstimateCaptionMemory(const Caption& caption) {
+    size_t bytes = sizeof(Caption) + caption.text.capacity() + caption.regions.capacity() * sizeof(CaptionRegion);
+    for (const CaptionRegion& region : caption.regions) {
+        bytes += region.chars.capacity() * sizeof(CaptionChar);
+    }
+    for (const auto& [code, drcs] : caption.drcs_map) {
+        // Hash node with a bucket pointer
+        bytes += sizeof(std::pair<const uint32_t, DRCS>) + 2 * sizeof(void*);
+        bytes += drcs.pixels.capacity() + drcs.md5.capacity() + drcs.alternative_text.capacity();
+    }
+    return bytes;
+}
+
+}  // namespace
+
 RendererImpl::RendererImpl(Context& context)
     : context_(context), log_(GetContextLogger(context)), region_renderer_(context) {}
 
-RendererImpl::~RendererImpl() = default;
+RendererImpl::~RendererImpl() {
+    CancelPrewarm();
+}
 
 bool RendererImpl::Initialize(CaptionType caption_type,
                               FontProviderType font_provider_type,
                               TextRendererType text_renderer_type) {
+    if (!CheckNotRenderingAllChanges("Initialize")) {
+        return false;
+    }
+
     expected_caption_type_ = caption_type;
+    font_provider_type_ = font_provider_type;
+    text_renderer_type_ = text_renderer_type;
     LoadDefaultFontFamilies();
+    render_workers_.clear();  // Re-created with the new font provider / text renderer types on demand
     return region_renderer_.Initialize(font_provider_type, text_renderer_type);
 }
 
@@ -78,31 +156,85 @@ void RendererImpl::LoadDefaultFontFamilies() {
 }
 
 void RendererImpl::SetStrokeWidth(float dots) {
+    if (!CheckNotRenderingAllChanges("SetStrokeWidth")) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
     region_renderer_.SetStrokeWidth(dots);
+    OnRenderSettingsChanged();
+    InvalidatePrevRenderedImages();
+}
+
+void RendererImpl::SetStrokeMode(StrokeMode mode) {
+    if (!CheckNotRenderingAllChanges("SetStrokeMode")) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+    region_renderer_.SetStrokeMode(mode);
+    OnRenderSettingsChanged();
+    InvalidatePrevRenderedImages();
+}
+
+void RendererImpl::SetDRCSScaleMode(DRCSScaleMode mode) {
+    if (!CheckNotRenderingAllChanges("SetDRCSScaleMode")) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+    region_renderer_.SetDRCSScaleMode(mode);
+    OnRenderSettingsChanged();
     InvalidatePrevRenderedImages();
 }
 
 void RendererImpl::SetReplaceDRCS(bool replace) {
+    if (!CheckNotRenderingAllChanges("SetReplaceDRCS")) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
     region_renderer_.SetReplaceDRCS(replace);
+    OnRenderSettingsChanged();
     InvalidatePrevRenderedImages();
 }
 
 void RendererImpl::SetForceStrokeText(bool force_stroke) {
+    if (!CheckNotRenderingAllChanges("SetForceStrokeText")) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
     region_renderer_.SetForceStrokeText(force_stroke);
+    OnRenderSettingsChanged();
     InvalidatePrevRenderedImages();
 }
 
 void RendererImpl::SetForceNoRuby(bool force_no_ruby) {
+    if (!CheckNotRenderingAllChanges("SetForceNoRuby")) {
+        return;
+    }
+
     force_no_ruby_ = force_no_ruby;
     InvalidatePrevRenderedImages();
 }
 
 void RendererImpl::SetForceNoBackground(bool force_no_background) {
+    if (!CheckNotRenderingAllChanges("SetForceNoBackground")) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
     region_renderer_.SetForceNoBackground(force_no_background);
+    OnRenderSettingsChanged();
     InvalidatePrevRenderedImages();
 }
 
 void RendererImpl::SetMergeRegionImages(bool merge) {
+    if (!CheckNotRenderingAllChanges("SetMergeRegionImages")) {
+        return;
+    }
+
     bool prev = merge_region_images_;
     merge_region_images_ = merge;
     if (prev != merge) {
@@ -110,23 +242,99 @@ void RendererImpl::SetMergeRegionImages(bool merge) {
     }
 }
 
+void RendererImpl::SetRegionMergeMode(RegionMergeMode mode) {
+    if (!CheckNotRenderingAllChanges("SetRegionMergeMode")) {
+        return;
+    }
+
+    RegionMergeMode prev = region_merge_mode_;
+    region_merge_mode_ = mode;
+    if (prev != mode && merge_region_images_) {
+        InvalidatePrevRenderedImages();
+    }
+}
+
+void RendererImpl::SetCropRegionImages(bool crop) {
+    if (!CheckNotRenderingAllChanges("SetCropRegionImages")) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+    region_renderer_.SetCropToContent(crop);
+    OnRenderSettingsChanged();
+    InvalidatePrevRenderedImages();
+}
+
+void RendererImpl::SetPixelFormat(PixelFormat format) {
+    if (!CheckNotRenderingAllChanges("SetPixelFormat")) {
+        return;
+    }
+
+    if (pixel_format_ == format) {
+        return;
+    }
+    pixel_format_ = format;
+    converted_images_.clear();
+    converted_images_serial_ = 0;
+    InvalidatePrevRenderedImages();
+}
+
+void RendererImpl::SetRenderOutputMode(RenderOutputMode mode) {
+    if (!CheckNotRenderingAllChanges("SetRenderOutputMode")) {
+        return;
+    }
+
+    if (output_mode_ == mode) {
+        return;
+    }
+    output_mode_ = mode;
+    InvalidatePrevRenderedImages();
+}
+
+bool RendererImpl::GetGlyphAtlas(GlyphAtlasUpdate& out_atlas) {
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+    if (!glyph_atlas_) {
+        return false;
+    }
+
+    glyph_atlas_->TakeUpdates();  // Covered by the snapshot
+    std::vector<Image> cells;
+    cells.push_back(glyph_atlas_->Snapshot());
+    out_atlas = ConvertAtlasUpdate(std::move(cells));
+    return true;
+}
+
 bool RendererImpl::SetDefaultFontFamily(const std::vector<std::string>& font_family, bool force_default) {
+    if (!CheckNotRenderingAllChanges("SetDefaultFontFamily")) {
+        return false;
+    }
+
     force_default_font_family_ = force_default;
     return SetLanguageSpecificFontFamily(0, font_family);
 }
 
 bool RendererImpl::SetLanguageSpecificFontFamily(uint32_t language_code, const std::vector<std::string>& font_family) {
+    if (!CheckNotRenderingAllChanges("SetLanguageSpecificFontFamily")) {
+        return false;
+    }
+
     if (font_family.empty()) {
         return false;
     }
 
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
     language_font_family_[language_code] = font_family;
+    OnRenderSettingsChanged();
 
     InvalidatePrevRenderedImages();
     return true;
 }
 
 bool RendererImpl::SetFrameSize(int frame_width, int frame_height) {
+    if (!CheckNotRenderingAllChanges("SetFrameSize")) {
+        return false;
+    }
+
     if (frame_width < 0 || frame_height < 0) {
         assert(frame_width >= 0 && frame_height >= 0 && "Frame width/height must >= 0");
         return false;
@@ -146,6 +354,10 @@ bool RendererImpl::SetFrameSize(int frame_width, int frame_height) {
 }
 
 bool RendererImpl::SetMargins(int top, int bottom, int left, int right) {
+    if (!CheckNotRenderingAllChanges("SetMargins")) {
+        return false;
+    }
+
     if (!frame_size_inited_) {
         assert(frame_size_inited_ && "Frame size is not indicated, call SetFrameSize() first");
         return false;
@@ -179,6 +391,10 @@ bool RendererImpl::SetMargins(int top, int bottom, int left, int right) {
 }
 
 void RendererImpl::SetStoragePolicy(CaptionStoragePolicy policy, std::optional<size_t> upper_limit) {
+    if (!CheckNotRenderingAllChanges("SetStoragePolicy")) {
+        return;
+    }
+
     storage_policy_ = policy;
 
     if (policy == CaptionStoragePolicy::kUpperLimitCount) {
@@ -187,10 +403,22 @@ void RendererImpl::SetStoragePolicy(CaptionStoragePolicy policy, std::optional<s
     } else if (policy == CaptionStoragePolicy::kUpperLimitDuration) {
         assert(upper_limit.has_value());
         upper_limit_duration_ = upper_limit.value();
+    } else if (policy == CaptionStoragePolicy::kUpperLimitBytes) {
+        assert(upper_limit.has_value());
+        upper_limit_bytes_ = upper_limit.value();
+        EnforceMemoryLimit();
     }
 }
 
 bool RendererImpl::AppendCaption(const Caption& caption) {
+    return AppendCaption(Caption(caption));
+}
+
+bool RendererImpl::AppendCaption(Caption&& caption) {
+    if (!CheckNotRenderingAllChanges("AppendCaption")) {
+        return false;
+    }
+
     assert(caption.pts != PTS_NOPTS && "Caption without PTS is not supported");
     assert(caption.plane_width > 0 && caption.plane_height > 0);
 
@@ -198,58 +426,111 @@ bool RendererImpl::AppendCaption(const Caption& caption) {
         return false;
     }
 
-    int64_t pts = caption.pts;
+    // Keep the order of captions queued earlier
+    DrainQueuedCaptions();
 
-    if (captions_.empty()) {
-        captions_.emplace(pts, caption);
-    } else {
-        auto prev = captions_.lower_bound(pts - 1);
-        if (prev == captions_.end() || (prev != captions_.begin() && prev->first > pts - 1)) {
-            --prev;
-        }
+    int64_t pts = caption.pts;
+    StoreCaption(std::move(caption));
+    NotifyCaptionChange(pts);
+    return true;
+}
 
-        // Correct previous caption's duration
-        if (prev->first < pts && prev->second.wait_duration == DURATION_INDEFINITE) {
-            Caption& prev_caption = prev->second;
-            prev_caption.wait_duration = pts - prev_caption.pts;
-        }
+bool RendererImpl::AppendCaption(const void* data, size_t size) {
+    Caption caption;
+    if (!DeserializeCaption(data, size, caption)) {
+        log_->e("RendererImpl: Invalid serialized caption passed to AppendCaption()");
+        return false;
+    }
 
-        captions_.insert_or_assign(std::next(prev), pts, caption);
+    // Serialized data comes from outside, don't rely on the assertions of AppendCaption(Caption&&)
+    if (caption.pts == PTS_NOPTS || caption.plane_width <= 0 || caption.plane_height <= 0) {
+        log_->e("RendererImpl: Serialized caption passed to AppendCaption() has no PTS or invalid plane size");
+        return false;
     }
 
-    if (pts <= prev_rendered_caption_pts_) {
-        InvalidatePrevRenderedImages();
+    return AppendCaption(std::move(caption));
+}
+
+bool RendererImpl::QueueCaption(Caption&& caption) {
+    if (caption.pts == PTS_NOPTS || caption.plane_width <= 0 || caption.plane_height <= 0) {
+        return false;
     }
 
-    CleanupCaptionsIfNecessary();
+    int64_t pts = caption.pts;
+    queued_captions_.Push(std::move(caption));
+
+    if (caption_queue_callback_) {
+        caption_queue_callback_(pts);
+    }
     return true;
 }
 
-bool RendererImpl::AppendCaption(Caption&& caption) {
-    assert(caption.pts != PTS_NOPTS && "Caption without PTS is not supported");
-    assert(caption.plane_width > 0 && caption.plane_height > 0);
+void RendererImpl::DrainQueuedCaptions() {
+    // Store all queued captions before notifying, so that the callback is called once per drain
+    std::optional<int64_t> earliest_pts;
+    Caption caption;
+    while (queued_captions_.Pop(caption)) {
+        int64_t pts = caption.pts;
+        StoreCaption(std::move(caption));
+        earliest_pts = earliest_pts ? std::min(*earliest_pts, pts) : pts;
+    }
 
-    if (caption.pts == PTS_NOPTS || caption.plane_width <= 0 || caption.plane_height <= 0) {
-        return false;
+    if (earliest_pts) {
+        NotifyCaptionChange(*earliest_pts);
+    }
+}
+
+void RendererImpl::NotifyCaptionChange(int64_t pts) {
+    if (notifying_caption_change_) {
+        // Changed from inside the callback, e.g. GetNextChangePts() drained more captions
+        // Deliver after the callback returns rather than calling it recursively
+        pending_change_pts_ = pending_change_pts_ ? std::min(*pending_change_pts_, pts) : pts;
+        return;
+    }
+
+    notifying_caption_change_ = true;
+    std::optional<int64_t> change_pts = pts;
+    while (change_pts && caption_change_callback_) {
+        caption_change_callback_(*change_pts);
+        change_pts = pending_change_pts_;
+        pending_change_pts_.reset();
     }
+    pending_change_pts_.reset();
+    notifying_caption_change_ = false;
+}
 
+void RendererImpl::StoreCaption(Caption&& caption) {
     int64_t pts = caption.pts;
 
-    if (captions_.empty()) {
-        captions_.emplace(pts, std::move(caption));
-    } else {
-        auto prev = captions_.lower_bound(pts - 1);
-        if (prev == captions_.end() || (prev != captions_.begin() && prev->first > pts - 1)) {
-            --prev;
-        }
+    auto iter = captions_.end();
+    if (!captions_.empty() && pts <= captions_.back().pts) {
+        // Out of order, e.g. after seeking
+        iter = std::lower_bound(captions_.begin(), captions_.end(), pts,
+                                [](const Caption& c, int64_t value) { return c.pts < value; });
+    }
 
-        // Correct previous caption's duration
-        if (prev->first < pts && prev->second.wait_duration == DURATION_INDEFINITE) {
-            Caption& prev_caption = prev->second;
+    // Correct previous caption's duration
+    if (iter != captions_.begin()) {
+        Caption& prev_caption = *std::prev(iter);
+        if (prev_caption.wait_duration == DURATION_INDEFINITE) {
             prev_caption.wait_duration = pts - prev_caption.pts;
         }
+    }
 
-        captions_.insert_or_assign(std::next(prev), pts, std::move(caption));
+    captions_memory_ += EstimateCaptionMemory(caption);
+    if (iter == captions_.end()) {
+        captions_.push_back(std::move(caption));
+    } else if (iter->pts == pts) {
+        captions_memory_ -= EstimateCaptionMemory(*iter);
+        *iter = std::move(caption);
+    } else {
+        captions_.insert(iter, std::move(caption));
+    }
+
+    {
+        // Layout of the replaced caption, if any, is no longer valid
+        std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+        layout_cache_.Erase(pts);
     }
 
     if (pts <= prev_rendered_caption_pts_) {
@@ -257,7 +538,6 @@ bool RendererImpl::AppendCaption(Caption&& caption) {
     }
 
     CleanupCaptionsIfNecessary();
-    return true;
 }
 
 void RendererImpl::CleanupCaptionsIfNecessary() {
@@ -267,56 +547,104 @@ void RendererImpl::CleanupCaptionsIfNecessary() {
         if (prev_rendered_caption_pts_ == PTS_NOPTS) {
             return;
         }
-        auto prev_rendered_caption_iter = captions_.find(prev_rendered_caption_pts_);
-        if (prev_rendered_caption_iter != captions_.end()) {
-            captions_.erase(captions_.begin(), prev_rendered_caption_iter);
+        auto prev_rendered_caption_iter =
+            std::lower_bound(captions_.begin(), captions_.end(), prev_rendered_caption_pts_,
+                             [](const Caption& c, int64_t value) { return c.pts < value; });
+        if (prev_rendered_caption_iter != captions_.end() &&
+                prev_rendered_caption_iter->pts == prev_rendered_caption_pts_) {
+            EraseFrontCaptions(static_cast<size_t>(prev_rendered_caption_iter - captions_.begin()));
         }
     } else if (storage_policy_ == CaptionStoragePolicy::kUpperLimitCount) {
         if (captions_.size() <= upper_limit_count_) {
             return;
         }
-        auto erase_end = std::prev(captions_.end(), static_cast<ptrdiff_t>(upper_limit_count_));
-        if (erase_end != captions_.begin()) {
-            captions_.erase(captions_.begin(), erase_end);
-        }
+        EraseFrontCaptions(captions_.size() - upper_limit_count_);
     } else if (storage_policy_ == CaptionStoragePolicy::kUpperLimitDuration) {
         if (captions_.empty()) {
             return;
         }
-        int64_t last_caption_pts = captions_.rbegin()->first;
+        int64_t last_caption_pts = captions_.back().pts;
         int64_t erase_end_pts = last_caption_pts - static_cast<int64_t>(upper_limit_duration_);
-        auto erase_end = captions_.lower_bound(erase_end_pts);
-        if (erase_end != captions_.end() && erase_end != captions_.begin()) {
-            captions_.erase(captions_.begin(), erase_end);
+        auto erase_end = std::lower_bound(captions_.begin(), captions_.end(), erase_end_pts,
+                                          [](const Caption& c, int64_t value) { return c.pts < value; });
+        if (erase_end != captions_.end()) {
+            EraseFrontCaptions(static_cast<size_t>(erase_end - captions_.begin()));
         }
+    } else if (storage_policy_ == CaptionStoragePolicy::kUpperLimitBytes) {
+        EnforceMemoryLimit();
     }
 }
 
-RenderStatus RendererImpl::TryRender(int64_t pts) {
-    if (!frame_size_inited_ || !margins_inited_) {
-        return RenderStatus::kError;
+void RendererImpl::EraseFrontCaptions(size_t count) {
+    if (count == 0) {
+        return;
+    }
+    auto erase_end = captions_.begin() + static_cast<ptrdiff_t>(count);
+    {
+        std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+        for (auto iter = captions_.begin(); iter != erase_end; ++iter) {
+            captions_memory_ -= EstimateCaptionMemory(*iter);
+            layout_cache_.Erase(iter->pts);
+        }
+    }
+    captions_.erase(captions_.begin(), erase_end);
+    caption_cursor_ = caption_cursor_ > count ? caption_cursor_ - count : 0;
+}
+
+void RendererImpl::EnforceMemoryLimit() {
+    if (storage_policy_ != CaptionStoragePolicy::kUpperLimitBytes) {
+        return;
     }
 
-    if (captions_.empty()) {
-        return RenderStatus::kNoImage;
+    auto exceeded = [this]() -> bool {
+        return GetStorageMemoryUsage().total > upper_limit_bytes_;
+    };
+
+    // Captions before the one displayed at the playback position are unlikely to be rendered again,
+    // the displayed caption and upcoming ones are always kept
+    // caption_cursor_ is not the playback position, lookups such as GetNextChangePts() move it ahead as well
+    size_t evictable = 0;
+    if (playback_pts_ != PTS_NOPTS) {
+        auto displayed = std::upper_bound(captions_.begin(), captions_.end(), playback_pts_,
+                                          [](int64_t value, const Caption& c) { return value < c.pts; });
+        if (displayed != captions_.begin()) {
+            evictable = static_cast<size_t>(displayed - captions_.begin()) - 1;
+        }
+    }
+    for (; evictable > 0 && exceeded(); evictable--) {
+        EraseFrontCaptions(1);
     }
 
-    auto iter = captions_.lower_bound(pts);
-    if (iter == captions_.end() || (iter != captions_.begin() && iter->first > pts)) {
-        --iter;
+    // Cached images and layouts could be created again if necessary
+    if (exceeded()) {
+        std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+        size_t others = captions_memory_ + layout_cache_.cost();
+        region_image_cache_.Trim(upper_limit_bytes_ > others ? upper_limit_bytes_ - others : 0);
+        others = captions_memory_ + region_image_cache_.cost();
+        layout_cache_.Trim(upper_limit_bytes_ > others ? upper_limit_bytes_ - others : 0);
     }
+}
 
-    Caption& caption = iter->second;
-    if (pts < caption.pts || (caption.wait_duration != DURATION_INDEFINITE && pts >= caption.pts + caption.wait_duration)) {
-        // Timeout
-        return RenderStatus::kNoImage;
+RenderStatus RendererImpl::TryRender(int64_t pts) {
+    if (!CheckNotRenderingAllChanges("TryRender")) {
+        return RenderStatus::kError;
     }
-    if (caption.regions.empty()) {
+
+    DrainQueuedCaptions();
+    playback_pts_ = pts;
+
+    if (!frame_size_inited_ || !margins_inited_) {
+        return RenderStatus::kError;
+    }
+
+    Caption* caption = FindCaption(pts);
+    if (!caption) {
         return RenderStatus::kNoImage;
     }
 
-    if (has_prev_rendered_caption_ && prev_rendered_caption_pts_ == caption.pts) {
-        if (!prev_rendered_images_.empty()) {
+    if (has_prev_rendered_caption_ && prev_rendered_caption_pts_ == caption->pts &&
+        prev_rendered_output_mode_ == output_mode_) {
+        if (!prev_rendered_images_.empty() || !prev_rendered_quads_.empty()) {
             return RenderStatus::kGotImageUnchanged;
         } else {
             return RenderStatus::kNoImage;
@@ -326,101 +654,835 @@ RenderStatus RendererImpl::TryRender(int64_t pts) {
     return RenderStatus::kGotImage;
 }
 
+int64_t RendererImpl::GetNextChangePts(int64_t pts) {
+    if (!CheckNotRenderingAllChanges("GetNextChangePts")) {
+        return PTS_NOPTS;
+    }
+
+    DrainQueuedCaptions();
+
+    size_t count = captions_.size();
+    size_t index = LocateCaption(pts);
+
+    // Caption displayed at specific PTS, index must be the last caption not after it
+    auto displayed_at = [this](size_t index, int64_t pts) -> const Caption* {
+        if (index >= captions_.size()) {
+            return nullptr;
+        }
+        const Caption& caption = captions_[index];
+        if (caption.regions.empty() ||
+                (caption.wait_duration != DURATION_INDEFINITE && pts >= caption.pts + caption.wait_duration)) {
+            return nullptr;
+        }
+        return &caption;
+    };
+
+    // Walk through appearances and expirations, until the displayed caption differs
+    const Caption* displayed = displayed_at(index, pts);
+
+    for (size_t i = index < count ? index : 0; i < count; i++) {
+        const Caption& caption = captions_[i];
+        if (caption.pts > pts && displayed_at(i, caption.pts) != displayed) {
+            return caption.pts;
+        }
+
+        // Expires before the next caption appears
+        if (caption.wait_duration != DURATION_INDEFINITE) {
+            int64_t end_pts = caption.pts + caption.wait_duration;
+            if (displayed && end_pts > pts && (i + 1 == count || end_pts < captions_[i + 1].pts)) {
+                return end_pts;
+            }
+        }
+    }
+
+    return PTS_NOPTS;
+}
+
+void RendererImpl::SetCaptionChangeCallback(CaptionChangeCallback callback) {
+    caption_change_callback_ = std::move(callback);
+}
+
+void RendererImpl::SetCaptionQueueCallback(CaptionQueueCallback callback) {
+    caption_queue_callback_ = std::move(callback);
+}
+
 RenderStatus RendererImpl::Render(int64_t pts, RenderResult& out_result) {
-    if (!frame_size_inited_ || !margins_inited_) {
-        assert(frame_size_inited_ && margins_inited_ && "Frame size / margins must be indicated first");
+    if (!CheckNotRenderingAllChanges("Render")) {
         return RenderStatus::kError;
     }
 
+    DrainQueuedCaptions();
+
     out_result.pts = 0;
     out_result.duration = 0;
     out_result.images.clear();
-
-    if (captions_.empty()) {
-        InvalidatePrevRenderedImages();
-        return RenderStatus::kNoImage;
+    out_result.quads.clear();
+    out_result.atlas = GlyphAtlasUpdate{};
+
+    playback_pts_ = pts;
+    RenderStatus status = RenderCaption(pts, output_mode_);
+    EnforceMemoryLimit();
+    if (status != RenderStatus::kGotImage && status != RenderStatus::kGotImageUnchanged) {
+        return status;
     }
 
-    auto iter = captions_.lower_bound(pts);
-    if (iter == captions_.end() || (iter != captions_.begin() && iter->first > pts)) {
-        --iter;
-    }
+    out_result.pts = prev_rendered_caption_pts_;
+    out_result.duration = prev_rendered_caption_duration_;
 
-    Caption& caption = iter->second;
-    if (pts < caption.pts || (caption.wait_duration != DURATION_INDEFINITE && pts >= caption.pts + caption.wait_duration)) {
-        // Timeout
-        InvalidatePrevRenderedImages();
-        return RenderStatus::kNoImage;
-    }
-    if (caption.regions.empty()) {
-        InvalidatePrevRenderedImages();
-        return RenderStatus::kNoImage;
+    if (output_mode_ == RenderOutputMode::kGlyphQuads) {
+        out_result.quads = prev_rendered_quads_;
+        std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+        std::vector<Image> cells;
+        if (status == RenderStatus::kGotImage && glyph_atlas_) {
+            cells = glyph_atlas_->TakeUpdates();
+        }
+        out_result.atlas = ConvertAtlasUpdate(std::move(cells));
+        return status;
     }
 
-    if (has_prev_rendered_caption_ && prev_rendered_caption_pts_ == caption.pts) {
-        // Reuse previous rendered caption
-        if (!prev_rendered_images_.empty()) {
-            out_result.pts = prev_rendered_caption_pts_;
-            out_result.duration = prev_rendered_caption_duration_;
-            out_result.images = prev_rendered_images_;
-            return RenderStatus::kGotImageUnchanged;
-        } else {
-            InvalidatePrevRenderedImages();
-            return RenderStatus::kNoImage;
+    if (pixel_format_ == PixelFormat::kRGBA8888) {
+        out_result.images = prev_rendered_images_;
+    } else {
+        if (converted_images_serial_ != rendered_images_serial_) {
+            converted_images_.clear();
+            converted_images_.reserve(prev_rendered_images_.size());
+            for (const Image& image : prev_rendered_images_) {
+                converted_images_.push_back(ConvertOutputImage(image, pixel_format_));
+            }
+            converted_images_serial_ = rendered_images_serial_;
         }
+        out_result.images = converted_images_;
     }
 
-    // Prepare for rendering
+    if (status == RenderStatus::kGotImageUnchanged) {
+        for (Image& image : out_result.images) {
+            image.changed = false;
+        }
+    }
 
-    // Set up Font Language
-    region_renderer_.SetFontLanguage(caption.iso6392_language_code);
+    return status;
+}
 
-    // Set up Font Family
-    uint32_t language_code = caption.iso6392_language_code;
-    if (force_default_font_family_ || language_font_family_.find(language_code) == language_font_family_.end()) {
-        language_code = 0;
+RenderStatus RendererImpl::RenderMulti(int64_t pts, const std::vector<RenderTarget>& targets,
+                                       std::vector<RenderResult>& out_results) {
+    if (!CheckNotRenderingAllChanges("RenderMulti")) {
+        return RenderStatus::kError;
     }
-    region_renderer_.SetFontFamily(language_font_family_[language_code]);
 
-    // Set up origin plane size / target caption area
-    AdjustCaptionArea(caption.plane_width, caption.plane_height);
+    DrainQueuedCaptions();
+    out_results.clear();
 
-    std::vector<Image> images;
-    for (CaptionRegion& region : caption.regions) {
-        if (region.is_ruby && force_no_ruby_) {
-            continue;
+    for (const RenderTarget& target : targets) {
+        if (target.frame_width <= 0 || target.frame_height <= 0 ||
+            target.frame_width - target.margin_left - target.margin_right < 0 ||
+            target.frame_height - target.margin_top - target.margin_bottom < 0) {
+            log_->e("RendererImpl: Invalid frame size / margins passed to RenderMulti()");
+            return RenderStatus::kError;
         }
+    }
 
-        Result<Image, RegionRenderError> result = region_renderer_.RenderCaptionRegion(region, caption.drcs_map);
-        if (result.is_ok()) {
-            images.push_back(std::move(result.value()));
-        } else if (result.error() == RegionRenderError::kImageTooSmall) {
-            // Skip image which is too small
-            continue;
-        } else {
-            log_->e("RendererImpl: RenderCaptionRegion() failed with error: %d", static_cast<int>(result.error()));
-            InvalidatePrevRenderedImages();
+    Caption* caption = FindCaption(pts);
+    if (!caption) {
+        return RenderStatus::kNoImage;
+    }
+
+    out_results.resize(targets.size());
+    bool has_image = false;
+
+    for (size_t i = 0; i < targets.size(); i++) {
+        const RenderTarget& target = targets[i];
+        RenderResult& result = out_results[i];
+
+        int video_area_width = target.frame_width - target.margin_left - target.margin_right;
+        int video_area_height = target.frame_height - target.margin_top - target.margin_bottom;
+        if (RenderCaptionImages(*caption, video_area_width, video_area_height, result.images) == RenderStatus::kError) {
+            out_results.clear();
             return RenderStatus::kError;
         }
-    }
 
-    if (merge_region_images_ && images.size() > 1) {
-        Image merged = MergeImages(images);
-        images.clear();
-        images.push_back(std::move(merged));
+        result.pts = caption->pts;
+        result.duration = caption->wait_duration;
+        if (pixel_format_ != PixelFormat::kRGBA8888) {
+            for (Image& image : result.images) {
+                image = ConvertOutputImage(image, pixel_format_);
+            }
+        }
+        has_image = has_image || !result.images.empty();
     }
+    EnforceMemoryLimit();
 
-    has_prev_rendered_caption_ = true;
-    prev_rendered_caption_pts_ = caption.pts;
-    prev_rendered_caption_duration_ = caption.wait_duration;
-    prev_rendered_images_ = std::move(images);
+    if (!has_image) {
+        out_results.clear();
+        return RenderStatus::kNoImage;
+    }
 
-    out_result.pts = caption.pts;
-    out_result.duration = caption.wait_duration;
-    out_result.images = prev_rendered_images_;
     return RenderStatus::kGotImage;
 }
 
+RenderStatus RendererImpl::RenderAllChanges(int64_t pts_begin, int64_t pts_end, const RenderChangeCallback& callback) {
+    if (!CheckNotRenderingAllChanges("RenderAllChanges")) {
+        return RenderStatus::kError;
+    }
+
+    DrainQueuedCaptions();
+
+    if (!frame_size_inited_ || !margins_inited_) {
+        assert(frame_size_inited_ && margins_inited_ && "Frame size / margins must be indicated first");
+        return RenderStatus::kError;
+    }
+
+    // Display intervals within the range, a caption lasts until it times out or the next caption appears
+    // Gaps between captions get intervals without caption
+    struct Interval {
+        int64_t begin = 0;
+        int64_t end = 0;
+        const Caption* caption = nullptr;
+        size_t job = 0;  // Index into jobs if caption is not null
+    };
+    std::vector<Interval> intervals;
+    std::vector<const Caption*> jobs;
+
+    size_t index = LocateCaption(pts_begin);
+    auto iter = captions_.begin() + static_cast<ptrdiff_t>(index < captions_.size() ? index : 0);
+    for (; iter != captions_.end() && iter->pts < pts_end; ++iter) {
+        const Caption& caption = *iter;
+        int64_t begin = std::max(caption.pts, pts_begin);
+        int64_t end = pts_end;
+        if (caption.wait_duration != DURATION_INDEFINITE && caption.wait_duration < pts_end - caption.pts) {
+            end = caption.pts + caption.wait_duration;
+        }
+        if (auto next = std::next(iter); next != captions_.end()) {
+            end = std::min(end, next->pts);
+        }
+        if (end <= begin) {
+            continue;
+        }
+
+        if (!intervals.empty() && intervals.back().end < begin) {
+            intervals.push_back(Interval{intervals.back().end, begin});
+        }
+        if (caption.regions.empty()) {
+            intervals.push_back(Interval{begin, end});
+        } else {
+            intervals.push_back(Interval{begin, end, &caption, jobs.size()});
+            jobs.push_back(&caption);
+        }
+    }
+
+    // Rendered images of jobs, filled by worker threads in order of jobs (or by this thread without workers)
+    struct JobResult {
+        bool done = false;
+        RenderStatus status = RenderStatus::kError;
+        std::vector<Image> images;
+    };
+    std::vector<JobResult> results(jobs.size());
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_cv;
+    size_t next_job = 0;
+    size_t consumed_jobs = 0;
+    bool stopped = false;
+
+    unsigned worker_count = 0;
+    if (jobs.size() >= kParallelRenderMinCaptions) {
+        worker_count = std::min(std::thread::hardware_concurrency(), kMaxRenderWorkers);
+        if (worker_count < 2) {
+            worker_count = 0;
+        }
+    }
+    if (worker_count > 0) {
+        // Worker RegionRenderers are kept across calls, so that their fonts and glyph caches stay warm
+        while (render_workers_.size() < worker_count) {
+            auto worker_renderer = std::make_unique<RegionRenderer>(context_);
+            if (!worker_renderer->Initialize(font_provider_type_, text_renderer_type_)) {
+                log_->e("RendererImpl: Failed to initialize RegionRenderer for rendering worker");
+                break;
+            }
+            render_workers_.push_back(std::move(worker_renderer));
+        }
+        worker_count = std::min(worker_count, static_cast<unsigned>(render_workers_.size()));
+        if (worker_count < 2) {
+            worker_count = 0;
+        }
+
+        std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+        for (unsigned i = 0; i < worker_count; i++) {
+            render_workers_[i]->CopySettingsFrom(region_renderer_);
+        }
+    }
+    size_t window = std::max<size_t>(worker_count * 2, 1);  // Count of jobs rendered ahead of the consumer
+
+    // Must be called with jobs_mutex held
+    auto take_job = [&](size_t& index) -> bool {
+        if (stopped || next_job >= jobs.size() || next_job >= consumed_jobs + window) {
+            return false;
+        }
+        index = next_job++;
+        return true;
+    };
+
+    auto render_job = [&](RegionRenderer* worker_renderer, size_t index) -> JobResult {
+        JobResult result;
+        if (worker_renderer) {
+            result.status = RenderCaptionImagesWith(*worker_renderer, *jobs[index], result.images);
+        } else {
+            result.status = RenderCaptionImages(*jobs[index], video_area_width_, video_area_height_, result.images);
+        }
+        if (result.status != RenderStatus::kError && pixel_format_ != PixelFormat::kRGBA8888) {
+            for (Image& image : result.images) {
+                image = ConvertOutputImage(image, pixel_format_);
+            }
+        }
+        result.done = true;
+        return result;
+    };
+
+    // Each worker renders with its own RegionRenderer, since text renderers are not thread-safe
+    std::vector<std::thread> workers;
+    auto stop_workers = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex);
+            stopped = true;
+            jobs_cv.notify_all();
+        }
+        for (std::thread& worker : workers) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    };
+    // Joinable threads would terminate the process on destruction, e.g. if the callback throws
+    ScopeExit workers_guard(stop_workers);
+
+    for (unsigned i = 0; i < worker_count; i++) {
+        workers.emplace_back([&, worker_renderer = render_workers_[i].get()]() {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            while (!stopped && next_job < jobs.size()) {
+                size_t index = 0;
+                if (!take_job(index)) {
+                    jobs_cv.wait(lock);
+                    continue;
+                }
+                lock.unlock();
+                JobResult result = render_job(worker_renderer, index);
+                lock.lock();
+                results[index] = std::move(result);
+                jobs_cv.notify_all();
+            }
+        });
+    }
+
+    // Workers keep walking captions_ while the callback is running, so that the callback must not call back into
+    // the renderer, see CheckNotRenderingAllChanges()
+    rendering_all_changes_ = true;
+    ScopeExit rendering_guard([this]() { rendering_all_changes_ = false; });
+
+    RenderStatus status = RenderStatus::kNoImage;
+    bool has_pending = false;
+    RenderStatus pending_status = RenderStatus::kNoImage;
+    RenderResult pending;
+
+    for (const Interval& interval : intervals) {
+        std::vector<Image> images;
+
+        if (interval.caption) {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            while (!results[interval.job].done) {
+                size_t index = 0;
+                if (worker_count == 0 && take_job(index)) {
+                    lock.unlock();
+                    JobResult result = render_job(nullptr, index);
+                    lock.lock();
+                    results[index] = std::move(result);
+                } else {
+                    jobs_cv.wait(lock);
+                }
+            }
+
+            JobResult& result = results[interval.job];
+            consumed_jobs = interval.job + 1;
+            jobs_cv.notify_all();
+            if (result.status == RenderStatus::kError) {
+                status = RenderStatus::kError;
+                break;
+            }
+            images = std::move(result.images);
+        }
+
+        RenderStatus interval_status = images.empty() ? RenderStatus::kNoImage : RenderStatus::kGotImage;
+
+        // Join with the previous interval if the displayed content doesn't change
+        if (has_pending && pending_status == interval_status &&
+            std::equal(images.begin(), images.end(), pending.images.begin(), pending.images.end(),
+                       [](const Image& a, const Image& b) { return a.content_id == b.content_id; })) {
+            pending.duration = interval.end - pending.pts;
+            continue;
+        }
+
+        if (interval_status == RenderStatus::kNoImage && !has_pending) {
+            continue;  // Nothing is reported before the first interval with images
+        }
+
+        // Mark images that didn't appear in the previous interval
+        for (Image& image : images) {
+            image.changed = std::none_of(pending.images.begin(),
+                                         pending.images.end(),
+                                         [&image](const Image& prev) { return prev.content_id == image.content_id; });
+        }
+
+        if (has_pending) {
+            callback(pending_status, pending);
+        }
+
+        has_pending = true;
+        pending_status = interval_status;
+        pending.pts = interval.begin;
+        pending.duration = interval.end - interval.begin;
+        pending.images = std::move(images);
+
+        if (interval_status == RenderStatus::kGotImage) {
+            status = RenderStatus::kGotImage;
+        }
+    }
+
+    stop_workers();
+
+    // Nothing is reported after the last interval with images
+    if (status != RenderStatus::kError && has_pending && pending_status == RenderStatus::kGotImage) {
+        callback(pending_status, pending);
+    }
+
+    EnforceMemoryLimit();
+
+    return status;
+}
+
+RenderStatus RendererImpl::RenderInto(int64_t pts, uint8_t* buffer, int stride, PixelFormat pixel_format,
+                                      RenderRect* dirty_rect_out) {
+    if (!CheckNotRenderingAllChanges("RenderInto")) {
+        return RenderStatus::kError;
+    }
+
+    DrainQueuedCaptions();
+
+    if (dirty_rect_out) {
+        *dirty_rect_out = RenderRect{};
+    }
+
+    if (!buffer || !pixelconv::IsPackedFormat(pixel_format) || stride < frame_width_ * 4) {
+        log_->e("RendererImpl: Invalid buffer / stride / pixel format passed to RenderInto()");
+        return RenderStatus::kError;
+    }
+
+    playback_pts_ = pts;
+    RenderStatus status = RenderCaption(pts, RenderOutputMode::kImages);
+    EnforceMemoryLimit();
+    if (status == RenderStatus::kError) {
+        return status;
+    }
+
+    if (status == RenderStatus::kGotImageUnchanged && rendered_into_serial_ == rendered_images_serial_) {
+        // Buffer already contains these images
+        return status;
+    }
+
+    Rect frame_rect(0, 0, frame_width_, frame_height_);
+
+    // Erase images drawn by the previous call
+    Rect dirty = Rect::ClipRect(frame_rect, rendered_into_rect_);
+    for (int y = dirty.top; y < dirty.bottom; y++) {
+        uint8_t* line = buffer + static_cast<ptrdiff_t>(y) * stride + static_cast<ptrdiff_t>(dirty.left) * 4;
+        memset(line, 0, static_cast<size_t>(std::max(dirty.width(), 0)) * 4);
+    }
+
+    Rect drawn;
+    rendered_into_serial_ = 0;
+
+    bool premultiplied = pixel_format == PixelFormat::kRGBA8888Premultiplied ||
+                         pixel_format == PixelFormat::kBGRA8888Premultiplied;
+    if (pixel_format != PixelFormat::kRGBA8888) {
+        rendered_into_line_.resize(static_cast<size_t>(frame_width_));
+    }
+
+    if (status == RenderStatus::kGotImage || status == RenderStatus::kGotImageUnchanged) {
+        for (const Image& image : prev_rendered_images_) {
+            Rect rect(image.dst_x, image.dst_y, image.dst_x + image.width, image.dst_y + image.height);
+            Rect clipped = Rect::ClipRect(frame_rect, rect);
+            if (clipped.width() <= 0 || clipped.height() <= 0) {
+                continue;
+            }
+
+            for (int y = clipped.top; y < clipped.bottom; y++) {
+                auto dest = reinterpret_cast<ColorRGBA*>(buffer + static_cast<ptrdiff_t>(y) * stride) + clipped.left;
+                auto src = reinterpret_cast<const ColorRGBA*>(image.bitmap.data() +
+                                                              static_cast<ptrdiff_t>(y - rect.top) * image.stride) +
+                           (clipped.left - rect.left);
+                auto width = static_cast<size_t>(clipped.width());
+                if (pixel_format == PixelFormat::kRGBA8888) {
+                    alphablend::BlendLine(dest, src, width);
+                    continue;
+                }
+
+                ColorRGBA* line = rendered_into_line_.data();
+                pixelconv::ConvertLine(line, src, width, pixel_format);
+                if (premultiplied) {
+                    alphablend::BlendLine_PremultipliedSrc(dest, line, width);
+                } else {
+                    alphablend::BlendLine(dest, line, width);
+                }
+            }
+
+            drawn = UnionRect(drawn, clipped);
+        }
+        rendered_into_serial_ = rendered_images_serial_;
+    }
+
+    rendered_into_rect_ = drawn;
+    dirty = UnionRect(dirty, drawn);
+
+    if (dirty_rect_out && dirty.width() > 0 && dirty.height() > 0) {
+        *dirty_rect_out = RenderRect{dirty.left, dirty.top, dirty.width(), dirty.height()};
+    }
+
+    return status;
+}
+
+size_t RendererImpl::LocateCaption(int64_t pts) {
+    size_t count = captions_.size();
+
+    // Sequential playback usually stays on the cursor or moves to the next one
+    size_t cursor = caption_cursor_;
+    for (size_t i = 0; i < 2 && cursor < count && captions_[cursor].pts <= pts; i++, cursor++) {
+        if (cursor + 1 == count || pts < captions_[cursor + 1].pts) {
+            caption_cursor_ = cursor;
+            return cursor;
+        }
+    }
+
+    // Seeking, fallback to binary search
+    auto iter = std::upper_bound(captions_.begin(), captions_.end(), pts,
+                                 [](int64_t value, const Caption& c) { return value < c.pts; });
+    if (iter == captions_.begin()) {
+        return count;
+    }
+    caption_cursor_ = static_cast<size_t>(iter - captions_.begin()) - 1;
+    return caption_cursor_;
+}
+
+Caption* RendererImpl::FindCaption(int64_t pts) {
+    size_t index = LocateCaption(pts);
+    if (index >= captions_.size()) {
+        return nullptr;
+    }
+
+    Caption& caption = captions_[index];
+    if (pts < caption.pts || (caption.wait_duration != DURATION_INDEFINITE && pts >= caption.pts + caption.wait_duration)) {
+        // Timeout
+        return nullptr;
+    }
+    if (caption.regions.empty()) {
+        return nullptr;
+    }
+
+    return &caption;
+}
+
+RenderStatus RendererImpl::RenderCaption(int64_t pts, RenderOutputMode mode) {
+    if (!frame_size_inited_ || !margins_inited_) {
+        assert(frame_size_inited_ && margins_inited_ && "Frame size / margins must be indicated first");
+        return RenderStatus::kError;
+    }
+
+    Caption* caption = FindCaption(pts);
+    if (!caption) {
+        InvalidatePrevRenderedImages();
+        return RenderStatus::kNoImage;
+    }
+
+    if (has_prev_rendered_caption_ && prev_rendered_caption_pts_ == caption->pts &&
+        prev_rendered_output_mode_ == mode) {
+        // Reuse previous rendered caption
+        if (!prev_rendered_images_.empty() || !prev_rendered_quads_.empty()) {
+            return RenderStatus::kGotImageUnchanged;
+        } else {
+            InvalidatePrevRenderedImages();
+            return RenderStatus::kNoImage;
+        }
+    }
+
+    if (mode == RenderOutputMode::kGlyphQuads) {
+        std::vector<RenderQuad> quads;
+        if (RenderCaptionQuads(*caption, video_area_width_, video_area_height_, quads) == RenderStatus::kError) {
+            InvalidatePrevRenderedImages();
+            return RenderStatus::kError;
+        }
+
+        has_prev_rendered_caption_ = true;
+        prev_rendered_caption_pts_ = caption->pts;
+        prev_rendered_caption_duration_ = caption->wait_duration;
+        prev_rendered_output_mode_ = mode;
+        prev_rendered_images_.clear();
+        prev_rendered_quads_ = std::move(quads);
+        rendered_images_serial_++;
+
+        return RenderStatus::kGotImage;
+    }
+
+    std::vector<Image> images;
+    if (RenderCaptionImages(*caption, video_area_width_, video_area_height_, images) == RenderStatus::kError) {
+        InvalidatePrevRenderedImages();
+        return RenderStatus::kError;
+    }
+
+    // Mark images that didn't appear in the previous result
+    for (Image& image : images) {
+        image.changed = std::none_of(prev_rendered_images_.begin(),
+                                     prev_rendered_images_.end(),
+                                     [&image](const Image& prev) { return prev.content_id == image.content_id; });
+    }
+
+    has_prev_rendered_caption_ = true;
+    prev_rendered_caption_pts_ = caption->pts;
+    prev_rendered_caption_duration_ = caption->wait_duration;
+    prev_rendered_output_mode_ = mode;
+    prev_rendered_images_ = std::move(images);
+    prev_rendered_quads_.clear();
+    rendered_images_serial_++;
+
+    return RenderStatus::kGotImage;
+}
+
+RenderStatus RendererImpl::RenderCaptionImages(const Caption& caption, int video_area_width, int video_area_height,
+                                               std::vector<Image>& out_images) {
+    // Prepare for rendering
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+
+    uint32_t language_code = PrepareCaptionFonts(region_renderer_, caption);
+
+    // Set up origin plane size / target caption area
+    Rect caption_area = AdjustCaptionArea(caption.plane_width, caption.plane_height,
+                                          video_area_width, video_area_height);
+
+    bool region_cache_enabled = region_image_cache_.capacity() > 0;
+
+    CaptionLayout& caption_layout = GetCaptionLayout(caption, caption_area);
+
+    for (size_t region_index = 0; region_index < caption.regions.size(); region_index++) {
+        const CaptionRegion& region = caption.regions[region_index];
+        if (region.is_ruby && force_no_ruby_) {
+            continue;
+        }
+
+        // The key is also used for deriving the content ID of the region image
+        std::string cache_key = MakeRegionCacheKey(region, caption.drcs_map,
+                                                   caption.iso6392_language_code, language_code,
+                                                   caption.plane_width, caption.plane_height, caption_area);
+        if (region_cache_enabled) {
+            if (Image* cached = region_image_cache_.Get(cache_key)) {
+                if (!cached->bitmap.empty()) {
+                    out_images.push_back(*cached);
+                }
+                continue;
+            }
+        }
+
+        const RegionLayout& region_layout = GetRegionLayout(caption, caption_layout, region_index);
+        Result<Image, RegionRenderError> result = region_renderer_.RenderRegionLayout(region_layout,
+                                                                                      caption.drcs_map);
+        if (result.is_ok()) {
+            result.value().content_id = HashBytes(cache_key.data(), cache_key.size(), render_settings_serial_);
+            if (region_cache_enabled) {
+                size_t cost = cache_key.size() + sizeof(Image) + result.value().bitmap.size();
+                region_image_cache_.Put(std::move(cache_key), result.value(), cost);
+            }
+            out_images.push_back(std::move(result.value()));
+        } else if (result.error() == RegionRenderError::kImageTooSmall) {
+            // Skip image which is too small
+            if (region_cache_enabled) {
+                size_t cost = cache_key.size() + sizeof(Image);
+                region_image_cache_.Put(std::move(cache_key), Image{}, cost);
+            }
+            continue;
+        } else {
+            log_->e("RendererImpl: RenderCaptionRegion() failed with error: %d", static_cast<int>(result.error()));
+            return RenderStatus::kError;
+        }
+    }
+
+    MergeRegionImages(out_images);
+    return RenderStatus::kGotImage;
+}
+
+RenderStatus RendererImpl::RenderCaptionImagesWith(RegionRenderer& region_renderer, const Caption& caption,
+                                                   std::vector<Image>& out_images) {
+    // region_renderer is owned by the calling thread, only the region image cache is shared
+    uint32_t language_code = PrepareCaptionFonts(region_renderer, caption);
+
+    Rect caption_area = CalcCaptionAreaRect(video_area_width_, video_area_height_,
+                                            caption.plane_width, caption.plane_height);
+    region_renderer.SetOriginalPlaneSize(caption.plane_width, caption.plane_height);
+    region_renderer.SetTargetCaptionAreaRect(caption_area);
+
+    for (const CaptionRegion& region : caption.regions) {
+        if (region.is_ruby && force_no_ruby_) {
+            continue;
+        }
+
+        std::string cache_key = MakeRegionCacheKey(region, caption.drcs_map,
+                                                   caption.iso6392_language_code, language_code,
+                                                   caption.plane_width, caption.plane_height, caption_area);
+        {
+            std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+            if (region_image_cache_.capacity() > 0) {
+                if (Image* cached = region_image_cache_.Get(cache_key)) {
+                    if (!cached->bitmap.empty()) {
+                        out_images.push_back(*cached);
+                    }
+                    continue;
+                }
+            }
+        }
+
+        Result<Image, RegionRenderError> result =
+            region_renderer.RenderRegionLayout(region_renderer.LayoutCaptionRegion(region), caption.drcs_map);
+        if (result.is_ok()) {
+            result.value().content_id = HashBytes(cache_key.data(), cache_key.size(), render_settings_serial_);
+            std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+            if (region_image_cache_.capacity() > 0) {
+                size_t cost = cache_key.size() + sizeof(Image) + result.value().bitmap.size();
+                region_image_cache_.Put(std::move(cache_key), result.value(), cost);
+            }
+            out_images.push_back(std::move(result.value()));
+        } else if (result.error() == RegionRenderError::kImageTooSmall) {
+            std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+            if (region_image_cache_.capacity() > 0) {
+                size_t cost = cache_key.size() + sizeof(Image);
+                region_image_cache_.Put(std::move(cache_key), Image{}, cost);
+            }
+        } else {
+            log_->e("RendererImpl: RenderCaptionRegion() failed with error: %d", static_cast<int>(result.error()));
+            return RenderStatus::kError;
+        }
+    }
+
+    MergeRegionImages(out_images);
+    return RenderStatus::kGotImage;
+}
+
+void RendererImpl::MergeRegionImages(std::vector<Image>& images) const {
+    if (!merge_region_images_ || images.size() <= 1) {
+        return;
+    }
+
+    if (region_merge_mode_ == RegionMergeMode::kSparse) {
+        images = MergeImagesSparse(images);
+    } else {
+        Image merged = MergeImages(images);
+        images.clear();
+        images.push_back(std::move(merged));
+    }
+}
+
+RenderStatus RendererImpl::RenderCaptionQuads(const Caption& caption, int video_area_width, int video_area_height,
+                                              std::vector<RenderQuad>& out_quads) {
+    // Prepare for rendering
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+
+    PrepareCaptionFonts(region_renderer_, caption);
+
+    Rect caption_area = AdjustCaptionArea(caption.plane_width, caption.plane_height,
+                                          video_area_width, video_area_height);
+
+    CaptionLayout& caption_layout = GetCaptionLayout(caption, caption_area);
+
+    if (!glyph_atlas_) {
+        glyph_atlas_ = std::make_unique<GlyphAtlas>(kGlyphAtlasSize, kGlyphAtlasSize);
+    }
+
+    // If the atlas runs out of room, start over with an empty one, which then only holds glyphs in use
+    for (int attempt = 0; attempt < 2; attempt++) {
+        out_quads.clear();
+        bool atlas_full = false;
+
+        for (size_t region_index = 0; region_index < caption.regions.size(); region_index++) {
+            const CaptionRegion& region = caption.regions[region_index];
+            if (region.is_ruby && force_no_ruby_) {
+                continue;
+            }
+
+            const RegionLayout& region_layout = GetRegionLayout(caption, caption_layout, region_index);
+            Result<size_t, RegionRenderError> result = region_renderer_.RenderRegionQuads(region_layout,
+                                                                                          caption.drcs_map,
+                                                                                          *glyph_atlas_,
+                                                                                          out_quads);
+            if (result.is_ok() || result.error() == RegionRenderError::kImageTooSmall) {
+                continue;
+            } else if (result.error() == RegionRenderError::kAtlasFull) {
+                atlas_full = true;
+                break;
+            } else {
+                log_->e("RendererImpl: RenderRegionQuads() failed with error: %d", static_cast<int>(result.error()));
+                out_quads.clear();
+                return RenderStatus::kError;
+            }
+        }
+
+        if (!atlas_full) {
+            return RenderStatus::kGotImage;
+        }
+        glyph_atlas_->Clear();
+    }
+
+    log_->e("RendererImpl: Glyphs of the caption don't fit into the glyph atlas");
+    out_quads.clear();
+    return RenderStatus::kError;
+}
+
+uint32_t RendererImpl::PrepareCaptionFonts(RegionRenderer& region_renderer, const Caption& caption) {
+    // Set up Font Language
+    region_renderer.SetFontLanguage(caption.iso6392_language_code);
+
+    // Set up Font Family
+    uint32_t language_code = caption.iso6392_language_code;
+    auto iter = language_font_family_.find(language_code);
+    if (force_default_font_family_ || iter == language_font_family_.end()) {
+        language_code = 0;
+        iter = language_font_family_.find(0);
+    }
+    region_renderer.SetFontFamily(iter->second);
+
+    return language_code;
+}
+
+const RegionLayout& RendererImpl::GetRegionLayout(const Caption& caption, CaptionLayout& caption_layout,
+                                                  size_t region_index) {
+    std::optional<RegionLayout>& region_layout = caption_layout.regions[region_index];
+    if (!region_layout) {
+        region_layout = region_renderer_.LayoutCaptionRegion(caption.regions[region_index]);
+        caption_layout.cost += sizeof(RegionLayout) + region_layout->chars.size() * sizeof(CharLayout);
+        UpdateLayoutCacheCost(caption.pts);
+    }
+    return *region_layout;
+}
+
+GlyphAtlasUpdate RendererImpl::ConvertAtlasUpdate(std::vector<Image>&& cells) {
+    GlyphAtlasUpdate update;
+    if (!glyph_atlas_) {
+        return update;
+    }
+
+    update.width = glyph_atlas_->width();
+    update.height = glyph_atlas_->height();
+    update.generation = glyph_atlas_->generation();
+    update.cells = std::move(cells);
+
+    if (pixel_format_ != PixelFormat::kRGBA8888 && pixelconv::IsPackedFormat(pixel_format_)) {
+        for (Image& cell : update.cells) {
+            cell = pixelconv::ConvertImage(cell, pixel_format_);
+        }
+    }
+    return update;
+}
+
 Image RendererImpl::MergeImages(std::vector<Image>& images) {
     if (images.empty()) return Image{};
 
@@ -434,7 +1496,11 @@ Image RendererImpl::MergeImages(std::vector<Image>& images) {
     Bitmap bitmap(rect.width(), rect.height(), PixelFormat::kRGBA8888);
     Canvas canvas(bitmap);
 
+    std::vector<uint64_t> content_ids;
+    content_ids.reserve(images.size());
+
     for (auto& image : images) {
+        content_ids.push_back(image.content_id);
         int x = image.dst_x - rect.left;
         int y = image.dst_y - rect.top;
         Bitmap bmp = Bitmap::FromImage(std::move(image));
@@ -444,31 +1510,307 @@ Image RendererImpl::MergeImages(std::vector<Image>& images) {
     Image merged = Bitmap::ToImage(std::move(bitmap));
     merged.dst_x = rect.left;
     merged.dst_y = rect.top;
+    merged.content_id = HashBytes(content_ids.data(), content_ids.size() * sizeof(uint64_t));
     return merged;
 }
 
-void RendererImpl::AdjustCaptionArea(int origin_plane_width, int origin_plane_height) {
-    float x_magnification = static_cast<float>(video_area_width_) / static_cast<float>(origin_plane_width);
-    float y_magnification = static_cast<float>(video_area_height_) / static_cast<float>(origin_plane_height);
+std::vector<Image> RendererImpl::MergeImagesSparse(std::vector<Image>& images) {
+    struct Cluster {
+        Rect rect;
+        std::vector<size_t> members;
+    };
+
+    auto area = [](const Rect& rect) -> int64_t {
+        return static_cast<int64_t>(rect.width()) * rect.height();
+    };
+
+    std::vector<Cluster> clusters;
+    clusters.reserve(images.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        const Image& image = images[i];
+        clusters.push_back(Cluster{Rect(image.dst_x, image.dst_y,
+                                        image.dst_x + image.width, image.dst_y + image.height), {i}});
+    }
+
+    // Join clusters which overlap each other, or whose joint bounding box doesn't waste much more
+    // than a quarter of its area, e.g. consecutive lines. Repeat until nothing changes.
+    bool joined = true;
+    while (joined) {
+        joined = false;
+        for (size_t i = 0; i < clusters.size() && !joined; i++) {
+            for (size_t j = i + 1; j < clusters.size(); j++) {
+                Rect& a = clusters[i].rect;
+                const Rect& b = clusters[j].rect;
+                Rect intersection = Rect::ClipRect(a, b);
+                Rect joint = UnionRect(a, b);
+                bool overlapped = intersection.width() > 0 && intersection.height() > 0;
+                if (!overlapped && area(joint) * 4 > (area(a) + area(b)) * 5) {
+                    continue;
+                }
+                a = joint;
+                clusters[i].members.insert(clusters[i].members.end(),
+                                           clusters[j].members.begin(), clusters[j].members.end());
+                clusters.erase(clusters.begin() + static_cast<ptrdiff_t>(j));
+                joined = true;
+                break;
+            }
+        }
+    }
+
+    std::vector<Image> merged_images;
+    merged_images.reserve(clusters.size());
+    for (Cluster& cluster : clusters) {
+        if (cluster.members.size() == 1) {
+            merged_images.push_back(std::move(images[cluster.members[0]]));
+            continue;
+        }
+        // Keep the original order of regions, which is also the drawing order
+        std::sort(cluster.members.begin(), cluster.members.end());
+        std::vector<Image> members;
+        members.reserve(cluster.members.size());
+        for (size_t index : cluster.members) {
+            members.push_back(std::move(images[index]));
+        }
+        merged_images.push_back(MergeImages(members));
+    }
+
+    return merged_images;
+}
+
+Rect RendererImpl::AdjustCaptionArea(int origin_plane_width, int origin_plane_height,
+                                     int video_area_width, int video_area_height) {
+    Rect caption_area = CalcCaptionAreaRect(video_area_width, video_area_height,
+                                            origin_plane_width, origin_plane_height);
+
+    region_renderer_.SetOriginalPlaneSize(origin_plane_width, origin_plane_height);
+    region_renderer_.SetTargetCaptionAreaRect(caption_area);
+    return caption_area;
+}
+
+auto RendererImpl::GetCaptionLayout(const Caption& caption, const Rect& caption_area) -> CaptionLayout& {
+    std::vector<CaptionLayout>* layouts = layout_cache_.Get(caption.pts);
+    if (!layouts) {
+        layouts = &layout_cache_.Put(caption.pts, {});
+    }
+
+    for (CaptionLayout& layout : *layouts) {
+        if (layout.caption_area == caption_area &&
+            layout.plane_width == caption.plane_width &&
+            layout.plane_height == caption.plane_height &&
+            layout.regions.size() == caption.regions.size()) {
+            return layout;
+        }
+    }
+
+    // Each caption area, e.g. of targets passed to RenderMulti(), gets its own layout
+    CaptionLayout& layout = layouts->emplace_back();
+    layout.caption_area = caption_area;
+    layout.plane_width = caption.plane_width;
+    layout.plane_height = caption.plane_height;
+    layout.cost = sizeof(CaptionLayout) + caption.regions.size() * sizeof(std::optional<RegionLayout>);
+    layout.regions.resize(caption.regions.size());
+
+    UpdateLayoutCacheCost(caption.pts);
+    return layout;
+}
+
+void RendererImpl::UpdateLayoutCacheCost(int64_t pts) {
+    if (std::vector<CaptionLayout>* layouts = layout_cache_.Get(pts)) {
+        size_t cost = 0;
+        for (const CaptionLayout& layout : *layouts) {
+            cost += layout.cost;
+        }
+        layout_cache_.UpdateCost(pts, cost);
+    }
+}
+
+Rect RendererImpl::CalcCaptionAreaRect(int video_area_width, int video_area_height,
+                                       int origin_plane_width, int origin_plane_height) {
+    float x_magnification = static_cast<float>(video_area_width) / static_cast<float>(origin_plane_width);
+    float y_magnification = static_cast<float>(video_area_height) / static_cast<float>(origin_plane_height);
     float magnification = std::min(x_magnification, y_magnification);
 
     int caption_area_width = static_cast<int>(std::floor(static_cast<float>(origin_plane_width) * magnification));
     int caption_area_height = static_cast<int>(std::floor(static_cast<float>(origin_plane_height) * magnification));
-    int caption_area_start_x = (video_area_width_ - caption_area_width) / 2;
-    int caption_area_start_y = (video_area_height_ - caption_area_height) / 2;
+    int caption_area_start_x = (video_area_width - caption_area_width) / 2;
+    int caption_area_start_y = (video_area_height - caption_area_height) / 2;
 
-    Rect caption_area(caption_area_start_x,
-                      caption_area_start_y,
-                      caption_area_start_x + caption_area_width,
-                      caption_area_start_y + caption_area_height);
+    return {caption_area_start_x,
+            caption_area_start_y,
+            caption_area_start_x + caption_area_width,
+            caption_area_start_y + caption_area_height};
+}
 
-    region_renderer_.SetOriginalPlaneSize(origin_plane_width, origin_plane_height);
-    region_renderer_.SetTargetCaptionAreaRect(caption_area);
+namespace {
+
+template <typename T>
+void AppendKeyField(std::string& key, const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void AppendKeyField(std::string& key, const std::string& value) {
+    AppendKeyField(key, value.size());
+    key.append(value);
+}
+
+}  // namespace
+
+std::string RendererImpl::MakeRegionCacheKey(const CaptionRegion& region,
+                                             const std::unordered_map<uint32_t, DRCS>& drcs_map,
+                                             uint32_t font_language_code,
+                                             uint32_t font_family_language_code,
+                                             int origin_plane_width,
+                                             int origin_plane_height,
+                                             const Rect& caption_area) {
+    std::string key;
+    key.reserve(64 + region.chars.size() * 72);
+
+    AppendKeyField(key, font_language_code);
+    AppendKeyField(key, font_family_language_code);
+    AppendKeyField(key, origin_plane_width);
+    AppendKeyField(key, origin_plane_height);
+    AppendKeyField(key, caption_area);
+
+    AppendKeyField(key, region.x);
+    AppendKeyField(key, region.y);
+    AppendKeyField(key, region.width);
+    AppendKeyField(key, region.height);
+    AppendKeyField(key, region.chars.size());
+
+    for (const CaptionChar& ch : region.chars) {
+        AppendKeyField(key, ch.type);
+        AppendKeyField(key, ch.codepoint);
+        AppendKeyField(key, ch.pua_codepoint);
+        AppendKeyField(key, ch.drcs_code);
+        AppendKeyField(key, ch.x);
+        AppendKeyField(key, ch.y);
+        AppendKeyField(key, ch.char_width);
+        AppendKeyField(key, ch.char_height);
+        AppendKeyField(key, ch.char_horizontal_spacing);
+        AppendKeyField(key, ch.char_vertical_spacing);
+        AppendKeyField(key, ch.char_horizontal_scale);
+        AppendKeyField(key, ch.char_vertical_scale);
+        AppendKeyField(key, ch.text_color);
+        AppendKeyField(key, ch.back_color);
+        AppendKeyField(key, ch.stroke_color);
+        AppendKeyField(key, ch.style);
+        AppendKeyField(key, ch.enclosure_style);
+
+        if (ch.type != CaptionCharType::kDRCS && ch.type != CaptionCharType::kDRCSReplaced) {
+            continue;
+        }
+
+        // DRCS codes are only meaningful within a caption, identify the pattern by its content
+        auto iter = drcs_map.find(ch.drcs_code);
+        if (iter == drcs_map.end()) {
+            AppendKeyField(key, int{-1});
+            continue;
+        }
+
+        const DRCS& drcs = iter->second;
+        AppendKeyField(key, drcs.width);
+        AppendKeyField(key, drcs.height);
+        AppendKeyField(key, drcs.depth);
+        if (!drcs.md5.empty()) {
+            AppendKeyField(key, drcs.md5);
+        } else {
+            AppendKeyField(key, drcs.pixels.size());
+            key.append(reinterpret_cast<const char*>(drcs.pixels.data()), drcs.pixels.size());
+        }
+    }
+
+    return key;
+}
+
+void RendererImpl::OnRenderSettingsChanged() {
+    assert(!rendering_all_changes_ && "Render settings must not be changed from the RenderAllChanges() callback");
+
+    // Cached region images are no longer valid, and the same content will get different IDs from now on
+    region_image_cache_.Clear();
+    layout_cache_.Clear();
+    render_settings_serial_++;
+    if (glyph_atlas_) {
+        glyph_atlas_->Clear();
+    }
+}
+
+void RendererImpl::SetRegionCacheMemoryLimit(size_t bytes) {
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+    region_image_cache_.SetCapacity(bytes);
+    if (bytes == 0) {
+        region_image_cache_.Clear();
+    }
+}
+
+StorageMemoryUsage RendererImpl::GetStorageMemoryUsage() {
+    StorageMemoryUsage usage;
+    usage.caption_count = captions_.size();
+    usage.captions = captions_memory_;
+    {
+        std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+        usage.region_image_cache = region_image_cache_.cost();
+        usage.layout_cache = layout_cache_.cost();
+    }
+    usage.total = usage.captions + usage.region_image_cache + usage.layout_cache;
+    usage.limit = storage_policy_ == CaptionStoragePolicy::kUpperLimitBytes ? upper_limit_bytes_ : 0;
+
+    usage.rendered_images = GetRenderedImagesMemory();
+    usage.glyph_atlas = glyph_atlas_ ? glyph_atlas_->memory_size() : 0;
+    usage.unevictable = usage.rendered_images + usage.glyph_atlas;
+    return usage;
+}
+
+size_t RendererImpl::GetRenderedImagesMemory() const {
+    size_t bytes = prev_rendered_quads_.capacity() * sizeof(RenderQuad);
+    for (const Image& image : prev_rendered_images_) {
+        bytes += sizeof(Image) + image.bitmap.capacity();
+    }
+    for (const Image& image : converted_images_) {
+        bytes += sizeof(Image) + image.bitmap.capacity();
+    }
+    return bytes;
+}
+
+RegionCacheStatistics RendererImpl::GetRegionCacheStatistics() {
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+
+    RegionCacheStatistics stats;
+    stats.hits = region_image_cache_.hits();
+    stats.misses = region_image_cache_.misses();
+    stats.entry_count = region_image_cache_.size();
+    stats.memory_used = region_image_cache_.cost();
+    stats.memory_limit = region_image_cache_.capacity();
+    return stats;
 }
 
 void RendererImpl::Flush() {
+    if (!CheckNotRenderingAllChanges("Flush")) {
+        return;
+    }
+
+    // Captions queued before flushing are dropped as well, without ever being stored
+    queued_captions_.Clear();
     captions_.clear();
+    caption_cursor_ = 0;
+    playback_pts_ = PTS_NOPTS;
+    captions_memory_ = 0;
+    {
+        std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+        layout_cache_.Clear();
+    }
     InvalidatePrevRenderedImages();
+
+    NotifyCaptionChange(PTS_NOPTS);
+}
+
+bool RendererImpl::CheckNotRenderingAllChanges(const char* function) {
+    if (rendering_all_changes_) {
+        assert(!rendering_all_changes_ && "Renderer must not be called back from the RenderAllChanges() callback");
+        log_->e("RendererImpl: %s() must not be called from the callback of RenderAllChanges()", function);
+        return false;
+    }
+    return true;
 }
 
 void RendererImpl::InvalidatePrevRenderedImages() {
@@ -476,6 +1818,151 @@ void RendererImpl::InvalidatePrevRenderedImages() {
     prev_rendered_caption_pts_ = PTS_NOPTS;
     prev_rendered_caption_duration_ = 0;
     prev_rendered_images_.clear();
+    prev_rendered_quads_.clear();
+}
+
+namespace {
+
+struct PrewarmItem {
+    uint32_t ucs4 = 0;
+    int char_width = 0;
+    int char_height = 0;
+};
+
+// Standard character size on the 960x540 caption plane (Profile A)
+constexpr int kPrewarmPlaneWidth = 960;
+constexpr int kPrewarmPlaneHeight = 540;
+constexpr int kPrewarmCharSize = 36;
+constexpr int kPrewarmMiddleCharWidth = kPrewarmCharSize / 2;
+
+// Count of chars rendered while holding the lock, so that Render() won't be blocked for long
+constexpr size_t kPrewarmBatchSize = 16;
+
+std::vector<PrewarmItem> CollectPrewarmItems(PrewarmCharset charsets) {
+    std::vector<PrewarmItem> items;
+    std::unordered_set<uint64_t> visited;
+
+    auto append = [&](uint32_t ucs4, int char_width) {
+        // Skip spaces and undefined codepoints
+        if (ucs4 == 0 || ucs4 == 0x3000 || ucs4 == 0xFFFD) {
+            return;
+        }
+        // Character sets may overlap with each other
+        if (!visited.insert((static_cast<uint64_t>(ucs4) << 32) | static_cast<uint32_t>(char_width)).second) {
+            return;
+        }
+        items.push_back(PrewarmItem{ucs4, char_width, kPrewarmCharSize});
+    };
+
+    if (charsets & PrewarmCharset::kPrewarmCharsetKana) {
+        for (uint32_t ucs4 : kHiraganaTable) {
+            append(ucs4, kPrewarmCharSize);
+        }
+        for (uint32_t ucs4 : kKatakanaTable) {
+            append(ucs4, kPrewarmCharSize);
+        }
+        // JIS X 0208 row 1: punctuations and symbols
+        for (size_t i = 0; i < 94; i++) {
+            append(kKanjiTable[i], kPrewarmCharSize);
+        }
+    }
+
+    if (charsets & PrewarmCharset::kPrewarmCharsetFullwidthAlphanumeric) {
+        for (uint32_t ucs4 : kAlphanumericTable_Fullwidth) {
+            append(ucs4, kPrewarmCharSize);
+            append(ucs4, kPrewarmMiddleCharWidth);
+        }
+    }
+
+    if (charsets & PrewarmCharset::kPrewarmCharsetDRCSReplacement) {
+        for (const auto& [md5, ucs4] : kDRCSReplacementMap) {
+            append(ucs4, kPrewarmCharSize);
+        }
+    }
+
+    if (charsets & PrewarmCharset::kPrewarmCharsetJISLevel1Kanji) {
+        // JIS X 0208 level-1 Kanji are located in row 16 ~ 47
+        constexpr size_t begin_ku = 15;
+        constexpr size_t end_ku = 47;
+        for (size_t index = begin_ku * 94; index < end_ku * 94; index++) {
+            append(kKanjiTable[index], kPrewarmCharSize);
+        }
+    }
+
+    return items;
+}
+
+}  // namespace
+
+void RendererImpl::WarmUpFonts() {
+    std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+    region_renderer_.WarmUpFontProvider();
+}
+
+bool RendererImpl::PrewarmGlyphs(uint32_t language_code, PrewarmCharset charsets, int frame_width, int frame_height) {
+    if (frame_width <= 0 || frame_height <= 0) {
+        log_->e("RendererImpl: Invalid frame size for pre-warming glyphs");
+        return false;
+    }
+
+    CancelPrewarm();
+
+    std::vector<PrewarmItem> items = CollectPrewarmItems(charsets);
+    if (items.empty()) {
+        return false;
+    }
+
+    // Select font family in the same way as Render()
+    uint32_t font_language_code = language_code;
+    if (force_default_font_family_ || language_font_family_.find(language_code) == language_font_family_.end()) {
+        font_language_code = 0;
+    }
+    std::vector<std::string> font_family = language_font_family_[font_language_code];
+
+    // Glyph sizes must match Render(), which lays out captions inside the video area, i.e. frame minus margins
+    int video_area_width = frame_width - margin_left_ - margin_right_;
+    int video_area_height = frame_height - margin_top_ - margin_bottom_;
+    if (video_area_width <= 0 || video_area_height <= 0) {
+        log_->e("RendererImpl: Frame size for pre-warming glyphs is smaller than margins");
+        return false;
+    }
+    Rect caption_area = CalcCaptionAreaRect(video_area_width, video_area_height,
+                                            kPrewarmPlaneWidth, kPrewarmPlaneHeight);
+
+    prewarm_cancelled_ = false;
+    prewarm_thread_ = std::thread([this, language_code, font_family = std::move(font_family),
+                                   caption_area, items = std::move(items)]() {
+        size_t succeed = 0;
+
+        for (size_t begin = 0; begin < items.size() && !prewarm_cancelled_; begin += kPrewarmBatchSize) {
+            std::lock_guard<std::mutex> lock(region_renderer_mutex_);
+
+            // Render() always sets up these states by itself, so there's no need for restoring
+            region_renderer_.SetFontLanguage(language_code);
+            region_renderer_.SetFontFamily(font_family);
+            region_renderer_.SetOriginalPlaneSize(kPrewarmPlaneWidth, kPrewarmPlaneHeight);
+            region_renderer_.SetTargetCaptionAreaRect(caption_area);
+
+            size_t end = std::min(begin + kPrewarmBatchSize, items.size());
+            for (size_t i = begin; i < end && !prewarm_cancelled_; i++) {
+                const PrewarmItem& item = items[i];
+                if (region_renderer_.PrewarmChar(item.ucs4, item.char_width, item.char_height)) {
+                    succeed++;
+                }
+            }
+        }
+
+        log_->v("RendererImpl: Pre-warmed %zu of %zu glyphs", succeed, items.size());
+    });
+
+    return true;
+}
+
+void RendererImpl::CancelPrewarm() {
+    if (prewarm_thread_.joinable()) {
+        prewarm_cancelled_ = true;
+        prewarm_thread_.join();
+    }
 }
 
 }  // namespace aribcaption::internal
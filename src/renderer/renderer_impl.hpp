@@ -20,13 +20,21 @@
 #ifndef ARIBCAPTION_RENDERER_IMPL_HPP
 #define ARIBCAPTION_RENDERER_IMPL_HPP
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
 #include <vector>
-#include <map>
+#include <deque>
 #include "aribcaption/caption.hpp"
 #include "aribcaption/renderer.hpp"
 #include "base/logger.hpp"
+#include "base/lru_cache.hpp"
+#include "base/spsc_queue.hpp"
+#include "renderer/glyph_atlas.hpp"
 #include "renderer/region_renderer.hpp"
 
 namespace aribcaption::internal {
@@ -41,11 +49,18 @@ public:
                     TextRendererType text_renderer_type = TextRendererType::kAuto);
 
     void SetStrokeWidth(float dots);
+    void SetStrokeMode(StrokeMode mode);
+    void SetDRCSScaleMode(DRCSScaleMode mode);
     void SetReplaceDRCS(bool replace);
     void SetForceStrokeText(bool force_stroke);
     void SetForceNoRuby(bool force_no_ruby);
     void SetForceNoBackground(bool force_no_background);
     void SetMergeRegionImages(bool merge);
+    void SetRegionMergeMode(RegionMergeMode mode);
+    void SetCropRegionImages(bool crop);
+    void SetPixelFormat(PixelFormat format);
+    void SetRenderOutputMode(RenderOutputMode mode);
+    bool GetGlyphAtlas(GlyphAtlasUpdate& out_atlas);
 
     bool SetDefaultFontFamily(const std::vector<std::string>& font_family, bool force_default);
     bool SetLanguageSpecificFontFamily(uint32_t language_code, const std::vector<std::string>& font_family);
@@ -56,17 +71,78 @@ public:
 
     bool AppendCaption(const Caption& caption);
     bool AppendCaption(Caption&& caption);
+    bool AppendCaption(const void* data, size_t size);
+    bool QueueCaption(Caption&& caption);
 
     RenderStatus TryRender(int64_t pts);
+    int64_t GetNextChangePts(int64_t pts);
+    void SetCaptionChangeCallback(CaptionChangeCallback callback);
+    void SetCaptionQueueCallback(CaptionQueueCallback callback);
     RenderStatus Render(int64_t pts, RenderResult& out_result);
+    RenderStatus RenderMulti(int64_t pts, const std::vector<RenderTarget>& targets,
+                             std::vector<RenderResult>& out_results);
+    RenderStatus RenderAllChanges(int64_t pts_begin, int64_t pts_end, const RenderChangeCallback& callback);
+    RenderStatus RenderInto(int64_t pts, uint8_t* buffer, int stride, PixelFormat pixel_format,
+                            RenderRect* dirty_rect_out);
     void Flush();
+
+    void WarmUpFonts();
+    bool PrewarmGlyphs(uint32_t language_code, PrewarmCharset charsets, int frame_width, int frame_height);
+
+    void SetRegionCacheMemoryLimit(size_t bytes);
+    RegionCacheStatistics GetRegionCacheStatistics();
+    StorageMemoryUsage GetStorageMemoryUsage();
+private:
+    // Layouts of a caption's regions, for a specific caption area
+    struct CaptionLayout {
+        Rect caption_area;
+        int plane_width = 0;
+        int plane_height = 0;
+        size_t cost = 0;
+        std::vector<std::optional<RegionLayout>> regions;  // Indexed as Caption::regions, laid out on demand
+    };
 private:
     void LoadDefaultFontFamilies();
+    void CancelPrewarm();
+    void DrainQueuedCaptions();
+    void StoreCaption(Caption&& caption);
+    void NotifyCaptionChange(int64_t pts);
     void CleanupCaptionsIfNecessary();
-    void AdjustCaptionArea(int origin_plane_width, int origin_plane_height);
+    void EraseFrontCaptions(size_t count);
+    void EnforceMemoryLimit();
+    size_t GetRenderedImagesMemory() const;
+    size_t LocateCaption(int64_t pts);
+    Caption* FindCaption(int64_t pts);
+    RenderStatus RenderCaption(int64_t pts, RenderOutputMode mode);
+    uint32_t PrepareCaptionFonts(RegionRenderer& region_renderer, const Caption& caption);
+    RenderStatus RenderCaptionImages(const Caption& caption, int video_area_width, int video_area_height,
+                                     std::vector<Image>& out_images);
+    RenderStatus RenderCaptionImagesWith(RegionRenderer& region_renderer, const Caption& caption,
+                                         std::vector<Image>& out_images);
+    void MergeRegionImages(std::vector<Image>& images) const;
+    RenderStatus RenderCaptionQuads(const Caption& caption, int video_area_width, int video_area_height,
+                                    std::vector<RenderQuad>& out_quads);
+    const RegionLayout& GetRegionLayout(const Caption& caption, CaptionLayout& caption_layout, size_t region_index);
+    GlyphAtlasUpdate ConvertAtlasUpdate(std::vector<Image>&& cells);
+    Rect AdjustCaptionArea(int origin_plane_width, int origin_plane_height,
+                           int video_area_width, int video_area_height);
+    CaptionLayout& GetCaptionLayout(const Caption& caption, const Rect& caption_area);
+    void UpdateLayoutCacheCost(int64_t pts);
     void InvalidatePrevRenderedImages();
+    bool CheckNotRenderingAllChanges(const char* function);
+    void OnRenderSettingsChanged();
 private:
     static Image MergeImages(std::vector<Image>& images);
+    static std::vector<Image> MergeImagesSparse(std::vector<Image>& images);
+    static Rect CalcCaptionAreaRect(int video_area_width, int video_area_height,
+                                    int origin_plane_width, int origin_plane_height);
+    static std::string MakeRegionCacheKey(const CaptionRegion& region,
+                                          const std::unordered_map<uint32_t, DRCS>& drcs_map,
+                                          uint32_t font_language_code,
+                                          uint32_t font_family_language_code,
+                                          int origin_plane_width,
+                                          int origin_plane_height,
+                                          const Rect& caption_area);
 public:
     RendererImpl(const RendererImpl&) = delete;
     RendererImpl& operator=(const RendererImpl&) = delete;
@@ -75,6 +151,8 @@ private:
     std::shared_ptr<Logger> log_;
 
     CaptionType expected_caption_type_ = CaptionType::kDefault;
+    FontProviderType font_provider_type_ = FontProviderType::kAuto;
+    TextRendererType text_renderer_type_ = TextRendererType::kAuto;
 
     // iso639_language_code => FontFamily
     // language code 0 as default FontFamily
@@ -102,19 +180,88 @@ private:
     CaptionStoragePolicy storage_policy_ = CaptionStoragePolicy::kMinimum;
     size_t upper_limit_count_ = 0;
     size_t upper_limit_duration_ = 0;
+    size_t upper_limit_bytes_ = 0;
 
     bool merge_region_images_ = false;
+    RegionMergeMode region_merge_mode_ = RegionMergeMode::kBoundingBox;
+
+    // Sorted by PTS incrementally, unique PTS
+    // Monotonic playback only appends to the back and erases from the front
+    std::deque<Caption> captions_;
+
+    // Index of the last located caption, a hint for sequential lookups
+    size_t caption_cursor_ = 0;
 
-    // PTS => Caption
-    // Sorted by PTS incrementally
-    std::map<int64_t, Caption> captions_;
+    // PTS of the last Render() / TryRender() / RenderInto() call, captions before the displayed one are evictable
+    int64_t playback_pts_ = PTS_NOPTS;
+
+    // Approximate memory used by captions_, in bytes
+    size_t captions_memory_ = 0;
+
+    CaptionChangeCallback caption_change_callback_;
+    bool notifying_caption_change_ = false;
+    std::optional<int64_t> pending_change_pts_;  // Changes made inside caption_change_callback_
+
+    // Called on the producer thread, set before queueing starts
+    CaptionQueueCallback caption_queue_callback_;
+
+    // Captions queued by QueueCaption() from the producer thread, moved into captions_ on the rendering thread
+    SPSCQueue<Caption> queued_captions_;
 
     RegionRenderer region_renderer_;
 
+    // Guards region_renderer_, which is shared with the glyph pre-warm thread
+    // Rendering workers of RenderAllChanges() have their own RegionRenderers, but share the caches
+    std::mutex region_renderer_mutex_;
+    std::thread prewarm_thread_;
+    std::atomic<bool> prewarm_cancelled_{false};
+
+    // RenderAllChanges() renders on worker threads if there are at least kParallelRenderMinCaptions captions
+    static constexpr size_t kParallelRenderMinCaptions = 8;
+    static constexpr unsigned kMaxRenderWorkers = 4;
+    std::vector<std::unique_ptr<RegionRenderer>> render_workers_;
+
+    // Set while RenderAllChanges() is calling back, workers are walking captions_ meanwhile
+    // Calls changing the storage or rendering are rejected in this state
+    bool rendering_all_changes_ = false;
+
+    // Serialized region content & rendering parameters => Rendered region image, guarded by region_renderer_mutex_
+    // An empty image indicates the region is too small to be rendered
+    static constexpr size_t kDefaultRegionCacheMemoryLimit = 16 * 1024 * 1024;  // in bytes
+    LRUCache<std::string, Image> region_image_cache_{kDefaultRegionCacheMemoryLimit};
+
+    // Caption PTS => Region layouts for each caption area, guarded by region_renderer_mutex_
+    // Entries are dropped once the caption at the PTS is replaced, or settings affecting layouts are changed
+    static constexpr size_t kLayoutCacheMemoryLimit = 1024 * 1024;  // in bytes
+    LRUCache<int64_t, std::vector<CaptionLayout>> layout_cache_{kLayoutCacheMemoryLimit};
+
+    // Bumped on every change of settings that affect rendered images, mixed into content IDs
+    uint64_t render_settings_serial_ = 0;
+
     bool has_prev_rendered_caption_ = false;
     int64_t prev_rendered_caption_pts_ = PTS_NOPTS;
     int64_t prev_rendered_caption_duration_ = 0;
     std::vector<Image> prev_rendered_images_;
+    uint64_t rendered_images_serial_ = 0;  // Bumped every time prev_rendered_images_ is replaced by new images
+
+    // Output of Render(), RenderInto() always renders images
+    RenderOutputMode output_mode_ = RenderOutputMode::kImages;
+    RenderOutputMode prev_rendered_output_mode_ = RenderOutputMode::kImages;
+    std::vector<RenderQuad> prev_rendered_quads_;
+
+    // Glyph cells referenced by quads, created on first use and guarded by region_renderer_mutex_
+    static constexpr int kGlyphAtlasSize = 2048;
+    std::unique_ptr<GlyphAtlas> glyph_atlas_;
+
+    // Output pixel format of Render(), images are always rendered in kRGBA8888 and converted afterwards
+    PixelFormat pixel_format_ = PixelFormat::kRGBA8888;
+    std::vector<Image> converted_images_;
+    uint64_t converted_images_serial_ = 0;  // Serial of prev_rendered_images_ converted into converted_images_
+
+    // State of the caller-provided buffer used by RenderInto()
+    uint64_t rendered_into_serial_ = 0;    // Serial of images drawn into the buffer, 0 for none
+    Rect rendered_into_rect_;
+    std::vector<ColorRGBA> rendered_into_line_;  // Scratch line for pixel format conversion
 };
 
 }  // namespace aribcaption::internal
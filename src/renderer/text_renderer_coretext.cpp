@@ -69,6 +69,11 @@ public:
     ScopedCFRef<CGContextRef> cg_context;
 };
 
+void TextRendererCoreText::SetStrokeMode(StrokeMode mode) {
+    (void)mode;
+    // No-OP, stroke text is always drawn by the system text rendering API
+}
+
 auto TextRendererCoreText::BeginDraw(Bitmap& target_bmp) -> TextRenderContext {
     ScopedCFRef<CGContextRef> ctx = CreateBitmapTargetCGContext(target_bmp);
 
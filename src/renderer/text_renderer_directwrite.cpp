@@ -283,6 +283,11 @@ public:
     ComPtr<ID2D1RenderTarget> d2d_render_target;
 };
 
+void TextRendererDirectWrite::SetStrokeMode(StrokeMode mode) {
+    (void)mode;
+    // No-OP, stroke text is always drawn by the system text rendering API
+}
+
 auto TextRendererDirectWrite::BeginDraw(Bitmap& target_bmp) -> TextRenderContext {
     auto priv = std::make_unique<TextRenderContextPrivateDirectWrite>();
     // Create WIC bitmap
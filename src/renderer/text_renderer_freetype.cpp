@@ -16,23 +16,23 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <cstdint>
 #include <cmath>
 #include "base/scoped_holder.hpp"
 #include "base/utf_helper.hpp"
-#include "renderer/alphablend.hpp"
 #include "renderer/canvas.hpp"
+#include "renderer/morphology.hpp"
 #include "renderer/text_renderer_freetype.hpp"
-#include FT_STROKER_H
 #include FT_SFNT_NAMES_H
 #include FT_TRUETYPE_IDS_H
 
 namespace aribcaption {
 
 TextRendererFreetype::TextRendererFreetype(Context& context, FontProvider& font_provider) :
-      log_(GetContextLogger(context)), font_provider_(font_provider) {}
+      log_(GetContextLogger(context)), font_provider_(font_provider), glyph_cache_(kGlyphCacheCapacity) {}
 
 TextRendererFreetype::~TextRendererFreetype() = default;
 
@@ -72,6 +72,14 @@ bool TextRendererFreetype::SetFontFamily(const std::vector<std::string>& font_fa
     return true;
 }
 
+void TextRendererFreetype::SetStrokeMode(StrokeMode mode) {
+    if (stroke_mode_ != mode) {
+        // Cached stroke borders were generated by the previous method
+        glyph_cache_.Clear();
+    }
+    stroke_mode_ = mode;
+}
+
 auto TextRendererFreetype::BeginDraw(Bitmap& target_bmp) -> TextRenderContext {
     return TextRenderContext(target_bmp);
 }
@@ -108,9 +116,11 @@ auto TextRendererFreetype::DrawChar(TextRenderContext& render_ctx, int target_x,
         std::pair<FT_Face, size_t>& pair = result.value();
         main_face_ = ScopedHolder<FT_Face>(pair.first, FT_Done_Face);
         main_face_index_ = pair.second;
+        main_face_id_ = next_face_id_++;
     }
 
     FT_Face face = main_face_;
+    uint32_t face_id = main_face_id_;
     FT_UInt glyph_index = FT_Get_Char_Index(face, ucs4);
 
     if (glyph_index == 0) {
@@ -123,6 +133,7 @@ auto TextRendererFreetype::DrawChar(TextRenderContext& render_ctx, int target_x,
         // Missing glyph, check fallback face
         if (fallback_face_ && (glyph_index = FT_Get_Char_Index(fallback_face_, ucs4))) {
             face = fallback_face_;
+            face_id = fallback_face_id_;
         } else if (main_face_index_ + 1 >= font_family_.size()) {
             // Fallback fonts not available
             return TextRenderStatus::kCodePointNotFound;
@@ -136,9 +147,11 @@ auto TextRendererFreetype::DrawChar(TextRenderContext& render_ctx, int target_x,
             }
             std::pair<FT_Face, size_t>& pair = result.value();
             fallback_face_ = ScopedHolder<FT_Face>(pair.first, FT_Done_Face);
+            fallback_face_id_ = next_face_id_++;
 
             // Use this fallback fontface for rendering this time
             face = fallback_face_;
+            face_id = fallback_face_id_;
             glyph_index = FT_Get_Char_Index(face, ucs4);
             if (glyph_index == 0) {
                 log_->e("Freetype: Got glyph_index == 0 for U+%04X in fallback font", ucs4);
@@ -147,64 +160,49 @@ auto TextRendererFreetype::DrawChar(TextRenderContext& render_ctx, int target_x,
         }
     }
 
-    if (FT_Set_Pixel_Sizes(face, static_cast<FT_UInt>(char_width), static_cast<FT_UInt>(char_height))) {
-        log_->e("Freetype: FT_Set_Pixel_Sizes failed");
-        return TextRenderStatus::kOtherError;
+    // Rasterized glyphs are cached, repeated characters won't be loaded and rendered by Freetype again
+    GlyphCacheKey cache_key{face_id, glyph_index, char_width, char_height};
+    CachedGlyph* glyph = glyph_cache_.Get(cache_key);
+    if (!glyph) {
+        auto result = RasterizeGlyph(face, glyph_index, char_width, char_height);
+        if (result.is_err()) {
+            return result.error();
+        }
+        size_t cost = result.value().GetMemoryCost();
+        glyph = &glyph_cache_.Put(cache_key, std::move(result.value()), cost);
     }
 
-    int baseline = static_cast<int>(face->size->metrics.ascender >> 6);
-    int ascender = static_cast<int>(face->size->metrics.ascender >> 6);
-    int descender = static_cast<int>(face->size->metrics.descender >> 6);
-    int underline = static_cast<int>(FT_MulFix(face->underline_position, face->size->metrics.x_scale) >> 6);
-    int underline_thickness = static_cast<int>(FT_MulFix(face->underline_thickness, face->size->metrics.x_scale) >> 6);
+    int baseline = glyph->baseline;
+    int ascender = glyph->ascender;
+    int descender = glyph->descender;
+    int underline = glyph->underline;
+    int underline_thickness = glyph->underline_thickness;
 
     int em_height = ascender + std::abs(descender);
     int em_adjust_y = (char_height - em_height) / 2;
 
-    if (FT_Load_Glyph(face, glyph_index, FT_LOAD_NO_BITMAP)) {
-        log_->e("Freetype: FT_Load_Glyph failed");
-        return TextRenderStatus::kOtherError;
-    }
-
-    // Generate glyph bitmap for filling
-    ScopedHolder<FT_Glyph> glyph_image(nullptr, FT_Done_Glyph);
-    if (FT_Get_Glyph(face->glyph, &glyph_image)) {
-        log_->e("Freetype: FT_Get_Glyph failed");
-        return TextRenderStatus::kOtherError;
-    }
-
-    if (FT_Glyph_To_Bitmap(&glyph_image, FT_RENDER_MODE_NORMAL, nullptr, true)) {
-        log_->e("Freetype: FT_Glyph_To_Bitmap failed");
-        return TextRenderStatus::kOtherError;
-    }
-
-    ScopedHolder<FT_Glyph> border_glyph_image(nullptr, FT_Done_Glyph);
+    const GlyphMask* border = nullptr;
 
     // If we need stroke text (border)
     if (style & CharStyle::kCharStyleStroke && stroke_width > 0.0f) {
-        // Generate glyph bitmap for stroke border
-        ScopedHolder<FT_Glyph> stroke_glyph(nullptr, FT_Done_Glyph);
-        if (FT_Get_Glyph(face->glyph, &stroke_glyph)) {
-            log_->e("Freetype: FT_Get_Glyph failed");
-            return TextRenderStatus::kOtherError;
-        }
-
-        ScopedHolder<FT_Stroker> stroker(nullptr, FT_Stroker_Done);
-        FT_Stroker_New(library_, &stroker);
-        FT_Stroker_Set(stroker,
-                       static_cast<FT_Fixed>(stroke_width * 64),
-                       FT_STROKER_LINECAP_ROUND,
-                       FT_STROKER_LINEJOIN_ROUND,
-                       0);
-
-        FT_Glyph_StrokeBorder(&stroke_glyph, stroker, false, true);
-
-        if (FT_Glyph_To_Bitmap(&stroke_glyph, FT_RENDER_MODE_NORMAL, nullptr, true)) {
-            log_->e("Freetype: FT_Glyph_To_Bitmap failed");
-            return TextRenderStatus::kOtherError;
+        auto radius = static_cast<FT_Fixed>(stroke_width * 64);
+        auto iter = std::find_if(glyph->borders.begin(), glyph->borders.end(),
+                                 [radius](const auto& pair) { return pair.first == radius; });
+        if (iter != glyph->borders.end()) {
+            border = &iter->second;
+        } else {
+            if (stroke_mode_ == StrokeMode::kDilation) {
+                glyph->borders.emplace_back(radius, DilateGlyphMask(glyph->fill, radius));
+            } else {
+                auto result = RasterizeBorder(face, glyph_index, char_width, char_height, radius);
+                if (result.is_err()) {
+                    return result.error();
+                }
+                glyph->borders.emplace_back(radius, std::move(result.value()));
+            }
+            border = &glyph->borders.back().second;
+            glyph_cache_.UpdateCost(cache_key, glyph->GetMemoryCost());
         }
-
-        border_glyph_image = std::move(stroke_glyph);
     }
 
     Canvas canvas(render_ctx.GetBitmap());
@@ -231,40 +229,158 @@ auto TextRendererFreetype::DrawChar(TextRenderContext& render_ctx, int target_x,
     }
 
     // Draw stroke border bitmap, if required
-    if (border_glyph_image) {
-        auto border_bitmap_glyph = reinterpret_cast<FT_BitmapGlyph>(border_glyph_image.Get());
-        int start_x = target_x + border_bitmap_glyph->left;
-        int start_y = target_y + baseline + em_adjust_y - border_bitmap_glyph->top;
+    if (border && border->width > 0 && border->rows > 0) {
+        int start_x = target_x + border->left;
+        int start_y = target_y + baseline + em_adjust_y - border->top;
 
-        Bitmap bmp = FTBitmapToColoredBitmap(border_bitmap_glyph->bitmap, stroke_color);
-        canvas.DrawBitmap(bmp, start_x, start_y);
+        canvas.DrawAlphaMask(border->alphas.data(), border->width, border->rows, border->width,
+                             stroke_color, start_x, start_y);
     }
 
     // Draw filling bitmap
-    if (glyph_image) {
-        auto bitmap_glyph = reinterpret_cast<FT_BitmapGlyph>(glyph_image.Get());
-        int start_x = target_x + bitmap_glyph->left;
-        int start_y = target_y + baseline + em_adjust_y - bitmap_glyph->top;
+    const GlyphMask& fill = glyph->fill;
+    if (fill.width > 0 && fill.rows > 0) {
+        int start_x = target_x + fill.left;
+        int start_y = target_y + baseline + em_adjust_y - fill.top;
 
-        Bitmap bmp = FTBitmapToColoredBitmap(bitmap_glyph->bitmap, color);
-        canvas.DrawBitmap(bmp, start_x, start_y);
+        canvas.DrawAlphaMask(fill.alphas.data(), fill.width, fill.rows, fill.width, color, start_x, start_y);
     }
 
     return TextRenderStatus::kOK;
 }
 
-Bitmap TextRendererFreetype::FTBitmapToColoredBitmap(const FT_Bitmap& ft_bmp, ColorRGBA color) {
-    Bitmap bitmap(static_cast<int>(ft_bmp.width), static_cast<int>(ft_bmp.rows), PixelFormat::kRGBA8888);
+auto TextRendererFreetype::LoadGlyph(FT_Face face, FT_UInt glyph_index, int char_width, int char_height)
+        -> TextRenderStatus {
+    if (FT_Set_Pixel_Sizes(face, static_cast<FT_UInt>(char_width), static_cast<FT_UInt>(char_height))) {
+        log_->e("Freetype: FT_Set_Pixel_Sizes failed");
+        return TextRenderStatus::kOtherError;
+    }
+
+    if (FT_Load_Glyph(face, glyph_index, FT_LOAD_NO_BITMAP)) {
+        log_->e("Freetype: FT_Load_Glyph failed");
+        return TextRenderStatus::kOtherError;
+    }
+
+    return TextRenderStatus::kOK;
+}
+
+auto TextRendererFreetype::RasterizeGlyph(FT_Face face, FT_UInt glyph_index, int char_width, int char_height)
+        -> Result<CachedGlyph, TextRenderStatus> {
+    if (TextRenderStatus status = LoadGlyph(face, glyph_index, char_width, char_height);
+            status != TextRenderStatus::kOK) {
+        return Err(status);
+    }
+
+    CachedGlyph glyph;
+    glyph.baseline = static_cast<int>(face->size->metrics.ascender >> 6);
+    glyph.ascender = static_cast<int>(face->size->metrics.ascender >> 6);
+    glyph.descender = static_cast<int>(face->size->metrics.descender >> 6);
+    glyph.underline = static_cast<int>(FT_MulFix(face->underline_position, face->size->metrics.x_scale) >> 6);
+    glyph.underline_thickness =
+        static_cast<int>(FT_MulFix(face->underline_thickness, face->size->metrics.x_scale) >> 6);
+
+    // Generate glyph bitmap for filling
+    ScopedHolder<FT_Glyph> glyph_image(nullptr, FT_Done_Glyph);
+    if (FT_Get_Glyph(face->glyph, &glyph_image)) {
+        log_->e("Freetype: FT_Get_Glyph failed");
+        return Err(TextRenderStatus::kOtherError);
+    }
+
+    if (FT_Glyph_To_Bitmap(&glyph_image, FT_RENDER_MODE_NORMAL, nullptr, true)) {
+        log_->e("Freetype: FT_Glyph_To_Bitmap failed");
+        return Err(TextRenderStatus::kOtherError);
+    }
+
+    glyph.fill = BitmapGlyphToMask(reinterpret_cast<FT_BitmapGlyph>(glyph_image.Get()));
+
+    return Ok(std::move(glyph));
+}
+
+auto TextRendererFreetype::RasterizeBorder(FT_Face face, FT_UInt glyph_index, int char_width, int char_height,
+                                           FT_Fixed radius) -> Result<GlyphMask, TextRenderStatus> {
+    // Stroker works on the outline, so the glyph must be loaded into the glyph slot
+    if (TextRenderStatus status = LoadGlyph(face, glyph_index, char_width, char_height);
+            status != TextRenderStatus::kOK) {
+        return Err(status);
+    }
+
+    FT_Stroker stroker = GetStroker(radius);
+    if (!stroker) {
+        return Err(TextRenderStatus::kOtherError);
+    }
+
+    // Generate glyph bitmap for stroke border
+    ScopedHolder<FT_Glyph> stroke_glyph(nullptr, FT_Done_Glyph);
+    if (FT_Get_Glyph(face->glyph, &stroke_glyph)) {
+        log_->e("Freetype: FT_Get_Glyph failed");
+        return Err(TextRenderStatus::kOtherError);
+    }
+
+    FT_Glyph_StrokeBorder(&stroke_glyph, stroker, false, true);
+
+    if (FT_Glyph_To_Bitmap(&stroke_glyph, FT_RENDER_MODE_NORMAL, nullptr, true)) {
+        log_->e("Freetype: FT_Glyph_To_Bitmap failed");
+        return Err(TextRenderStatus::kOtherError);
+    }
+
+    return Ok(BitmapGlyphToMask(reinterpret_cast<FT_BitmapGlyph>(stroke_glyph.Get())));
+}
+
+auto TextRendererFreetype::GetStroker(FT_Fixed radius) -> FT_Stroker {
+    // The stroker is created once and reused, it only needs to be reconfigured if stroke width changes
+    if (!stroker_) {
+        FT_Stroker stroker = nullptr;
+        if (FT_Stroker_New(library_, &stroker)) {
+            log_->e("Freetype: FT_Stroker_New failed");
+            return nullptr;
+        }
+        stroker_ = ScopedHolder<FT_Stroker>(stroker, FT_Stroker_Done);
+        stroker_radius_ = -1;
+    }
+
+    if (stroker_radius_ != radius) {
+        FT_Stroker_Set(stroker_,
+                       radius,
+                       FT_STROKER_LINECAP_ROUND,
+                       FT_STROKER_LINEJOIN_ROUND,
+                       0);
+        stroker_radius_ = radius;
+    }
+
+    return stroker_;
+}
+
+auto TextRendererFreetype::DilateGlyphMask(const GlyphMask& fill, FT_Fixed radius) -> GlyphMask {
+    float radius_px = static_cast<float>(radius) / 64.0f;
+    int padding = morphology::GetDilationPadding(radius_px);
+    morphology::AlphaMask dilated = morphology::DilateMask(fill.alphas.data(), fill.width, fill.rows, fill.width,
+                                                           radius_px);
+
+    GlyphMask mask;
+    mask.left = fill.left - padding;
+    mask.top = fill.top + padding;
+    mask.width = dilated.width;
+    mask.rows = dilated.height;
+    mask.alphas = std::move(dilated.alphas);
+    return mask;
+}
+
+auto TextRendererFreetype::BitmapGlyphToMask(FT_BitmapGlyph bitmap_glyph) -> GlyphMask {
+    const FT_Bitmap& ft_bmp = bitmap_glyph->bitmap;
 
-    for (uint32_t y = 0; y < ft_bmp.rows; y++) {
-        uint32_t src_index = y * ft_bmp.pitch;
-        const uint8_t* src = &ft_bmp.buffer[src_index];
-        ColorRGBA* dest = bitmap.GetPixelAt(0, static_cast<int>(y));
+    GlyphMask mask;
+    mask.left = bitmap_glyph->left;
+    mask.top = bitmap_glyph->top;
+    mask.width = static_cast<int>(ft_bmp.width);
+    mask.rows = static_cast<int>(ft_bmp.rows);
+    mask.alphas.resize(static_cast<size_t>(mask.width) * mask.rows);
 
-        alphablend::FillLineWithAlphas(dest, src, color, ft_bmp.width);
+    for (int y = 0; y < mask.rows; y++) {
+        const uint8_t* src = ft_bmp.buffer + static_cast<ptrdiff_t>(y) * ft_bmp.pitch;
+        std::memcpy(&mask.alphas[static_cast<size_t>(y) * mask.width], src, mask.width);
     }
 
-    return bitmap;
+    return mask;
 }
 
 static bool MatchFontFamilyName(FT_Face face, const std::string& family_name) {
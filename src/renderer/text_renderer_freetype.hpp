@@ -21,6 +21,10 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_GLYPH_H
+#include FT_STROKER_H
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <optional>
@@ -29,6 +33,7 @@
 #include "aribcaption/color.hpp"
 #include "aribcaption/context.hpp"
 #include "base/logger.hpp"
+#include "base/lru_cache.hpp"
 #include "base/result.hpp"
 #include "base/scoped_holder.hpp"
 #include "renderer/bitmap.hpp"
@@ -45,6 +50,7 @@ public:
     bool Initialize() override;
     void SetLanguage(uint32_t iso6392_language_code) override;
     bool SetFontFamily(const std::vector<std::string>& font_family) override;
+    void SetStrokeMode(StrokeMode mode) override;
     auto BeginDraw(Bitmap& target_bmp) -> TextRenderContext override;
     void EndDraw(TextRenderContext& context) override;
     auto DrawChar(TextRenderContext& render_ctx, int x, int y,
@@ -53,7 +59,68 @@ public:
                   std::optional<UnderlineInfo> underline_info,
                   TextRenderFallbackPolicy fallback_policy) -> TextRenderStatus override;
 private:
-    static Bitmap FTBitmapToColoredBitmap(const FT_Bitmap& ft_bmp, ColorRGBA color);
+    // Identifies a rasterized glyph, face_id is a serial number assigned to each loaded FT_Face
+    struct GlyphCacheKey {
+        uint32_t face_id = 0;
+        uint32_t glyph_index = 0;
+        int char_width = 0;
+        int char_height = 0;
+
+        bool operator==(const GlyphCacheKey& rhs) const {
+            return face_id == rhs.face_id && glyph_index == rhs.glyph_index &&
+                   char_width == rhs.char_width && char_height == rhs.char_height;
+        }
+    };
+
+    struct GlyphCacheKeyHash {
+        size_t operator()(const GlyphCacheKey& key) const {
+            uint64_t h = (static_cast<uint64_t>(key.face_id) << 32) | key.glyph_index;
+            h ^= (static_cast<uint64_t>(static_cast<uint32_t>(key.char_width)) << 16) ^
+                 static_cast<uint64_t>(static_cast<uint32_t>(key.char_height)) * 0x9E3779B97F4A7C15ull;
+            return std::hash<uint64_t>{}(h);
+        }
+    };
+
+    // Rasterized 8-bit coverage mask
+    struct GlyphMask {
+        int left = 0;
+        int top = 0;
+        int width = 0;
+        int rows = 0;
+        std::vector<uint8_t> alphas;  // width * rows, tightly packed
+    };
+
+    // Filling mask of a glyph, stroke border masks and face metrics at this pixel size
+    struct CachedGlyph {
+        GlyphMask fill;
+        std::vector<std::pair<FT_Fixed, GlyphMask>> borders;  // stroke radius (26.6) => border mask
+
+        int baseline = 0;
+        int ascender = 0;
+        int descender = 0;
+        int underline = 0;
+        int underline_thickness = 0;
+
+        [[nodiscard]]
+        size_t GetMemoryCost() const {
+            size_t cost = sizeof(CachedGlyph) + fill.alphas.size();
+            for (const auto& [radius, border] : borders) {
+                cost += sizeof(border) + border.alphas.size();
+            }
+            return cost;
+        }
+    };
+
+    static constexpr size_t kGlyphCacheCapacity = 8 * 1024 * 1024;  // in bytes
+private:
+    static GlyphMask BitmapGlyphToMask(FT_BitmapGlyph bitmap_glyph);
+    static GlyphMask DilateGlyphMask(const GlyphMask& fill, FT_Fixed radius);
+    auto LoadGlyph(FT_Face face, FT_UInt glyph_index, int char_width, int char_height) -> TextRenderStatus;
+    auto RasterizeGlyph(FT_Face face, FT_UInt glyph_index, int char_width, int char_height)
+        -> Result<CachedGlyph, TextRenderStatus>;
+    auto RasterizeBorder(FT_Face face, FT_UInt glyph_index, int char_width, int char_height, FT_Fixed radius)
+        -> Result<GlyphMask, TextRenderStatus>;
+    auto GetStroker(FT_Fixed radius) -> FT_Stroker;
     auto LoadFontFace(bool is_fallback,
                       std::optional<uint32_t> codepoint = std::nullopt,
                       std::optional<size_t> begin_index = std::nullopt)
@@ -63,13 +130,22 @@ private:
 
     FontProvider& font_provider_;
     std::vector<std::string> font_family_;
+    StrokeMode stroke_mode_ = StrokeMode::kOutline;
 
     ScopedHolder<FT_Library> library_;
+    ScopedHolder<FT_Stroker> stroker_;
+    FT_Fixed stroker_radius_ = -1;
     ScopedHolder<FT_Face> main_face_;
     ScopedHolder<FT_Face> fallback_face_;
     std::vector<uint8_t> main_face_data_;
     std::vector<uint8_t> fallback_face_data_;
     size_t main_face_index_ = 0;
+
+    uint32_t main_face_id_ = 0;
+    uint32_t fallback_face_id_ = 0;
+    uint32_t next_face_id_ = 1;
+
+    LRUCache<GlyphCacheKey, CachedGlyph, GlyphCacheKeyHash> glyph_cache_;
 };
 
 }  // namespace aribcaption
@@ -0,0 +1,406 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include "base/always_inline.hpp"
+#include "renderer/rect.hpp"
+#include "renderer/yuv_blend.hpp"
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    #include <emmintrin.h>  // SSE2
+    #if defined(__SSE2__) || defined(_MSC_VER)
+        #define ARIBCC_YUV_BLEND_SSE2
+    #endif
+#endif
+
+namespace aribcaption::yuvblend {
+
+namespace {
+
+constexpr int kCoefficientBits = 13;
+constexpr int32_t kCoefficientRound = 1 << (kCoefficientBits - 1);
+
+// RGB => YUV conversion coefficients in fixed-point (kCoefficientBits), targeting samples of the frame's bit depth
+struct Coefficients {
+    int32_t yr = 0, yg = 0, yb = 0;
+    int32_t ur = 0, ug = 0, ub = 0;
+    int32_t vr = 0, vg = 0, vb = 0;
+    int32_t y_offset = 0;
+    int32_t c_offset = 0;
+    int32_t max_value = 0;
+};
+
+Coefficients CalcCoefficients(YUVColorMatrix matrix, YUVColorRange range, int bit_depth) {
+    double kr = 0.2126;
+    double kb = 0.0722;
+    if (matrix == YUVColorMatrix::kBT601) {
+        kr = 0.299;
+        kb = 0.114;
+    }
+    double kg = 1.0 - kr - kb;
+
+    int max_value = (1 << bit_depth) - 1;
+    double y_scale = 0.0;
+    double c_scale = 0.0;
+    int y_offset = 0;
+
+    if (range == YUVColorRange::kLimited) {
+        // 219 / 224 steps at 8-bit, scaled by 2^(bit_depth - 8)
+        double depth_scale = static_cast<double>(1 << (bit_depth - 8));
+        y_scale = 219.0 * depth_scale / 255.0;
+        c_scale = 224.0 * depth_scale / 255.0;
+        y_offset = 16 << (bit_depth - 8);
+    } else {
+        y_scale = static_cast<double>(max_value) / 255.0;
+        c_scale = static_cast<double>(max_value) / 255.0;
+    }
+
+    auto fixed = [](double value) {
+        return static_cast<int32_t>(std::lround(value * (1 << kCoefficientBits)));
+    };
+
+    Coefficients c;
+    c.yr = fixed(kr * y_scale);
+    c.yg = fixed(kg * y_scale);
+    c.yb = fixed(kb * y_scale);
+    c.ur = fixed(-0.5 * kr / (1.0 - kb) * c_scale);
+    c.ug = fixed(-0.5 * kg / (1.0 - kb) * c_scale);
+    c.ub = fixed(0.5 * c_scale);
+    c.vr = fixed(0.5 * c_scale);
+    c.vg = fixed(-0.5 * kg / (1.0 - kr) * c_scale);
+    c.vb = fixed(-0.5 * kb / (1.0 - kr) * c_scale);
+    c.y_offset = y_offset;
+    c.c_offset = 128 << (bit_depth - 8);
+    c.max_value = max_value;
+    return c;
+}
+
+// Rounded x / 255 for x in [0, 255 * 1023], same approximation as the SIMD path
+ALWAYS_INLINE int32_t DivideBy255(int32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// Samples are stored in Sample type, shifted left by kShift bits (e.g. P010)
+template <typename Sample, int kShift>
+ALWAYS_INLINE int32_t LoadSample(const Sample* sample) {
+    return static_cast<int32_t>(*sample) >> kShift;
+}
+
+template <typename Sample, int kShift>
+ALWAYS_INLINE void StoreSample(Sample* sample, int32_t value) {
+    *sample = static_cast<Sample>(value << kShift);
+}
+
+template <typename Sample, int kShift>
+void BlendLumaLine(Sample* __restrict dest, const uint8_t* __restrict rgba, int width, const Coefficients& c) {
+    int i = 0;
+#if defined(ARIBCC_YUV_BLEND_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask_0xff = _mm_set1_epi32(0xFF);
+    const __m128i coef_rg = _mm_set1_epi32((c.yg << 16) | c.yr);
+    const __m128i coef_b_round = _mm_set1_epi32((kCoefficientRound << 16) | c.yb);
+    const __m128i one_hi = _mm_set1_epi32(1 << 16);
+    const __m128i y_offset = _mm_set1_epi32(c.y_offset);
+    const __m128i const_255 = _mm_set1_epi32(255);
+    const __m128i const_128 = _mm_set1_epi32(128);
+    const __m128i max_value = _mm_set1_epi16(static_cast<int16_t>(c.max_value));
+
+    for (; i + 4 <= width; i += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 4));
+        __m128i a = _mm_srli_epi32(pixels, 24);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, zero)) == 0xFFFF) {
+            continue;  // Fully transparent
+        }
+
+        __m128i r = _mm_and_si128(pixels, mask_0xff);
+        __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask_0xff);
+        __m128i b = _mm_and_si128(_mm_srli_epi32(pixels, 16), mask_0xff);
+
+        // Y = (yr * R + yg * G + yb * B + round) >> bits + offset
+        __m128i rg = _mm_or_si128(r, _mm_slli_epi32(g, 16));
+        __m128i b1 = _mm_or_si128(b, one_hi);
+        __m128i y_sum = _mm_add_epi32(_mm_madd_epi16(rg, coef_rg), _mm_madd_epi16(b1, coef_b_round));
+        __m128i y_src = _mm_add_epi32(_mm_srai_epi32(y_sum, kCoefficientBits), y_offset);
+
+        __m128i y_dst;
+        if constexpr (sizeof(Sample) == 1) {
+            int32_t packed;
+            memcpy(&packed, dest + i, sizeof(packed));
+            y_dst = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+        } else {
+            y_dst = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(dest + i)), zero);
+            y_dst = _mm_srli_epi32(y_dst, kShift);
+        }
+
+        // Y = (Y_src * A + Y_dst * (255 - A)) / 255
+        __m128i pair = _mm_or_si128(y_src, _mm_slli_epi32(y_dst, 16));
+        __m128i weights = _mm_or_si128(a, _mm_slli_epi32(_mm_sub_epi32(const_255, a), 16));
+        __m128i x = _mm_add_epi32(_mm_madd_epi16(pair, weights), const_128);
+        __m128i y = _mm_srli_epi32(_mm_add_epi32(x, _mm_srli_epi32(x, 8)), 8);
+
+        __m128i y16 = _mm_min_epi16(_mm_packs_epi32(y, y), max_value);
+        if constexpr (sizeof(Sample) == 1) {
+            auto packed = _mm_cvtsi128_si32(_mm_packus_epi16(y16, y16));
+            memcpy(dest + i, &packed, sizeof(packed));
+        } else {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + i), _mm_slli_epi16(y16, kShift));
+        }
+    }
+#endif
+    for (; i < width; i++) {
+        const uint8_t* pixel = rgba + i * 4;
+        int32_t a = pixel[3];
+        if (a == 0) {
+            continue;
+        }
+
+        int32_t y_src = ((c.yr * pixel[0] + c.yg * pixel[1] + c.yb * pixel[2] + kCoefficientRound)
+                         >> kCoefficientBits) + c.y_offset;
+        int32_t y_dst = LoadSample<Sample, kShift>(dest + i);
+        int32_t y = DivideBy255(y_src * a + y_dst * (255 - a));
+        StoreSample<Sample, kShift>(dest + i, std::min(y, c.max_value));
+    }
+}
+
+// Blend chroma samples of a line of 2x2 blocks
+// u_dest / v_dest point to the chroma sample of the first block, sample_step is 1 for planar and 2 for interleaved
+// rows are the bitmap lines covered by the blocks (nullptr if outside the bitmap), bitmap columns in [begin_x, end_x)
+// are valid. pixels_per_block is the count of luma pixels inside the frame covered by each block.
+template <typename Sample, int kShift>
+void BlendChromaLine(Sample* u_dest, Sample* v_dest, int sample_step,
+                     const uint8_t* const rows[2], int block_count, int first_block_x, int begin_x, int end_x,
+                     int pixels_per_block, const Coefficients& c) {
+    // Divide by (255 * pixels_per_block) through multiplication, exact for dividends below 2^24
+    constexpr int kReciprocalBits = 40;
+    const int64_t denominator = static_cast<int64_t>(pixels_per_block) * 255;
+    const int64_t half_denominator = denominator / 2;
+    const int64_t reciprocal = ((int64_t{1} << kReciprocalBits) + denominator - 1) / denominator;
+
+    for (int block = 0; block < block_count; block++) {
+        int64_t sum_a = 0;
+        int64_t sum_r = 0;
+        int64_t sum_g = 0;
+        int64_t sum_b = 0;
+
+        int x = first_block_x + block * 2;
+        if (rows[0] && rows[1] && x >= begin_x && x + 2 <= end_x) {
+            // Block is fully inside the bitmap
+            const uint8_t* p0 = rows[0] + x * 4;
+            const uint8_t* p1 = rows[1] + x * 4;
+            uint32_t a[4] = {p0[3], p0[7], p1[3], p1[7]};
+            if ((a[0] | a[1] | a[2] | a[3]) == 0) {
+                continue;  // Fully transparent
+            }
+
+            sum_a = a[0] + a[1] + a[2] + a[3];
+            sum_r = a[0] * p0[0] + a[1] * p0[4] + a[2] * p1[0] + a[3] * p1[4];
+            sum_g = a[0] * p0[1] + a[1] * p0[5] + a[2] * p1[1] + a[3] * p1[5];
+            sum_b = a[0] * p0[2] + a[1] * p0[6] + a[2] * p1[2] + a[3] * p1[6];
+        } else {
+            for (int dx = 0; dx < 2; dx++, x++) {
+                if (x < begin_x || x >= end_x) {
+                    continue;
+                }
+                for (int dy = 0; dy < 2; dy++) {
+                    if (!rows[dy]) {
+                        continue;
+                    }
+                    const uint8_t* pixel = rows[dy] + x * 4;
+                    int64_t a = pixel[3];
+                    sum_a += a;
+                    sum_r += a * pixel[0];
+                    sum_g += a * pixel[1];
+                    sum_b += a * pixel[2];
+                }
+            }
+        }
+        if (sum_a == 0) {
+            continue;
+        }
+
+        const int64_t dest_weight = static_cast<int64_t>(pixels_per_block) * 255 - sum_a;
+
+        Sample* u = u_dest + block * sample_step;
+        Sample* v = v_dest + block * sample_step;
+
+        // Alpha-weighted sums of source and destination samples, in sample units * 255 * pixels_per_block
+        int64_t u_sum = ((static_cast<int64_t>(c.c_offset) * sum_a << kCoefficientBits) +
+                         c.ur * sum_r + c.ug * sum_g + c.ub * sum_b + kCoefficientRound) >> kCoefficientBits;
+        int64_t v_sum = ((static_cast<int64_t>(c.c_offset) * sum_a << kCoefficientBits) +
+                         c.vr * sum_r + c.vg * sum_g + c.vb * sum_b + kCoefficientRound) >> kCoefficientBits;
+        u_sum += dest_weight * LoadSample<Sample, kShift>(u);
+        v_sum += dest_weight * LoadSample<Sample, kShift>(v);
+
+        auto u_value = static_cast<int32_t>(((u_sum + half_denominator) * reciprocal) >> kReciprocalBits);
+        auto v_value = static_cast<int32_t>(((v_sum + half_denominator) * reciprocal) >> kReciprocalBits);
+
+        StoreSample<Sample, kShift>(u, std::clamp(u_value, 0, c.max_value));
+        StoreSample<Sample, kShift>(v, std::clamp(v_value, 0, c.max_value));
+    }
+}
+
+template <typename Sample, int kShift, bool kInterleaved>
+void BlendToFrame(const uint8_t* rgba, int stride, int dst_x, int dst_y, const Rect& clipped,
+                  const YUVFrame& frame, const Coefficients& c) {
+    // Luma
+    for (int y = clipped.top; y < clipped.bottom; y++) {
+        auto dest = reinterpret_cast<Sample*>(frame.planes[0] + static_cast<ptrdiff_t>(y) * frame.strides[0]);
+        const uint8_t* src = rgba + static_cast<ptrdiff_t>(y - dst_y) * stride +
+                             static_cast<ptrdiff_t>(clipped.left - dst_x) * 4;
+        BlendLumaLine<Sample, kShift>(dest + clipped.left, src, clipped.width(), c);
+    }
+
+    // Chroma, per 2x2 block
+    int block_left = clipped.left / 2;
+    int block_right = (clipped.right + 1) / 2;
+    int block_top = clipped.top / 2;
+    int block_bottom = (clipped.bottom + 1) / 2;
+
+    for (int block_y = block_top; block_y < block_bottom; block_y++) {
+        const uint8_t* rows[2] = {nullptr, nullptr};
+        int rows_in_frame = 0;
+        for (int dy = 0; dy < 2; dy++) {
+            int y = block_y * 2 + dy;
+            if (y < frame.height) {
+                rows_in_frame++;
+            }
+            if (y >= clipped.top && y < clipped.bottom) {
+                rows[dy] = rgba + static_cast<ptrdiff_t>(y - dst_y) * stride;
+            }
+        }
+
+        Sample* u_dest = nullptr;
+        Sample* v_dest = nullptr;
+        int sample_step = 1;
+        if constexpr (kInterleaved) {
+            auto uv = reinterpret_cast<Sample*>(frame.planes[1] + static_cast<ptrdiff_t>(block_y) * frame.strides[1]);
+            u_dest = uv + block_left * 2;
+            v_dest = uv + block_left * 2 + 1;
+            sample_step = 2;
+        } else {
+            auto u = reinterpret_cast<Sample*>(frame.planes[1] + static_cast<ptrdiff_t>(block_y) * frame.strides[1]);
+            auto v = reinterpret_cast<Sample*>(frame.planes[2] + static_cast<ptrdiff_t>(block_y) * frame.strides[2]);
+            u_dest = u + block_left;
+            v_dest = v + block_left;
+        }
+
+        // Blocks at the right edge of an odd-width frame only cover one column
+        int full_blocks = std::min(block_right, frame.width / 2) - block_left;
+        int begin_x = clipped.left - dst_x;
+        int end_x = clipped.right - dst_x;
+        int first_block_x = block_left * 2 - dst_x;  // relative to the bitmap
+
+        full_blocks = std::max(full_blocks, 0);
+        if (full_blocks > 0) {
+            BlendChromaLine<Sample, kShift>(u_dest, v_dest, sample_step, rows, full_blocks,
+                                            first_block_x, begin_x, end_x, rows_in_frame * 2, c);
+        }
+        if (block_right - block_left > full_blocks) {
+            BlendChromaLine<Sample, kShift>(u_dest + full_blocks * sample_step, v_dest + full_blocks * sample_step,
+                                            sample_step, rows, 1, first_block_x + full_blocks * 2, begin_x, end_x,
+                                            rows_in_frame, c);
+        }
+    }
+}
+
+}  // namespace
+
+bool BlendRGBAToYUVFrame(const uint8_t* rgba, int width, int height, int stride,
+                         int dst_x, int dst_y, const YUVFrame& frame) {
+    if (!rgba || width <= 0 || height <= 0 || stride < width * 4) {
+        return false;
+    }
+    if (frame.width <= 0 || frame.height <= 0 || !frame.planes[0] || !frame.planes[1]) {
+        return false;
+    }
+
+    bool interleaved = frame.format == YUVFormat::kNV12 || frame.format == YUVFormat::kP010;
+    if (!interleaved && !frame.planes[2]) {
+        return false;
+    }
+
+    Rect frame_rect(0, 0, frame.width, frame.height);
+    Rect clipped = Rect::ClipRect(frame_rect, Rect(dst_x, dst_y, dst_x + width, dst_y + height));
+    if (clipped.width() <= 0 || clipped.height() <= 0) {
+        return true;  // Nothing to do
+    }
+
+    switch (frame.format) {
+        case YUVFormat::kI420:
+            BlendToFrame<uint8_t, 0, false>(rgba, stride, dst_x, dst_y, clipped, frame,
+                                            CalcCoefficients(frame.color_matrix, frame.color_range, 8));
+            break;
+        case YUVFormat::kNV12:
+            BlendToFrame<uint8_t, 0, true>(rgba, stride, dst_x, dst_y, clipped, frame,
+                                           CalcCoefficients(frame.color_matrix, frame.color_range, 8));
+            break;
+        case YUVFormat::kI420P10:
+            BlendToFrame<uint16_t, 0, false>(rgba, stride, dst_x, dst_y, clipped, frame,
+                                             CalcCoefficients(frame.color_matrix, frame.color_range, 10));
+            break;
+        case YUVFormat::kP010:
+            BlendToFrame<uint16_t, 6, true>(rgba, stride, dst_x, dst_y, clipped, frame,
+                                            CalcCoefficients(frame.color_matrix, frame.color_range, 10));
+            break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+void ConvertColorToYUV(ColorRGBA color, YUVColorMatrix matrix, YUVColorRange range, uint8_t out_yuv[3]) {
+    Coefficients c = CalcCoefficients(matrix, range, 8);
+    int32_t y = ((c.yr * color.r + c.yg * color.g + c.yb * color.b + kCoefficientRound) >> kCoefficientBits)
+                + c.y_offset;
+    int32_t u = ((c.ur * color.r + c.ug * color.g + c.ub * color.b + kCoefficientRound) >> kCoefficientBits)
+                + c.c_offset;
+    int32_t v = ((c.vr * color.r + c.vg * color.g + c.vb * color.b + kCoefficientRound) >> kCoefficientBits)
+                + c.c_offset;
+    out_yuv[0] = static_cast<uint8_t>(std::clamp(y, 0, c.max_value));
+    out_yuv[1] = static_cast<uint8_t>(std::clamp(u, 0, c.max_value));
+    out_yuv[2] = static_cast<uint8_t>(std::clamp(v, 0, c.max_value));
+}
+
+}  // namespace aribcaption::yuvblend
+
+namespace aribcaption {
+
+bool BlendImageToYUVFrame(const Image& image, const YUVFrame& frame) {
+    if (image.pixel_format != PixelFormat::kRGBA8888 || image.bitmap.empty()) {
+        return false;
+    }
+    return yuvblend::BlendRGBAToYUVFrame(image.bitmap.data(), image.width, image.height, image.stride,
+                                         image.dst_x, image.dst_y, frame);
+}
+
+bool BlendImagesToYUVFrame(const std::vector<Image>& images, const YUVFrame& frame) {
+    for (const Image& image : images) {
+        if (!BlendImageToYUVFrame(image, frame)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace aribcaption
@@ -0,0 +1,46 @@
+
+/*
+ * Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+ *
+ * This file is part of libaribcaption.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef ARIBCAPTION_YUV_BLEND_HPP
+#define ARIBCAPTION_YUV_BLEND_HPP
+
+#include <cstdint>
+#include "aribcaption/image.hpp"
+
+namespace aribcaption::yuvblend {
+
+/**
+ * Alpha-blend a RGBA8888 bitmap onto a YUV 4:2:0 frame at (dst_x, dst_y), clipped to the frame
+ *
+ * Luma is blended per pixel, chroma per 2x2 block with the alpha-weighted average color of the block
+ * and the block's average alpha.
+ *
+ * @return false if the frame description is invalid
+ */
+bool BlendRGBAToYUVFrame(const uint8_t* rgba, int width, int height, int stride,
+                         int dst_x, int dst_y, const YUVFrame& frame);
+
+/**
+ * Convert a non-premultiplied color into 8-bit Y, U (Cb), V (Cr) samples, alpha is ignored
+ */
+void ConvertColorToYUV(ColorRGBA color, YUVColorMatrix matrix, YUVColorRange range, uint8_t out_yuv[3]);
+
+}  // namespace aribcaption::yuvblend
+
+#endif  // ARIBCAPTION_YUV_BLEND_HPP
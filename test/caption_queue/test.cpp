@@ -0,0 +1,228 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/renderer.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+CaptionRegion MakeRegion(const std::string& text, int y) {
+    CaptionRegion region;
+    region.x = 100;
+    region.y = y;
+    region.width = 40 * static_cast<int>(text.size());
+    region.height = 60;
+    for (size_t i = 0; i < text.size(); i++) {
+        CaptionChar ch;
+        ch.type = CaptionCharType::kText;
+        ch.codepoint = static_cast<uint32_t>(text[i]);
+        ch.u8str[0] = text[i];
+        ch.x = region.x + 40 * static_cast<int>(i);
+        ch.y = y;
+        ch.char_width = 36;
+        ch.char_height = 36;
+        ch.char_horizontal_spacing = 4;
+        ch.char_vertical_spacing = 24;
+        ch.char_horizontal_scale = 1.0f;
+        ch.char_vertical_scale = 1.0f;
+        ch.text_color = ColorRGBA(255, 255, 255, 255);
+        ch.back_color = ColorRGBA(0, 0, 0, 128);
+        ch.stroke_color = ColorRGBA(0, 0, 0, 255);
+        ch.style = CharStyle::kCharStyleStroke;
+        region.chars.push_back(ch);
+    }
+    return region;
+}
+
+Caption MakeCaption(int64_t pts, const std::string& line) {
+    Caption caption;
+    caption.pts = pts;
+    caption.wait_duration = DURATION_INDEFINITE;
+    caption.plane_width = 960;
+    caption.plane_height = 540;
+    caption.regions.push_back(MakeRegion(line, 400));
+    return caption;
+}
+
+// Captions in decoding order, including seeks back and repeated PTS, so that the stored result depends on the order
+std::vector<Caption> MakeCaptions() {
+    std::vector<Caption> captions;
+    for (int i = 0; i < 60; i++) {
+        int64_t pts = 1000 * i;
+        if (i % 10 == 9) {
+            pts = captions.back().pts;          // Replaces the previous one
+        } else if (i % 7 == 6) {
+            pts = 1000 * (i - 4) + 500;         // Seek back
+        }
+        captions.push_back(MakeCaption(pts, "Caption " + std::to_string(i)));
+    }
+    return captions;
+}
+
+void SetupRenderer(Renderer& renderer) {
+    CHECK(renderer.Initialize());
+    CHECK(renderer.SetFrameSize(1920, 1080));
+    renderer.SetStoragePolicy(CaptionStoragePolicy::kUnlimited);
+}
+
+// Content IDs displayed at every caption PTS and between captions
+std::vector<uint64_t> RenderContents(Renderer& renderer, const std::vector<Caption>& captions) {
+    std::vector<uint64_t> contents;
+    for (const Caption& caption : captions) {
+        for (int64_t pts : {caption.pts, caption.pts + 250}) {
+            RenderResult result;
+            RenderStatus status = renderer.Render(pts, result);
+            CHECK(status != RenderStatus::kError);
+            contents.push_back(result.images.empty() ? 0 : result.images.front().content_id);
+        }
+    }
+    return contents;
+}
+
+uint64_t RenderContent(Renderer& renderer, int64_t pts) {
+    RenderResult result;
+    if (renderer.Render(pts, result) == RenderStatus::kError || result.images.empty()) {
+        return 0;
+    }
+    return result.images.front().content_id;
+}
+
+}  // namespace
+
+int main() {
+    Context context;
+    context.SetLogcatCallback([](LogLevel, const char*) {});
+
+    std::vector<Caption> captions = MakeCaptions();
+
+    Renderer appended(context);
+    SetupRenderer(appended);
+    for (const Caption& caption : captions) {
+        CHECK(appended.AppendCaption(caption));
+    }
+    std::vector<uint64_t> expected = RenderContents(appended, captions);
+
+    // Queued from a producer thread while the rendering thread keeps taking queued captions
+    Renderer queued(context);
+    SetupRenderer(queued);
+
+    std::vector<int64_t> queued_pts;
+    std::thread::id callback_thread;
+    queued.SetCaptionQueueCallback([&](int64_t pts) {
+        queued_pts.push_back(pts);
+        callback_thread = std::this_thread::get_id();
+    });
+
+    std::atomic<bool> produced = false;
+    std::thread::id producer_thread;
+    std::thread producer([&]() {
+        producer_thread = std::this_thread::get_id();
+        for (const Caption& caption : captions) {
+            CHECK(queued.QueueCaption(caption));
+            std::this_thread::yield();
+        }
+        produced = true;
+    });
+    while (!produced) {
+        CHECK(queued.TryRender(0) != RenderStatus::kError);
+    }
+    producer.join();
+
+    CHECK(RenderContents(queued, captions) == expected);
+    CHECK(queued_pts.size() == captions.size());
+    for (size_t i = 0; i < queued_pts.size() && i < captions.size(); i++) {
+        CHECK(queued_pts[i] == captions[i].pts);
+    }
+    CHECK(callback_thread == producer_thread);
+
+    // Queued all at once, then taken in a single batch
+    Renderer batched(context);
+    SetupRenderer(batched);
+    for (const Caption& caption : captions) {
+        CHECK(batched.QueueCaption(caption));
+    }
+    CHECK(RenderContents(batched, captions) == expected);
+
+    // Invalid captions are rejected without notifying
+    Caption invalid = MakeCaption(PTS_NOPTS, "Invalid");
+    CHECK(!queued.QueueCaption(invalid));
+    invalid = MakeCaption(1000, "Invalid");
+    invalid.plane_width = 0;
+    CHECK(!queued.QueueCaption(invalid));
+    CHECK(queued_pts.size() == captions.size());
+
+    // Appending keeps the order of captions queued earlier
+    Renderer mixed(context);
+    SetupRenderer(mixed);
+    CHECK(mixed.QueueCaption(MakeCaption(1000, "Queued first")));
+    CHECK(mixed.AppendCaption(MakeCaption(1000, "Appended later")));
+    CHECK(mixed.AppendCaption(MakeCaption(2000, "Appended first")));
+    CHECK(mixed.QueueCaption(MakeCaption(2000, "Queued later")));
+
+    Renderer reference(context);
+    SetupRenderer(reference);
+    CHECK(reference.AppendCaption(MakeCaption(1000, "Appended later")));
+    CHECK(reference.AppendCaption(MakeCaption(2000, "Queued later")));
+    CHECK(RenderContent(mixed, 1000) == RenderContent(reference, 1000));
+    CHECK(RenderContent(mixed, 2000) == RenderContent(reference, 2000));
+    CHECK(RenderContent(mixed, 1000) != 0);
+
+    // Flush discards queued captions without ever storing them
+    std::vector<int64_t> changes;
+    mixed.SetCaptionChangeCallback([&](int64_t pts) { changes.push_back(pts); });
+    CHECK(mixed.QueueCaption(MakeCaption(3000, "Discarded")));
+    CHECK(mixed.QueueCaption(MakeCaption(4000, "Discarded too")));
+    mixed.Flush();
+    CHECK(changes.size() == 1 && changes.back() == PTS_NOPTS);
+    CHECK(mixed.TryRender(3000) == RenderStatus::kNoImage);
+    CHECK(RenderContent(mixed, 1000) == 0);
+    CHECK(RenderContent(mixed, 4000) == 0);
+    CHECK(mixed.GetNextChangePts(0) == PTS_NOPTS);
+    CHECK(changes.size() == 1);
+
+    // Queue keeps working after flushing
+    CHECK(mixed.QueueCaption(MakeCaption(1000, "Appended later")));
+    CHECK(RenderContent(mixed, 1000) == RenderContent(reference, 1000));
+    CHECK(changes.size() == 2 && changes.back() == 1000);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
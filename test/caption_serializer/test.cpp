@@ -0,0 +1,325 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "aribcaption/caption_serializer.hpp"
+#include "aribcaption/context.hpp"
+#include "aribcaption/renderer.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+CaptionChar MakeChar(char c, int x, int y, ColorRGBA text_color) {
+    CaptionChar ch;
+    ch.type = CaptionCharType::kText;
+    ch.codepoint = static_cast<uint32_t>(c);
+    ch.u8str[0] = c;
+    ch.x = x;
+    ch.y = y;
+    ch.char_width = 36;
+    ch.char_height = 36;
+    ch.char_horizontal_spacing = 4;
+    ch.char_vertical_spacing = 24;
+    ch.char_horizontal_scale = 1.0f;
+    ch.char_vertical_scale = 1.0f;
+    ch.text_color = text_color;
+    ch.back_color = ColorRGBA(0, 0, 0, 128);
+    ch.stroke_color = ColorRGBA(0, 0, 0, 255);
+    return ch;
+}
+
+// Two regions, with several style runs and a DRCS char
+Caption MakeCaption() {
+    Caption caption;
+    caption.type = CaptionType::kCaption;
+    caption.flags = static_cast<CaptionFlags>(kCaptionFlagsClearScreen | kCaptionFlagsWaitDuration);
+    caption.iso6392_language_code = ThreeCC("jpn");
+    caption.text = "Hello World\n";
+    caption.pts = 123456;
+    caption.wait_duration = 3000;
+    caption.plane_width = 960;
+    caption.plane_height = 540;
+    caption.has_builtin_sound = true;
+    caption.builtin_sound_id = 3;
+
+    CaptionRegion first;
+    first.x = 100;
+    first.y = 300;
+    first.width = 200;
+    first.height = 60;
+    const char* text = "Hello";
+    for (int i = 0; text[i]; i++) {
+        ColorRGBA color = i < 2 ? ColorRGBA(255, 255, 255, 255) : ColorRGBA(255, 255, 0, 255);
+        first.chars.push_back(MakeChar(text[i], 100 + 40 * i, 300, color));
+    }
+    first.chars[4].char_horizontal_scale = 0.5f;
+
+    CaptionRegion second;
+    second.x = 100;
+    second.y = 400;
+    second.width = 200;
+    second.height = 60;
+    second.is_ruby = true;
+    CaptionChar drcs_char = MakeChar('?', 100, 400, ColorRGBA(0, 255, 255, 255));
+    drcs_char.type = CaptionCharType::kDRCS;
+    drcs_char.codepoint = 0;
+    drcs_char.drcs_code = 0x41;
+    second.chars.push_back(drcs_char);
+    second.chars.push_back(MakeChar('W', 140, 400, ColorRGBA(0, 255, 255, 255)));
+
+    caption.regions.push_back(first);
+    caption.regions.push_back(second);
+
+    DRCS drcs;
+    drcs.width = 4;
+    drcs.height = 2;
+    drcs.depth = 2;
+    drcs.depth_bits = 1;
+    drcs.pixels = {0x5A, 0xA5};
+    drcs.md5 = "0123456789abcdef0123456789abcdef";
+    drcs.alternative_text = "X";
+    drcs.alternative_ucs4 = 'X';
+    caption.drcs_map[0x41] = drcs;
+
+    return caption;
+}
+
+bool IsSameChar(const CaptionChar& a, const CaptionChar& b) {
+    return a.type == b.type && a.codepoint == b.codepoint && a.pua_codepoint == b.pua_codepoint &&
+           a.drcs_code == b.drcs_code && a.x == b.x && a.y == b.y &&
+           a.char_width == b.char_width && a.char_height == b.char_height &&
+           a.char_horizontal_spacing == b.char_horizontal_spacing &&
+           a.char_vertical_spacing == b.char_vertical_spacing &&
+           a.char_horizontal_scale == b.char_horizontal_scale && a.char_vertical_scale == b.char_vertical_scale &&
+           a.text_color.u32 == b.text_color.u32 && a.back_color.u32 == b.back_color.u32 &&
+           a.stroke_color.u32 == b.stroke_color.u32 &&
+           a.style == b.style && a.enclosure_style == b.enclosure_style && strcmp(a.u8str, b.u8str) == 0;
+}
+
+void TestRoundTrip() {
+    Caption caption = MakeCaption();
+    std::vector<uint8_t> buffer;
+    CHECK(SerializeCaption(caption, buffer));
+    CHECK(buffer.size() == GetSerializedCaptionSize(caption));
+    CHECK(buffer.size() % 8 == 0);
+
+    const SerializedCaptionHeader* header = ValidateSerializedCaption(buffer.data(), buffer.size());
+    CHECK(header != nullptr);
+    if (header) {
+        CHECK(header->regions.count == 2);
+        CHECK(header->style_runs.count == 4);
+        CHECK(header->chars.count == 7);
+        CHECK(header->drcs.count == 1);
+    }
+
+    Caption out;
+    CHECK(DeserializeCaption(buffer.data(), buffer.size(), out));
+    CHECK(out.type == caption.type);
+    CHECK(out.flags == caption.flags);
+    CHECK(out.iso6392_language_code == caption.iso6392_language_code);
+    CHECK(out.text == caption.text);
+    CHECK(out.pts == caption.pts);
+    CHECK(out.wait_duration == caption.wait_duration);
+    CHECK(out.plane_width == caption.plane_width);
+    CHECK(out.plane_height == caption.plane_height);
+    CHECK(out.has_builtin_sound == caption.has_builtin_sound);
+    CHECK(out.builtin_sound_id == caption.builtin_sound_id);
+
+    CHECK(out.regions.size() == caption.regions.size());
+    for (size_t i = 0; i < out.regions.size() && i < caption.regions.size(); i++) {
+        const CaptionRegion& a = out.regions[i];
+        const CaptionRegion& b = caption.regions[i];
+        CHECK(a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height && a.is_ruby == b.is_ruby);
+        CHECK(a.chars.size() == b.chars.size());
+        for (size_t c = 0; c < a.chars.size() && c < b.chars.size(); c++) {
+            CHECK(IsSameChar(a.chars[c], b.chars[c]));
+        }
+    }
+
+    CHECK(out.drcs_map.size() == 1);
+    if (out.drcs_map.count(0x41)) {
+        const DRCS& a = out.drcs_map[0x41];
+        const DRCS& b = caption.drcs_map[0x41];
+        CHECK(a.width == b.width && a.height == b.height && a.depth == b.depth && a.depth_bits == b.depth_bits);
+        CHECK(a.pixels == b.pixels && a.md5 == b.md5);
+        CHECK(a.alternative_text == b.alternative_text && a.alternative_ucs4 == b.alternative_ucs4);
+    }
+
+    // Serialization is deterministic
+    std::vector<uint8_t> again;
+    CHECK(SerializeCaption(out, again));
+    CHECK(again == buffer);
+
+    // Caption without regions and DRCS
+    Caption empty;
+    empty.pts = 0;
+    empty.plane_width = 960;
+    empty.plane_height = 540;
+    CHECK(SerializeCaption(empty, buffer));
+    CHECK(DeserializeCaption(buffer.data(), buffer.size(), out));
+    CHECK(out.regions.empty() && out.drcs_map.empty() && out.text.empty());
+
+    // Destination buffer too small
+    std::vector<uint8_t> small(GetSerializedCaptionSize(caption) - 8);
+    CHECK(SerializeCaption(caption, small.data(), small.size()) == 0);
+}
+
+// Serializes the test caption, applies the modification and checks the result is rejected
+void CheckRejected(int line, const std::function<void(std::vector<uint8_t>&)>& modify) {
+    std::vector<uint8_t> buffer;
+    SerializeCaption(MakeCaption(), buffer);
+    modify(buffer);
+
+    Caption out;
+    if (ValidateSerializedCaption(buffer.data(), buffer.size()) ||
+            DeserializeCaption(buffer.data(), buffer.size(), out)) {
+        fprintf(stderr, "%s:%d: Malformed serialized caption was accepted\n", __FILE__, line);
+        failures++;
+    }
+}
+
+SerializedCaptionHeader* Header(std::vector<uint8_t>& buffer) {
+    return reinterpret_cast<SerializedCaptionHeader*>(buffer.data());
+}
+
+template <class T>
+T* Array(std::vector<uint8_t>& buffer, SerializedCaptionSpan span) {
+    return reinterpret_cast<T*>(buffer.data() + span.offset);
+}
+
+SerializedCaptionRegion* Regions(std::vector<uint8_t>& buffer) {
+    return Array<SerializedCaptionRegion>(buffer, Header(buffer)->regions);
+}
+
+SerializedCaptionStyleRun* Runs(std::vector<uint8_t>& buffer) {
+    return Array<SerializedCaptionStyleRun>(buffer, Header(buffer)->style_runs);
+}
+
+void TestMalformed() {
+    // Truncated or corrupted header
+    CheckRejected(__LINE__, [](auto& buffer) { buffer.resize(buffer.size() - 8); });
+    CheckRejected(__LINE__, [](auto& buffer) { buffer.resize(sizeof(SerializedCaptionHeader) - 8); });
+    CheckRejected(__LINE__, [](auto& buffer) { Header(buffer)->magic ^= 1; });
+    CheckRejected(__LINE__, [](auto& buffer) { Header(buffer)->version++; });
+    CheckRejected(__LINE__, [](auto& buffer) { Header(buffer)->header_size = 8; });
+    CheckRejected(__LINE__, [](auto& buffer) { Header(buffer)->type = 0xFF; });
+
+    // Arrays out of the buffer or misaligned
+    CheckRejected(__LINE__, [](auto& buffer) { Header(buffer)->regions.count = 0x10000000; });
+    CheckRejected(__LINE__, [](auto& buffer) { Header(buffer)->chars.offset = Header(buffer)->total_size; });
+    CheckRejected(__LINE__, [](auto& buffer) { Header(buffer)->style_runs.offset += 2; });
+    CheckRejected(__LINE__, [](auto& buffer) { Header(buffer)->drcs.offset = 0; });
+
+    // Regions sharing style runs, which would duplicate chars
+    CheckRejected(__LINE__, [](auto& buffer) {
+        Regions(buffer)[1].first_style_run = 0;
+        Regions(buffer)[1].style_run_count = Header(buffer)->style_runs.count;
+    });
+    // Style runs sharing chars
+    CheckRejected(__LINE__, [](auto& buffer) {
+        Runs(buffer)[1].first_char = 0;
+        Runs(buffer)[1].char_count = Header(buffer)->chars.count;
+    });
+    CheckRejected(__LINE__, [](auto& buffer) { Runs(buffer)[1].first_char--; });
+    // Style runs or chars out of order
+    CheckRejected(__LINE__, [](auto& buffer) { std::swap(Runs(buffer)[0], Runs(buffer)[1]); });
+    CheckRejected(__LINE__, [](auto& buffer) { std::swap(Regions(buffer)[0], Regions(buffer)[1]); });
+    // Style runs or chars not referenced by any region or style run
+    CheckRejected(__LINE__, [](auto& buffer) { Regions(buffer)[1].style_run_count--; });
+    CheckRejected(__LINE__, [](auto& buffer) { Runs(buffer)[3].char_count--; });
+    CheckRejected(__LINE__, [](auto& buffer) { Header(buffer)->chars.count--; });
+
+    // Invalid chars, strings and DRCS
+    CheckRejected(__LINE__, [](auto& buffer) {
+        Array<SerializedCaptionChar>(buffer, Header(buffer)->chars)[0].type = 0xFF;
+    });
+    CheckRejected(__LINE__, [](auto& buffer) {
+        memset(Array<SerializedCaptionChar>(buffer, Header(buffer)->chars)[0].u8str, 'A', 8);
+    });
+    CheckRejected(__LINE__, [](auto& buffer) {
+        SerializedCaptionSpan text = Header(buffer)->text;
+        buffer[text.offset + text.count] = 'A';
+    });
+    CheckRejected(__LINE__, [](auto& buffer) {
+        Array<SerializedCaptionDRCS>(buffer, Header(buffer)->drcs)[0].pixels.count = Header(buffer)->total_size;
+    });
+
+    // Misaligned data
+    std::vector<uint8_t> buffer;
+    SerializeCaption(MakeCaption(), buffer);
+    std::vector<uint8_t> shifted(buffer.size() + 8);
+    memcpy(shifted.data() + 4, buffer.data(), buffer.size());
+    CHECK(ValidateSerializedCaption(shifted.data() + 4, buffer.size()) == nullptr);
+    CHECK(ValidateSerializedCaption(nullptr, buffer.size()) == nullptr);
+}
+
+void TestRendererAppend() {
+    Context context;
+    context.SetLogcatCallback([](LogLevel, const char*) {});
+    Renderer renderer(context);
+
+    std::vector<uint8_t> buffer;
+    SerializeCaption(MakeCaption(), buffer);
+    CHECK(renderer.AppendCaption(buffer.data(), buffer.size()));
+    CHECK(renderer.GetStorageMemoryUsage().caption_count == 1);
+
+    // Rejected without assertions, the data comes from outside
+    Caption caption = MakeCaption();
+    caption.pts = PTS_NOPTS;
+    SerializeCaption(caption, buffer);
+    CHECK(!renderer.AppendCaption(buffer.data(), buffer.size()));
+
+    caption = MakeCaption();
+    caption.plane_width = 0;
+    SerializeCaption(caption, buffer);
+    CHECK(!renderer.AppendCaption(buffer.data(), buffer.size()));
+
+    Header(buffer)->magic = 0;
+    CHECK(!renderer.AppendCaption(buffer.data(), buffer.size()));
+    CHECK(renderer.GetStorageMemoryUsage().caption_count == 1);
+}
+
+}  // namespace
+
+int main() {
+    TestRoundTrip();
+    TestMalformed();
+    TestRendererAppend();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
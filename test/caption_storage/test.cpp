@@ -0,0 +1,246 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/renderer.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+CaptionRegion MakeRegion(const std::string& text, int y) {
+    CaptionRegion region;
+    region.x = 100;
+    region.y = y;
+    region.width = 40 * static_cast<int>(text.size());
+    region.height = 60;
+    for (size_t i = 0; i < text.size(); i++) {
+        CaptionChar ch;
+        ch.type = CaptionCharType::kText;
+        ch.codepoint = static_cast<uint32_t>(text[i]);
+        ch.u8str[0] = text[i];
+        ch.x = region.x + 40 * static_cast<int>(i);
+        ch.y = y;
+        ch.char_width = 36;
+        ch.char_height = 36;
+        ch.char_horizontal_spacing = 4;
+        ch.char_vertical_spacing = 24;
+        ch.char_horizontal_scale = 1.0f;
+        ch.char_vertical_scale = 1.0f;
+        ch.text_color = ColorRGBA(255, 255, 255, 255);
+        ch.back_color = ColorRGBA(0, 0, 0, 128);
+        ch.stroke_color = ColorRGBA(0, 0, 0, 255);
+        ch.style = CharStyle::kCharStyleStroke;
+        region.chars.push_back(ch);
+    }
+    return region;
+}
+
+Caption MakeCaption(int64_t pts, const std::string& line, int64_t wait_duration = DURATION_INDEFINITE) {
+    Caption caption;
+    caption.pts = pts;
+    caption.wait_duration = wait_duration;
+    caption.plane_width = 960;
+    caption.plane_height = 540;
+    if (!line.empty()) {
+        caption.regions.push_back(MakeRegion(line, 400));
+    }
+    return caption;
+}
+
+void SetupRenderer(Renderer& renderer) {
+    CHECK(renderer.Initialize());
+    CHECK(renderer.SetFrameSize(1920, 1080));
+    renderer.SetStoragePolicy(CaptionStoragePolicy::kUnlimited);
+}
+
+uint64_t RenderContent(Renderer& renderer, int64_t pts) {
+    RenderResult result;
+    RenderStatus status = renderer.Render(pts, result);
+    CHECK(status != RenderStatus::kError);
+    return result.images.empty() ? 0 : result.images.front().content_id;
+}
+
+// Expected display, independent from the renderer's storage: the last caption not after the PTS is displayed
+// unless it clears the screen or has timed out
+struct Expectation {
+    int64_t pts = 0;
+    int64_t wait_duration = DURATION_INDEFINITE;
+    uint64_t content_id = 0;
+};
+
+class Oracle {
+public:
+    explicit Oracle(Context& context) : renderer_(context) {
+        SetupRenderer(renderer_);
+    }
+
+    void Store(const Caption& caption) {
+        renderer_.Flush();
+        CHECK(renderer_.AppendCaption(caption));
+        Expectation expectation{caption.pts, caption.wait_duration, RenderContent(renderer_, caption.pts)};
+        CHECK(caption.regions.empty() || expectation.content_id != 0);
+
+        auto iter = std::lower_bound(expectations_.begin(), expectations_.end(), caption.pts,
+                                     [](const Expectation& e, int64_t value) { return e.pts < value; });
+        if (iter != expectations_.end() && iter->pts == caption.pts) {
+            *iter = expectation;
+        } else {
+            expectations_.insert(iter, expectation);
+        }
+    }
+
+    uint64_t ContentAt(int64_t pts) const {
+        auto iter = std::upper_bound(expectations_.begin(), expectations_.end(), pts,
+                                     [](int64_t value, const Expectation& e) { return value < e.pts; });
+        if (iter == expectations_.begin()) {
+            return 0;
+        }
+        const Expectation& expectation = *std::prev(iter);
+        if (expectation.wait_duration != DURATION_INDEFINITE && pts >= expectation.pts + expectation.wait_duration) {
+            return 0;
+        }
+        return expectation.content_id;
+    }
+private:
+    Renderer renderer_;
+    std::vector<Expectation> expectations_;
+};
+
+// Captions in PTS order, with clear screens and timed out captions in between
+std::vector<Caption> MakeCaptions() {
+    std::vector<Caption> captions;
+    for (int i = 0; i < 40; i++) {
+        int64_t pts = 1000 * i;
+        if (i % 9 == 4) {
+            captions.push_back(MakeCaption(pts, ""));
+        } else if (i % 5 == 2) {
+            captions.push_back(MakeCaption(pts, "Timed " + std::to_string(i), 600));
+        } else {
+            captions.push_back(MakeCaption(pts, "Caption " + std::to_string(i)));
+        }
+    }
+    return captions;
+}
+
+}  // namespace
+
+int main() {
+    Context context;
+    context.SetLogcatCallback([](LogLevel, const char*) {});
+
+    std::vector<Caption> captions = MakeCaptions();
+    Renderer renderer(context);
+    SetupRenderer(renderer);
+    Oracle oracle(context);
+
+    // Appended out of order, every third caption is preceded by a stale caption of the same PTS to be replaced
+    size_t count = captions.size();
+    for (size_t i = 0; i < count; i++) {
+        const Caption& caption = captions[(i * 7) % count];
+        if (i % 3 == 0) {
+            Caption stale = MakeCaption(caption.pts, "Stale " + std::to_string(i));
+            CHECK(renderer.AppendCaption(stale));
+            oracle.Store(stale);
+        }
+        CHECK(renderer.AppendCaption(caption));
+        oracle.Store(caption);
+    }
+
+    auto check_at = [&](int64_t pts) {
+        uint64_t expected = oracle.ContentAt(pts);
+        uint64_t rendered = RenderContent(renderer, pts);
+        if (rendered != expected) {
+            fprintf(stderr, "Unexpected content at %lld\n", static_cast<long long>(pts));
+        }
+        CHECK(rendered == expected);
+    };
+
+    int64_t end = captions.back().pts + 2000;
+
+    // Sequential playback, then backwards
+    for (int64_t pts = -500; pts < end; pts += 250) {
+        check_at(pts);
+    }
+    for (int64_t pts = end; pts >= -500; pts -= 250) {
+        check_at(pts);
+    }
+
+    // Random seeks
+    uint32_t seed = 12345;
+    for (int i = 0; i < 200; i++) {
+        seed = seed * 1664525 + 1013904223;
+        check_at(static_cast<int64_t>(seed % static_cast<uint32_t>(end + 1000)) - 500);
+    }
+
+    // Insertion before the playback position while playing
+    for (int64_t pts = 20000; pts < 26000; pts += 100) {
+        check_at(pts);
+        if (pts == 22000) {
+            Caption inserted = MakeCaption(21500, "Inserted behind");
+            CHECK(renderer.AppendCaption(inserted));
+            oracle.Store(inserted);
+        } else if (pts == 23000) {
+            Caption inserted = MakeCaption(23300, "Inserted ahead");
+            CHECK(renderer.AppendCaption(inserted));
+            oracle.Store(inserted);
+        } else if (pts == 24000) {
+            Caption replaced = MakeCaption(24000, "Replaced");
+            CHECK(renderer.AppendCaption(replaced));
+            oracle.Store(replaced);
+        }
+    }
+    for (int64_t pts = -500; pts < end; pts += 100) {
+        check_at(pts);
+    }
+
+    // Duration of an indefinite caption is corrected by the next one, also if appended out of order
+    Renderer durations(context);
+    SetupRenderer(durations);
+    CHECK(durations.AppendCaption(MakeCaption(5000, "Last")));
+    CHECK(durations.AppendCaption(MakeCaption(1000, "First")));
+    CHECK(durations.AppendCaption(MakeCaption(3000, "Second")));
+    RenderResult result;
+    CHECK(durations.Render(1000, result) == RenderStatus::kGotImage);
+    CHECK(result.pts == 1000 && result.duration == 2000);
+    CHECK(durations.Render(5000, result) == RenderStatus::kGotImage);
+    CHECK(result.pts == 5000 && result.duration == DURATION_INDEFINITE);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,207 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <vector>
+#include <fontconfig/fontconfig.h>
+#include "aribcaption/caption.hpp"
+#include "base/language_code.hpp"
+#include "base/scoped_holder.hpp"
+#include "renderer/font_provider_fontconfig.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+struct Query {
+    std::string font_name;
+    std::optional<uint32_t> ucs4;
+    uint32_t language_code = 0;
+};
+
+struct Match {
+    bool ok = false;
+    FontProviderError error = FontProviderError::kOtherError;
+    std::string family_name;
+    std::string postscript_name;
+    std::string filename;
+    int face_index = 0;
+
+    bool operator==(const Match& other) const {
+        if (ok != other.ok) {
+            return false;
+        }
+        if (!ok) {
+            return error == other.error;
+        }
+        return family_name == other.family_name && postscript_name == other.postscript_name &&
+               filename == other.filename && face_index == other.face_index;
+    }
+};
+
+Match Lookup(FontProviderFontconfig& provider, const Query& query) {
+    provider.SetLanguage(query.language_code);
+    auto result = provider.GetFontFace(query.font_name, query.ucs4);
+
+    Match match;
+    match.ok = result.is_ok();
+    if (result.is_ok()) {
+        match.family_name = result.value().family_name;
+        match.postscript_name = result.value().postscript_name;
+        match.filename = result.value().filename;
+        match.face_index = result.value().face_index;
+    } else {
+        match.error = result.error();
+    }
+    return match;
+}
+
+// Uncached reference, asks Fontconfig for every query the same way as the provider did before caching matches
+Match LookupUncached(FcConfig* config, const Query& query) {
+    Match match;
+    ScopedHolder<FcPattern*> pattern(FcNameParse(reinterpret_cast<const FcChar8*>(query.font_name.c_str())),
+                                     FcPatternDestroy);
+    if (!pattern) {
+        match.error = FontProviderError::kFontNotFound;
+        return match;
+    }
+    FcPatternAddString(pattern, FC_FAMILY, reinterpret_cast<const FcChar8*>(query.font_name.c_str()));
+    FcPatternAddBool(pattern, FC_OUTLINE, FcTrue);
+    FcConfigSubstitute(config, pattern, FcMatchPattern);
+    FcDefaultSubstitute(pattern);
+
+    FcPatternDel(pattern, FC_LANG);
+    if (query.language_code) {
+        ScopedHolder<FcLangSet*> langset(FcLangSetCreate(), FcLangSetDestroy);
+        FcLangSetAdd(langset, reinterpret_cast<const FcChar8*>(ISO6392ToISO6391LanguageString(query.language_code)));
+        FcPatternAddLangSet(pattern, FC_LANG, langset);
+    }
+
+    FcResult result = FcResultMatch;
+    FcPattern* matched = FcFontMatch(config, pattern, &result);
+    if (!matched || result != FcResultMatch) {
+        match.error = FontProviderError::kFontNotFound;
+        return match;
+    }
+    ScopedHolder<FcPattern*> best(matched, FcPatternDestroy);
+
+    FcChar8* filename = nullptr;
+    FcChar8* family_name = nullptr;
+    FcChar8* postscript_name = nullptr;
+    FcCharSet* charset = nullptr;
+    if (FcPatternGetString(best, FC_FILE, 0, &filename) != FcResultMatch ||
+            FcPatternGetInteger(best, FC_INDEX, 0, &match.face_index) != FcResultMatch ||
+            FcPatternGetString(best, FC_FAMILY, 0, &family_name) != FcResultMatch ||
+            FcPatternGetString(best, FC_POSTSCRIPT_NAME, 0, &postscript_name) != FcResultMatch) {
+        match.error = FontProviderError::kOtherError;
+        return match;
+    }
+    if (query.ucs4 && query.ucs4.value() != 0) {
+        if (FcPatternGetCharSet(best, FC_CHARSET, 0, &charset) != FcResultMatch) {
+            match.error = FontProviderError::kOtherError;
+            return match;
+        }
+        if (!FcCharSetHasChar(charset, query.ucs4.value())) {
+            match.error = FontProviderError::kCodePointNotFound;
+            return match;
+        }
+    }
+
+    match.ok = true;
+    match.family_name = reinterpret_cast<const char*>(family_name);
+    match.postscript_name = reinterpret_cast<const char*>(postscript_name);
+    match.filename = reinterpret_cast<const char*>(filename);
+    return match;
+}
+
+void PrintQuery(const Query& query) {
+    fprintf(stderr, "  font \"%s\" codepoint %s%X language %08X\n", query.font_name.c_str(),
+            query.ucs4 ? "U+" : "none ", query.ucs4.value_or(0), query.language_code);
+}
+
+}  // namespace
+
+int main() {
+    Context context;
+    context.SetLogcatCallback([](LogLevel, const char*) {});
+
+    const std::vector<std::string> font_names = {
+        "sans-serif", "serif", "monospace", "DejaVu Sans", "Noto Sans CJK JP", "NoSuchFontFamily",
+    };
+    const std::vector<std::optional<uint32_t>> codepoints = {
+        std::nullopt, U'A', U'\u3042', U'\u6F22', 0x10FFFD,
+    };
+    const std::vector<uint32_t> language_codes = {0, ThreeCC("jpn"), ThreeCC("por")};
+
+    std::vector<Query> queries;
+    for (uint32_t language_code : language_codes) {
+        for (const std::string& font_name : font_names) {
+            for (const auto& ucs4 : codepoints) {
+                queries.push_back(Query{font_name, ucs4, language_code});
+            }
+        }
+    }
+
+    ScopedHolder<FcConfig*> config(FcInitLoadConfigAndFonts(), FcConfigDestroy);
+    if (!config) {
+        fprintf(stderr, "Cannot load Fontconfig configuration\n");
+        return 1;
+    }
+    std::vector<Match> expected;
+    for (const Query& query : queries) {
+        expected.push_back(LookupUncached(config, query));
+    }
+    CHECK(expected[1].ok);  // sans-serif covering 'A'
+    CHECK(!expected[4].ok && expected[4].error == FontProviderError::kCodePointNotFound);  // Noncharacter
+
+    // One provider answers all queries in several orders, from its cache after the first match of a font
+    FontProviderFontconfig cached(context);
+    CHECK(cached.Initialize());
+    for (int round = 0; round < 3; round++) {
+        for (size_t n = 0; n < queries.size(); n++) {
+            // Forward, backward, then strided order, so that languages and codepoints keep switching
+            size_t i = round == 0 ? n : round == 1 ? queries.size() - 1 - n : (n * 7) % queries.size();
+            Match match = Lookup(cached, queries[i]);
+            if (!(match == expected[i])) {
+                fprintf(stderr, "Cached match differs in round %d:\n", round);
+                PrintQuery(queries[i]);
+                failures++;
+            }
+        }
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "renderer/font_provider_fontconfig.hpp"
+#include "stopwatch.hpp"
+
+using namespace aribcaption;
+
+static double ToMilliseconds(int64_t microseconds) {
+    return static_cast<double>(microseconds) / 1000.0f;
+}
+
+int main(int argc, char** argv) {
+    constexpr int count = 8;
+
+    Context context;
+    auto stopwatch = StopWatch::Create();
+
+    // Initialize() is lazy, the first font lookup pays for loading the configuration
+    stopwatch->Start();
+    auto first = std::make_unique<FontProviderFontconfig>(context);
+    first->Initialize();
+    stopwatch->Stop();
+    printf("initialize (lazy)       = %lfms\n", ToMilliseconds(stopwatch->GetMicroseconds()));
+
+    stopwatch->Start();
+    auto result = first->GetFontFace("sans-serif", std::nullopt);
+    stopwatch->Stop();
+    int64_t cold_microseconds = stopwatch->GetMicroseconds();
+    printf("first lookup (cold)     = %lfms\n", ToMilliseconds(cold_microseconds));
+
+    if (result.is_err()) {
+        fprintf(stderr, "GetFontFace() failed\n");
+        return -1;
+    }
+
+    // Subsequent providers share the already loaded configuration
+    std::vector<std::unique_ptr<FontProviderFontconfig>> providers;
+    stopwatch->Start();
+    for (int i = 0; i < count; i++) {
+        auto provider = std::make_unique<FontProviderFontconfig>(context);
+        provider->Initialize();
+        (void)provider->GetFontFace("sans-serif", std::nullopt);
+        providers.push_back(std::move(provider));
+    }
+    stopwatch->Stop();
+    printf("shared (average)        = %lfms\n", ToMilliseconds(stopwatch->GetMicroseconds() / count));
+
+    // Cached lookups
+    stopwatch->Start();
+    for (int i = 0; i < 1000; i++) {
+        (void)first->GetFontFace("sans-serif", U'A');
+    }
+    stopwatch->Stop();
+    printf("cached lookup           = %lfms\n", ToMilliseconds(stopwatch->GetMicroseconds()) / 1000);
+
+    // Release all providers, then measure background warm up
+    providers.clear();
+    first.reset();
+
+    stopwatch->Start();
+    auto warm = std::make_unique<FontProviderFontconfig>(context);
+    warm->Initialize();
+    warm->WarmUpAsync();
+    stopwatch->Stop();
+    printf("warm up (async)         = %lfms\n", ToMilliseconds(stopwatch->GetMicroseconds()));
+
+    // Simulate other player initialization meanwhile, long enough for the warm up to finish
+    std::this_thread::sleep_for(std::chrono::microseconds(std::max<int64_t>(cold_microseconds * 2, 50000)));
+
+    stopwatch->Start();
+    (void)warm->GetFontFace("sans-serif", std::nullopt);
+    stopwatch->Stop();
+    printf("first lookup (warmed)   = %lfms\n", ToMilliseconds(stopwatch->GetMicroseconds()));
+
+    return 0;
+}
@@ -0,0 +1,176 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "aribcaption/context.hpp"
+#include "aribcaption/renderer.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+Caption MakeCaption(int64_t pts, const std::string& text) {
+    Caption caption;
+    caption.pts = pts;
+    caption.wait_duration = DURATION_INDEFINITE;
+    caption.plane_width = 960;
+    caption.plane_height = 540;
+
+    CaptionRegion region;
+    region.x = 100;
+    region.y = 300;
+    region.width = 40 * static_cast<int>(text.size());
+    region.height = 60;
+    for (size_t i = 0; i < text.size(); i++) {
+        CaptionChar ch;
+        ch.type = CaptionCharType::kText;
+        ch.codepoint = static_cast<uint32_t>(text[i]);
+        ch.u8str[0] = text[i];
+        ch.x = region.x + 40 * static_cast<int>(i);
+        ch.y = region.y;
+        ch.char_width = 36;
+        ch.char_height = 36;
+        ch.char_horizontal_spacing = 4;
+        ch.char_vertical_spacing = 24;
+        ch.char_horizontal_scale = 1.0f;
+        ch.char_vertical_scale = 1.0f;
+        ch.text_color = ColorRGBA(255, 255, 255, 255);
+        ch.back_color = ColorRGBA(0, 0, 0, 128);
+        region.chars.push_back(ch);
+    }
+    caption.regions.push_back(region);
+    return caption;
+}
+
+bool IsDisplayed(RenderStatus status) {
+    return status == RenderStatus::kGotImage || status == RenderStatus::kGotImageUnchanged;
+}
+
+void TestAccounting(Context& context) {
+    Renderer renderer(context);
+    CHECK(renderer.Initialize());
+    CHECK(renderer.SetFrameSize(1920, 1080));
+    renderer.SetStoragePolicy(CaptionStoragePolicy::kUpperLimitBytes, 64 * 1024 * 1024);
+
+    for (int i = 0; i < 4; i++) {
+        CHECK(renderer.AppendCaption(MakeCaption(i * 1000, "Caption " + std::to_string(i))));
+    }
+    RenderResult result;
+    CHECK(IsDisplayed(renderer.Render(1500, result)));
+
+    StorageMemoryUsage usage = renderer.GetStorageMemoryUsage();
+    CHECK(usage.caption_count == 4);
+    CHECK(usage.captions > 0);
+    CHECK(usage.region_image_cache > 0);
+    CHECK(usage.limit == 64 * 1024 * 1024);
+    // Only evictable memory is accounted into the limit
+    CHECK(usage.total == usage.captions + usage.region_image_cache + usage.layout_cache);
+    CHECK(usage.rendered_images > 0);
+    CHECK(usage.unevictable == usage.rendered_images + usage.glyph_atlas);
+    CHECK(usage.glyph_atlas == 0);
+
+    renderer.SetRenderOutputMode(RenderOutputMode::kGlyphQuads);
+    CHECK(IsDisplayed(renderer.Render(2500, result)));
+    usage = renderer.GetStorageMemoryUsage();
+    CHECK(usage.glyph_atlas >= 2048 * 2048 * 4);
+    CHECK(usage.unevictable == usage.rendered_images + usage.glyph_atlas);
+}
+
+void TestEviction(Context& context) {
+    Renderer renderer(context);
+    CHECK(renderer.Initialize());
+    CHECK(renderer.SetFrameSize(1920, 1080));
+    // Far below a single caption, everything evictable is evicted
+    renderer.SetStoragePolicy(CaptionStoragePolicy::kUpperLimitBytes, 1);
+
+    for (int i = 0; i < 10; i++) {
+        CHECK(renderer.AppendCaption(MakeCaption(i * 1000, "Caption " + std::to_string(i))));
+    }
+    // Nothing is evicted before the first rendering
+    CHECK(renderer.GetStorageMemoryUsage().caption_count == 10);
+
+    RenderResult result;
+    CHECK(IsDisplayed(renderer.Render(5500, result)));
+    StorageMemoryUsage usage = renderer.GetStorageMemoryUsage();
+    CHECK(usage.caption_count == 5);  // 5 ~ 9
+    CHECK(usage.region_image_cache == 0);
+    CHECK(usage.layout_cache == 0);
+
+    // Looking ahead doesn't move the playback position, the displayed caption must survive appending
+    CHECK(renderer.GetNextChangePts(5500) == 6000);
+    CHECK(renderer.GetNextChangePts(9500) == PTS_NOPTS);
+    CHECK(renderer.TryRender(5600) == RenderStatus::kGotImageUnchanged);
+    CHECK(renderer.GetNextChangePts(8500) == 9000);
+    CHECK(renderer.AppendCaption(MakeCaption(10000, "Caption 10")));
+    CHECK(renderer.GetStorageMemoryUsage().caption_count == 6);
+    CHECK(IsDisplayed(renderer.Render(5700, result)));
+
+    RenderResult displayed;
+    CHECK(renderer.Render(6500, displayed) == RenderStatus::kGotImage);
+    CHECK(renderer.GetStorageMemoryUsage().caption_count == 5);  // 6 ~ 10
+
+    // RenderMulti() and RenderAllChanges() don't move the playback position either
+    std::vector<RenderResult> results;
+    CHECK(renderer.RenderMulti(9500, {RenderTarget{1280, 720}}, results) == RenderStatus::kGotImage);
+    CHECK(renderer.RenderAllChanges(8000, 11000, [](RenderStatus, const RenderResult&) {}) ==
+          RenderStatus::kGotImage);
+    CHECK(renderer.AppendCaption(MakeCaption(11000, "Caption 11")));
+    CHECK(renderer.GetStorageMemoryUsage().caption_count == 6);
+    CHECK(renderer.Render(6600, result) == RenderStatus::kGotImageUnchanged);
+
+    // Seeking backwards keeps everything after the new playback position
+    CHECK(renderer.Render(6000, result) == RenderStatus::kGotImageUnchanged);
+    CHECK(renderer.GetStorageMemoryUsage().caption_count == 6);
+
+    // Flushing resets the playback position
+    renderer.Flush();
+    for (int i = 0; i < 4; i++) {
+        CHECK(renderer.AppendCaption(MakeCaption(i * 1000, "Caption " + std::to_string(i))));
+    }
+    CHECK(renderer.GetNextChangePts(2500) == 3000);
+    CHECK(renderer.GetStorageMemoryUsage().caption_count == 4);
+}
+
+}  // namespace
+
+int main() {
+    Context context;
+    context.SetLogcatCallback([](LogLevel, const char*) {});
+
+    TestAccounting(context);
+    TestEviction(context);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
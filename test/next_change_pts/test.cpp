@@ -0,0 +1,204 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/renderer.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+CaptionRegion MakeRegion(const std::string& text, int y) {
+    CaptionRegion region;
+    region.x = 100;
+    region.y = y;
+    region.width = 40 * static_cast<int>(text.size());
+    region.height = 60;
+    for (size_t i = 0; i < text.size(); i++) {
+        CaptionChar ch;
+        ch.type = CaptionCharType::kText;
+        ch.codepoint = static_cast<uint32_t>(text[i]);
+        ch.u8str[0] = text[i];
+        ch.x = region.x + 40 * static_cast<int>(i);
+        ch.y = y;
+        ch.char_width = 36;
+        ch.char_height = 36;
+        ch.char_horizontal_spacing = 4;
+        ch.char_vertical_spacing = 24;
+        ch.char_horizontal_scale = 1.0f;
+        ch.char_vertical_scale = 1.0f;
+        ch.text_color = ColorRGBA(255, 255, 255, 255);
+        ch.back_color = ColorRGBA(0, 0, 0, 128);
+        ch.stroke_color = ColorRGBA(0, 0, 0, 255);
+        ch.style = CharStyle::kCharStyleStroke;
+        region.chars.push_back(ch);
+    }
+    return region;
+}
+
+// Empty line for clearing the screen
+Caption MakeCaption(int64_t pts, const std::string& line, int64_t wait_duration = DURATION_INDEFINITE) {
+    Caption caption;
+    caption.pts = pts;
+    caption.wait_duration = wait_duration;
+    caption.plane_width = 960;
+    caption.plane_height = 540;
+    if (!line.empty()) {
+        caption.regions.push_back(MakeRegion(line, 400));
+    }
+    return caption;
+}
+
+void SetupRenderer(Renderer& renderer) {
+    CHECK(renderer.Initialize());
+    CHECK(renderer.SetFrameSize(1920, 1080));
+    renderer.SetStoragePolicy(CaptionStoragePolicy::kUnlimited);
+}
+
+uint64_t RenderContent(Renderer& renderer, int64_t pts) {
+    RenderResult result;
+    RenderStatus status = renderer.Render(pts, result);
+    CHECK(status != RenderStatus::kError);
+    return result.images.empty() ? 0 : result.images.front().content_id;
+}
+
+}  // namespace
+
+int main() {
+    Context context;
+    context.SetLogcatCallback([](LogLevel, const char*) {});
+
+    Renderer renderer(context);
+    SetupRenderer(renderer);
+    CHECK(renderer.GetNextChangePts(0) == PTS_NOPTS);
+
+    CHECK(renderer.AppendCaption(MakeCaption(1000, "Replaced")));
+    CHECK(renderer.AppendCaption(MakeCaption(3000, "Timed out", 500)));
+    CHECK(renderer.AppendCaption(MakeCaption(5000, "Cleared")));
+    CHECK(renderer.AppendCaption(MakeCaption(7000, "")));
+    CHECK(renderer.AppendCaption(MakeCaption(9000, "Last")));
+
+    // Appearance, replacement, timeout, clear screen and the indefinite last caption
+    const std::pair<int64_t, int64_t> expectations[] = {
+        {-100, 1000}, {0, 1000}, {1000, 3000}, {2999, 3000}, {3000, 3500}, {3499, 3500},
+        {3500, 5000}, {4000, 5000}, {5000, 7000}, {7000, 9000}, {8999, 9000}, {9000, PTS_NOPTS}, {20000, PTS_NOPTS},
+    };
+    for (auto [pts, next_pts] : expectations) {
+        if (renderer.GetNextChangePts(pts) != next_pts) {
+            fprintf(stderr, "Unexpected next change after %lld\n", static_cast<long long>(pts));
+        }
+        CHECK(renderer.GetNextChangePts(pts) == next_pts);
+    }
+
+    // Rendered content must stay the same until the next change, and change there
+    constexpr int64_t kStep = 50;
+    std::vector<uint64_t> contents;
+    for (int64_t pts = 0; pts < 12000; pts += kStep) {
+        contents.push_back(RenderContent(renderer, pts));
+    }
+    for (size_t i = 0; i < contents.size(); i++) {
+        int64_t pts = static_cast<int64_t>(i) * kStep;
+        int64_t next_pts = renderer.GetNextChangePts(pts);
+        size_t next = next_pts == PTS_NOPTS ? contents.size() : static_cast<size_t>(next_pts / kStep);
+        CHECK(next_pts == PTS_NOPTS || next_pts % kStep == 0);
+        for (size_t j = i; j < next && j < contents.size(); j++) {
+            CHECK(contents[j] == contents[i]);
+        }
+        if (next < contents.size()) {
+            CHECK(contents[next] != contents[i]);
+        }
+    }
+
+    // Callback is called on appending, once per batch of queued captions with the earliest PTS
+    std::vector<int64_t> changes;
+    std::vector<int64_t> queued;
+    renderer.SetCaptionChangeCallback([&](int64_t pts) { changes.push_back(pts); });
+    renderer.SetCaptionQueueCallback([&](int64_t pts) { queued.push_back(pts); });
+
+    CHECK(renderer.AppendCaption(MakeCaption(10000, "Appended")));
+    CHECK(changes == std::vector<int64_t>{10000});
+    CHECK(renderer.GetNextChangePts(9000) == 10000);
+
+    changes.clear();
+    CHECK(renderer.QueueCaption(MakeCaption(12000, "Queued")));
+    CHECK(renderer.QueueCaption(MakeCaption(11000, "Queued earlier")));
+    CHECK(renderer.QueueCaption(MakeCaption(13000, "Queued later")));
+    CHECK(queued == (std::vector<int64_t>{12000, 11000, 13000}));
+    CHECK(changes.empty());
+    CHECK(renderer.GetNextChangePts(10000) == 11000);
+    CHECK(changes == std::vector<int64_t>{11000});
+    CHECK(renderer.TryRender(11000) == RenderStatus::kGotImage);
+    CHECK(changes.size() == 1);
+
+    // Changes made from inside the callback are delivered after it returns, not recursively
+    changes.clear();
+    int depth = 0;
+    renderer.SetCaptionChangeCallback([&](int64_t pts) {
+        CHECK(depth == 0);
+        depth++;
+        changes.push_back(pts);
+        if (changes.size() == 1) {
+            CHECK(renderer.AppendCaption(MakeCaption(16000, "From callback")));
+            CHECK(renderer.QueueCaption(MakeCaption(15000, "Queued from callback")));
+            CHECK(renderer.GetNextChangePts(14000) == 15000);
+        }
+        depth--;
+    });
+    CHECK(renderer.AppendCaption(MakeCaption(14000, "Triggering")));
+    CHECK(changes == (std::vector<int64_t>{14000, 15000}));
+    CHECK(renderer.GetNextChangePts(15000) == 16000);
+
+    // Flushing
+    renderer.SetCaptionChangeCallback([&](int64_t pts) { changes.push_back(pts); });
+    changes.clear();
+    renderer.Flush();
+    CHECK(changes == std::vector<int64_t>{PTS_NOPTS});
+    CHECK(renderer.GetNextChangePts(0) == PTS_NOPTS);
+    CHECK(changes.size() == 1);
+
+    // Cleared callbacks are no longer called
+    renderer.SetCaptionChangeCallback(nullptr);
+    renderer.SetCaptionQueueCallback(nullptr);
+    CHECK(renderer.QueueCaption(MakeCaption(1000, "Queued")));
+    CHECK(renderer.AppendCaption(MakeCaption(2000, "Appended")));
+    CHECK(changes.size() == 1);
+    CHECK(queued.size() == 4);
+    CHECK(renderer.GetNextChangePts(0) == 1000);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,452 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <vector>
+#include "aribcaption/pgs_writer.hpp"
+#include "renderer/yuv_blend.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+constexpr uint8_t kSegmentPDS = 0x14;
+constexpr uint8_t kSegmentODS = 0x15;
+constexpr uint8_t kSegmentPCS = 0x16;
+constexpr uint8_t kSegmentWDS = 0x17;
+constexpr uint8_t kSegmentEND = 0x80;
+
+constexpr int kFrameWidth = 1920;
+constexpr int kFrameHeight = 1080;
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+struct Segment {
+    uint32_t pts = 0;
+    uint8_t type = 0;
+    std::vector<uint8_t> data;
+};
+
+struct Reader {
+    const std::vector<uint8_t>& data;
+    size_t offset = 0;
+
+    [[nodiscard]] bool Has(size_t size) const { return offset + size <= data.size(); }
+    uint32_t Read(size_t bytes) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < bytes; i++) {
+            value = (value << 8) | data[offset++];
+        }
+        return value;
+    }
+};
+
+std::vector<Segment> ParseSegments(const std::vector<uint8_t>& stream) {
+    std::vector<Segment> segments;
+    Reader reader{stream};
+    while (reader.Has(13)) {
+        if (reader.Read(1) != 'P' || reader.Read(1) != 'G') {
+            fprintf(stderr, "Invalid segment magic at offset %zu\n", reader.offset - 2);
+            failures++;
+            break;
+        }
+        Segment segment;
+        segment.pts = reader.Read(4);
+        CHECK(reader.Read(4) == 0);  // DTS
+        segment.type = static_cast<uint8_t>(reader.Read(1));
+        size_t size = reader.Read(2);
+        if (!reader.Has(size)) {
+            fprintf(stderr, "Truncated segment at offset %zu\n", reader.offset);
+            failures++;
+            break;
+        }
+        segment.data.assign(stream.begin() + static_cast<ptrdiff_t>(reader.offset),
+                            stream.begin() + static_cast<ptrdiff_t>(reader.offset + size));
+        reader.offset += size;
+        segments.push_back(std::move(segment));
+    }
+    CHECK(reader.offset == stream.size());
+    return segments;
+}
+
+struct CompositionObject {
+    uint16_t object_id = 0;
+    uint8_t window_id = 0;
+    uint16_t x = 0;
+    uint16_t y = 0;
+};
+
+struct DisplaySet {
+    uint32_t pts = 0;
+    uint8_t composition_state = 0;
+    std::vector<CompositionObject> objects;
+    size_t window_count = 0;
+    std::map<uint8_t, std::array<uint8_t, 4>> palette;  // Y, Cr, Cb, A
+    size_t object_segment_count = 0;
+    std::vector<uint8_t> object_sequence_flags;
+    int object_width = 0;
+    int object_height = 0;
+    std::vector<uint8_t> object_data;  // Concatenated RLE data of object 0
+    uint32_t object_data_length = 0;   // As declared in the first ODS, includes width and height
+};
+
+std::vector<DisplaySet> ParseDisplaySets(const std::vector<Segment>& segments) {
+    std::vector<DisplaySet> sets;
+    DisplaySet* current = nullptr;
+    for (const Segment& segment : segments) {
+        Reader reader{segment.data};
+        if (segment.type == kSegmentPCS) {
+            current = &sets.emplace_back();
+            current->pts = segment.pts;
+            CHECK(reader.Read(2) == kFrameWidth);
+            CHECK(reader.Read(2) == kFrameHeight);
+            reader.Read(1);  // frame rate
+            reader.Read(2);  // composition number
+            current->composition_state = static_cast<uint8_t>(reader.Read(1));
+            reader.Read(2);  // palette update flag, palette id
+            size_t count = reader.Read(1);
+            for (size_t i = 0; i < count; i++) {
+                CompositionObject object;
+                object.object_id = static_cast<uint16_t>(reader.Read(2));
+                object.window_id = static_cast<uint8_t>(reader.Read(1));
+                reader.Read(1);  // cropped / forced flags
+                object.x = static_cast<uint16_t>(reader.Read(2));
+                object.y = static_cast<uint16_t>(reader.Read(2));
+                current->objects.push_back(object);
+            }
+            CHECK(reader.offset == segment.data.size());
+            continue;
+        }
+
+        if (!current) {
+            fprintf(stderr, "Segment 0x%02x without a preceding PCS\n", segment.type);
+            failures++;
+            continue;
+        }
+        CHECK(segment.pts == current->pts);
+
+        if (segment.type == kSegmentWDS) {
+            current->window_count = reader.Read(1);
+            CHECK(segment.data.size() == 1 + current->window_count * 9);
+        } else if (segment.type == kSegmentPDS) {
+            reader.Read(2);  // palette id, version
+            while (reader.Has(5)) {
+                auto index = static_cast<uint8_t>(reader.Read(1));
+                std::array<uint8_t, 4> entry{};
+                for (uint8_t& value : entry) {
+                    value = static_cast<uint8_t>(reader.Read(1));
+                }
+                current->palette[index] = entry;
+            }
+            CHECK(reader.offset == segment.data.size());
+        } else if (segment.type == kSegmentODS) {
+            uint32_t object_id = reader.Read(2);
+            reader.Read(1);  // version
+            auto flags = static_cast<uint8_t>(reader.Read(1));
+            if (flags & 0x80) {
+                current->object_data_length = reader.Read(3);
+                current->object_width = static_cast<int>(reader.Read(2));
+                current->object_height = static_cast<int>(reader.Read(2));
+            }
+            if (object_id == 0) {
+                current->object_segment_count++;
+                current->object_sequence_flags.push_back(flags);
+                current->object_data.insert(current->object_data.end(),
+                                            segment.data.begin() + static_cast<ptrdiff_t>(reader.offset),
+                                            segment.data.end());
+            }
+        } else if (segment.type == kSegmentEND) {
+            CHECK(segment.data.empty());
+            current = nullptr;
+        } else {
+            fprintf(stderr, "Unknown segment type 0x%02x\n", segment.type);
+            failures++;
+        }
+    }
+    CHECK(current == nullptr);  // Every display set is terminated
+    return sets;
+}
+
+// Returns palette indices of the decoded object, or an empty vector if the RLE data is malformed
+std::vector<uint8_t> DecodeRLE(const std::vector<uint8_t>& data, int width, int height) {
+    std::vector<uint8_t> pixels;
+    pixels.reserve(static_cast<size_t>(width) * height);
+    Reader reader{data};
+    int lines = 0;
+    size_t line_begin = 0;
+    while (reader.Has(1)) {
+        uint8_t byte = static_cast<uint8_t>(reader.Read(1));
+        if (byte) {
+            pixels.push_back(byte);
+            continue;
+        }
+        if (!reader.Has(1)) {
+            return {};
+        }
+        uint8_t flags = static_cast<uint8_t>(reader.Read(1));
+        if (flags == 0) {
+            // End of line
+            if (pixels.size() - line_begin != static_cast<size_t>(width)) {
+                fprintf(stderr, "Line %d has %zu pixels, expected %d\n", lines, pixels.size() - line_begin, width);
+                return {};
+            }
+            lines++;
+            line_begin = pixels.size();
+            continue;
+        }
+        size_t run = flags & 0x3F;
+        if (flags & 0x40) {
+            if (!reader.Has(1)) {
+                return {};
+            }
+            run = (run << 8) | reader.Read(1);
+        }
+        uint8_t color = 0;
+        if (flags & 0x80) {
+            if (!reader.Has(1)) {
+                return {};
+            }
+            color = static_cast<uint8_t>(reader.Read(1));
+        }
+        pixels.insert(pixels.end(), run, color);
+    }
+    if (lines != height || pixels.size() != line_begin) {
+        fprintf(stderr, "Decoded %d lines, expected %d\n", lines, height);
+        return {};
+    }
+    return pixels;
+}
+
+Image MakeImage(int width, int height, int dst_x, int dst_y, uint64_t content_id) {
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.stride = width * 4;
+    image.dst_x = dst_x;
+    image.dst_y = dst_y;
+    image.pixel_format = PixelFormat::kRGBA8888;
+    image.content_id = content_id;
+    image.bitmap.resize(static_cast<size_t>(image.stride) * height);
+    return image;
+}
+
+void SetPixel(Image& image, int x, int y, ColorRGBA color) {
+    uint8_t* pixel = image.bitmap.data() + static_cast<size_t>(y) * image.stride + static_cast<size_t>(x) * 4;
+    pixel[0] = color.r;
+    pixel[1] = color.g;
+    pixel[2] = color.b;
+    pixel[3] = color.a;
+}
+
+ColorRGBA GetPixel(const Image& image, int x, int y) {
+    const uint8_t* pixel = image.bitmap.data() + static_cast<size_t>(y) * image.stride + static_cast<size_t>(x) * 4;
+    return ColorRGBA(pixel[0], pixel[1], pixel[2], pixel[3]);
+}
+
+// Check the object of a display set decodes back to the colors of the image
+void CheckObject(const DisplaySet& set, const Image& image) {
+    CHECK(set.object_width == image.width);
+    CHECK(set.object_height == image.height);
+    CHECK(set.object_data_length == set.object_data.size() + 4);
+
+    std::vector<uint8_t> indices = DecodeRLE(set.object_data, set.object_width, set.object_height);
+    if (indices.size() != static_cast<size_t>(image.width) * image.height) {
+        fprintf(stderr, "Failed to decode the object\n");
+        failures++;
+        return;
+    }
+
+    YUVColorMatrix matrix = kFrameHeight > 576 ? YUVColorMatrix::kBT709 : YUVColorMatrix::kBT601;
+    int mismatches = 0;
+    for (int y = 0; y < image.height; y++) {
+        for (int x = 0; x < image.width; x++) {
+            ColorRGBA expected = GetPixel(image, x, y);
+            uint8_t index = indices[static_cast<size_t>(y) * image.width + x];
+            auto entry = set.palette.find(index);
+            uint8_t alpha = entry != set.palette.end() ? entry->second[3] : 0;
+            bool match = alpha == expected.a;
+            if (match && expected.a) {
+                uint8_t yuv[3];
+                yuvblend::ConvertColorToYUV(expected, matrix, YUVColorRange::kLimited, yuv);
+                match = entry->second[0] == yuv[0] && entry->second[1] == yuv[2] && entry->second[2] == yuv[1];
+            }
+            if (!match && mismatches++ < 10) {
+                fprintf(stderr, "Pixel (%d, %d) decoded to palette index %u with a wrong color\n", x, y, index);
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Context context;
+    PGSWriter writer(context);
+    std::vector<uint8_t> stream;
+    bool initialized = writer.Initialize(kFrameWidth, kFrameHeight, [&stream](const uint8_t* data, size_t size) {
+        stream.insert(stream.end(), data, data + size);
+    });
+    CHECK(initialized);
+
+    const ColorRGBA white(255, 255, 255, 255);
+    const ColorRGBA red(255, 0, 0, 255);
+    const ColorRGBA back(0, 0, 0, 128);
+
+    // Runs of every RLE code: single pixels, short and long runs of colors and transparency
+    Image text = MakeImage(400, 30, 760, 900, 1);
+    for (int y = 0; y < text.height; y++) {
+        for (int x = 0; x < text.width; x++) {
+            ColorRGBA color(0, 0, 0, 0);
+            if (x >= 10 && x < 11) {
+                color = white;  // single pixel
+            } else if (x >= 20 && x < 22) {
+                color = red;  // 2 pixels
+            } else if (x >= 30 && x < 33) {
+                color = white;  // short run
+            } else if (x >= 100 && x < 300) {
+                color = y % 2 ? back : red;  // long run
+            } else if (x >= 350) {
+                color = (x + y) % 3 ? white : back;
+            }
+            SetPixel(text, x, y, color);
+        }
+    }
+
+    RenderResult result;
+    result.pts = 1000;
+    result.duration = 2000;
+    result.images = {text};
+    CHECK(writer.Write(result));
+
+    // Same window, new content: normal composition with objects re-sent
+    Image text2 = text;
+    text2.content_id = 2;
+    SetPixel(text2, 0, 0, red);
+    result.pts = 3000;
+    result.duration = DURATION_INDEFINITE;
+    result.images = {text2};
+    CHECK(writer.Write(result));
+
+    // Same content again: objects are still in the decoder
+    result.pts = 4000;
+    CHECK(writer.Write(result));
+
+    // Another window and an object larger than a segment: new epoch, fragmented ODS
+    Image large = MakeImage(1920, 200, 0, 0, 3);
+    uint32_t state = 1;
+    const ColorRGBA colors[] = {white, red, back, ColorRGBA(0, 0, 255, 255)};
+    for (int y = 0; y < large.height; y++) {
+        for (int x = 0; x < large.width; x++) {
+            state = state * 1664525u + 1013904223u;
+            SetPixel(large, x, y, colors[(state >> 16) % 4]);
+        }
+    }
+    result.pts = 5000;
+    result.duration = 1000;
+    result.images = {large};
+    CHECK(writer.Write(result));
+
+    // Invalid PTS are rejected without writing anything
+    size_t stream_size = stream.size();
+    result.pts = 4500;  // Earlier than the previous one
+    CHECK(!writer.Write(result));
+    result.pts = -1;
+    CHECK(!writer.Write(result));
+    result.pts = int64_t{UINT32_MAX / 90} + 1;  // Doesn't fit into 32-bit 90kHz timestamps
+    CHECK(!writer.Write(result));
+    CHECK(stream.size() == stream_size);
+
+    // The last result is cleared at the end of its duration, clamped into the timestamp range
+    result.pts = int64_t{UINT32_MAX / 90} - 10;
+    result.duration = INT64_MAX / 2;
+    result.images = {text};
+    CHECK(writer.Write(result));
+    writer.Flush();
+
+    std::vector<DisplaySet> sets = ParseDisplaySets(ParseSegments(stream));
+    // 1000, 3000 (no clear in between), 4000, 5000, clear at 6000, last result, clear of the last result
+    CHECK(sets.size() == 7);
+    if (sets.size() != 7) {
+        fprintf(stderr, "Got %zu display sets\n", sets.size());
+        return 1;
+    }
+
+    const uint32_t pts_90k[] = {90000, 270000, 360000, 450000, 540000,
+                                (UINT32_MAX / 90 - 10) * 90, UINT32_MAX / 90 * 90};
+    for (size_t i = 0; i < sets.size(); i++) {
+        CHECK(sets[i].pts == pts_90k[i]);
+    }
+
+    // Epoch start with a single object, sent in a single ODS
+    CHECK(sets[0].composition_state == 0x80);
+    CHECK(sets[0].objects.size() == 1 && sets[0].window_count == 1);
+    CHECK(sets[0].objects[0].x == 760 && sets[0].objects[0].y == 900);
+    CHECK(sets[0].object_segment_count == 1);
+    CHECK(sets[0].object_sequence_flags == std::vector<uint8_t>{0xC0});
+    CheckObject(sets[0], text);
+
+    // Same window: normal composition, the new object is sent
+    CHECK(sets[1].composition_state == 0x00);
+    CHECK(sets[1].object_segment_count == 1);
+    CheckObject(sets[1], text2);
+
+    // Same content: composition only
+    CHECK(sets[2].composition_state == 0x00);
+    CHECK(sets[2].objects.size() == 1);
+    CHECK(sets[2].object_segment_count == 0 && sets[2].palette.empty());
+
+    // New window: epoch start, object fragmented into first / middle / last segments
+    CHECK(sets[3].composition_state == 0x80);
+    CHECK(sets[3].object_segment_count > 2);
+    if (sets[3].object_segment_count > 2) {
+        const std::vector<uint8_t>& flags = sets[3].object_sequence_flags;
+        CHECK(flags.front() == 0x80);
+        CHECK(flags.back() == 0x40);
+        for (size_t i = 1; i + 1 < flags.size(); i++) {
+            CHECK(flags[i] == 0x00);
+        }
+    }
+    CheckObject(sets[3], large);
+
+    // Clearing display sets keep the windows and show no object
+    for (size_t index : {size_t{4}, size_t{6}}) {
+        CHECK(sets[index].composition_state == 0x00);
+        CHECK(sets[index].objects.empty());
+        CHECK(sets[index].window_count == 1);
+        CHECK(sets[index].object_segment_count == 0);
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed, %zu bytes in %zu display sets\n", stream.size(), sets.size());
+    return 0;
+}
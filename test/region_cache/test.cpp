@@ -0,0 +1,189 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/renderer.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+CaptionRegion MakeRegion(const std::string& text, int y) {
+    CaptionRegion region;
+    region.x = 100;
+    region.y = y;
+    region.width = 40 * static_cast<int>(text.size());
+    region.height = 60;
+    for (size_t i = 0; i < text.size(); i++) {
+        CaptionChar ch;
+        ch.type = CaptionCharType::kText;
+        ch.codepoint = static_cast<uint32_t>(text[i]);
+        ch.u8str[0] = text[i];
+        ch.x = region.x + 40 * static_cast<int>(i);
+        ch.y = y;
+        ch.char_width = 36;
+        ch.char_height = 36;
+        ch.char_horizontal_spacing = 4;
+        ch.char_vertical_spacing = 24;
+        ch.char_horizontal_scale = 1.0f;
+        ch.char_vertical_scale = 1.0f;
+        ch.text_color = ColorRGBA(255, 255, 255, 255);
+        ch.back_color = ColorRGBA(0, 0, 0, 128);
+        ch.stroke_color = ColorRGBA(0, 0, 0, 255);
+        ch.style = CharStyle::kCharStyleStroke;
+        region.chars.push_back(ch);
+    }
+    return region;
+}
+
+// A persistent speaker label with a changing line below
+Caption MakeCaption(int64_t pts, const std::string& line) {
+    Caption caption;
+    caption.pts = pts;
+    caption.wait_duration = DURATION_INDEFINITE;
+    caption.plane_width = 960;
+    caption.plane_height = 540;
+    caption.regions.push_back(MakeRegion("Speaker", 300));
+    caption.regions.push_back(MakeRegion(line, 400));
+    return caption;
+}
+
+bool IsSameImage(const Image& a, const Image& b) {
+    return a.width == b.width && a.height == b.height && a.stride == b.stride &&
+           a.dst_x == b.dst_x && a.dst_y == b.dst_y && a.bitmap == b.bitmap;
+}
+
+bool IsSameImages(const std::vector<Image>& a, const std::vector<Image>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!IsSameImage(a[i], b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Renders at pts with both renderers, cached results must be identical to rendering from scratch
+std::vector<Image> RenderBoth(Renderer& cached, Renderer& uncached, int64_t pts) {
+    RenderResult cached_result;
+    RenderResult uncached_result;
+    CHECK(cached.Render(pts, cached_result) == RenderStatus::kGotImage);
+    CHECK(uncached.Render(pts, uncached_result) == RenderStatus::kGotImage);
+    CHECK(cached_result.images.size() == 2);
+    CHECK(IsSameImages(cached_result.images, uncached_result.images));
+    return cached_result.images;
+}
+
+}  // namespace
+
+int main() {
+    Context context;
+    context.SetLogcatCallback([](LogLevel, const char*) {});
+
+    Renderer cached(context);
+    Renderer uncached(context);
+    for (Renderer* renderer : {&cached, &uncached}) {
+        CHECK(renderer->Initialize());
+        CHECK(renderer->SetFrameSize(1920, 1080));
+        renderer->SetStoragePolicy(CaptionStoragePolicy::kUnlimited);
+        CHECK(renderer->AppendCaption(MakeCaption(0, "First line")));
+        CHECK(renderer->AppendCaption(MakeCaption(1000, "Second line")));
+        CHECK(renderer->AppendCaption(MakeCaption(2000, "First line")));
+        CHECK(renderer->AppendCaption(MakeCaption(3000, "Third line")));
+    }
+    uncached.SetRegionCacheMemoryLimit(0);
+
+    RegionCacheStatistics stats = cached.GetRegionCacheStatistics();
+    CHECK(stats.hits == 0 && stats.misses == 0 && stats.entry_count == 0);
+    CHECK(stats.memory_limit == 16 * 1024 * 1024);
+
+    std::vector<Image> first = RenderBoth(cached, uncached, 500);
+    stats = cached.GetRegionCacheStatistics();
+    CHECK(stats.hits == 0 && stats.misses == 2 && stats.entry_count == 2);
+    CHECK(stats.memory_used >= first[0].bitmap.size() + first[1].bitmap.size());
+
+    // The speaker label is served from the cache
+    std::vector<Image> second = RenderBoth(cached, uncached, 1500);
+    stats = cached.GetRegionCacheStatistics();
+    CHECK(stats.hits == 1 && stats.misses == 3 && stats.entry_count == 3);
+    CHECK(second[0].content_id == first[0].content_id);
+    CHECK(second[1].content_id != first[1].content_id);
+    CHECK(!second[0].changed && second[1].changed);
+
+    // Identical content of another caption is served from the cache completely
+    std::vector<Image> third = RenderBoth(cached, uncached, 2500);
+    stats = cached.GetRegionCacheStatistics();
+    CHECK(stats.hits == 3 && stats.misses == 3 && stats.entry_count == 3);
+    CHECK(third[0].content_id == first[0].content_id && third[1].content_id == first[1].content_id);
+
+    // Changing a render setting drops cached images and changes content IDs
+    cached.SetStrokeWidth(4.0f);
+    uncached.SetStrokeWidth(4.0f);
+    stats = cached.GetRegionCacheStatistics();
+    CHECK(stats.entry_count == 0 && stats.memory_used == 0);
+    std::vector<Image> stroked = RenderBoth(cached, uncached, 500);
+    stats = cached.GetRegionCacheStatistics();
+    CHECK(stats.hits == 3 && stats.misses == 5 && stats.entry_count == 2);
+    CHECK(stroked[0].content_id != first[0].content_id && stroked[1].content_id != first[1].content_id);
+    CHECK(!IsSameImage(stroked[0], first[0]));
+
+    // Another frame size is another content, never served from images of the previous size
+    for (Renderer* renderer : {&cached, &uncached}) {
+        CHECK(renderer->SetFrameSize(1280, 720));
+    }
+    std::vector<Image> resized = RenderBoth(cached, uncached, 1500);
+    stats = cached.GetRegionCacheStatistics();
+    CHECK(stats.hits == 3 && stats.misses == 7 && stats.entry_count == 4);
+    CHECK(resized[0].content_id != stroked[0].content_id);
+
+    // The uncached renderer never keeps anything
+    stats = uncached.GetRegionCacheStatistics();
+    CHECK(stats.hits == 0 && stats.entry_count == 0 && stats.memory_used == 0 && stats.memory_limit == 0);
+
+    // Lowering the cap evicts least recently used images
+    size_t one_image = resized[0].bitmap.size() + resized[1].bitmap.size();
+    cached.SetRegionCacheMemoryLimit(one_image + 1024);
+    stats = cached.GetRegionCacheStatistics();
+    CHECK(stats.memory_used <= one_image + 1024);
+    CHECK(stats.entry_count >= 1 && stats.entry_count < 4);
+    RenderBoth(cached, uncached, 2500);
+    CHECK(cached.GetRegionCacheStatistics().memory_used <= one_image + 1024);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,267 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/renderer.hpp"
+#include "renderer/alphablend.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+constexpr int kFrameWidth = 1920;
+constexpr int kFrameHeight = 1080;
+
+CaptionRegion MakeRegion(const std::string& text, int x, int y) {
+    CaptionRegion region;
+    region.x = x;
+    region.y = y;
+    region.width = 40 * static_cast<int>(text.size());
+    region.height = 60;
+    for (size_t i = 0; i < text.size(); i++) {
+        CaptionChar ch;
+        ch.type = CaptionCharType::kText;
+        ch.codepoint = static_cast<uint32_t>(text[i]);
+        ch.u8str[0] = text[i];
+        ch.x = region.x + 40 * static_cast<int>(i);
+        ch.y = y;
+        ch.char_width = 36;
+        ch.char_height = 36;
+        ch.char_horizontal_spacing = 4;
+        ch.char_vertical_spacing = 24;
+        ch.char_horizontal_scale = 1.0f;
+        ch.char_vertical_scale = 1.0f;
+        ch.text_color = ColorRGBA(255, 255, 255, 255);
+        ch.back_color = ColorRGBA(0, 0, 0, 128);
+        ch.stroke_color = ColorRGBA(0, 0, 0, 255);
+        ch.style = CharStyle::kCharStyleStroke;
+        region.chars.push_back(ch);
+    }
+    return region;
+}
+
+Caption MakeCaption(int64_t pts, std::vector<CaptionRegion> regions) {
+    Caption caption;
+    caption.pts = pts;
+    caption.wait_duration = 1000;
+    caption.plane_width = 960;
+    caption.plane_height = 540;
+    caption.regions = std::move(regions);
+    return caption;
+}
+
+struct Rect {
+    int left = 0;
+    int top = 0;
+    int right = 0;
+    int bottom = 0;
+};
+
+Rect ImageRect(const Image& image) {
+    return Rect{image.dst_x, image.dst_y, image.dst_x + image.width, image.dst_y + image.height};
+}
+
+bool IsOverlapped(const Rect& a, const Rect& b) {
+    return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+}
+
+bool IsInside(const Rect& inner, const Rect& outer) {
+    return inner.left >= outer.left && inner.top >= outer.top &&
+           inner.right <= outer.right && inner.bottom <= outer.bottom;
+}
+
+int64_t Area(const std::vector<Image>& images) {
+    int64_t area = 0;
+    for (const Image& image : images) {
+        area += static_cast<int64_t>(image.width) * image.height;
+    }
+    return area;
+}
+
+// Blend images onto a transparent frame in order, the same way regions are merged
+std::vector<ColorRGBA> Compose(const std::vector<Image>& images) {
+    std::vector<ColorRGBA> frame(static_cast<size_t>(kFrameWidth) * kFrameHeight);
+    for (const Image& image : images) {
+        for (int y = 0; y < image.height; y++) {
+            auto src = reinterpret_cast<const ColorRGBA*>(image.bitmap.data() + static_cast<size_t>(y) * image.stride);
+            ColorRGBA* dest = frame.data() + static_cast<size_t>(image.dst_y + y) * kFrameWidth + image.dst_x;
+            alphablend::BlendLine(dest, src, static_cast<size_t>(image.width));
+        }
+    }
+    return frame;
+}
+
+// Merged images must equal the regions composed onto a transparent frame
+bool MatchesFrame(const Image& image, const std::vector<ColorRGBA>& frame) {
+    for (int y = 0; y < image.height; y++) {
+        auto src = reinterpret_cast<const ColorRGBA*>(image.bitmap.data() + static_cast<size_t>(y) * image.stride);
+        const ColorRGBA* line = frame.data() + static_cast<size_t>(image.dst_y + y) * kFrameWidth + image.dst_x;
+        for (int x = 0; x < image.width; x++) {
+            if (src[x].r != line[x].r || src[x].g != line[x].g || src[x].b != line[x].b || src[x].a != line[x].a) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Count of sparse images containing each unmerged image, every region must belong to exactly one of them
+bool IsPartitioned(const std::vector<Image>& sparse, const std::vector<Image>& unmerged) {
+    for (const Image& image : unmerged) {
+        int containers = 0;
+        for (const Image& merged : sparse) {
+            if (IsInside(ImageRect(image), ImageRect(merged))) {
+                containers++;
+            }
+        }
+        if (containers != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HasOverlap(const std::vector<Image>& images) {
+    for (size_t i = 0; i < images.size(); i++) {
+        for (size_t j = i + 1; j < images.size(); j++) {
+            if (IsOverlapped(ImageRect(images[i]), ImageRect(images[j]))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+const Image* FindImageAt(const std::vector<Image>& images, int dst_x, int dst_y) {
+    for (const Image& image : images) {
+        if (image.dst_x == dst_x && image.dst_y == dst_y) {
+            return &image;
+        }
+    }
+    return nullptr;
+}
+
+}  // namespace
+
+int main() {
+    Context context;
+    context.SetLogcatCallback([](LogLevel, const char*) {});
+
+    Renderer unmerged(context);
+    Renderer bounding_box(context);
+    Renderer sparse(context);
+    for (Renderer* renderer : {&unmerged, &bounding_box, &sparse}) {
+        CHECK(renderer->Initialize());
+        CHECK(renderer->SetFrameSize(kFrameWidth, kFrameHeight));
+        renderer->SetStoragePolicy(CaptionStoragePolicy::kUnlimited);
+
+        // One line at the top, two consecutive lines at the bottom
+        CHECK(renderer->AppendCaption(MakeCaption(0, {MakeRegion("Top line", 100, 30),
+                                                      MakeRegion("First bottom line", 100, 420),
+                                                      MakeRegion("Second line", 100, 480)})));
+        // Two short lines at both sides of the same row
+        CHECK(renderer->AppendCaption(MakeCaption(1000, {MakeRegion("Left", 40, 200),
+                                                         MakeRegion("Right", 760, 200)})));
+        // Overlapping regions
+        CHECK(renderer->AppendCaption(MakeCaption(2000, {MakeRegion("Overlapping", 100, 200),
+                                                         MakeRegion("Text", 400, 230)})));
+    }
+    bounding_box.SetMergeRegionImages(true);
+    sparse.SetMergeRegionImages(true);
+    sparse.SetRegionMergeMode(RegionMergeMode::kSparse);
+
+    const size_t expected_clusters[] = {2, 2, 1};
+    const size_t expected_regions[] = {3, 2, 2};
+
+    for (int i = 0; i < 3; i++) {
+        int64_t pts = i * 1000;
+        RenderResult unmerged_result;
+        RenderResult bounding_box_result;
+        RenderResult sparse_result;
+        CHECK(unmerged.Render(pts, unmerged_result) == RenderStatus::kGotImage);
+        CHECK(bounding_box.Render(pts, bounding_box_result) == RenderStatus::kGotImage);
+        CHECK(sparse.Render(pts, sparse_result) == RenderStatus::kGotImage);
+
+        const std::vector<Image>& regions = unmerged_result.images;
+        const std::vector<Image>& clusters = sparse_result.images;
+        CHECK(regions.size() == expected_regions[i]);
+        CHECK(bounding_box_result.images.size() == 1);
+        CHECK(clusters.size() == expected_clusters[i]);
+
+        CHECK(!HasOverlap(clusters));
+        CHECK(IsPartitioned(clusters, regions));
+        CHECK(Area(clusters) <= Area(bounding_box_result.images));
+
+        std::vector<ColorRGBA> expected = Compose(regions);
+        for (const Image& image : bounding_box_result.images) {
+            CHECK(MatchesFrame(image, expected));
+        }
+        for (const Image& image : clusters) {
+            const Image* region = FindImageAt(regions, image.dst_x, image.dst_y);
+            if (region && region->width == image.width && region->height == image.height) {
+                // Regions left alone are passed through untouched
+                CHECK(image.bitmap == region->bitmap);
+                CHECK(image.content_id == region->content_id);
+            } else {
+                CHECK(MatchesFrame(image, expected));
+            }
+        }
+    }
+
+    // Top line stays alone, bottom lines are joined
+    RenderResult result;
+    CHECK(sparse.Render(0, result) == RenderStatus::kGotImage);
+    CHECK(result.images.size() == 2);
+    RenderResult regions_result;
+    CHECK(unmerged.Render(0, regions_result) == RenderStatus::kGotImage);
+    if (result.images.size() == 2 && regions_result.images.size() == 3) {
+        const Image* top = FindImageAt(result.images, regions_result.images[0].dst_x, regions_result.images[0].dst_y);
+        CHECK(top && top->width == regions_result.images[0].width && top->height == regions_result.images[0].height);
+        const Image* bottom = FindImageAt(result.images, regions_result.images[1].dst_x,
+                                          regions_result.images[1].dst_y);
+        CHECK(bottom && bottom->dst_y + bottom->height ==
+                        regions_result.images[2].dst_y + regions_result.images[2].height);
+    }
+
+    // Switching the mode back produces a single image again
+    sparse.SetRegionMergeMode(RegionMergeMode::kBoundingBox);
+    CHECK(sparse.Render(0, result) == RenderStatus::kGotImage);
+    CHECK(result.images.size() == 1);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,301 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/renderer.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+// Every PTS below is a multiple of the polling step
+constexpr int64_t kPollStep = 10;
+
+CaptionRegion MakeRegion(const std::string& text, int y) {
+    CaptionRegion region;
+    region.x = 100;
+    region.y = y;
+    region.width = 40 * static_cast<int>(text.size());
+    region.height = 60;
+    for (size_t i = 0; i < text.size(); i++) {
+        CaptionChar ch;
+        ch.type = CaptionCharType::kText;
+        ch.codepoint = static_cast<uint32_t>(text[i]);
+        ch.u8str[0] = text[i];
+        ch.x = region.x + 40 * static_cast<int>(i);
+        ch.y = y;
+        ch.char_width = 36;
+        ch.char_height = 36;
+        ch.char_horizontal_spacing = 4;
+        ch.char_vertical_spacing = 24;
+        ch.char_horizontal_scale = 1.0f;
+        ch.char_vertical_scale = 1.0f;
+        ch.text_color = ColorRGBA(255, 255, 255, 255);
+        ch.back_color = ColorRGBA(0, 0, 0, 128);
+        ch.stroke_color = ColorRGBA(0, 0, 0, 255);
+        ch.style = CharStyle::kCharStyleStroke;
+        region.chars.push_back(ch);
+    }
+    return region;
+}
+
+// Enough captions for rendering on worker threads, mixing clear screens, timeouts and repeated captions
+std::vector<Caption> MakeCaptions() {
+    std::vector<Caption> captions;
+    for (int i = 0; i < 24; i++) {
+        Caption caption;
+        caption.pts = 500 + 1000 * i;
+        caption.wait_duration = DURATION_INDEFINITE;
+        caption.plane_width = 960;
+        caption.plane_height = 540;
+        if (i % 6 == 3) {
+            // Clear screen
+        } else if (i % 6 == 1) {
+            caption.regions = captions.back().regions;    // Identical to the previous one, must be joined
+        } else {
+            caption.regions.push_back(MakeRegion("Speaker", 300));
+            caption.regions.push_back(MakeRegion("Line " + std::to_string(i), 400));
+            if (i % 4 == 0) {
+                caption.wait_duration = 700;
+            }
+        }
+        captions.push_back(std::move(caption));
+    }
+    return captions;
+}
+
+void SetupRenderer(Renderer& renderer, const std::vector<Caption>& captions) {
+    CHECK(renderer.Initialize());
+    CHECK(renderer.SetFrameSize(1920, 1080));
+    renderer.SetStoragePolicy(CaptionStoragePolicy::kUnlimited);
+    for (const Caption& caption : captions) {
+        CHECK(renderer.AppendCaption(caption));
+    }
+}
+
+struct Interval {
+    RenderStatus status = RenderStatus::kNoImage;
+    int64_t begin = 0;
+    int64_t end = 0;
+    std::vector<Image> images;
+};
+
+bool IsSameContent(const std::vector<Image>& a, const std::vector<Image>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].content_id != b[i].content_id) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IsSameImages(const std::vector<Image>& a, const std::vector<Image>& b) {
+    if (!IsSameContent(a, b)) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].width != b[i].width || a[i].height != b[i].height || a[i].dst_x != b[i].dst_x ||
+            a[i].dst_y != b[i].dst_y || a[i].changed != b[i].changed || a[i].bitmap != b[i].bitmap) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Polls Render() with a fresh renderer over [begin, end), joining consecutive results of the same content.
+// Changed flags of Render() are relative to the previous call, i.e. to the previous interval.
+std::vector<Interval> PollIntervals(Context& context, const std::vector<Caption>& captions,
+                                    int64_t begin, int64_t end) {
+    Renderer renderer(context);
+    SetupRenderer(renderer, captions);
+
+    std::vector<Interval> intervals;
+    for (int64_t pts = begin; pts < end; pts += kPollStep) {
+        RenderResult result;
+        RenderStatus status = renderer.Render(pts, result);
+        CHECK(status != RenderStatus::kError);
+        if (status == RenderStatus::kGotImageUnchanged) {
+            status = RenderStatus::kGotImage;
+        }
+        if (!intervals.empty() && intervals.back().status == status &&
+            IsSameContent(intervals.back().images, result.images)) {
+            intervals.back().end = pts + kPollStep;
+            continue;
+        }
+        intervals.push_back(Interval{status, pts, pts + kPollStep, std::move(result.images)});
+    }
+
+    // Nothing is reported before the first or after the last interval with images
+    while (!intervals.empty() && intervals.front().status == RenderStatus::kNoImage) {
+        intervals.erase(intervals.begin());
+    }
+    while (!intervals.empty() && intervals.back().status == RenderStatus::kNoImage) {
+        intervals.pop_back();
+    }
+    return intervals;
+}
+
+RenderStatus RenderIntervals(Renderer& renderer, int64_t begin, int64_t end, std::vector<Interval>& intervals) {
+    intervals.clear();
+    return renderer.RenderAllChanges(begin, end, [&](RenderStatus status, const RenderResult& result) {
+        intervals.push_back(Interval{status, result.pts, result.pts + result.duration, result.images});
+    });
+}
+
+bool IsSameIntervals(const std::vector<Interval>& a, const std::vector<Interval>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].status != b[i].status || a[i].begin != b[i].begin || a[i].end != b[i].end ||
+            !IsSameImages(a[i].images, b[i].images)) {
+            fprintf(stderr, "Interval %zu mismatch: [%lld, %lld) vs [%lld, %lld)\n", i,
+                    static_cast<long long>(a[i].begin), static_cast<long long>(a[i].end),
+                    static_cast<long long>(b[i].begin), static_cast<long long>(b[i].end));
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    Context context;
+    context.SetLogcatCallback([](LogLevel, const char*) {});
+
+    std::vector<Caption> captions = MakeCaptions();
+    Renderer renderer(context);
+    SetupRenderer(renderer, captions);
+
+    std::vector<Interval> intervals;
+
+    // Whole range, rendered on worker threads if the hardware allows
+    int64_t end = captions.back().pts + 2000;
+    CHECK(RenderIntervals(renderer, 0, end, intervals) == RenderStatus::kGotImage);
+    CHECK(IsSameIntervals(intervals, PollIntervals(context, captions, 0, end)));
+
+    // Repeated captions are joined, clear screens and timeouts produce intervals without images
+    bool has_joined = false;
+    bool has_cleared = false;
+    bool has_kept_image = false;
+    for (size_t i = 0; i < intervals.size(); i++) {
+        has_joined = has_joined || intervals[i].end - intervals[i].begin > 1000;
+        has_cleared = has_cleared || intervals[i].status == RenderStatus::kNoImage;
+        for (const Image& image : intervals[i].images) {
+            has_kept_image = has_kept_image || !image.changed;
+        }
+        if (i > 0) {
+            CHECK(intervals[i].begin == intervals[i - 1].end);
+        }
+    }
+    CHECK(has_joined);
+    CHECK(has_cleared);
+    CHECK(has_kept_image);
+
+    // Sub-ranges are clipped, few captions are rendered on the calling thread
+    for (auto [begin, range_end] : {std::pair<int64_t, int64_t>{2550, 4250}, {1400, 1700}, {5100, 9990}}) {
+        CHECK(RenderIntervals(renderer, begin, range_end, intervals) == RenderStatus::kGotImage);
+        CHECK(!intervals.empty());
+        CHECK(IsSameIntervals(intervals, PollIntervals(context, captions, begin, range_end)));
+    }
+
+    // Nothing displayed within the range
+    CHECK(RenderIntervals(renderer, 0, 500, intervals) == RenderStatus::kNoImage);
+    CHECK(intervals.empty());
+    CHECK(RenderIntervals(renderer, 3600, 4400, intervals) == RenderStatus::kNoImage);
+    CHECK(intervals.empty());
+
+    // State of Render() is not affected
+    RenderResult before;
+    RenderResult after;
+    CHECK(renderer.Render(600, before) == RenderStatus::kGotImage);
+    CHECK(RenderIntervals(renderer, 0, end, intervals) == RenderStatus::kGotImage);
+    CHECK(renderer.Render(600, after) == RenderStatus::kGotImageUnchanged);
+
+#ifdef NDEBUG
+    // Calling back into the renderer is rejected, and asserts in debug builds
+    int callbacks = 0;
+    CHECK(renderer.RenderAllChanges(0, end, [&](RenderStatus, const RenderResult&) {
+        if (callbacks++ > 0) {
+            return;
+        }
+        RenderResult result;
+        std::vector<RenderResult> results;
+        std::vector<uint8_t> buffer(1920 * 1080 * 4);
+        CHECK(renderer.Render(600, result) == RenderStatus::kError);
+        CHECK(renderer.RenderMulti(600, {{1920, 1080, 0, 0, 0, 0}}, results) == RenderStatus::kError);
+        CHECK(renderer.RenderInto(600, buffer.data(), 1920 * 4, PixelFormat::kRGBA8888) == RenderStatus::kError);
+        CHECK(renderer.RenderAllChanges(0, end, [](RenderStatus, const RenderResult&) {}) == RenderStatus::kError);
+        CHECK(!renderer.AppendCaption(captions.front()));
+        CHECK(!renderer.SetFrameSize(1280, 720));
+        renderer.SetStrokeWidth(8.0f);
+        renderer.SetPixelFormat(PixelFormat::kBGRA8888);
+        renderer.Flush();
+    }) == RenderStatus::kGotImage);
+    CHECK(callbacks > 1);
+
+    // Settings and captions are left intact
+    CHECK(RenderIntervals(renderer, 0, end, intervals) == RenderStatus::kGotImage);
+    CHECK(IsSameIntervals(intervals, PollIntervals(context, captions, 0, end)));
+#endif
+
+    // Exceptions thrown from the callback stop rendering and leave the renderer usable
+    bool thrown = false;
+    try {
+        int count = 0;
+        renderer.RenderAllChanges(0, end, [&](RenderStatus, const RenderResult&) {
+            if (++count == 3) {
+                throw std::runtime_error("callback failure");
+            }
+        });
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(RenderIntervals(renderer, 0, end, intervals) == RenderStatus::kGotImage);
+    CHECK(IsSameIntervals(intervals, PollIntervals(context, captions, 0, end)));
+    CHECK(renderer.SetFrameSize(1280, 720));
+    CHECK(renderer.Render(600, after) == RenderStatus::kGotImage);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
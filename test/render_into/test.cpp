@@ -0,0 +1,226 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/renderer.hpp"
+#include "renderer/alphablend.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+constexpr int kFrameWidth = 1920;
+constexpr int kFrameHeight = 1080;
+constexpr int kStride = kFrameWidth * 4 + 64;    // Padded, bytes beyond the frame width must stay untouched
+
+CaptionRegion MakeRegion(const std::string& text, int x, int y) {
+    CaptionRegion region;
+    region.x = x;
+    region.y = y;
+    region.width = 40 * static_cast<int>(text.size());
+    region.height = 60;
+    for (size_t i = 0; i < text.size(); i++) {
+        CaptionChar ch;
+        ch.type = CaptionCharType::kText;
+        ch.codepoint = static_cast<uint32_t>(text[i]);
+        ch.u8str[0] = text[i];
+        ch.x = region.x + 40 * static_cast<int>(i);
+        ch.y = y;
+        ch.char_width = 36;
+        ch.char_height = 36;
+        ch.char_horizontal_spacing = 4;
+        ch.char_vertical_spacing = 24;
+        ch.char_horizontal_scale = 1.0f;
+        ch.char_vertical_scale = 1.0f;
+        ch.text_color = ColorRGBA(255, 255, 255, 255);
+        ch.back_color = ColorRGBA(0, 0, 0, 128);
+        ch.stroke_color = ColorRGBA(0, 0, 0, 255);
+        ch.style = CharStyle::kCharStyleStroke;
+        region.chars.push_back(ch);
+    }
+    return region;
+}
+
+Caption MakeCaption(int64_t pts, const std::string& line, int x, int y) {
+    Caption caption;
+    caption.pts = pts;
+    caption.wait_duration = 1000;
+    caption.plane_width = 960;
+    caption.plane_height = 540;
+    caption.regions.push_back(MakeRegion(line, x, y));
+    return caption;
+}
+
+struct Surface {
+    std::vector<uint8_t> pixels = std::vector<uint8_t>(static_cast<size_t>(kStride) * kFrameHeight, 0);
+
+    ColorRGBA* Line(int y) {
+        return reinterpret_cast<ColorRGBA*>(pixels.data() + static_cast<size_t>(y) * kStride);
+    }
+};
+
+// Reference composition: blend the images returned by Render() onto a transparent surface
+Surface Compose(const std::vector<Image>& images) {
+    Surface surface;
+    for (const Image& image : images) {
+        for (int y = 0; y < image.height; y++) {
+            auto src = reinterpret_cast<const ColorRGBA*>(image.bitmap.data() + static_cast<size_t>(y) * image.stride);
+            alphablend::BlendLine(surface.Line(image.dst_y + y) + image.dst_x, src, static_cast<size_t>(image.width));
+        }
+    }
+    return surface;
+}
+
+RenderRect BoundingRect(const std::vector<Image>& images) {
+    int left = kFrameWidth, top = kFrameHeight, right = 0, bottom = 0;
+    for (const Image& image : images) {
+        left = std::min(left, image.dst_x);
+        top = std::min(top, image.dst_y);
+        right = std::max(right, image.dst_x + image.width);
+        bottom = std::max(bottom, image.dst_y + image.height);
+    }
+    return RenderRect{left, top, right - left, bottom - top};
+}
+
+RenderRect UnionRect(const RenderRect& a, const RenderRect& b) {
+    int left = std::min(a.x, b.x);
+    int top = std::min(a.y, b.y);
+    int right = std::max(a.x + a.width, b.x + b.width);
+    int bottom = std::max(a.y + a.height, b.y + b.height);
+    return RenderRect{left, top, right - left, bottom - top};
+}
+
+bool IsSameRect(const RenderRect& a, const RenderRect& b) {
+    return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+bool IsEmptyRect(const RenderRect& rect) {
+    return rect.width == 0 && rect.height == 0;
+}
+
+// Renders at pts with RenderInto() and Render(), the surface must equal the Render() images composed from scratch
+std::vector<Image> RenderBoth(Renderer& target, Renderer& reference, Surface& surface, int64_t pts,
+                              RenderRect& dirty_rect) {
+    RenderResult result;
+    RenderStatus status = reference.Render(pts, result);
+    CHECK(target.RenderInto(pts, surface.pixels.data(), kStride, PixelFormat::kRGBA8888, &dirty_rect) == status);
+    CHECK(surface.pixels == Compose(result.images).pixels);
+    return result.images;
+}
+
+}  // namespace
+
+int main() {
+    Context context;
+    context.SetLogcatCallback([](LogLevel, const char*) {});
+
+    Renderer target(context);
+    Renderer reference(context);
+    for (Renderer* renderer : {&target, &reference}) {
+        CHECK(renderer->Initialize());
+        CHECK(renderer->SetFrameSize(kFrameWidth, kFrameHeight));
+        renderer->SetStoragePolicy(CaptionStoragePolicy::kUnlimited);
+        CHECK(renderer->AppendCaption(MakeCaption(0, "Top left line", 40, 40)));
+        CHECK(renderer->AppendCaption(MakeCaption(1000, "Bottom", 500, 440)));
+        CHECK(renderer->AppendCaption(MakeCaption(1500, "Bottom line", 300, 440)));
+    }
+
+    Surface surface;
+    RenderRect dirty_rect;
+
+    // Invalid arguments are rejected without touching the surface
+    dirty_rect = RenderRect{1, 2, 3, 4};
+    CHECK(target.RenderInto(0, surface.pixels.data(), kFrameWidth * 4 - 4, PixelFormat::kRGBA8888,
+                            &dirty_rect) == RenderStatus::kError);
+    CHECK(IsEmptyRect(dirty_rect));
+    CHECK(target.RenderInto(0, nullptr, kStride, PixelFormat::kRGBA8888, &dirty_rect) == RenderStatus::kError);
+    CHECK(target.RenderInto(0, surface.pixels.data(), kStride, PixelFormat::kIndexed8,
+                            &dirty_rect) == RenderStatus::kError);
+    CHECK(surface.pixels == Surface().pixels);
+
+    // Nothing displayed yet
+    RenderBoth(target, reference, surface, -100, dirty_rect);
+    CHECK(IsEmptyRect(dirty_rect));
+
+    // First draw, dirty rect is the bounding rect of the images
+    std::vector<Image> first = RenderBoth(target, reference, surface, 0, dirty_rect);
+    CHECK(!first.empty());
+    RenderRect first_rect = BoundingRect(first);
+    CHECK(IsSameRect(dirty_rect, first_rect));
+
+    // Unchanged caption leaves the surface alone
+    RenderBoth(target, reference, surface, 500, dirty_rect);
+    CHECK(IsEmptyRect(dirty_rect));
+
+    // Caption changes, the previous rect must be erased and reported as well
+    std::vector<Image> second = RenderBoth(target, reference, surface, 1000, dirty_rect);
+    CHECK(!second.empty());
+    RenderRect second_rect = BoundingRect(second);
+    CHECK(IsSameRect(dirty_rect, UnionRect(first_rect, second_rect)));
+
+    // Overlapping replacement covering a wider area
+    std::vector<Image> third = RenderBoth(target, reference, surface, 1500, dirty_rect);
+    CHECK(!third.empty());
+    RenderRect third_rect = BoundingRect(third);
+    CHECK(IsSameRect(dirty_rect, UnionRect(second_rect, third_rect)));
+
+    // Caption disappears, the previous rect is cleared and reported
+    CHECK(target.RenderInto(2500, surface.pixels.data(), kStride, PixelFormat::kRGBA8888,
+                            &dirty_rect) == RenderStatus::kNoImage);
+    CHECK(IsSameRect(dirty_rect, third_rect));
+    CHECK(surface.pixels == Surface().pixels);
+
+    // Surface is already empty
+    CHECK(target.RenderInto(3000, surface.pixels.data(), kStride, PixelFormat::kRGBA8888,
+                            &dirty_rect) == RenderStatus::kNoImage);
+    CHECK(IsEmptyRect(dirty_rect));
+
+    // Seeking back draws again
+    std::vector<Image> redrawn = RenderBoth(target, reference, surface, 100, dirty_rect);
+    CHECK(IsSameRect(dirty_rect, BoundingRect(redrawn)));
+
+    // Flush drops the displayed caption, the next call must still erase it
+    target.Flush();
+    CHECK(target.RenderInto(100, surface.pixels.data(), kStride, PixelFormat::kRGBA8888,
+                            &dirty_rect) == RenderStatus::kNoImage);
+    CHECK(IsSameRect(dirty_rect, BoundingRect(redrawn)));
+    CHECK(surface.pixels == Surface().pixels);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
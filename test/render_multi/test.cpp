@@ -0,0 +1,192 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "aribcaption/context.hpp"
+#include "aribcaption/renderer.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+CaptionRegion MakeRegion(const std::string& text, int y) {
+    CaptionRegion region;
+    region.x = 100;
+    region.y = y;
+    region.width = 40 * static_cast<int>(text.size());
+    region.height = 60;
+    for (size_t i = 0; i < text.size(); i++) {
+        CaptionChar ch;
+        ch.type = CaptionCharType::kText;
+        ch.codepoint = static_cast<uint32_t>(text[i]);
+        ch.u8str[0] = text[i];
+        ch.x = region.x + 40 * static_cast<int>(i);
+        ch.y = y;
+        ch.char_width = 36;
+        ch.char_height = 36;
+        ch.char_horizontal_spacing = 4;
+        ch.char_vertical_spacing = 24;
+        ch.char_horizontal_scale = 1.0f;
+        ch.char_vertical_scale = 1.0f;
+        ch.text_color = ColorRGBA(255, 255, 255, 255);
+        ch.back_color = ColorRGBA(0, 0, 0, 128);
+        ch.stroke_color = ColorRGBA(0, 0, 0, 255);
+        ch.style = CharStyle::kCharStyleStroke;
+        region.chars.push_back(ch);
+    }
+    return region;
+}
+
+Caption MakeCaption(int64_t pts, const std::string& line) {
+    Caption caption;
+    caption.pts = pts;
+    caption.wait_duration = 1000;
+    caption.plane_width = 960;
+    caption.plane_height = 540;
+    caption.regions.push_back(MakeRegion("Speaker", 300));
+    caption.regions.push_back(MakeRegion(line, 400));
+    return caption;
+}
+
+bool IsSameImages(const std::vector<Image>& a, const std::vector<Image>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].width != b[i].width || a[i].height != b[i].height || a[i].stride != b[i].stride ||
+            a[i].dst_x != b[i].dst_x || a[i].dst_y != b[i].dst_y || a[i].pixel_format != b[i].pixel_format ||
+            a[i].content_id != b[i].content_id || a[i].bitmap != b[i].bitmap) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SetupRenderer(Renderer& renderer) {
+    CHECK(renderer.Initialize());
+    renderer.SetStoragePolicy(CaptionStoragePolicy::kUnlimited);
+    renderer.SetRegionCacheMemoryLimit(64 * 1024 * 1024);
+    CHECK(renderer.AppendCaption(MakeCaption(0, "First line")));
+    CHECK(renderer.AppendCaption(MakeCaption(1000, "Second line")));
+    CHECK(renderer.AppendCaption(MakeCaption(3000, "Third line")));
+}
+
+}  // namespace
+
+int main() {
+    Context context;
+    context.SetLogcatCallback([](LogLevel, const char*) {});
+
+    const std::vector<RenderTarget> targets = {
+        {1920, 1080, 0, 0, 0, 0},
+        {1280, 720, 0, 0, 0, 0},
+        {3840, 2160, 0, 0, 0, 0},
+        {1440, 1080, 60, 60, 0, 0},     // Letterboxed
+        {1920, 1080, 0, 0, 240, 240},   // Pillarboxed
+    };
+
+    Renderer multi(context);
+    SetupRenderer(multi);
+    CHECK(multi.SetFrameSize(640, 360));    // Frame size of the renderer must not be used
+
+    // One renderer per target as reference
+    std::vector<std::unique_ptr<Renderer>> references;
+    for (const RenderTarget& target : targets) {
+        references.push_back(std::make_unique<Renderer>(context));
+        Renderer& reference = *references.back();
+        SetupRenderer(reference);
+        CHECK(reference.SetFrameSize(target.frame_width, target.frame_height));
+        CHECK(reference.SetMargins(target.margin_top, target.margin_bottom, target.margin_left, target.margin_right));
+    }
+
+    auto check_against_references = [&](int64_t pts) {
+        std::vector<RenderResult> results;
+        CHECK(multi.RenderMulti(pts, targets, results) == RenderStatus::kGotImage);
+        CHECK(results.size() == targets.size());
+        for (size_t i = 0; i < targets.size() && i < results.size(); i++) {
+            RenderResult expected;
+            CHECK(references[i]->Render(pts, expected) != RenderStatus::kError);
+            CHECK(!results[i].images.empty());
+            CHECK(IsSameImages(results[i].images, expected.images));
+            CHECK(results[i].pts == expected.pts);
+            CHECK(results[i].duration == expected.duration);
+            for (const Image& image : results[i].images) {
+                CHECK(image.changed);
+            }
+        }
+    };
+
+    // Rendering the same PTS twice exercises the per-size region cache
+    for (int64_t pts : {0, 500, 1000, 3000, 3000}) {
+        check_against_references(pts);
+    }
+
+    // Pixel format conversion applies to all targets
+    multi.SetPixelFormat(PixelFormat::kBGRA8888Premultiplied);
+    for (auto& reference : references) {
+        reference->SetPixelFormat(PixelFormat::kBGRA8888Premultiplied);
+    }
+    check_against_references(1000);
+    multi.SetPixelFormat(PixelFormat::kRGBA8888);
+    for (auto& reference : references) {
+        reference->SetPixelFormat(PixelFormat::kRGBA8888);
+    }
+
+    // State of Render() is not affected
+    RenderResult before;
+    RenderResult after;
+    std::vector<RenderResult> results;
+    CHECK(multi.Render(0, before) == RenderStatus::kGotImage);
+    CHECK(multi.RenderMulti(1000, targets, results) == RenderStatus::kGotImage);
+    CHECK(multi.Render(0, after) == RenderStatus::kGotImageUnchanged);
+    CHECK(IsSameImages(before.images, after.images));
+
+    // Out of any caption
+    CHECK(multi.RenderMulti(2500, targets, results) == RenderStatus::kNoImage);
+    CHECK(results.empty());
+    CHECK(multi.RenderMulti(-100, targets, results) == RenderStatus::kNoImage);
+    CHECK(results.empty());
+
+    // Invalid targets
+    CHECK(multi.RenderMulti(0, {{1920, 1080, 0, 0, 0, 0}, {0, 720, 0, 0, 0, 0}}, results) == RenderStatus::kError);
+    CHECK(results.empty());
+    CHECK(multi.RenderMulti(0, {{1920, 1080, 600, 600, 0, 0}}, results) == RenderStatus::kError);
+    CHECK(results.empty());
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
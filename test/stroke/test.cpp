@@ -0,0 +1,155 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_GLYPH_H
+#include FT_STROKER_H
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "base/scoped_holder.hpp"
+#include "renderer/font_provider_fontconfig.hpp"
+#include "renderer/morphology.hpp"
+#include "stopwatch.hpp"
+
+using namespace aribcaption;
+
+static double ToMilliseconds(int64_t microseconds) {
+    return static_cast<double>(microseconds) / 1000.0f;
+}
+
+// Compare FT_Glyph_StrokeBorder against morphological dilation of the rasterized glyph
+int main(int argc, char** argv) {
+    constexpr int count = 100;
+    constexpr int pixel_size = 72;  // 36 dots characters on 1920x1080
+    const float radii[] = {1.5f, 3.0f, 4.5f};
+
+    const char* font_name = argc > 1 ? argv[1] : "sans-serif";
+
+    Context context;
+    FontProviderFontconfig font_provider(context);
+    font_provider.Initialize();
+
+    auto result = font_provider.GetFontFace(font_name, std::nullopt);
+    if (result.is_err()) {
+        fprintf(stderr, "Cannot find font %s\n", font_name);
+        return -1;
+    }
+    FontfaceInfo& info = result.value();
+
+    FT_Library ft_library = nullptr;
+    FT_Init_FreeType(&ft_library);
+    ScopedHolder<FT_Library> library(ft_library, FT_Done_FreeType);
+
+    FT_Face ft_face = nullptr;
+    if (FT_New_Face(library, info.filename.c_str(), info.face_index, &ft_face)) {
+        fprintf(stderr, "FT_New_Face() failed for %s\n", info.filename.c_str());
+        return -1;
+    }
+    ScopedHolder<FT_Face> face(ft_face, FT_Done_Face);
+    FT_Set_Pixel_Sizes(face, pixel_size, pixel_size);
+
+    printf("font: %s\n", info.filename.c_str());
+
+    // Prepare outlines and filling masks of printable ASCII characters
+    std::vector<FT_Glyph> outlines;
+    std::vector<std::vector<uint8_t>> masks;
+    std::vector<std::pair<int, int>> mask_sizes;
+
+    for (uint32_t ch = 0x21; ch < 0x7F; ch++) {
+        FT_UInt glyph_index = FT_Get_Char_Index(face, ch);
+        if (!glyph_index || FT_Load_Glyph(face, glyph_index, FT_LOAD_NO_BITMAP)) {
+            continue;
+        }
+
+        FT_Glyph outline = nullptr;
+        FT_Get_Glyph(face->glyph, &outline);
+
+        FT_Glyph bitmap_glyph = nullptr;
+        FT_Glyph_Copy(outline, &bitmap_glyph);
+        FT_Glyph_To_Bitmap(&bitmap_glyph, FT_RENDER_MODE_NORMAL, nullptr, true);
+        const FT_Bitmap& bmp = reinterpret_cast<FT_BitmapGlyph>(bitmap_glyph)->bitmap;
+
+        std::vector<uint8_t> mask(static_cast<size_t>(bmp.width) * bmp.rows);
+        for (uint32_t y = 0; y < bmp.rows; y++) {
+            std::copy_n(bmp.buffer + y * bmp.pitch, bmp.width, mask.begin() + y * bmp.width);
+        }
+        mask_sizes.emplace_back(static_cast<int>(bmp.width), static_cast<int>(bmp.rows));
+        FT_Done_Glyph(bitmap_glyph);
+
+        outlines.push_back(outline);
+        masks.push_back(std::move(mask));
+    }
+
+    printf("glyphs: %zu, pixel size: %d, iterations: %d\n", outlines.size(), pixel_size, count);
+
+    auto stopwatch = StopWatch::Create();
+
+    ScopedHolder<FT_Stroker> stroker(nullptr, FT_Stroker_Done);
+    FT_Stroker_New(library, &stroker);
+
+    for (float radius : radii) {
+        FT_Stroker_Set(stroker,
+                       static_cast<FT_Fixed>(radius * 64),
+                       FT_STROKER_LINECAP_ROUND,
+                       FT_STROKER_LINEJOIN_ROUND,
+                       0);
+
+        stopwatch->Start();
+        for (int i = 0; i < count; i++) {
+            for (FT_Glyph outline : outlines) {
+                FT_Glyph border = nullptr;
+                FT_Glyph_Copy(outline, &border);
+                FT_Glyph_StrokeBorder(&border, stroker, false, true);
+                FT_Glyph_To_Bitmap(&border, FT_RENDER_MODE_NORMAL, nullptr, true);
+                FT_Done_Glyph(border);
+            }
+        }
+        stopwatch->Stop();
+        int64_t outline_elapsed = stopwatch->GetMicroseconds();
+
+        size_t total_size = 0;
+        stopwatch->Start();
+        for (int i = 0; i < count; i++) {
+            for (size_t n = 0; n < masks.size(); n++) {
+                auto [width, height] = mask_sizes[n];
+                morphology::AlphaMask border = morphology::DilateMask(masks[n].data(), width, height, width, radius);
+                total_size += border.alphas.size();
+            }
+        }
+        stopwatch->Stop();
+        int64_t dilation_elapsed = stopwatch->GetMicroseconds();
+
+        size_t glyph_count = outlines.size() * count;
+        printf("radius %.1fpx: FT_Glyph_StrokeBorder = %lfms/glyph, DilateMask = %lfms/glyph, speedup = %.2fx, mask = %zu bytes/glyph\n",
+               radius,
+               ToMilliseconds(outline_elapsed) / static_cast<double>(glyph_count),
+               ToMilliseconds(dilation_elapsed) / static_cast<double>(glyph_count),
+               static_cast<double>(outline_elapsed) / static_cast<double>(dilation_elapsed),
+               total_size / glyph_count);
+    }
+
+    for (FT_Glyph outline : outlines) {
+        FT_Done_Glyph(outline);
+    }
+
+    return 0;
+}
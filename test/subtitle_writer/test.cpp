@@ -0,0 +1,238 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "aribcaption/subtitle_writer.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+struct Event {
+    int64_t begin = 0;
+    int64_t end = 0;
+    std::string text;
+
+    bool operator==(const Event& other) const {
+        return begin == other.begin && end == other.end && text == other.text;
+    }
+};
+
+Caption MakeCaption(int64_t pts, int64_t duration, const char* text, int y, bool clear_screen) {
+    Caption caption;
+    caption.pts = pts;
+    caption.wait_duration = duration;
+    caption.plane_width = 960;
+    caption.plane_height = 540;
+    caption.flags = clear_screen ? kCaptionFlagsClearScreen : kCaptionFlagsDefault;
+    if (duration != DURATION_INDEFINITE) {
+        caption.flags = static_cast<CaptionFlags>(caption.flags | kCaptionFlagsWaitDuration);
+    }
+    if (!text) {
+        return caption;
+    }
+
+    CaptionRegion region;
+    region.x = 100;
+    region.y = y;
+    region.height = 60;
+    for (int i = 0; text[i]; i++) {
+        CaptionChar ch;
+        ch.type = CaptionCharType::kText;
+        ch.codepoint = static_cast<uint32_t>(text[i]);
+        ch.u8str[0] = text[i];
+        ch.x = region.x + 40 * i;
+        ch.y = y;
+        ch.char_width = 36;
+        ch.char_height = 36;
+        ch.char_horizontal_spacing = 4;
+        ch.char_vertical_spacing = 24;
+        ch.char_horizontal_scale = 1.0f;
+        ch.char_vertical_scale = 1.0f;
+        ch.text_color = ColorRGBA(255, 255, 255, 255);
+        ch.back_color = ColorRGBA(0, 0, 0, 128);
+        region.chars.push_back(ch);
+        region.width += 40;
+    }
+    caption.regions.push_back(std::move(region));
+    caption.text = text;
+    return caption;
+}
+
+// h:mm:ss.cc for ASS, hh:mm:ss.mmm for WebVTT
+int64_t ParseTime(const std::string& time) {
+    int h = 0, m = 0, s = 0, fraction = 0;
+    char separator = 0;
+    if (sscanf(time.c_str(), "%d:%d:%d%c%d", &h, &m, &s, &separator, &fraction) != 5) {
+        return -1;
+    }
+    size_t digits = time.size() - time.find(separator) - 1;
+    int64_t ms = digits == 2 ? fraction * 10 : fraction;
+    return ((h * 60 + m) * 60 + s) * 1000 + ms;
+}
+
+std::string StripTags(const std::string& text, char open, char close) {
+    std::string stripped;
+    bool in_tag = false;
+    for (char c : text) {
+        if (c == open) {
+            in_tag = true;
+        } else if (c == close) {
+            in_tag = false;
+        } else if (!in_tag) {
+            stripped.push_back(c);
+        }
+    }
+    return stripped;
+}
+
+std::vector<std::string> SplitLines(const std::string& text) {
+    std::vector<std::string> lines;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find('\n', begin);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        lines.push_back(text.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return lines;
+}
+
+// Text events, i.e. Dialogue lines of the Default style, backgrounds are drawn by separate events
+std::vector<Event> ParseASS(const std::string& ass) {
+    std::vector<Event> events;
+    for (const std::string& line : SplitLines(ass)) {
+        if (line.rfind("Dialogue: ", 0) != 0) {
+            continue;
+        }
+        std::vector<std::string> fields;
+        size_t begin = 0;
+        while (fields.size() < 9) {
+            size_t comma = line.find(',', begin);
+            fields.push_back(line.substr(begin, comma - begin));
+            begin = comma + 1;
+        }
+        if (fields[3] != "Default") {
+            continue;
+        }
+        events.push_back(Event{ParseTime(fields[1]), ParseTime(fields[2]), StripTags(line.substr(begin), '{', '}')});
+    }
+    return events;
+}
+
+std::vector<Event> ParseWebVTT(const std::string& vtt) {
+    std::vector<Event> events;
+    std::vector<std::string> lines = SplitLines(vtt);
+    for (size_t i = 0; i + 1 < lines.size(); i++) {
+        size_t arrow = lines[i].find(" --> ");
+        if (arrow == std::string::npos) {
+            continue;
+        }
+        std::string end = lines[i].substr(arrow + 5, lines[i].find(' ', arrow + 5) - arrow - 5);
+        events.push_back(Event{ParseTime(lines[i].substr(0, arrow)), ParseTime(end),
+                               StripTags(lines[i + 1], '<', '>')});
+    }
+    return events;
+}
+
+std::string WriteCaptions(SubtitleFormat format) {
+    Context context;
+    SubtitleWriter writer(context);
+    std::string out;
+    bool initialized = writer.Initialize(format, [&out](const char* data, size_t size) {
+        out.append(data, size);
+    }, 64);  // Small buffer, output is written in many chunks
+    CHECK(initialized);
+
+    // Captions without kCaptionFlagsClearScreen are displayed on top of the displayed ones
+    CHECK(writer.Write(MakeCaption(1000, DURATION_INDEFINITE, "Hello", 400, true)));
+    CHECK(writer.Write(MakeCaption(2000, DURATION_INDEFINITE, "World", 460, false)));
+    // Neither clears the screen nor adds regions, nothing changes
+    CHECK(writer.Write(MakeCaption(2500, 1000, nullptr, 0, false)));
+    // Clears the screen only
+    CHECK(writer.Write(MakeCaption(3000, DURATION_INDEFINITE, nullptr, 0, true)));
+
+    // Captions ended by their durations are written in PTS order
+    CHECK(writer.Write(MakeCaption(4000, 500, "Timed", 400, true)));
+    CHECK(writer.Write(MakeCaption(4200, 2000, "Over", 460, false)));
+    CHECK(writer.Write(MakeCaption(5000, DURATION_INDEFINITE, "Last", 340, false)));
+
+    CHECK(!writer.Write(MakeCaption(4900, DURATION_INDEFINITE, "Early", 400, true)));
+    CHECK(!writer.Write(MakeCaption(PTS_NOPTS, DURATION_INDEFINITE, "NoPTS", 400, true)));
+
+    writer.Flush(7000);
+    return out;
+}
+
+void CheckEvents(const char* name, const std::vector<Event>& events) {
+    const std::vector<Event> expected = {
+        {1000, 3000, "Hello"},
+        {2000, 3000, "World"},
+        {4000, 4500, "Timed"},
+        {4200, 6200, "Over"},
+        {5000, 7000, "Last"},
+    };
+    if (events != expected) {
+        fprintf(stderr, "%s: unexpected events:\n", name);
+        for (const Event& event : events) {
+            fprintf(stderr, "  %lld - %lld: %s\n", static_cast<long long>(event.begin),
+                    static_cast<long long>(event.end), event.text.c_str());
+        }
+        failures++;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string ass = WriteCaptions(SubtitleFormat::kASS);
+    CHECK(ass.rfind("[Script Info]", 0) == 0);
+    CHECK(ass.find("PlayResX: 960\n") != std::string::npos);
+    CHECK(ass.find("PlayResY: 540\n") != std::string::npos);
+    CHECK(ass.find("[Events]") != std::string::npos);
+    CHECK(ass.find("Dialogue: 0,0:00:01.00,0:00:03.00,Background,") != std::string::npos);
+    CheckEvents("ASS", ParseASS(ass));
+
+    std::string vtt = WriteCaptions(SubtitleFormat::kWebVTT);
+    CHECK(vtt.rfind("WEBVTT\n\nSTYLE\n", 0) == 0);
+    CHECK(vtt.find("::cue(.white) { color: #FFFFFF; }") != std::string::npos);
+    CHECK(vtt.find("<c.white.bg_black>Hello</c>") != std::string::npos);
+    CheckEvents("WebVTT", ParseWebVTT(vtt));
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,327 @@
+/*
+* Copyright (C) 2021 magicxqq <xqq@xqq.im>. All rights reserved.
+*
+* This file is part of libaribcaption.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+* WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+* ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+* WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+* ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+* OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "aribcaption/image.hpp"
+
+using namespace aribcaption;
+
+namespace {
+
+constexpr int kFrameWidth = 37;   // odd sizes exercise the partial chroma blocks at the edges
+constexpr int kFrameHeight = 23;
+constexpr int kStridePadding = 8;
+constexpr uint8_t kPaddingByte = 0xA5;
+
+// Floating-point model of the blending: luma per pixel, chroma per 2x2 block with the alpha-weighted color
+struct ReferenceFrame {
+    int bit_depth = 8;
+    double kr = 0.0, kb = 0.0;
+    double y_scale = 0.0, c_scale = 0.0, y_offset = 0.0, c_offset = 0.0;
+    std::vector<double> y, u, v;
+
+    ReferenceFrame(YUVColorMatrix matrix, YUVColorRange range, int depth) : bit_depth(depth) {
+        kr = matrix == YUVColorMatrix::kBT601 ? 0.299 : 0.2126;
+        kb = matrix == YUVColorMatrix::kBT601 ? 0.114 : 0.0722;
+        double max_value = (1 << depth) - 1;
+        if (range == YUVColorRange::kLimited) {
+            y_scale = 219.0 * (1 << (depth - 8)) / 255.0;
+            c_scale = 224.0 * (1 << (depth - 8)) / 255.0;
+            y_offset = 16 << (depth - 8);
+        } else {
+            y_scale = c_scale = max_value / 255.0;
+        }
+        c_offset = 128 << (depth - 8);
+    }
+
+    [[nodiscard]] double Y(const uint8_t* p) const {
+        return y_offset + y_scale * (kr * p[0] + (1.0 - kr - kb) * p[1] + kb * p[2]);
+    }
+    [[nodiscard]] double U(const uint8_t* p) const {
+        double kg = 1.0 - kr - kb;
+        return c_offset + c_scale * 0.5 * (-kr * p[0] - kg * p[1] + (1.0 - kb) * p[2]) / (1.0 - kb);
+    }
+    [[nodiscard]] double V(const uint8_t* p) const {
+        double kg = 1.0 - kr - kb;
+        return c_offset + c_scale * 0.5 * ((1.0 - kr) * p[0] - kg * p[1] - kb * p[2]) / (1.0 - kr);
+    }
+};
+
+struct TestImage {
+    int width = 0;
+    int height = 0;
+    int dst_x = 0;
+    int dst_y = 0;
+    std::vector<uint8_t> rgba;
+};
+
+uint32_t NextRandom(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+TestImage MakeImage(int width, int height, int dst_x, int dst_y, uint32_t& state) {
+    TestImage image{width, height, dst_x, dst_y, std::vector<uint8_t>(static_cast<size_t>(width) * height * 4)};
+    for (size_t i = 0; i < image.rgba.size(); i += 4) {
+        image.rgba[i + 0] = static_cast<uint8_t>(NextRandom(state));
+        image.rgba[i + 1] = static_cast<uint8_t>(NextRandom(state));
+        image.rgba[i + 2] = static_cast<uint8_t>(NextRandom(state));
+        // Mix fully transparent, opaque and translucent pixels
+        uint32_t kind = NextRandom(state) % 4;
+        image.rgba[i + 3] = kind == 0 ? 0 : kind == 1 ? 255 : static_cast<uint8_t>(NextRandom(state));
+    }
+    return image;
+}
+
+void BlendReference(ReferenceFrame& ref, const TestImage& image) {
+    auto pixel_at = [&](int x, int y) -> const uint8_t* {
+        int ix = x - image.dst_x;
+        int iy = y - image.dst_y;
+        if (ix < 0 || iy < 0 || ix >= image.width || iy >= image.height) {
+            return nullptr;
+        }
+        return image.rgba.data() + (static_cast<size_t>(iy) * image.width + ix) * 4;
+    };
+
+    for (int y = 0; y < kFrameHeight; y++) {
+        for (int x = 0; x < kFrameWidth; x++) {
+            const uint8_t* p = pixel_at(x, y);
+            if (!p) {
+                continue;
+            }
+            double& dst = ref.y[y * kFrameWidth + x];
+            dst = std::round((ref.Y(p) * p[3] + dst * (255 - p[3])) / 255.0);
+        }
+    }
+
+    int chroma_width = (kFrameWidth + 1) / 2;
+    for (int by = 0; by < (kFrameHeight + 1) / 2; by++) {
+        for (int bx = 0; bx < chroma_width; bx++) {
+            double sum_a = 0.0, sum_u = 0.0, sum_v = 0.0;
+            int pixels = 0;
+            for (int y = by * 2; y < by * 2 + 2 && y < kFrameHeight; y++) {
+                for (int x = bx * 2; x < bx * 2 + 2 && x < kFrameWidth; x++) {
+                    pixels++;
+                    if (const uint8_t* p = pixel_at(x, y)) {
+                        sum_a += p[3];
+                        sum_u += p[3] * ref.U(p);
+                        sum_v += p[3] * ref.V(p);
+                    }
+                }
+            }
+            if (sum_a == 0.0) {
+                continue;
+            }
+            double weight = pixels * 255.0;
+            double& u = ref.u[by * chroma_width + bx];
+            double& v = ref.v[by * chroma_width + bx];
+            u = std::round((sum_u + (weight - sum_a) * u) / weight);
+            v = std::round((sum_v + (weight - sum_a) * v) / weight);
+        }
+    }
+}
+
+const char* FormatName(YUVFormat format) {
+    switch (format) {
+        case YUVFormat::kI420: return "I420";
+        case YUVFormat::kNV12: return "NV12";
+        case YUVFormat::kI420P10: return "I420P10";
+        case YUVFormat::kP010: return "P010";
+    }
+    return "unknown";
+}
+
+// Returns the count of mismatched samples
+int RunCase(YUVFormat format, YUVColorMatrix matrix, YUVColorRange range, const std::vector<TestImage>& images) {
+    bool high_depth = format == YUVFormat::kI420P10 || format == YUVFormat::kP010;
+    bool interleaved = format == YUVFormat::kNV12 || format == YUVFormat::kP010;
+    int sample_size = high_depth ? 2 : 1;
+    int shift = format == YUVFormat::kP010 ? 6 : 0;
+    int chroma_width = (kFrameWidth + 1) / 2;
+    int chroma_height = (kFrameHeight + 1) / 2;
+
+    ReferenceFrame ref(matrix, range, high_depth ? 10 : 8);
+    ref.y.resize(static_cast<size_t>(kFrameWidth) * kFrameHeight);
+    ref.u.resize(static_cast<size_t>(chroma_width) * chroma_height);
+    ref.v.resize(ref.u.size());
+
+    // Random initial frame content, so that blending with the destination is covered
+    uint32_t state = 12345;
+    int max_value = (1 << ref.bit_depth) - 1;
+    for (double& sample : ref.y) sample = NextRandom(state) % (max_value + 1);
+    for (double& sample : ref.u) sample = NextRandom(state) % (max_value + 1);
+    for (double& sample : ref.v) sample = NextRandom(state) % (max_value + 1);
+
+    YUVFrame frame;
+    frame.format = format;
+    frame.color_matrix = matrix;
+    frame.color_range = range;
+    frame.width = kFrameWidth;
+    frame.height = kFrameHeight;
+
+    int plane_count = interleaved ? 2 : 3;
+    std::vector<uint8_t> planes[3];
+    for (int i = 0; i < plane_count; i++) {
+        int width = i == 0 ? kFrameWidth : chroma_width * (interleaved ? 2 : 1);
+        int height = i == 0 ? kFrameHeight : chroma_height;
+        frame.strides[i] = width * sample_size + kStridePadding;
+        planes[i].assign(static_cast<size_t>(frame.strides[i]) * height, kPaddingByte);
+        frame.planes[i] = planes[i].data();
+    }
+
+    auto sample_ptr = [&](int plane, int x, int y) {
+        return frame.planes[plane] + static_cast<ptrdiff_t>(y) * frame.strides[plane] + x * sample_size;
+    };
+    auto load = [&](int plane, int x, int y) -> int {
+        uint8_t* p = sample_ptr(plane, x, y);
+        if (sample_size == 1) {
+            return *p;
+        }
+        uint16_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    };
+    auto store = [&](int plane, int x, int y, int value) {
+        uint8_t* p = sample_ptr(plane, x, y);
+        if (sample_size == 1) {
+            *p = static_cast<uint8_t>(value);
+        } else {
+            auto sample = static_cast<uint16_t>(value << shift);
+            memcpy(p, &sample, sizeof(sample));
+        }
+    };
+    auto chroma_at = [&](int component, int x) {
+        return interleaved ? std::make_pair(1, x * 2 + component) : std::make_pair(1 + component, x);
+    };
+
+    for (int y = 0; y < kFrameHeight; y++) {
+        for (int x = 0; x < kFrameWidth; x++) {
+            store(0, x, y, static_cast<int>(ref.y[y * kFrameWidth + x]));
+        }
+    }
+    for (int y = 0; y < chroma_height; y++) {
+        for (int x = 0; x < chroma_width; x++) {
+            auto [u_plane, u_x] = chroma_at(0, x);
+            auto [v_plane, v_x] = chroma_at(1, x);
+            store(u_plane, u_x, y, static_cast<int>(ref.u[y * chroma_width + x]));
+            store(v_plane, v_x, y, static_cast<int>(ref.v[y * chroma_width + x]));
+        }
+    }
+
+    for (const TestImage& image : images) {
+        Image caption_image;
+        caption_image.width = image.width;
+        caption_image.height = image.height;
+        caption_image.stride = image.width * 4;
+        caption_image.dst_x = image.dst_x;
+        caption_image.dst_y = image.dst_y;
+        caption_image.pixel_format = PixelFormat::kRGBA8888;
+        caption_image.bitmap.assign(image.rgba.begin(), image.rgba.end());
+        if (!BlendImageToYUVFrame(caption_image, frame)) {
+            fprintf(stderr, "%s: BlendImageToYUVFrame() failed\n", FormatName(format));
+            return 1;
+        }
+        BlendReference(ref, image);
+    }
+
+    // Fixed-point arithmetic may differ from the reference by one step of rounding
+    constexpr int kTolerance = 1;
+    int mismatches = 0;
+    auto check = [&](const char* plane_name, int plane, int x, int y, double expected) {
+        int value = load(plane, x, y);
+        if (value & ((1 << shift) - 1)) {
+            fprintf(stderr, "%s: %s(%d, %d) has low bits set: 0x%04x\n", FormatName(format), plane_name, x, y, value);
+            mismatches++;
+            return;
+        }
+        value >>= shift;
+        if (std::abs(value - static_cast<int>(expected)) > kTolerance) {
+            if (mismatches < 10) {
+                fprintf(stderr, "%s: %s(%d, %d) = %d, expected %d\n",
+                        FormatName(format), plane_name, x, y, value, static_cast<int>(expected));
+            }
+            mismatches++;
+        }
+    };
+
+    for (int y = 0; y < kFrameHeight; y++) {
+        for (int x = 0; x < kFrameWidth; x++) {
+            check("Y", 0, x, y, ref.y[y * kFrameWidth + x]);
+        }
+    }
+    for (int y = 0; y < chroma_height; y++) {
+        for (int x = 0; x < chroma_width; x++) {
+            auto [u_plane, u_x] = chroma_at(0, x);
+            auto [v_plane, v_x] = chroma_at(1, x);
+            check("U", u_plane, u_x, y, ref.u[y * chroma_width + x]);
+            check("V", v_plane, v_x, y, ref.v[y * chroma_width + x]);
+        }
+    }
+
+    // Bytes past the end of each line must be left untouched
+    for (int i = 0; i < plane_count; i++) {
+        int line_bytes = frame.strides[i] - kStridePadding;
+        for (size_t offset = 0; offset < planes[i].size(); offset += frame.strides[i]) {
+            for (int b = line_bytes; b < frame.strides[i]; b++) {
+                if (planes[i][offset + b] != kPaddingByte) {
+                    fprintf(stderr, "%s: padding of plane %d was overwritten\n", FormatName(format), i);
+                    return mismatches + 1;
+                }
+            }
+        }
+    }
+
+    return mismatches;
+}
+
+}  // namespace
+
+int main() {
+    uint32_t state = 1;
+    std::vector<TestImage> images;
+    images.push_back(MakeImage(20, 13, -3, 5, state));     // clipped at the left, odd position
+    images.push_back(MakeImage(16, 12, 25, 15, state));    // clipped at the right and the bottom
+    images.push_back(MakeImage(9, 7, 10, -2, state));      // clipped at the top, overlaps the first one
+    images.push_back(MakeImage(40, 30, -1, -1, state));    // covers the whole frame
+
+    const YUVFormat formats[] = {YUVFormat::kI420, YUVFormat::kNV12, YUVFormat::kI420P10, YUVFormat::kP010};
+    const YUVColorMatrix matrices[] = {YUVColorMatrix::kBT601, YUVColorMatrix::kBT709};
+    const YUVColorRange ranges[] = {YUVColorRange::kLimited, YUVColorRange::kFull};
+
+    int failed = 0;
+    for (YUVFormat format : formats) {
+        for (YUVColorMatrix matrix : matrices) {
+            for (YUVColorRange range : ranges) {
+                int mismatches = RunCase(format, matrix, range, images);
+                printf("%-8s %s %-7s: %s\n", FormatName(format),
+                       matrix == YUVColorMatrix::kBT601 ? "BT.601" : "BT.709",
+                       range == YUVColorRange::kLimited ? "limited" : "full",
+                       mismatches ? "FAILED" : "OK");
+                if (mismatches) {
+                    failed++;
+                }
+            }
+        }
+    }
+
+    return failed ? 1 : 0;
+}